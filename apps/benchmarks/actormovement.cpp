@@ -0,0 +1,260 @@
+/// Times a frame of actor movement traces on a heightfield with obstacles, as the number of actors
+/// grows, serially and on a thread pool, and checks that both produce the same positions.
+///
+/// Each actor does the traces of a typical step of the movement solver: a trace in the direction
+/// of movement, a step up, forward and down when blocked, and a trace down to the ground.
+///
+/// Usage: bench_actormovement [thread count] [frames]
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <btBulletDynamicsCommon.h>
+
+#include <OgreRoot.h>
+
+#include <openengine/bullet/physic.hpp>
+#include <openengine/bullet/trace.h>
+#include <openengine/bullet/BtOgreExtras.h>
+
+#include <components/nifbullet/bulletnifloader.hpp>
+#include <components/misc/threadpool.hpp>
+
+namespace
+{
+    const int sVerts = 65;
+    const float sTriSize = 128.f;
+    const float sCellSize = sTriSize * (sVerts-1);
+
+    struct Actor
+    {
+        OEngine::Physic::RigidBody *mBody;
+        Ogre::Vector3 mPosition;
+        Ogre::Vector3 mVelocity;
+        Ogre::Vector3 mResult;
+    };
+
+    class Scene
+    {
+            OEngine::Physic::PhysicEngine mEngine;
+            std::vector<float> mHeights;
+            btCylinderShapeZ mActorShape;
+            btBoxShape mObstacleShape;
+            std::vector<OEngine::Physic::RigidBody *> mBodies;
+
+            OEngine::Physic::RigidBody *addBody (btCollisionShape *shape, const Ogre::Vector3& position,
+                int group, int mask)
+            {
+                btRigidBody::btRigidBodyConstructionInfo info (0, 0, shape);
+                OEngine::Physic::RigidBody *body = new OEngine::Physic::RigidBody (info, "bench");
+                body->setCollisionFlags (btCollisionObject::CF_KINEMATIC_OBJECT);
+                body->setActivationState (DISABLE_DEACTIVATION);
+                body->getWorldTransform().setOrigin (BtOgre::Convert::toBullet (position));
+                mEngine.mDynamicsWorld->addRigidBody (body, group, mask);
+                mBodies.push_back (body);
+                return body;
+            }
+
+        public:
+
+            std::vector<Actor> mActors;
+
+            Scene()
+            : mEngine (new NifBullet::ManualBulletShapeLoader), mHeights (sVerts*sVerts),
+              mActorShape (btVector3 (30, 30, 64)), mObstacleShape (btVector3 (100, 100, 150))
+            {
+                for (int y=0; y<sVerts; ++y)
+                    for (int x=0; x<sVerts; ++x)
+                        mHeights[y*sVerts+x] = 200 * std::sin (x * 0.3f) * std::cos (y * 0.2f);
+
+                mEngine.addHeightField (&mHeights[0], 0, 0, 0, sTriSize, sVerts);
+
+                for (int i=0; i<64; ++i)
+                    addBody (&mObstacleShape, Ogre::Vector3 ((i%8 + 0.5f) * sCellSize/8, (i/8 + 0.5f) * sCellSize/8, 100),
+                        OEngine::Physic::CollisionType_World, OEngine::Physic::CollisionType_Actor);
+            }
+
+            ~Scene()
+            {
+                for (std::vector<OEngine::Physic::RigidBody *>::iterator iter (mBodies.begin());
+                    iter!=mBodies.end(); ++iter)
+                {
+                    mEngine.mDynamicsWorld->removeRigidBody (*iter);
+                    delete *iter;
+                }
+
+                mEngine.removeHeightField (0, 0);
+            }
+
+            void addActors (int count)
+            {
+                const int mask = OEngine::Physic::CollisionType_World | OEngine::Physic::CollisionType_HeightMap
+                    | OEngine::Physic::CollisionType_Actor;
+
+                for (int i=0; i<count; ++i)
+                {
+                    // deterministic pseudo-random spread
+                    int index = static_cast<int> (mActors.size());
+                    float x = std::fmod (index * 677.f, sCellSize-200) + 100;
+                    float y = std::fmod (index * 1031.f, sCellSize-200) + 100;
+                    float angle = index * 2.4f;
+
+                    Actor actor;
+                    actor.mPosition = Ogre::Vector3 (x, y, 400);
+                    actor.mVelocity = Ogre::Vector3 (std::cos (angle), std::sin (angle), 0) * 200;
+                    actor.mBody = addBody (&mActorShape, actor.mPosition, OEngine::Physic::CollisionType_Actor, mask);
+                    mActors.push_back (actor);
+                }
+            }
+
+            /// Same kind of traces as MovementSolver::move
+            void solve (size_t begin, size_t end, float time)
+            {
+                for (size_t i=begin; i<end; ++i)
+                {
+                    Actor& actor = mActors[i];
+
+                    OEngine::Physic::ActorTracer tracer;
+                    Ogre::Vector3 position = actor.mPosition;
+                    Ogre::Vector3 toMove = actor.mVelocity * time;
+
+                    tracer.doTrace (actor.mBody, position, position + toMove, &mEngine);
+                    position = tracer.mEndPos;
+
+                    if (tracer.mFraction < 1.0f)
+                    {
+                        OEngine::Physic::ActorTracer stepper;
+                        stepper.doTrace (actor.mBody, position, position + Ogre::Vector3 (0, 0, 34), &mEngine);
+                        tracer.doTrace (actor.mBody, stepper.mEndPos, stepper.mEndPos + toMove * (1-tracer.mFraction),
+                            &mEngine);
+                        stepper.doTrace (actor.mBody, tracer.mEndPos, tracer.mEndPos - Ogre::Vector3 (0, 0, 62),
+                            &mEngine);
+                        position = stepper.mEndPos;
+                    }
+
+                    tracer.doTrace (actor.mBody, position, position - Ogre::Vector3 (0, 0, 64), &mEngine);
+                    actor.mResult = tracer.mEndPos;
+                }
+            }
+
+            /// Move the collision bodies to the results, as World::doPhysics does.
+            void apply()
+            {
+                for (std::vector<Actor>::iterator iter (mActors.begin()); iter!=mActors.end(); ++iter)
+                {
+                    iter->mPosition = iter->mResult;
+
+                    // Walk back and forth within the cell
+                    if (iter->mPosition.x<0 || iter->mPosition.x>sCellSize)
+                        iter->mVelocity.x = -iter->mVelocity.x;
+                    if (iter->mPosition.y<0 || iter->mPosition.y>sCellSize)
+                        iter->mVelocity.y = -iter->mVelocity.y;
+
+                    iter->mBody->getWorldTransform().setOrigin (BtOgre::Convert::toBullet (iter->mPosition));
+                    mEngine.mDynamicsWorld->updateSingleAabb (iter->mBody);
+                }
+            }
+
+            /// Put the actors back to an earlier state of mActors.
+            void restore (const std::vector<Actor>& actors)
+            {
+                mActors = actors;
+
+                for (std::vector<Actor>::iterator iter (mActors.begin()); iter!=mActors.end(); ++iter)
+                {
+                    iter->mBody->getWorldTransform().setOrigin (BtOgre::Convert::toBullet (iter->mPosition));
+                    mEngine.mDynamicsWorld->updateSingleAabb (iter->mBody);
+                }
+            }
+    };
+
+    /// \return ms per frame
+    double run (Scene& scene, Misc::ThreadPool *pool, int frames, std::vector<Ogre::Vector3>& positions)
+    {
+        const float time = 1.f/60;
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int frame=0; frame<frames; ++frame)
+        {
+            size_t count = scene.mActors.size();
+
+            if (pool)
+            {
+                size_t ranges = std::min (count, static_cast<size_t> (pool->getThreadCount() * 4));
+                for (size_t i=0; i<ranges; ++i)
+                    pool->push (boost::bind (&Scene::solve, &scene, count*i/ranges, count*(i+1)/ranges, time));
+                pool->wait();
+            }
+            else
+                scene.solve (0, count, time);
+
+            scene.apply();
+        }
+
+        boost::posix_time::time_duration duration =
+            boost::posix_time::microsec_clock::universal_time() - start;
+
+        positions.clear();
+        for (std::vector<Actor>::const_iterator iter (scene.mActors.begin()); iter!=scene.mActors.end(); ++iter)
+            positions.push_back (iter->mPosition);
+
+        return duration.total_microseconds() / 1000.0 / frames;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    unsigned int threads = argc>1 ? std::atoi (argv[1]) : 0;
+    int frames = argc>2 ? std::max (1, std::atoi (argv[2])) : 60;
+
+    try
+    {
+        // Need this for Ogre's getSingleton
+        new Ogre::Root ("", "", "bench_actormovement.log");
+
+        Misc::ThreadPool pool (threads);
+
+        std::cout << "frames of actor movement, " << pool.getThreadCount() << " threads" << std::endl;
+
+        Scene scene;
+
+        for (int actors=25; actors<=1600; actors*=2)
+        {
+            scene.addActors (actors - static_cast<int> (scene.mActors.size()));
+
+            // Both runs start from the same state
+            std::vector<Actor> start = scene.mActors;
+
+            std::vector<Ogre::Vector3> serialPositions, parallelPositions;
+
+            double serial = run (scene, 0, frames, serialPositions);
+
+            scene.restore (start);
+
+            double parallel = run (scene, &pool, frames, parallelPositions);
+
+            std::cout << actors << " actors: serial " << serial << " ms, parallel " << parallel << " ms ("
+                << serial / parallel << "x)" << std::endl;
+
+            if (serialPositions!=parallelPositions)
+            {
+                std::cerr << "error: serial and parallel movement produced different positions" << std::endl;
+                return 1;
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
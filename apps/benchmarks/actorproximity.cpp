@@ -0,0 +1,155 @@
+/// Times the head tracking search of Actors::update, a full scan over all actors as before
+/// against queries of Misc::SpatialGrid, with a few hundred actors summoned into one cell, and
+/// checks that both find the same actors.
+///
+/// Each frame, the actors walk a little, the grid is brought up to date and every actor looks for
+/// the actors within head tracking distance, in the same order as PtrActorMap.
+///
+/// Usage: bench_actorproximity [actor count] [frames]
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <components/misc/spatialgrid.hpp>
+
+namespace
+{
+    // The default of fMaxHeadTrackDistance
+    const float sHeadTrackDistance = 400;
+
+    struct Actor
+    {
+        float mPosition[3];
+        float mDirection;
+    };
+
+    float getSquaredDistance (const Actor& left, const Actor& right)
+    {
+        float dx = left.mPosition[0] - right.mPosition[0];
+        float dy = left.mPosition[1] - right.mPosition[1];
+        float dz = left.mPosition[2] - right.mPosition[2];
+        return dx*dx + dy*dy + dz*dz;
+    }
+
+    /// Summoned around the player, in a cell of 8192 units
+    std::vector<Actor> makeActors (int count)
+    {
+        std::vector<Actor> actors (count);
+
+        for (int i=0; i<count; ++i)
+        {
+            float angle = i * 2.4f;
+            // spread evenly over the area around the player
+            float distance = 3500 * std::sqrt (((i * 577) % 1000 + 0.5f) / 1000);
+
+            actors[i].mPosition[0] = 4096 + distance * std::cos (angle);
+            actors[i].mPosition[1] = 4096 + distance * std::sin (angle);
+            actors[i].mPosition[2] = (i * 31) % 200;
+            actors[i].mDirection = angle * 3;
+        }
+
+        return actors;
+    }
+
+    void walk (std::vector<Actor>& actors, float distance)
+    {
+        for (std::vector<Actor>::iterator iter (actors.begin()); iter!=actors.end(); ++iter)
+        {
+            iter->mPosition[0] += distance * std::cos (iter->mDirection);
+            iter->mPosition[1] += distance * std::sin (iter->mDirection);
+            iter->mDirection += 0.01f;
+        }
+    }
+
+    /// \return ms per frame
+    double runScan (std::vector<Actor> actors, int frames, std::vector<int>& pairs)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int frame=0; frame<frames; ++frame)
+        {
+            walk (actors, 3);
+
+            for (size_t i=0; i<actors.size(); ++i)
+                for (size_t j=0; j<actors.size(); ++j)
+                {
+                    if (i==j)
+                        continue;
+
+                    if (getSquaredDistance (actors[i], actors[j])<=sHeadTrackDistance*sHeadTrackDistance)
+                        pairs.push_back (static_cast<int> (j));
+                }
+        }
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0 / frames;
+    }
+
+    /// \return ms per frame
+    double runGrid (std::vector<Actor> actors, int frames, std::vector<int>& pairs)
+    {
+        Misc::SpatialGrid<int> grid (1024);
+        std::vector<int> found;
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int frame=0; frame<frames; ++frame)
+        {
+            walk (actors, 3);
+
+            for (size_t i=0; i<actors.size(); ++i)
+                grid.update (static_cast<int> (i), actors[i].mPosition[0], actors[i].mPosition[1],
+                    actors[i].mPosition[2]);
+
+            for (size_t i=0; i<actors.size(); ++i)
+            {
+                found.clear();
+                grid.query (actors[i].mPosition[0], actors[i].mPosition[1], actors[i].mPosition[2],
+                    sHeadTrackDistance, found);
+                std::sort (found.begin(), found.end());
+
+                for (std::vector<int>::const_iterator iter (found.begin()); iter!=found.end(); ++iter)
+                    if (*iter!=static_cast<int> (i))
+                        pairs.push_back (*iter);
+            }
+        }
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0 / frames;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int count = argc>1 ? std::max (1, std::atoi (argv[1])) : 400;
+    int frames = argc>2 ? std::max (1, std::atoi (argv[2])) : 30;
+
+    try
+    {
+        std::vector<Actor> actors = makeActors (count);
+
+        std::vector<int> scanPairs, gridPairs;
+
+        double scan = runScan (actors, frames, scanPairs);
+        double grid = runGrid (actors, frames, gridPairs);
+
+        std::cout << count << " actors: scan " << scan << " ms, grid " << grid << " ms per frame ("
+            << scan / grid << "x)" << std::endl;
+
+        if (scanPairs!=gridPairs)
+        {
+            std::cerr << "error: scan and grid found different actors" << std::endl;
+            return 1;
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+/// Times the name lookup of Bsa::BSAFile against the case insensitive std::map it used to have,
+/// with every file of an archive looked up once in its own case and once in upper case, and
+/// checks that both find all files.
+///
+/// Without an archive, a synthetic one with 20000 files in the layout of Morrowind.bsa is written
+/// to the temporary directory.
+///
+/// Usage: bench_bsalookup [archive] [rounds]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <libs/platform/strings.h>
+
+#include <components/bsa/bsa_file.hpp>
+
+namespace
+{
+    /// Writes an archive with the layout described in BSAFile::readHeader
+    void writeArchive (const std::string& path, const std::vector<std::string>& names)
+    {
+        const uint32_t count = names.size();
+
+        std::vector<uint32_t> sizes;
+        std::vector<uint32_t> nameOffsets;
+        std::string nameBuffer;
+        for (uint32_t i=0; i<count; ++i)
+        {
+            sizes.push_back (i % 7);
+            sizes.push_back (0);
+            nameOffsets.push_back (nameBuffer.size());
+            nameBuffer.append (names[i].c_str(), names[i].size() + 1);
+        }
+
+        // Data offsets relative to the data buffer
+        uint32_t offset = 0;
+        for (uint32_t i=0; i<count; ++i)
+        {
+            sizes[2*i+1] = offset;
+            offset += sizes[2*i];
+        }
+
+        uint32_t header[3] = { 0x100, 12*count + static_cast<uint32_t> (nameBuffer.size()), count };
+
+        std::ofstream stream (path.c_str(), std::ios::binary);
+        stream.write (reinterpret_cast<const char*> (header), sizeof (header));
+        stream.write (reinterpret_cast<const char*> (&sizes[0]), sizes.size()*4);
+        stream.write (reinterpret_cast<const char*> (&nameOffsets[0]), nameOffsets.size()*4);
+        stream.write (nameBuffer.data(), nameBuffer.size());
+
+        for (uint32_t i=0; i<count; ++i)
+        {
+            uint64_t hash = Bsa::BSAFile::getHash (names[i].c_str());
+            stream.write (reinterpret_cast<const char*> (&hash), 8);
+        }
+
+        stream.write (std::string (offset, 'x').data(), offset);
+
+        if (!stream)
+            throw std::runtime_error ("can't write " + path);
+    }
+
+    void writeSyntheticArchive (const std::string& path)
+    {
+        static const char *folders[] = { "meshes\\f\\", "meshes\\x\\", "meshes\\i\\", "textures\\", "icons\\m\\" };
+        static const char *extensions[] = { ".nif", ".nif", ".nif", ".dds", ".tga" };
+
+        std::vector<std::string> names;
+        for (int i=0; i<20000; ++i)
+        {
+            std::ostringstream name;
+            name << folders[i % 5] << "furn_de_" << (i * 7919 % 20000) << extensions[i % 5];
+            names.push_back (name.str());
+        }
+
+        writeArchive (path, names);
+    }
+
+    std::string toUpper (std::string name)
+    {
+        for (std::string::iterator iter (name.begin()); iter!=name.end(); ++iter)
+            if (*iter>='a' && *iter<='z')
+                *iter -= 'a' - 'A';
+        return name;
+    }
+
+    /// The lookup BSAFile used before the hash table
+    struct iltstr
+    {
+        bool operator() (const char *s1, const char *s2) const
+        { return strcasecmp (s1, s2) < 0; }
+    };
+
+    typedef std::map<const char*, int, iltstr> Lookup;
+
+    /// \return ns per lookup
+    double runMap (const Lookup& lookup, const std::vector<std::string>& queries, int rounds, size_t& found)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int round=0; round<rounds; ++round)
+            for (std::vector<std::string>::const_iterator iter (queries.begin()); iter!=queries.end(); ++iter)
+                found += lookup.find (iter->c_str())!=lookup.end();
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / static_cast<double> (rounds * queries.size());
+    }
+
+    /// \return ns per lookup
+    double runHash (const Bsa::BSAFile& file, const std::vector<std::string>& queries, int rounds, size_t& found)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int round=0; round<rounds; ++round)
+            for (std::vector<std::string>::const_iterator iter (queries.begin()); iter!=queries.end(); ++iter)
+                found += file.exists (iter->c_str());
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / static_cast<double> (rounds * queries.size());
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int rounds = argc>2 ? std::max (1, std::atoi (argv[2])) : 20;
+
+    std::string path;
+    bool temporary = argc<=1;
+
+    try
+    {
+        if (temporary)
+        {
+            path = (boost::filesystem::temp_directory_path()
+                / boost::filesystem::unique_path ("openmw-bench-%%%%%%%%.bsa")).string();
+            writeSyntheticArchive (path);
+        }
+        else
+            path = argv[1];
+
+        Bsa::BSAFile file;
+        file.open (path);
+
+        const Bsa::BSAFile::FileList& files = file.getList();
+
+        Lookup lookup;
+        std::vector<std::string> queries;
+        for (size_t i=0; i<files.size(); ++i)
+        {
+            lookup[files[i].name] = static_cast<int> (i);
+            queries.push_back (files[i].name);
+            queries.push_back (toUpper (files[i].name));
+        }
+
+        size_t mapFound = 0;
+        size_t hashFound = 0;
+
+        double map = runMap (lookup, queries, rounds, mapFound);
+        double hash = runHash (file, queries, rounds, hashFound);
+
+        std::cout << files.size() << " files: std::map " << map << " ns, hash table " << hash
+            << " ns per lookup (" << map / hash << "x)" << std::endl;
+
+        if (temporary)
+            boost::filesystem::remove (path);
+
+        if (mapFound!=hashFound || mapFound!=rounds * queries.size())
+        {
+            std::cerr << "error: std::map and hash table found different files" << std::endl;
+            return 1;
+        }
+    }
+    catch (std::exception& e)
+    {
+        if (temporary && !path.empty())
+        {
+            boost::system::error_code error;
+            boost::filesystem::remove (path, error);
+        }
+
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
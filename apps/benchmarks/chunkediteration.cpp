@@ -0,0 +1,79 @@
+/// Times iterating over the references of a cell in Misc::ChunkedVector against the std::list
+/// CellRefList used to keep them in, with other allocations interleaved as when a cell is
+/// loaded, and checks that both visit the same references.
+///
+/// Usage: bench_chunkediteration [references] [runs]
+
+#include <iostream>
+#include <list>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <components/misc/chunkedvector.hpp>
+
+namespace
+{
+    /// About the size of a LiveCellRef
+    struct Reference
+    {
+        int mIndex;
+        std::string mId;
+        float mData[48];
+
+        Reference (int index) : mIndex (index), mId ("reference") {}
+    };
+
+    typedef Misc::ChunkedVector<Reference, 32> Vector;
+
+    /// \return ns per reference
+    template<class Container>
+    double run (const Container& container, int runs, long long& sum)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int i=0; i<runs; ++i)
+            for (typename Container::const_iterator iter (container.begin()); iter!=container.end(); ++iter)
+                sum += iter->mIndex;
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / (static_cast<double> (runs) * container.size());
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int references = argc>1 ? std::max (1, std::atoi (argv[1])) : 5000;
+    int runs = argc>2 ? std::max (1, std::atoi (argv[2])) : 200;
+
+    std::list<Reference> list;
+    Vector vector;
+
+    // Interleave allocations, as references of different types are loaded at the same time
+    std::list<std::string> noise;
+    for (int i=0; i<references; ++i)
+    {
+        list.push_back (Reference (i));
+        vector.push_back (Reference (i));
+        noise.push_back (std::string (100, 'x'));
+    }
+
+    long long listSum = 0;
+    long long vectorSum = 0;
+
+    double listTime = run (list, runs, listSum);
+    double vectorTime = run (vector, runs, vectorSum);
+
+    std::cout << references << " references: std::list " << listTime << " ns, ChunkedVector "
+        << vectorTime << " ns per reference (" << listTime / vectorTime << "x)" << std::endl;
+
+    if (listSum!=vectorSum)
+    {
+        std::cerr << "error: std::list and ChunkedVector visited different references" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
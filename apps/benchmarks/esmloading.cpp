@@ -0,0 +1,353 @@
+/// Times loading a synthetic load order of one master and many plugins into an ESMStore,
+/// serially, with the parallel parser and from the content cache, and checks that all of them
+/// produce the same store.
+///
+/// Usage: bench_esmloading [plugin count] [thread count]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/esm/records.hpp>
+#include <components/loadinglistener/loadinglistener.hpp>
+
+#include "../openmw/mwworld/esmstore.hpp"
+#include "../openmw/mwworld/esmloader.hpp"
+
+namespace
+{
+    struct NullListener : public Loading::Listener
+    {
+        virtual void setLabel (const std::string& label) {}
+        virtual void loadingOn() {}
+        virtual void loadingOff() {}
+        virtual void indicateProgress () {}
+        virtual void setProgressRange (size_t range) {}
+        virtual void setProgress (size_t value) {}
+        virtual void increaseProgress (size_t increase) {}
+    };
+
+    template<class T>
+    void writeRecord (ESM::ESMWriter& writer, const T& record)
+    {
+        writer.startRecord (T::sRecordId);
+        writer.writeHNCString ("NAME", record.mId);
+        record.save (writer);
+        writer.endRecord (T::sRecordId);
+    }
+
+    std::string makeId (const std::string& prefix, int file, int index)
+    {
+        std::ostringstream stream;
+        stream << prefix << "_" << file << "_" << index;
+        return stream.str();
+    }
+
+    /// File 0 is the master, all other files are plugins that add new records and
+    /// override some of the master's.
+    void writeContentFile (const boost::filesystem::path& path, int file, const std::string& master,
+        uint64_t masterSize)
+    {
+        const int records = file==0 ? 20000 : 1000;
+        const int dialogues = file==0 ? 200 : 10;
+        const int cells = 100;
+
+        ESM::ESMWriter writer;
+        writer.setFormat (0);
+        writer.setVersion();
+        writer.setType (0);
+        writer.setAuthor ("bench");
+        writer.setDescription ("synthetic content file");
+        writer.setRecordCount (records + dialogues*6 + cells*2 + 100);
+
+        if (file!=0)
+            writer.addMaster (master, masterSize);
+
+        std::ofstream stream (path.string().c_str(), std::ios::binary);
+        writer.save (stream);
+
+        for (int i=0; i<records; ++i)
+        {
+            switch (i % 4)
+            {
+                case 0:
+                {
+                    ESM::Static record;
+                    record.mId = makeId ("stat", file, i);
+                    record.mModel = "meshes\\bench\\" + record.mId + ".nif";
+                    writeRecord (writer, record);
+                    break;
+                }
+
+                case 1:
+                {
+                    ESM::Miscellaneous record;
+                    record.mId = makeId ("misc", file, i);
+                    record.mName = "Miscellaneous item " + record.mId;
+                    record.mModel = "meshes\\m\\" + record.mId + ".nif";
+                    record.mIcon = "m\\" + record.mId + ".dds";
+                    record.mData.mWeight = 1;
+                    record.mData.mValue = i;
+                    record.mData.mIsKey = 0;
+                    writeRecord (writer, record);
+                    break;
+                }
+
+                case 2:
+                {
+                    ESM::Book record;
+                    record.mId = makeId ("book", file, i);
+                    record.mName = "Book " + record.mId;
+                    record.mModel = "meshes\\m\\text_octavo_01.nif";
+                    record.mIcon = "m\\tx_octavo_01.dds";
+                    record.mText = std::string (2000, 'x');
+                    record.mData.mWeight = 1;
+                    record.mData.mValue = i;
+                    record.mData.mIsScroll = 0;
+                    record.mData.mSkillID = -1;
+                    record.mData.mEnchant = 0;
+                    writeRecord (writer, record);
+                    break;
+                }
+
+                default:
+                {
+                    // Plugins override every 40th record of the master
+                    ESM::Static record;
+                    record.mId = file==0 || i % 40!=3 ? makeId ("stat", file, i) : makeId ("stat", 0, i);
+                    record.mModel = "meshes\\override\\" + record.mId + ".nif";
+                    writeRecord (writer, record);
+                    break;
+                }
+            }
+        }
+
+        for (int i=0; i<dialogues; ++i)
+        {
+            ESM::Dialogue dialogue;
+            dialogue.mId = makeId ("topic", file, i);
+            dialogue.mType = ESM::Dialogue::Topic;
+            writeRecord (writer, dialogue);
+
+            for (int j=0; j<5; ++j)
+            {
+                ESM::DialInfo info;
+                info.mId = makeId (dialogue.mId, j, 0);
+                info.mPrev = j==0 ? "" : makeId (dialogue.mId, j-1, 0);
+                info.mNext = j==4 ? "" : makeId (dialogue.mId, j+1, 0);
+                info.mData.mUnknown1 = 0;
+                info.mData.mDisposition = 0;
+                info.mData.mRank = -1;
+                info.mData.mGender = -1;
+                info.mData.mPCrank = -1;
+                info.mData.mUnknown2 = 0;
+                info.mQuestStatus = ESM::DialInfo::QS_None;
+                info.mResponse = "Response " + info.mId;
+
+                writer.startRecord (ESM::REC_INFO);
+                writer.writeHNCString ("INAM", info.mId);
+                info.save (writer);
+                writer.endRecord (ESM::REC_INFO);
+            }
+        }
+
+        // The master defines all cells, each plugin adds references to one of them
+        for (int i=0; i<cells; ++i)
+        {
+            if (file!=0 && i!=file % cells)
+                continue;
+
+            ESM::Cell cell;
+            cell.mName = makeId ("cell", 0, i);
+            cell.mData.mFlags = ESM::Cell::Interior;
+            cell.mData.mX = 0;
+            cell.mData.mY = 0;
+            cell.mWater = 0;
+            cell.mWaterInt = false;
+            cell.mAmbi.mAmbient = cell.mAmbi.mSunlight = cell.mAmbi.mFog = 0;
+            cell.mAmbi.mFogDensity = 1;
+
+            writer.startRecord (ESM::REC_CELL);
+            writer.writeHNCString ("NAME", cell.mName);
+            cell.save (writer);
+
+            for (int j=0; j<10; ++j)
+            {
+                ESM::CellRef ref;
+                ref.blank();
+                ref.mRefNum.mIndex = file*10 + j;
+                ref.mRefID = makeId ("stat", 0, j*4);
+                ref.save (writer);
+            }
+
+            writer.endRecord (ESM::REC_CELL);
+
+            ESM::Cell exterior;
+            exterior.mData.mFlags = ESM::Cell::HasWater;
+            exterior.mData.mX = i;
+            exterior.mData.mY = file;
+            exterior.mRegion = "bench region";
+            exterior.mMapColor = 0;
+            exterior.mRefNumCounter = 0;
+
+            writer.startRecord (ESM::REC_CELL);
+            writer.writeHNCString ("NAME", "");
+            exterior.save (writer);
+            writer.endRecord (ESM::REC_CELL);
+        }
+
+        ESM::LandTexture texture;
+        texture.mId = makeId ("ltex", file, 0);
+        texture.mIndex = file % 3;
+        texture.mTexture = "tx_bench.dds";
+        writeRecord (writer, texture);
+
+        if (file!=0)
+        {
+            // Delete one of the master's records
+            writer.startRecord (ESM::REC_STAT);
+            writer.writeHNCString ("NAME", makeId ("stat", 0, file*4));
+            writer.writeHNT ("DELE", static_cast<int> (0));
+            writer.endRecord (ESM::REC_STAT);
+        }
+
+        writer.close();
+    }
+
+    double load (const std::vector<boost::filesystem::path>& files, unsigned int threads,
+        MWWorld::ESMStore& store, const boost::filesystem::path& cache = boost::filesystem::path())
+    {
+        NullListener listener;
+        std::vector<ESM::ESMReader> readers (files.size());
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        MWWorld::EsmLoader loader (store, readers, NULL, listener, threads);
+
+        if (!cache.empty())
+            loader.enableCache (cache);
+
+        for (int i=0; i<static_cast<int> (files.size()); ++i)
+            loader.load (files[i], i);
+
+        loader.finish();
+
+        boost::posix_time::time_duration duration =
+            boost::posix_time::microsec_clock::universal_time() - start;
+
+        return duration.total_microseconds() / 1000.0;
+    }
+
+    template<class T>
+    bool compare (const MWWorld::ESMStore& left, const MWWorld::ESMStore& right)
+    {
+        std::vector<std::string> leftIds, rightIds;
+        left.get<T>().listIdentifier (leftIds);
+        right.get<T>().listIdentifier (rightIds);
+        return leftIds==rightIds;
+    }
+
+    bool compareStores (const MWWorld::ESMStore& left, const MWWorld::ESMStore& right)
+    {
+        bool same = compare<ESM::Static> (left, right) &&
+            compare<ESM::Miscellaneous> (left, right) &&
+            compare<ESM::Book> (left, right) &&
+            compare<ESM::Dialogue> (left, right) &&
+            compare<ESM::Cell> (left, right) &&
+            left.get<ESM::Cell>().getSize()==right.get<ESM::Cell>().getSize() &&
+            left.get<ESM::LandTexture>().getSize()==right.get<ESM::LandTexture>().getSize();
+
+        const MWWorld::Store<ESM::Static>& statics = right.get<ESM::Static>();
+        for (MWWorld::Store<ESM::Static>::iterator iter (statics.begin()); same && iter!=statics.end(); ++iter)
+            same = left.get<ESM::Static>().find (iter->mId)->mModel==iter->mModel;
+
+        const MWWorld::Store<ESM::Dialogue>& dialogues = right.get<ESM::Dialogue>();
+        for (MWWorld::Store<ESM::Dialogue>::iterator iter (dialogues.begin()); same && iter!=dialogues.end(); ++iter)
+            same = left.get<ESM::Dialogue>().find (iter->mId)->mInfo.size()==iter->mInfo.size();
+
+        const MWWorld::Store<ESM::Cell>& cells = right.get<ESM::Cell>();
+        for (MWWorld::Store<ESM::Cell>::iterator iter (cells.intBegin()); same && iter!=cells.intEnd(); ++iter)
+            same = left.get<ESM::Cell>().find (iter->mName)->mContextList.size()==iter->mContextList.size();
+
+        return same;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int plugins = argc>1 ? std::atoi (argv[1]) : 199;
+    unsigned int threads = argc>2 ? std::atoi (argv[2]) : 0;
+
+    boost::filesystem::path dir =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path ("openmw-bench-%%%%%%%%");
+    boost::filesystem::create_directories (dir);
+
+    try
+    {
+        std::vector<boost::filesystem::path> files;
+
+        std::cout << "Generating 1 master and " << plugins << " plugins in " << dir.string() << std::endl;
+
+        for (int i=0; i<=plugins; ++i)
+        {
+            std::ostringstream name;
+            name << "bench" << i << (i==0 ? ".esm" : ".esp");
+            files.push_back (dir / name.str());
+
+            writeContentFile (files.back(), i, "bench0.esm",
+                i==0 ? 0 : boost::filesystem::file_size (files.front()));
+        }
+
+        MWWorld::ESMStore serialStore;
+        double serial = load (files, 1, serialStore);
+        serialStore.setUp();
+        std::cout << "serial:   " << serial << " ms" << std::endl;
+
+        MWWorld::ESMStore parallelStore;
+        double parallel = load (files, threads, parallelStore);
+        parallelStore.setUp();
+        std::cout << "parallel: " << parallel << " ms (" << serial / parallel << "x)" << std::endl;
+
+        boost::filesystem::path cache = dir / "content.cache";
+
+        MWWorld::ESMStore uncachedStore;
+        double uncached = load (files, threads, uncachedStore, cache);
+        std::cout << "writing cache: " << uncached << " ms" << std::endl;
+
+        MWWorld::ESMStore cachedStore;
+        double cached = load (files, threads, cachedStore, cache);
+        cachedStore.setUp();
+        std::cout << "cached:   " << cached << " ms (" << serial / cached << "x)" << std::endl;
+
+        bool sameParallel = compareStores (serialStore, parallelStore);
+        bool sameCached = compareStores (serialStore, cachedStore);
+
+        boost::filesystem::remove_all (dir);
+
+        if (!sameParallel)
+        {
+            std::cerr << "error: serial and parallel loading produced different stores" << std::endl;
+            return 1;
+        }
+
+        if (!sameCached)
+        {
+            std::cerr << "error: the content cache produced a different store" << std::endl;
+            return 1;
+        }
+    }
+    catch (std::exception& e)
+    {
+        boost::filesystem::remove_all (dir);
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
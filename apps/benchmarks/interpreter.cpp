@@ -0,0 +1,178 @@
+/// Times the interpreter on a compiled local script that loops over arithmetic, comparisons,
+/// branches and local variable accesses, and checks the result of the loop.
+///
+/// Usage: bench_interpreter [runs]
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <components/compiler/context.hpp>
+#include <components/compiler/fileparser.hpp>
+#include <components/compiler/scanner.hpp>
+#include <components/compiler/streamerrorhandler.hpp>
+#include <components/interpreter/context.hpp>
+#include <components/interpreter/installopcodes.hpp>
+#include <components/interpreter/interpreter.hpp>
+
+namespace
+{
+    class CompilerContext : public Compiler::Context
+    {
+        public:
+
+            virtual bool canDeclareLocals() const { return true; }
+            virtual char getGlobalType (const std::string& name) const { return ' '; }
+            virtual std::pair<char, bool> getMemberType (const std::string& name,
+                const std::string& id) const { return std::make_pair (' ', false); }
+            virtual bool isId (const std::string& name) const { return false; }
+            virtual bool isJournalId (const std::string& name) const { return false; }
+    };
+
+    /// Only locals are supported, everything else is unused by the script.
+    class Context : public Interpreter::Context
+    {
+        public:
+
+            std::vector<int> mShorts;
+            std::vector<int> mLongs;
+            std::vector<float> mFloats;
+
+            Context (const Compiler::Locals& locals)
+            : mShorts (locals.get ('s').size()), mLongs (locals.get ('l').size()),
+              mFloats (locals.get ('f').size())
+            {}
+
+            virtual int getLocalShort (int index) const { return mShorts.at (index); }
+            virtual int getLocalLong (int index) const { return mLongs.at (index); }
+            virtual float getLocalFloat (int index) const { return mFloats.at (index); }
+            virtual void setLocalShort (int index, int value) { mShorts.at (index) = value; }
+            virtual void setLocalLong (int index, int value) { mLongs.at (index) = value; }
+            virtual void setLocalFloat (int index, float value) { mFloats.at (index) = value; }
+
+            virtual void messageBox (const std::string& message, const std::vector<std::string>& buttons) {}
+            virtual void report (const std::string& message) {}
+            virtual bool menuMode() { return false; }
+            virtual int getGlobalShort (const std::string& name) const { return 0; }
+            virtual int getGlobalLong (const std::string& name) const { return 0; }
+            virtual float getGlobalFloat (const std::string& name) const { return 0; }
+            virtual void setGlobalShort (const std::string& name, int value) {}
+            virtual void setGlobalLong (const std::string& name, int value) {}
+            virtual void setGlobalFloat (const std::string& name, float value) {}
+            virtual std::vector<std::string> getGlobals () const { return std::vector<std::string>(); }
+            virtual char getGlobalType (const std::string& name) const { return ' '; }
+            virtual std::string getActionBinding (const std::string& action) const { return ""; }
+            virtual std::string getNPCName() const { return ""; }
+            virtual std::string getNPCRace() const { return ""; }
+            virtual std::string getNPCClass() const { return ""; }
+            virtual std::string getNPCFaction() const { return ""; }
+            virtual std::string getNPCRank() const { return ""; }
+            virtual std::string getPCName() const { return ""; }
+            virtual std::string getPCRace() const { return ""; }
+            virtual std::string getPCClass() const { return ""; }
+            virtual std::string getPCRank() const { return ""; }
+            virtual std::string getPCNextRank() const { return ""; }
+            virtual int getPCBounty() const { return 0; }
+            virtual std::string getCurrentCellName() const { return ""; }
+            virtual bool isScriptRunning (const std::string& name) const { return false; }
+            virtual void startScript (const std::string& name, const std::string& targetId) {}
+            virtual void stopScript (const std::string& name) {}
+            virtual float getDistance (const std::string& name, const std::string& id) const { return 0; }
+            virtual float getSecondsPassed() const { return 0; }
+            virtual bool isDisabled (const std::string& id) const { return false; }
+            virtual void enable (const std::string& id) {}
+            virtual void disable (const std::string& id) {}
+            virtual int getMemberShort (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual int getMemberLong (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual float getMemberFloat (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual void setMemberShort (const std::string& id, const std::string& name, int value, bool global) {}
+            virtual void setMemberLong (const std::string& id, const std::string& name, int value, bool global) {}
+            virtual void setMemberFloat (const std::string& id, const std::string& name, float value, bool global) {}
+            virtual std::string getTargetId() const { return ""; }
+    };
+
+    const int sIterations = 1000;
+
+    /// Arithmetic, comparisons, branches and local variable accesses, as in a typical local script
+    const char *sLoopScript =
+        "begin loop\n"
+        "short i\n"
+        "long sum\n"
+        "float f\n"
+        "while ( i < 1000 )\n"
+        "    set sum to sum + i * 3\n"
+        "    set f to f * 0.5 + 1\n"
+        "    if ( sum > 100000 )\n"
+        "        set sum to sum - 100000\n"
+        "    endif\n"
+        "    set i to i + 1\n"
+        "endwhile\n"
+        "end\n";
+
+    /// \return The sum computed by the loop script
+    int getSum()
+    {
+        int sum = 0;
+        for (int i=0; i<sIterations; ++i)
+        {
+            sum += i * 3;
+            if (sum > 100000)
+                sum -= 100000;
+        }
+        return sum;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int runs = argc>1 ? std::max (1, std::atoi (argv[1])) : 200;
+
+    CompilerContext compilerContext;
+    Compiler::StreamErrorHandler errorHandler (std::cerr);
+    Compiler::FileParser parser (errorHandler, compilerContext);
+
+    std::istringstream input (sLoopScript);
+    Compiler::Scanner scanner (errorHandler, input, compilerContext.getExtensions());
+    scanner.scan (parser);
+
+    if (!errorHandler.isGood())
+    {
+        std::cerr << "error: failed to compile the script" << std::endl;
+        return 1;
+    }
+
+    std::vector<Interpreter::Type_Code> code;
+    parser.getCode (code);
+
+    Interpreter::Interpreter interpreter;
+    Interpreter::installOpcodes (interpreter);
+
+    Context context (parser.getLocals());
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    for (int run=0; run<runs; ++run)
+    {
+        context.mShorts[0] = 0;
+        context.mLongs[0] = 0;
+        interpreter.run (&code[0], code.size(), context);
+    }
+
+    double time = (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+        / (runs * static_cast<double> (sIterations));
+
+    std::cout << "script of " << code[0] << " opcodes: " << time << " ns per loop iteration" << std::endl;
+
+    if (context.mShorts[0]!=sIterations || context.mLongs[0]!=getSum())
+    {
+        std::cerr << "error: the script computed a wrong result" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+/// Times NifOgre::KeyframePose against a copy of the previous, per-controller evaluation that
+/// searches the key maps of every track, animating N skeletons for M frames, and checks that
+/// both leave the bones in the same pose.
+///
+/// Each skeleton has the bones of a biped with a rotation track, some of them with a translation
+/// or scale track, and plays a synthetic animation of a few seconds in a loop, each skeleton at
+/// a different phase. The bones are plain nodes, no render system is needed.
+///
+/// Usage: bench_keyframes [skeletons] [frames]
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <OgreNode.h>
+#include <OgreController.h>
+#include <OgreQuaternion.h>
+#include <OgreVector3.h>
+
+#include <components/nif/node.hpp>
+#include <components/nif/data.hpp>
+#include <components/nif/controller.hpp>
+#include <components/nifogre/controller.hpp>
+#include <components/nifogre/keyframes.hpp>
+
+namespace
+{
+    const int sBones = 60;
+    const float sDuration = 4.0f;
+    const float sKeysPerSecond = 15.0f;
+    const float sFrameTime = 1.0f / 60.0f;
+
+    /// KeyframeController::Value before it used NifOgre::KeyframeTracks, for quaternion rotations
+    class Reference : public NifOgre::NodeTargetValue<Ogre::Real>, public NifOgre::ValueInterpolator
+    {
+            const Nif::NiKeyframeData *mData;
+
+            static Ogre::Quaternion interpKey (const Nif::QuaternionKeyMap::MapType &keys, float time)
+            {
+                if(time <= keys.begin()->first)
+                    return keys.begin()->second.mValue;
+
+                Nif::QuaternionKeyMap::MapType::const_iterator it = keys.lower_bound(time);
+                if (it != keys.end())
+                {
+                    float aTime = it->first;
+                    const Nif::QuaternionKey* aKey = &it->second;
+
+                    Nif::QuaternionKeyMap::MapType::const_iterator last = --it;
+                    float aLastTime = last->first;
+                    const Nif::QuaternionKey* aLastKey = &last->second;
+
+                    float a = (time - aLastTime) / (aTime - aLastTime);
+                    return Ogre::Quaternion::nlerp(a, aLastKey->mValue, aKey->mValue);
+                }
+                else
+                    return keys.rbegin()->second.mValue;
+            }
+
+            using ValueInterpolator::interpKey;
+
+        public:
+
+            Reference (Ogre::Node *target, const Nif::NiKeyframeData *data)
+            : NodeTargetValue<Ogre::Real> (target), mData (data)
+            {}
+
+            virtual Ogre::Quaternion getRotation (float time) const
+            { return interpKey (mData->mRotations.mKeys, time); }
+
+            virtual Ogre::Vector3 getTranslation (float time) const
+            { return interpKey (mData->mTranslations.mKeys, time); }
+
+            virtual Ogre::Vector3 getScale (float time) const
+            { return Ogre::Vector3 (interpKey (mData->mScales.mKeys, time)); }
+
+            virtual Ogre::Real getValue() const { return 0.0f; }
+
+            virtual void setValue (Ogre::Real time)
+            {
+                if (mData->mRotations.mKeys.size() > 0)
+                    mNode->setOrientation (interpKey (mData->mRotations.mKeys, time));
+                if (mData->mTranslations.mKeys.size() > 0)
+                    mNode->setPosition (interpKey (mData->mTranslations.mKeys, time));
+                if (mData->mScales.mKeys.size() > 0)
+                    mNode->setScale (Ogre::Vector3 (interpKey (mData->mScales.mKeys, time)));
+            }
+    };
+
+    class Bone : public Ogre::Node
+    {
+        protected:
+
+            virtual Ogre::Node *createChildImpl()
+            { return new Bone; }
+
+            virtual Ogre::Node *createChildImpl (const Ogre::String& name)
+            { return new Bone; }
+    };
+
+    /// Animation time of a skeleton
+    class Time : public Ogre::ControllerValue<Ogre::Real>
+    {
+            Ogre::Real mTime;
+
+        public:
+
+            Time (Ogre::Real time) : mTime (time) {}
+
+            virtual Ogre::Real getValue() const { return mTime; }
+
+            virtual void setValue (Ogre::Real time) { mTime = time; }
+    };
+
+    /// The key data of all bones, shared by the skeletons like that of a .kf file
+    class Animation
+    {
+            std::vector<Nif::NiKeyframeData *> mData;
+            Nif::NiKeyframeController mController;
+
+            Animation (const Animation&);
+            Animation& operator= (const Animation&);
+
+        public:
+
+            Animation()
+            {
+                mController.frequency = 1.0f;
+                mController.phase = 0.0f;
+                mController.timeStart = 0.0f;
+                mController.timeStop = sDuration;
+
+                int keys = static_cast<int> (sDuration * sKeysPerSecond) + 1;
+
+                for (int bone=0; bone<sBones; ++bone)
+                {
+                    Nif::NiKeyframeData *data = new Nif::NiKeyframeData;
+                    mData.push_back (data);
+
+                    for (int i=0; i<keys; ++i)
+                    {
+                        float time = i / sKeysPerSecond;
+                        float angle = std::sin (time * 2.1f + bone) * 0.8f;
+
+                        Nif::QuaternionKey rotation;
+                        rotation.mValue = Ogre::Quaternion (Ogre::Radian (angle),
+                            Ogre::Vector3 (1.0f, bone * 0.1f, 0.5f).normalisedCopy());
+                        data->mRotations.mKeys[time] = rotation;
+
+                        // the root moves, a few bones are scaled
+                        if (bone==0 || bone%7==0)
+                        {
+                            Nif::Vector3Key translation;
+                            translation.mValue = Ogre::Vector3 (time * 100.0f, std::cos (time * 3.0f) * 5.0f, 70.0f);
+                            data->mTranslations.mKeys[time] = translation;
+                        }
+
+                        if (bone%13==5)
+                        {
+                            Nif::FloatKey scale;
+                            scale.mValue = 1.0f + 0.2f * std::sin (time * 4.0f);
+                            data->mScales.mKeys[time] = scale;
+                        }
+                    }
+                }
+            }
+
+            ~Animation()
+            {
+                for (std::vector<Nif::NiKeyframeData *>::iterator iter (mData.begin()); iter!=mData.end(); ++iter)
+                    delete *iter;
+            }
+
+            const Nif::NiKeyframeData *getData (int bone) const { return mData[bone]; }
+
+            const Nif::Controller *getController() const { return &mController; }
+    };
+
+    class Skeleton
+    {
+            Bone mRoot;
+            std::vector<Ogre::Node *> mBones;
+            Ogre::SharedPtr<Time> mTime;
+            std::vector<Ogre::Controller<Ogre::Real> > mReference;
+            std::vector<Ogre::Controller<Ogre::Real> > mControllers;
+            NifOgre::KeyframePose mPose;
+
+            Skeleton (const Skeleton&);
+            Skeleton& operator= (const Skeleton&);
+
+        public:
+
+            Skeleton (const Animation& animation, float phase) : mTime (new Time (phase))
+            {
+                for (int bone=0; bone<sBones; ++bone)
+                {
+                    // a chain of a few bones per limb
+                    Ogre::Node *parent = bone%5==0 ? &mRoot : mBones.back();
+                    mBones.push_back (parent->createChild());
+
+                    Ogre::ControllerFunctionRealPtr function (
+                        new NifOgre::DefaultFunction (animation.getController(), false));
+
+                    mReference.push_back (Ogre::Controller<Ogre::Real> (mTime,
+                        Ogre::ControllerValueRealPtr (new Reference (mBones.back(), animation.getData (bone))),
+                        function));
+
+                    mControllers.push_back (Ogre::Controller<Ogre::Real> (mTime,
+                        Ogre::ControllerValueRealPtr (new NifOgre::KeyframeValue (mBones.back(),
+                        Nif::NIFFilePtr(), animation.getData (bone))), function));
+
+                    mPose.add (mControllers.back());
+                }
+            }
+
+            ~Skeleton()
+            {
+                // children first, a node removes itself from its parent
+                for (std::vector<Ogre::Node *>::reverse_iterator iter (mBones.rbegin()); iter!=mBones.rend(); ++iter)
+                    delete *iter;
+            }
+
+            void advance()
+            {
+                float time = mTime->getValue() + sFrameTime;
+                mTime->setValue (time>sDuration ? time-sDuration : time);
+            }
+
+            void updateReference()
+            {
+                for (size_t i=0; i<mReference.size(); ++i)
+                    mReference[i].update();
+            }
+
+            void updatePose()
+            {
+                mPose.update (mTime->getValue());
+            }
+
+            /// Transformations of the bones, to compare
+            void getPose (std::vector<float>& pose) const
+            {
+                pose.clear();
+
+                for (size_t i=0; i<mBones.size(); ++i)
+                {
+                    const Ogre::Quaternion& rotation = mBones[i]->getOrientation();
+                    const Ogre::Vector3& position = mBones[i]->getPosition();
+                    const Ogre::Vector3& scale = mBones[i]->getScale();
+
+                    // q and -q are the same rotation
+                    float sign = rotation.w<0 ? -1.0f : 1.0f;
+                    for (int j=0; j<4; ++j)
+                        pose.push_back (rotation[j] * sign);
+
+                    for (int j=0; j<3; ++j)
+                    {
+                        pose.push_back (position[j]);
+                        pose.push_back (scale[j]);
+                    }
+                }
+            }
+    };
+
+    /// \return ms
+    double run (std::vector<Skeleton *>& skeletons, int frames, bool reference)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int frame=0; frame<frames; ++frame)
+            for (size_t i=0; i<skeletons.size(); ++i)
+            {
+                skeletons[i]->advance();
+
+                if (reference)
+                    skeletons[i]->updateReference();
+                else
+                    skeletons[i]->updatePose();
+            }
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+    }
+
+    /// \return Do the reference and the pose leave the bones of \a skeletons the same over \a frames?
+    bool check (std::vector<Skeleton *>& skeletons, int frames)
+    {
+        std::vector<float> reference;
+        std::vector<float> pose;
+
+        for (int frame=0; frame<frames; ++frame)
+            for (size_t i=0; i<skeletons.size(); ++i)
+            {
+                skeletons[i]->advance();
+
+                skeletons[i]->updateReference();
+                skeletons[i]->getPose (reference);
+
+                skeletons[i]->updatePose();
+                skeletons[i]->getPose (pose);
+
+                for (size_t j=0; j<pose.size(); ++j)
+                    if (std::abs (pose[j]-reference[j])>1e-4f * std::max (1.0f, std::abs (reference[j])))
+                        return false;
+            }
+
+        return true;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int skeletonCount = argc>1 ? std::max (1, std::atoi (argv[1])) : 50;
+    int frames = argc>2 ? std::max (1, std::atoi (argv[2])) : 1000;
+
+    Animation animation;
+
+    std::vector<Skeleton *> skeletons;
+    for (int i=0; i<skeletonCount; ++i)
+        skeletons.push_back (new Skeleton (animation, std::fmod (i * 0.37f, sDuration)));
+
+    double referenceTime = run (skeletons, frames, true);
+    double poseTime = run (skeletons, frames, false);
+
+    std::cout << skeletonCount << " skeletons of " << sBones << " bones, " << frames << " frames: reference "
+        << referenceTime << " ms, pose " << poseTime << " ms (" << referenceTime / poseTime << "x)" << std::endl;
+
+    bool same = check (skeletons, 200);
+
+    for (std::vector<Skeleton *>::iterator iter (skeletons.begin()); iter!=skeletons.end(); ++iter)
+        delete *iter;
+
+    if (!same)
+    {
+        std::cerr << "error: reference and pose animated the bones differently" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/// Times the bulk array reads of NIFStream against reading the same data value by value, and
+/// optionally parses every NIF file of a corpus of archives and data directories.
+///
+/// Usage: bench_nifloading [--runs n] [archive or data directory]...
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <OgreRoot.h>
+#include <OgreResourceGroupManager.h>
+
+#include <components/nif/niffile.hpp>
+#include <components/nif/nifstream.hpp>
+#include <components/bsa/bsa_archive.hpp>
+#include <components/bsa/vfsindex.hpp>
+
+namespace
+{
+    double elapsed (const boost::posix_time::ptime& start)
+    {
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+    }
+
+    Nif::NIFStream makeStream (const std::vector<char>& buffer)
+    {
+        Ogre::DataStreamPtr stream (
+            OGRE_NEW Ogre::MemoryDataStream (const_cast<char *> (&buffer[0]), buffer.size(), false, true));
+        return Nif::NIFStream (0, stream);
+    }
+
+    /// Vertex data is read in the same pattern as NiTriShapeData: vertices, normals and UVs.
+    bool benchmarkArrays (int runs)
+    {
+        const size_t vertices = 1 << 20;
+
+        std::vector<char> buffer (vertices * 8 * sizeof (float));
+        for (size_t i=0; i<vertices*8; ++i)
+        {
+            float value = static_cast<float> (i) * 0.25f;
+            std::memcpy (&buffer[i*sizeof (float)], &value, sizeof (float));
+        }
+
+        std::vector<Ogre::Vector3> singleVertices (vertices), singleNormals (vertices);
+        std::vector<Ogre::Vector2> singleUVs (vertices);
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int run=0; run<runs; ++run)
+        {
+            Nif::NIFStream nif = makeStream (buffer);
+
+            for (size_t i=0; i<vertices; ++i)
+                singleVertices[i] = nif.getVector3();
+            for (size_t i=0; i<vertices; ++i)
+                singleNormals[i] = nif.getVector3();
+            for (size_t i=0; i<vertices; ++i)
+                singleUVs[i] = nif.getVector2();
+        }
+
+        double single = elapsed (start) / runs;
+
+        std::vector<Ogre::Vector3> bulkVertices, bulkNormals;
+        std::vector<Ogre::Vector2> bulkUVs;
+
+        start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int run=0; run<runs; ++run)
+        {
+            Nif::NIFStream nif = makeStream (buffer);
+
+            nif.getVector3s (bulkVertices, vertices);
+            nif.getVector3s (bulkNormals, vertices);
+            nif.getVector2s (bulkUVs, vertices);
+        }
+
+        double bulk = elapsed (start) / runs;
+
+        double megabytes = buffer.size() / (1024.0 * 1024.0);
+
+        std::cout << "value by value: " << single << " ms (" << megabytes / single * 1000 << " MB/s)" << std::endl;
+        std::cout << "bulk:           " << bulk << " ms (" << megabytes / bulk * 1000 << " MB/s, "
+            << single / bulk << "x)" << std::endl;
+
+        return singleVertices==bulkVertices && singleNormals==bulkNormals && singleUVs==bulkUVs;
+    }
+
+    void benchmarkCorpus (const std::vector<std::string>& sources, int runs)
+    {
+        boost::shared_ptr<Bsa::VFSIndex> index (new Bsa::VFSIndex);
+
+        for (std::vector<std::string>::const_iterator iter (sources.begin()); iter!=sources.end(); ++iter)
+        {
+            if (boost::filesystem::is_directory (*iter))
+                index->addDirectory (*iter);
+            else
+                index->addArchive (*iter);
+        }
+
+        std::vector<std::string> meshes;
+        size_t bytes = 0;
+
+        const Bsa::VFSIndex::Index& files = index->getIndex();
+        for (Bsa::VFSIndex::Index::const_iterator iter (files.begin()); iter!=files.end(); ++iter)
+            if (iter->first.size()>4 && iter->first.compare (iter->first.size()-4, 4, ".nif")==0)
+            {
+                meshes.push_back (iter->first);
+                bytes += iter->second.mSize;
+            }
+
+        Ogre::ResourceGroupManager::getSingleton().createResourceGroup ("Bench");
+        Bsa::addVFS (index, "Bench", "Bench");
+        Ogre::ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
+
+        std::cout << "parsing " << meshes.size() << " NIF files" << std::endl;
+
+        int failed = 0;
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int run=0; run<runs; ++run)
+            for (std::vector<std::string>::const_iterator iter (meshes.begin()); iter!=meshes.end(); ++iter)
+            {
+                try
+                {
+                    Nif::NIFFile file (*iter);
+                }
+                catch (const std::exception&)
+                {
+                    if (run==0)
+                        ++failed;
+                }
+            }
+
+        double time = elapsed (start) / runs;
+
+        std::cout << "corpus: " << time << " ms per run";
+        if (bytes)
+            std::cout << " (" << bytes / (1024.0 * 1024.0) / time * 1000 << " MB/s from archives)";
+        std::cout << ", " << failed << " files failed to parse" << std::endl;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int runs = 5;
+    std::vector<std::string> sources;
+
+    for (int i=1; i<argc; ++i)
+    {
+        if (std::strcmp (argv[i], "--runs")==0 && i+1<argc)
+            runs = std::max (1, std::atoi (argv[++i]));
+        else
+            sources.push_back (argv[i]);
+    }
+
+    try
+    {
+        if (!benchmarkArrays (runs))
+        {
+            std::cerr << "error: bulk and value by value reads produced different arrays" << std::endl;
+            return 1;
+        }
+
+        if (!sources.empty())
+        {
+            // Need this for Ogre's getSingleton
+            new Ogre::Root ("", "", "bench_nifloading.log");
+
+            benchmarkCorpus (sources, runs);
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
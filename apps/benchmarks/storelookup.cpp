@@ -0,0 +1,122 @@
+/// Times the record lookup of MWWorld::Store, by ID and by handle, against the lower case copy of
+/// the ID and std::map lookup it used to do, with about as many game settings as Morrowind.esm
+/// has, and checks that all three find the same records.
+///
+/// Usage: bench_storelookup [lookups]
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <components/esm/loadgmst.hpp>
+#include <components/misc/stringops.hpp>
+
+#include "../openmw/mwworld/store.hpp"
+
+namespace
+{
+    const int sSettings = 1500;
+
+    ESM::GameSetting makeSetting (const std::string& id, int value)
+    {
+        ESM::GameSetting setting;
+        setting.mId = id;
+        setting.mValue.setType (ESM::VT_Int);
+        setting.mValue.setInteger (value);
+        return setting;
+    }
+
+    /// \return ns per lookup
+    double runMap (const std::map<std::string, ESM::GameSetting>& map, const std::vector<std::string>& ids,
+        int lookups, int& sum)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int i=0; i<lookups; ++i)
+            sum += map.find (Misc::StringUtils::lowerCase (ids[i % ids.size()]))->second.getInt();
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / static_cast<double> (lookups);
+    }
+
+    /// \return ns per lookup
+    double runId (const MWWorld::Store<ESM::GameSetting>& store, const std::vector<std::string>& ids,
+        int lookups, int& sum)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int i=0; i<lookups; ++i)
+            sum += store.find (ids[i % ids.size()])->getInt();
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / static_cast<double> (lookups);
+    }
+
+    /// \return ns per lookup
+    double runHandle (const MWWorld::Store<ESM::GameSetting>& store,
+        const std::vector<MWWorld::RecordHandle>& handles, int lookups, int& sum)
+    {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (int i=0; i<lookups; ++i)
+            sum += store.find (handles[i % handles.size()])->getInt();
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds()
+            / static_cast<double> (lookups);
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int lookups = argc>1 ? std::max (1, std::atoi (argv[1])) : 1000000;
+
+    try
+    {
+        MWWorld::Store<ESM::GameSetting> store;
+        std::map<std::string, ESM::GameSetting> map;
+        std::vector<std::string> ids;
+
+        for (int i=0; i<sSettings; ++i)
+        {
+            std::ostringstream id;
+            id << "fSetting" << i << "Mult";
+            ids.push_back (id.str());
+            store.insertStatic (makeSetting (id.str(), i));
+            map[Misc::StringUtils::lowerCase (id.str())] = makeSetting (id.str(), i);
+        }
+
+        std::vector<MWWorld::RecordHandle> handles;
+        for (int i=0; i<sSettings; ++i)
+            handles.push_back (store.getHandle (ids[i]));
+
+        int mapSum = 0;
+        int idSum = 0;
+        int handleSum = 0;
+
+        double mapTime = runMap (map, ids, lookups, mapSum);
+        double idTime = runId (store, ids, lookups, idSum);
+        double handleTime = runHandle (store, handles, lookups, handleSum);
+
+        std::cout << sSettings << " records: std::map " << mapTime << " ns, hashed ID " << idTime
+            << " ns, handle " << handleTime << " ns per lookup" << std::endl;
+
+        if (mapSum!=idSum || mapSum!=handleSum)
+        {
+            std::cerr << "error: std::map, ID and handle lookups found different records" << std::endl;
+            return 1;
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
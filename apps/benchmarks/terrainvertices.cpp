@@ -0,0 +1,450 @@
+/// Times ESMTerrain::Storage::fillVertexBuffers against a copy of its previous, per-vertex
+/// implementation, filling all chunks of a synthetic exterior world of N x N cells, and checks
+/// that both write the same vertices.
+///
+/// The chunks are those of the distant land quad tree, from one cell up to the whole world, each
+/// at the LOD level Terrain::DefaultWorld uses for it. The storage fills them twice, the second
+/// time in reverse order, to show the effect of the decoded cell cache. No render system is
+/// needed, colours are converted to the default vertex colour format of the platform.
+///
+/// Usage: bench_terrainvertices [world size in cells]
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <OgreVector2.h>
+#include <OgreVector3.h>
+#include <OgreColourValue.h>
+#include <OgreHardwareVertexBuffer.h>
+
+#include <components/esmterrain/storage.hpp>
+
+namespace
+{
+    /// Procedural land with a few holes, some cells without vertex colours
+    class World
+    {
+            int mSize;
+            std::vector<ESM::Land *> mLands;
+
+            World (const World&);
+            World& operator= (const World&);
+
+            static float getHeight (int cellX, int cellY, int x, int y)
+            {
+                float wx = cellX + x / float (ESM::Land::LAND_SIZE-1);
+                float wy = cellY + y / float (ESM::Land::LAND_SIZE-1);
+                return 1000 * std::sin (wx * 1.3f) * std::cos (wy * 0.7f) + 300 * std::sin ((wx + wy) * 5.1f);
+            }
+
+        public:
+
+            World (int size) : mSize (size), mLands (size*size)
+            {
+                for (int cellY=0; cellY<size; ++cellY)
+                    for (int cellX=0; cellX<size; ++cellX)
+                    {
+                        if ((cellX * 7 + cellY * 13) % 17 == 0)
+                            continue;
+
+                        ESM::Land *land = new ESM::Land;
+                        mLands[cellY*size + cellX] = land;
+
+                        land->mX = cellX;
+                        land->mY = cellY;
+                        land->mDataTypes = ESM::Land::DATA_VHGT | ESM::Land::DATA_VNML;
+
+                        if ((cellX + cellY) % 5 != 0)
+                            land->mDataTypes |= ESM::Land::DATA_VCLR;
+
+                        land->mDataLoaded = land->mDataTypes;
+                        land->mLandData = new ESM::Land::LandData;
+                        land->mLandData->mDataTypes = land->mDataTypes;
+
+                        for (int y=0; y<ESM::Land::LAND_SIZE; ++y)
+                            for (int x=0; x<ESM::Land::LAND_SIZE; ++x)
+                            {
+                                // the records are column-major, see ESMTerrain::Storage
+                                int index = y*ESM::Land::LAND_SIZE + x;
+
+                                land->mLandData->mHeights[index] = getHeight (cellX, cellY, x, y);
+
+                                float dx = getHeight (cellX, cellY, x+1, y) - getHeight (cellX, cellY, x-1, y);
+                                float dy = getHeight (cellX, cellY, x, y+1) - getHeight (cellX, cellY, x, y-1);
+                                Ogre::Vector3 normal (-dx, -dy, 256);
+                                normal.normalise();
+
+                                land->mLandData->mNormals[index*3] = static_cast<signed char> (normal.x * 127);
+                                land->mLandData->mNormals[index*3+1] = static_cast<signed char> (normal.y * 127);
+                                land->mLandData->mNormals[index*3+2] = static_cast<signed char> (normal.z * 127);
+
+                                land->mLandData->mColours[index*3] = static_cast<char> ((x * 3 + cellX) % 128);
+                                land->mLandData->mColours[index*3+1] = static_cast<char> ((y * 5 + cellY) % 128);
+                                land->mLandData->mColours[index*3+2] = static_cast<char> ((x + y) % 128);
+                            }
+                    }
+            }
+
+            ~World()
+            {
+                for (std::vector<ESM::Land *>::iterator iter (mLands.begin()); iter!=mLands.end(); ++iter)
+                    delete *iter;
+            }
+
+            int getSize() const { return mSize; }
+
+            ESM::Land *getLand (int cellX, int cellY) const
+            {
+                if (cellX<0 || cellY<0 || cellX>=mSize || cellY>=mSize)
+                    return 0;
+
+                return mLands[cellY*mSize + cellX];
+            }
+    };
+
+    class Storage : public ESMTerrain::Storage
+    {
+            const World& mWorld;
+
+            virtual ESM::Land* getLand (int cellX, int cellY)
+            {
+                return mWorld.getLand (cellX, cellY);
+            }
+
+            virtual const ESM::LandTexture* getLandTexture (int index, short plugin)
+            {
+                return 0;
+            }
+
+        public:
+
+            Storage (const World& world) : mWorld (world) {}
+
+            virtual void getBounds (float& minX, float& maxX, float& minY, float& maxY)
+            {
+                minX = minY = 0;
+                maxX = maxY = static_cast<float> (mWorld.getSize());
+            }
+    };
+
+    /// The previous implementation of ESMTerrain::Storage::fillVertexBuffers and its helpers
+    namespace Reference
+    {
+        void fixNormal (const World& world, Ogre::Vector3& normal, int cellX, int cellY, int col, int row)
+        {
+            while (col >= ESM::Land::LAND_SIZE-1)
+            {
+                ++cellY;
+                col -= ESM::Land::LAND_SIZE-1;
+            }
+            while (row >= ESM::Land::LAND_SIZE-1)
+            {
+                ++cellX;
+                row -= ESM::Land::LAND_SIZE-1;
+            }
+            while (col < 0)
+            {
+                --cellY;
+                col += ESM::Land::LAND_SIZE-1;
+            }
+            while (row < 0)
+            {
+                --cellX;
+                row += ESM::Land::LAND_SIZE-1;
+            }
+            ESM::Land* land = world.getLand(cellX, cellY);
+            if (land && land->mDataTypes&ESM::Land::DATA_VNML)
+            {
+                normal.x = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3];
+                normal.y = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+1];
+                normal.z = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+2];
+                normal.normalise();
+            }
+            else
+                normal = Ogre::Vector3(0,0,1);
+        }
+
+        void averageNormal (const World& world, Ogre::Vector3 &normal, int cellX, int cellY, int col, int row)
+        {
+            Ogre::Vector3 n1,n2,n3,n4;
+            fixNormal(world, n1, cellX, cellY, col+1, row);
+            fixNormal(world, n2, cellX, cellY, col-1, row);
+            fixNormal(world, n3, cellX, cellY, col, row+1);
+            fixNormal(world, n4, cellX, cellY, col, row-1);
+            normal = (n1+n2+n3+n4);
+            normal.normalise();
+        }
+
+        void fixColour (const World& world, Ogre::ColourValue& color, int cellX, int cellY, int col, int row)
+        {
+            if (col == ESM::Land::LAND_SIZE-1)
+            {
+                ++cellY;
+                col = 0;
+            }
+            if (row == ESM::Land::LAND_SIZE-1)
+            {
+                ++cellX;
+                row = 0;
+            }
+            ESM::Land* land = world.getLand(cellX, cellY);
+            if (land && land->mDataTypes&ESM::Land::DATA_VCLR)
+            {
+                color.r = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3] / 255.f;
+                color.g = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+1] / 255.f;
+                color.b = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+2] / 255.f;
+            }
+            else
+            {
+                color.r = 1;
+                color.g = 1;
+                color.b = 1;
+            }
+        }
+
+        void fillVertexBuffers (const World& world, int lodLevel, float size, const Ogre::Vector2& center,
+            std::vector<float>& positions, std::vector<float>& normals, std::vector<Ogre::uint8>& colours)
+        {
+            size_t increment = 1 << lodLevel;
+
+            Ogre::Vector2 origin = center - Ogre::Vector2(size/2.f, size/2.f);
+
+            int startX = static_cast<int>(origin.x);
+            int startY = static_cast<int>(origin.y);
+
+            size_t numVerts = static_cast<size_t>(size*(ESM::Land::LAND_SIZE - 1) / increment + 1);
+
+            colours.resize(numVerts*numVerts*4);
+            positions.resize(numVerts*numVerts*3);
+            normals.resize(numVerts*numVerts*3);
+
+            Ogre::Vector3 normal;
+            Ogre::ColourValue color;
+
+            float vertY = 0;
+            float vertX = 0;
+
+            float vertY_ = 0;
+            for (int cellY = startY; cellY < startY + std::ceil(size); ++cellY)
+            {
+                float vertX_ = 0;
+                for (int cellX = startX; cellX < startX + std::ceil(size); ++cellX)
+                {
+                    ESM::Land* land = world.getLand(cellX, cellY);
+                    if (land && !(land->mDataTypes&ESM::Land::DATA_VHGT))
+                        land = NULL;
+
+                    int rowStart = 0;
+                    int colStart = 0;
+                    if (colStart == 0 && vertY_ != 0)
+                        colStart += increment;
+                    if (rowStart == 0 && vertX_ != 0)
+                        rowStart += increment;
+
+                    vertY = vertY_;
+                    for (int col=colStart; col<ESM::Land::LAND_SIZE; col += increment)
+                    {
+                        vertX = vertX_;
+                        for (int row=rowStart; row<ESM::Land::LAND_SIZE; row += increment)
+                        {
+                            positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3)] = ((vertX / float(numVerts - 1) - 0.5f) * size * 8192);
+                            positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 1)] = ((vertY / float(numVerts - 1) - 0.5f) * size * 8192);
+                            if (land)
+                                positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = land->mLandData->mHeights[col*ESM::Land::LAND_SIZE + row];
+                            else
+                                positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = -2048;
+
+                            if (land && land->mDataTypes&ESM::Land::DATA_VNML)
+                            {
+                                normal.x = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3];
+                                normal.y = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+1];
+                                normal.z = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+2];
+                                normal.normalise();
+                            }
+                            else
+                                normal = Ogre::Vector3(0,0,1);
+
+                            if (col == ESM::Land::LAND_SIZE-1 || row == ESM::Land::LAND_SIZE-1)
+                                fixNormal(world, normal, cellX, cellY, col, row);
+
+                            if ((row == 0 || row == ESM::Land::LAND_SIZE-1) && (col == 0 || col == ESM::Land::LAND_SIZE-1))
+                                averageNormal(world, normal, cellX, cellY, col, row);
+
+                            normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3)] = normal.x;
+                            normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 1)] = normal.y;
+                            normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = normal.z;
+
+                            if (land && land->mDataTypes&ESM::Land::DATA_VCLR)
+                            {
+                                color.r = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3] / 255.f;
+                                color.g = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+1] / 255.f;
+                                color.b = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+2] / 255.f;
+                            }
+                            else
+                            {
+                                color.r = 1;
+                                color.g = 1;
+                                color.b = 1;
+                            }
+
+                            if (col == ESM::Land::LAND_SIZE-1 || row == ESM::Land::LAND_SIZE-1)
+                                fixColour(world, color, cellX, cellY, col, row);
+
+                            color.a = 1;
+                            Ogre::uint32 rsColor = Ogre::VertexElement::convertColourValue(color,
+                                Ogre::VertexElement::getBestColourVertexElementType());
+                            std::memcpy(&colours[static_cast<unsigned int>(vertX*numVerts * 4 + vertY * 4)], &rsColor, sizeof(Ogre::uint32));
+
+                            ++vertX;
+                        }
+                        ++vertY;
+                    }
+                    vertX_ = vertX;
+                }
+                vertY_ = vertY;
+            }
+        }
+    }
+
+    struct Buffers
+    {
+        std::vector<float> mPositions;
+        std::vector<float> mNormals;
+        std::vector<Ogre::uint8> mColours;
+
+        bool operator== (const Buffers& buffers) const
+        {
+            return mPositions==buffers.mPositions && mNormals==buffers.mNormals && mColours==buffers.mColours;
+        }
+    };
+
+    struct Chunk
+    {
+        int mLodLevel;
+        float mSize;
+        Ogre::Vector2 mCenter;
+    };
+
+    /// The quad tree of Terrain::DefaultWorld, for a world with a power of two size
+    std::vector<Chunk> makeChunks (int worldSize)
+    {
+        std::vector<Chunk> chunks;
+
+        int lodLevel = 0;
+        for (int size=1; size<=worldSize; size*=2, ++lodLevel)
+            for (int y=0; y<worldSize; y+=size)
+                for (int x=0; x<worldSize; x+=size)
+                {
+                    Chunk chunk;
+                    chunk.mLodLevel = lodLevel;
+                    chunk.mSize = static_cast<float> (size);
+                    chunk.mCenter = Ogre::Vector2 (x + size/2.f, y + size/2.f);
+                    chunks.push_back (chunk);
+                }
+
+        return chunks;
+    }
+
+    /// \return ms
+    double runReference (const World& world, const std::vector<Chunk>& chunks)
+    {
+        Buffers buffers;
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (size_t i=0; i<chunks.size(); ++i)
+            Reference::fillVertexBuffers (world, chunks[i].mLodLevel, chunks[i].mSize, chunks[i].mCenter,
+                buffers.mPositions, buffers.mNormals, buffers.mColours);
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+    }
+
+    /// \param reverse Fill the chunks in reverse order, like a camera going back the way it came,
+    /// which finds the cells decoded last still in the cache.
+    /// \return ms
+    double runStorage (Storage& storage, const std::vector<Chunk>& chunks, bool reverse)
+    {
+        Buffers buffers;
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        for (size_t j=0; j<chunks.size(); ++j)
+        {
+            size_t i = reverse ? chunks.size()-1-j : j;
+            storage.fillVertexBuffers (chunks[i].mLodLevel, chunks[i].mSize, chunks[i].mCenter, Terrain::Align_XY,
+                buffers.mPositions, buffers.mNormals, buffers.mColours);
+        }
+
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+    }
+
+    /// \return Do the reference and \a storage write the same vertices for all chunks?
+    bool check (const World& world, Storage& storage, const std::vector<Chunk>& chunks)
+    {
+        Buffers reference;
+        Buffers buffers;
+
+        for (size_t i=0; i<chunks.size(); ++i)
+        {
+            Reference::fillVertexBuffers (world, chunks[i].mLodLevel, chunks[i].mSize, chunks[i].mCenter,
+                reference.mPositions, reference.mNormals, reference.mColours);
+            storage.fillVertexBuffers (chunks[i].mLodLevel, chunks[i].mSize, chunks[i].mCenter, Terrain::Align_XY,
+                buffers.mPositions, buffers.mNormals, buffers.mColours);
+
+            if (!(reference==buffers))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int worldSize = 16;
+
+    if (argc>1)
+    {
+        // round down to a power of two, like the quad tree
+        int size = std::max (1, std::atoi (argv[1]));
+        for (worldSize=1; worldSize*2<=size; worldSize*=2) {}
+    }
+
+    try
+    {
+        World world (worldSize);
+        Storage storage (world);
+
+        std::vector<Chunk> chunks = makeChunks (worldSize);
+
+        double referenceTime = runReference (world, chunks);
+        double coldTime = runStorage (storage, chunks, false);
+        double warmTime = runStorage (storage, chunks, true);
+
+        std::cout << worldSize << "x" << worldSize << " cells, " << chunks.size() << " chunks: reference "
+            << referenceTime << " ms, storage " << coldTime << " ms (" << referenceTime / coldTime
+            << "x), cached " << warmTime << " ms (" << referenceTime / warmTime << "x)" << std::endl;
+
+        // once with the cells still in the cache and once decoding them again
+        Storage fresh (world);
+
+        if (!check (world, storage, chunks) || !check (world, fresh, chunks))
+        {
+            std::cerr << "error: reference and storage wrote different vertices" << std::endl;
+            return 1;
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
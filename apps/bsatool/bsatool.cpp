@@ -7,6 +7,7 @@
 #include <boost/filesystem/fstream.hpp>
 
 #include <components/bsa/bsa_file.hpp>
+#include <components/bsa/vfsindex.hpp>
 
 #define BSATOOL_VERSION 1.1
 
@@ -21,6 +22,9 @@ struct Arguments
     std::string extractfile;
     std::string outdir;
 
+    std::vector<std::string> archives;
+    std::vector<std::string> dataDirs;
+
     bool longformat;
     bool fullpath;
 };
@@ -45,6 +49,9 @@ bool parseOptions (int argc, char** argv, Arguments &info)
             "      Extract a file from the input archive.\n\n"
             "  bsatool extractall archivefile [output_directory]\n"
             "      Extract all files from the input archive.\n\n"
+            "  bsatool vfs [-l] [--data directory]... [archivefile]...\n"
+            "      List the files of the virtual file system built from the data directories\n"
+            "      and archives, in increasing priority, with the source each file is loaded from.\n\n"
             "Allowed options");
 
     desc.add_options()
@@ -53,6 +60,8 @@ bool parseOptions (int argc, char** argv, Arguments &info)
         ("long,l", "Include extra information in archive listing.")
         ("full-path,f", "Create directory hierarchy on file extraction "
          "(always true for extractall).")
+        ("data", bpo::value< std::vector<std::string> >()->composing(),
+         "Data directory for the vfs mode, may be given multiple times.")
         ;
 
     // input-file is hidden and used as a positional argument
@@ -64,7 +73,7 @@ bool parseOptions (int argc, char** argv, Arguments &info)
         ;
 
     bpo::positional_options_description p;
-    p.add("mode", 1).add("input-file", 3);
+    p.add("mode", 1).add("input-file", -1);
 
     // there might be a better way to do this
     bpo::options_description all;
@@ -104,13 +113,31 @@ bool parseOptions (int argc, char** argv, Arguments &info)
     }
 
     info.mode = variables["mode"].as<std::string>();
-    if (!(info.mode == "list" || info.mode == "extract" || info.mode == "extractall"))
+    if (!(info.mode == "list" || info.mode == "extract" || info.mode == "extractall" || info.mode == "vfs"))
     {
         std::cout << std::endl << "ERROR: invalid mode \"" << info.mode << "\"\n\n"
             << desc << std::endl;
         return false;
     }
 
+    info.longformat = variables.count("long") != 0;
+
+    if (info.mode == "vfs")
+    {
+        if (variables.count("input-file"))
+            info.archives = variables["input-file"].as< std::vector<std::string> >();
+        if (variables.count("data"))
+            info.dataDirs = variables["data"].as< std::vector<std::string> >();
+
+        if (info.archives.empty() && info.dataDirs.empty())
+        {
+            std::cout << "\nERROR: no archives or data directories given\n\n"
+                << desc << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     if (!variables.count("input-file"))
     {
         std::cout << "\nERROR: missing BSA archive\n\n"
@@ -138,7 +165,6 @@ bool parseOptions (int argc, char** argv, Arguments &info)
     else if (variables["input-file"].as< std::vector<std::string> >().size() > 1)
         info.outdir = variables["input-file"].as< std::vector<std::string> >()[1];
 
-    info.longformat = variables.count("long") != 0;
     info.fullpath = variables.count("full-path") != 0;
 
     return true;
@@ -147,6 +173,7 @@ bool parseOptions (int argc, char** argv, Arguments &info)
 int list(Bsa::BSAFile& bsa, Arguments& info);
 int extract(Bsa::BSAFile& bsa, Arguments& info);
 int extractAll(Bsa::BSAFile& bsa, Arguments& info);
+int vfs(Arguments& info);
 
 int main(int argc, char** argv)
 {
@@ -156,6 +183,9 @@ int main(int argc, char** argv)
         if(!parseOptions (argc, argv, info))
             return 1;
 
+        if (info.mode == "vfs")
+            return vfs(info);
+
         // Open file
         Bsa::BSAFile bsa;
         bsa.open(info.filename);
@@ -287,3 +317,19 @@ int extractAll(Bsa::BSAFile& bsa, Arguments& info)
 
     return 0;
 }
+
+int vfs(Arguments& info)
+{
+    // Same priorities as in the engine: archives in order, then loose files overriding them
+    Bsa::VFSIndex index;
+
+    for (std::vector<std::string>::const_iterator it = info.archives.begin(); it != info.archives.end(); ++it)
+        index.addArchive(*it);
+
+    for (std::vector<std::string>::const_iterator it = info.dataDirs.begin(); it != info.dataDirs.end(); ++it)
+        index.addDirectory(*it);
+
+    index.dump(std::cout, info.longformat);
+
+    return 0;
+}
@@ -244,19 +244,18 @@ namespace CSVWorld
         bool ignoreObjects = !(visibilityMask & (uint32_t)CSVRender::Element_Reference);
 
         Ogre::Vector3 norm; // not used
-        std::pair<std::string, float> result =
+        std::pair<const OEngine::Physic::RigidBody*, float> result =
                                 mEngine->rayTest(_from, _to, !ignoreObjects, ignoreHeightMap, &norm);
 
-        // result.first is the object's referenceId
-        if(result.first == "")
+        // the name of the hit body is the object's referenceId
+        if(!result.first)
             return std::make_pair("", Ogre::Vector3(0,0,0));
         else
         {
-            std::string name = refIdToSceneNode(result.first, sceneMgr);
+            const std::string& referenceId = result.first->mName;
+            std::string name = refIdToSceneNode(referenceId, sceneMgr);
             if(name == "")
-                name = result.first;
-            else
-                name = refIdToSceneNode(result.first, sceneMgr);
+                name = referenceId;
 
             return std::make_pair(name, ray.getPoint(farClipDist*result.second));
         }
@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 #include <iomanip>
+#include <algorithm>
+#include <sstream>
 
 #include <OgreRoot.h>
 #include <OgreRenderWindow.h>
@@ -22,6 +24,7 @@
 #include <components/nifbullet/bulletnifloader.hpp>
 #include <components/nifogre/ogrenifloader.hpp>
 
+#include <components/esm/cachefile.hpp>
 #include <components/esm/loadcell.hpp>
 
 #include "mwinput/inputmanagerimp.hpp"
@@ -48,6 +51,23 @@
 
 #include "mwstate/statemanagerimp.hpp"
 
+namespace
+{
+    /// Identifies the engine build and the content files in load order, for caches of data
+    /// derived from them
+    std::string getContentKey (const Files::Collections& collections,
+        const std::vector<std::string>& content)
+    {
+        std::vector<boost::filesystem::path> files;
+
+        for (std::vector<std::string>::const_iterator iter (content.begin()); iter!=content.end(); ++iter)
+            files.push_back (
+                collections.getCollection (boost::filesystem::path (*iter).extension().string()).getPath (*iter));
+
+        return ESM::getCacheKey (files);
+    }
+}
+
 void OMW::Engine::executeLocalScripts()
 {
     MWWorld::LocalScripts& localScripts = MWBase::Environment::get().getWorld()->getLocalScripts();
@@ -365,6 +385,9 @@ void OMW::Engine::prepareEngine (Settings::Manager & settings)
 
     Bsa::registerResources (mFileCollections, mArchives, true, mFSStrict);
 
+    mNifCache.setThreads (std::max (0, settings.getInt ("nif loading threads", "Cells")));
+    mNifCache.setMemoryBudget (std::max (0, settings.getInt ("nif cache size", "Cells")) * 1024 * 1024);
+
     // Create input and UI first to set up a bootstrapping environment for
     // showing a loading screen and keeping the window responsive while doing so
 
@@ -431,9 +454,14 @@ void OMW::Engine::prepareEngine (Settings::Manager & settings)
     mScriptContext = new MWScript::CompilerContext (MWScript::CompilerContext::Type_Full);
     mScriptContext->setExtensions (&mExtensions);
 
-    mEnvironment.setScriptManager (new MWScript::ScriptManager (MWBase::Environment::get().getWorld()->getStore(),
-        mVerboseScripts, *mScriptContext, mWarningsMode,
-        mScriptBlacklistUse ? mScriptBlacklist : std::vector<std::string>()));
+    MWScript::ScriptManager* scriptManager = new MWScript::ScriptManager (
+        MWBase::Environment::get().getWorld()->getStore(), mVerboseScripts, *mScriptContext, mWarningsMode,
+        mScriptBlacklistUse ? mScriptBlacklist : std::vector<std::string>());
+    mEnvironment.setScriptManager (scriptManager);
+
+    if (Settings::Manager::getBool ("script cache", "General"))
+        scriptManager->enableCache (mCfgMgr.getCachePath() / "scripts.cache",
+            getContentKey (mFileCollections, mContentFiles));
 
     // Create game mechanics system
     MWMechanics::MechanicsManager* mechanics = new MWMechanics::MechanicsManager;
@@ -50,6 +50,7 @@ namespace MWRender
 namespace MWMechanics
 {
     struct Movement;
+    class NavigationGraph;
 }
 
 namespace MWWorld
@@ -112,6 +113,12 @@ namespace MWBase
 
             virtual MWWorld::CellStore *getExterior (int x, int y) = 0;
 
+            virtual bool preloadExterior (int x, int y, size_t references) = 0;
+            ///< Load at most \a references more references of an exterior cell, so that loading a
+            /// cell can be spread over several frames.
+            ///
+            /// \return Are all references of the cell loaded?
+
             virtual MWWorld::CellStore *getInterior (const std::string& name) = 0;
 
             virtual MWWorld::CellStore *getCell (const ESM::CellId& id) = 0;
@@ -134,6 +141,9 @@ namespace MWBase
 
             virtual const MWWorld::ESMStore& getStore() const = 0;
 
+            virtual const MWMechanics::NavigationGraph& getNavigationGraph() const = 0;
+            ///< Graph of the pathgrids of all exterior cells
+
             virtual std::vector<ESM::ESMReader>& getEsmReader() = 0;
 
             virtual MWWorld::LocalScripts& getLocalScripts() = 0;
@@ -439,6 +449,11 @@ namespace MWBase
             virtual bool getLOS(const MWWorld::Ptr& actor,const MWWorld::Ptr& targetActor) = 0;
             ///< get Line of Sight (morrowind stupid implementation)
 
+            virtual void getLOS(const MWWorld::Ptr& actor, const std::vector<MWWorld::Ptr>& targetActors,
+                std::vector<bool>& out) = 0;
+            ///< Same as getLOS for each of \a targetActors, with the rays cast in one batch.
+            /// \a out gets one entry per target.
+
             virtual float getDistToNearestRayHit(const Ogre::Vector3& from, const Ogre::Vector3& dir, float maxDist) = 0;
 
             virtual void enableActorCollision(const MWWorld::Ptr& actor, bool enable) = 0;
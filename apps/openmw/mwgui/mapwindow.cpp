@@ -559,6 +559,7 @@ namespace MWGui
         , mEventBoxGlobal(NULL)
         , mEventBoxLocal(NULL)
         , mGlobalMapRender(0)
+        , mCacheDir(cacheDir)
         , mEditNoteDialog()
     {
         static bool registered = false;
@@ -701,7 +702,8 @@ namespace MWGui
 
     void MapWindow::renderGlobalMap(Loading::Listener* loadingListener)
     {
-        mGlobalMapRender = new MWRender::GlobalMap("");
+        mGlobalMapRender = new MWRender::GlobalMap(
+            Settings::Manager::getBool("global map cache", "General") ? mCacheDir : "");
         mGlobalMapRender->render(loadingListener);
         mGlobalMap->setCanvasSize (mGlobalMapRender->getWidth(), mGlobalMapRender->getHeight());
         mGlobalMapImage->setSize(mGlobalMapRender->getWidth(), mGlobalMapRender->getHeight());
@@ -218,6 +218,8 @@ namespace MWGui
 
         MWRender::GlobalMap* mGlobalMapRender;
 
+        std::string mCacheDir;
+
         EditNoteDialog mEditNoteDialog;
         ESM::CustomMarker mEditingMarker;
 
@@ -102,6 +102,7 @@ namespace MWGui
             const std::string& logpath, const std::string& cacheDir, bool consoleOnlyScripts,
             Translation::Storage& translationDataStorage, ToUTF8::FromType encoding, bool exportFonts, const std::map<std::string, std::string>& fallbackMap)
       : mConsoleOnlyScripts(consoleOnlyScripts)
+      , mCacheDir(cacheDir)
       , mCurrentModals()
       , mGuiManager(NULL)
       , mRendering(ogre)
@@ -253,7 +254,7 @@ namespace MWGui
 
         mRecharge = new Recharge();
         mMenu = new MainMenu(w,h);
-        mMap = new MapWindow(mCustomMarkers, mDragAndDrop, "");
+        mMap = new MapWindow(mCustomMarkers, mDragAndDrop, mCacheDir);
         trackWindow(mMap, "map");
         mStatsWindow = new StatsWindow(mDragAndDrop);
         trackWindow(mStatsWindow, "stats");
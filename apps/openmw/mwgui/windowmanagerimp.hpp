@@ -354,6 +354,8 @@ namespace MWGui
   private:
     bool mConsoleOnlyScripts;
 
+    std::string mCacheDir;
+
     std::map<MyGUI::Window*, std::string> mTrackedWindows;
     void trackWindow(OEngine::GUI::Layout* layout, const std::string& name);
     void onWindowChangeCoord(MyGUI::Window* _sender);
@@ -2,6 +2,7 @@
 #include "actors.hpp"
 
 #include <typeinfo>
+#include <algorithm>
 
 #include <OgreVector3.h>
 #include <OgreSceneNode.h>
@@ -182,6 +183,19 @@ void getRestorationPerHourOfSleep (const MWWorld::Ptr& ptr, float& health, float
     }
 }
 
+float getMaxHeadTrackDistance (const MWWorld::Ptr& actor)
+{
+    static const float fMaxHeadTrackDistance = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
+            .find("fMaxHeadTrackDistance")->getFloat();
+    static const float fInteriorHeadTrackMult = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
+            .find("fInteriorHeadTrackMult")->getFloat();
+    float maxDistance = fMaxHeadTrackDistance;
+    const ESM::Cell* currentCell = actor.getCell()->getCell();
+    if (!currentCell->isExterior() && !(currentCell->mData.mFlags & ESM::Cell::QuasiEx))
+        maxDistance *= fInteriorHeadTrackMult;
+    return maxDistance;
+}
+
 }
 
 namespace MWMechanics
@@ -274,14 +288,7 @@ namespace MWMechanics
     void Actors::updateHeadTracking(const MWWorld::Ptr& actor, const MWWorld::Ptr& targetActor,
                                     MWWorld::Ptr& headTrackTarget, float& sqrHeadTrackDistance)
     {
-        static const float fMaxHeadTrackDistance = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
-                .find("fMaxHeadTrackDistance")->getFloat();
-        static const float fInteriorHeadTrackMult = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
-                .find("fInteriorHeadTrackMult")->getFloat();
-        float maxDistance = fMaxHeadTrackDistance;
-        const ESM::Cell* currentCell = actor.getCell()->getCell();
-        if (!currentCell->isExterior() && !(currentCell->mData.mFlags & ESM::Cell::QuasiEx))
-            maxDistance *= fInteriorHeadTrackMult;
+        float maxDistance = getMaxHeadTrackDistance(actor);
 
         const ESM::Position& actor1Pos = actor.getRefData().getPosition();
         const ESM::Position& actor2Pos = targetActor.getRefData().getPosition();
@@ -1000,7 +1007,8 @@ namespace MWMechanics
         }
     }
 
-    Actors::Actors() {}
+    // About the diameter of the head tracking search
+    Actors::Actors() : mGrid (1024) {}
 
     Actors::~Actors()
     {
@@ -1013,6 +1021,7 @@ namespace MWMechanics
 
         MWRender::Animation *anim = MWBase::Environment::get().getWorld()->getAnimation(ptr);
         mActors.insert(std::make_pair(ptr, new Actor(ptr, anim)));
+        updatePosition(ptr);
         if (updateImmediately)
             mActors[ptr]->getCharacterController()->update(0);
     }
@@ -1024,6 +1033,7 @@ namespace MWMechanics
         {
             delete iter->second;
             mActors.erase(iter);
+            mGrid.remove(ptr);
         }
     }
 
@@ -1037,6 +1047,18 @@ namespace MWMechanics
 
             actor->updatePtr(ptr);
             mActors.insert(std::make_pair(ptr, actor));
+
+            mGrid.remove(old);
+            updatePosition(ptr);
+        }
+    }
+
+    void Actors::updatePosition (const MWWorld::Ptr& ptr)
+    {
+        if (mActors.find(ptr) != mActors.end())
+        {
+            const float *pos = ptr.getRefData().getPosition().pos;
+            mGrid.update(ptr, pos[0], pos[1], pos[2]);
         }
     }
 
@@ -1048,6 +1070,7 @@ namespace MWMechanics
             if(iter->first.getCell()==cellStore && iter->first != ignore)
             {
                 delete iter->second;
+                mGrid.remove(iter->first);
                 mActors.erase(iter++);
             }
             else
@@ -1076,6 +1099,10 @@ namespace MWMechanics
             // using higher values will make a quest in Bloodmoon harder or impossible to complete (bug #1876)
             const float sqrProcessingDistance = 7168*7168;
 
+            // Positions can also be changed without going through World::moveObject
+            for(PtrActorMap::iterator iter(mActors.begin()); iter != mActors.end(); ++iter)
+                updatePosition(iter->first);
+
             /// \todo move update logic to Actor class where appropriate
 
              // AI and magic effects update
@@ -1093,6 +1120,8 @@ namespace MWMechanics
                             if (iter->first != player)
                                 adjustCommandedActor(iter->first);
 
+                            // Usually all actors are within the processing distance, so there's
+                            // nothing to gain from the grid here
                             for(PtrActorMap::iterator it(mActors.begin()); it != mActors.end(); ++it)
                             {
                                 if (it->first == iter->first || iter->first == player) // player is not AI-controlled
@@ -1105,11 +1134,15 @@ namespace MWMechanics
                             float sqrHeadTrackDistance = std::numeric_limits<float>::max();
                             MWWorld::Ptr headTrackTarget;
 
-                            for(PtrActorMap::iterator it(mActors.begin()); it != mActors.end(); ++it)
+                            std::vector<MWWorld::Ptr> neighbors;
+                            getObjectsInRange(Ogre::Vector3(iter->first.getRefData().getPosition().pos),
+                                getMaxHeadTrackDistance(iter->first), neighbors);
+
+                            for(std::vector<MWWorld::Ptr>::iterator it(neighbors.begin()); it != neighbors.end(); ++it)
                             {
-                                if (it->first == iter->first)
+                                if (*it == iter->first)
                                     continue;
-                                updateHeadTracking(iter->first, it->first, headTrackTarget, sqrHeadTrackDistance);
+                                updateHeadTracking(iter->first, *it, headTrackTarget, sqrHeadTrackDistance);
                             }
                             iter->second->getCharacterController()->setHeadTrackTarget(headTrackTarget);
                         }
@@ -1227,16 +1260,26 @@ namespace MWMechanics
 
                     bool detected = false;
 
+                    // is the player in range
+                    std::vector<MWWorld::Ptr> observers;
                     for (PtrActorMap::iterator iter(mActors.begin()); iter != mActors.end(); ++iter)
                     {
                         if (iter->first == player)  // not the player
                             continue;
 
-                        // is the player in range and can they be detected
-                        if (Ogre::Vector3(iter->first.getRefData().getPosition().pos).squaredDistance(Ogre::Vector3(player.getRefData().getPosition().pos)) <= radius*radius
-                            && MWBase::Environment::get().getWorld()->getLOS(player, iter->first))
+                        if (Ogre::Vector3(iter->first.getRefData().getPosition().pos).squaredDistance(Ogre::Vector3(player.getRefData().getPosition().pos)) <= radius*radius)
+                            observers.push_back(iter->first);
+                    }
+
+                    std::vector<bool> inLOS;
+                    MWBase::Environment::get().getWorld()->getLOS(player, observers, inLOS);
+
+                    for (size_t i = 0; i < observers.size(); ++i)
+                    {
+                        // can the player be detected
+                        if (inLOS[i])
                         {
-                            if (MWBase::Environment::get().getMechanicsManager()->awarenessCheck(player, iter->first))
+                            if (MWBase::Environment::get().getMechanicsManager()->awarenessCheck(player, observers[i]))
                             {
                                 detected = true;
                                 avoidedNotice = false;
@@ -1384,11 +1427,9 @@ namespace MWMechanics
 
     void Actors::getObjectsInRange(const Ogre::Vector3& position, float radius, std::vector<MWWorld::Ptr>& out)
     {
-        for (PtrActorMap::iterator iter = mActors.begin(); iter != mActors.end(); ++iter)
-        {
-            if (Ogre::Vector3(iter->first.getRefData().getPosition().pos).squaredDistance(position) <= radius*radius)
-                out.push_back(iter->first);
-        }
+        std::vector<MWWorld::Ptr>::size_type size = out.size();
+        mGrid.query(position.x, position.y, position.z, radius, out);
+        std::sort(out.begin() + size, out.end());
     }
 
     std::list<MWWorld::Ptr> Actors::getActorsFollowing(const MWWorld::Ptr& actor)
@@ -1502,6 +1543,7 @@ namespace MWMechanics
             it->second = NULL;
         }
         mActors.clear();
+        mGrid.clear();
         mDeathCount.clear();
     }
 
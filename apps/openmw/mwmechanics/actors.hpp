@@ -7,6 +7,8 @@
 #include <map>
 #include <list>
 
+#include <components/misc/spatialgrid.hpp>
+
 #include "movement.hpp"
 #include "../mwbase/world.hpp"
 
@@ -75,6 +77,11 @@ namespace MWMechanics
             void updateActor(const MWWorld::Ptr &old, const MWWorld::Ptr& ptr);
             ///< Updates an actor with a new Ptr
 
+            void updatePosition (const MWWorld::Ptr& ptr);
+            ///< Must be called after an actor has been moved, for the proximity queries.
+            ///
+            /// \note Ignored, if \a ptr is not a registered actor.
+
             void dropActors (const MWWorld::CellStore *cellStore, const MWWorld::Ptr& ignore);
             ///< Deregister all actors (except for \a ignore) in the given cell.
 
@@ -115,6 +122,8 @@ namespace MWMechanics
         bool checkAnimationPlaying(const MWWorld::Ptr& ptr, const std::string& groupName);
 
             void getObjectsInRange(const Ogre::Vector3& position, float radius, std::vector<MWWorld::Ptr>& out);
+            ///< Append the actors within \a radius of \a position to \a out, in the same order as
+            /// begin() to end().
 
             ///Returns the list of actors which are following the given actor
             /**ie AiFollow is active and the target is the actor **/
@@ -138,6 +147,8 @@ namespace MWMechanics
     private:
         PtrActorMap mActors;
 
+        Misc::SpatialGrid<MWWorld::Ptr> mGrid; ///< positions of mActors
+
     };
 }
 
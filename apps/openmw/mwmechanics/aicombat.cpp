@@ -587,8 +587,7 @@ namespace MWMechanics
                 if(inLOS && mPathFinder.getPath().size() > 1)
                 {
                     // get point just before target
-                    std::list<ESM::Pathgrid::Point>::const_iterator pntIter = --mPathFinder.getPath().end();
-                    --pntIter;
+                    std::deque<ESM::Pathgrid::Point>::const_iterator pntIter = mPathFinder.getPath().end() - 2;
                     Ogre::Vector3 vBeforeTarget(PathFinder::MakeOgreVector3(*pntIter));
 
                     // if current actor pos is closer to target then last point of path (excluding target itself) then go straight on target
@@ -561,10 +561,10 @@ namespace MWMechanics
         // Every now and then check whether one of the doors is opened. (maybe
         // at the end of playing idle?) If the door is opened then re-calculate
         // allowed nodes starting from the spawn point.
-        std::list<ESM::Pathgrid::Point> paths = pathfinder.getPath();
-        while(paths.size() >= 2)
+        const std::deque<ESM::Pathgrid::Point>& paths = pathfinder.getPath();
+        for(size_t i = paths.size(); i >= 2; --i)
         {
-            ESM::Pathgrid::Point pt = paths.back();
+            const ESM::Pathgrid::Point& pt = paths[i - 1];
             for(unsigned int j = 0; j < nodes.size(); j++)
             {
                 // FIXME: doesn't hadle a door with the same X/Y
@@ -575,7 +575,6 @@ namespace MWMechanics
                     break;
                 }
             }
-            paths.pop_back();
         }
     }
 
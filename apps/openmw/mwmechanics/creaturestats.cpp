@@ -10,6 +10,13 @@
 #include "../mwbase/world.hpp"
 #include "../mwbase/mechanicsmanager.hpp"
 
+namespace
+{
+    // Handles into the store passed to CreatureStats::setUp
+    MWWorld::RecordHandle fFatigueBase = -1;
+    MWWorld::RecordHandle fFatigueMult = -1;
+}
+
 namespace MWMechanics
 {
     int CreatureStats::sActorId = 0;
@@ -46,8 +53,9 @@ namespace MWMechanics
         const MWWorld::Store<ESM::GameSetting> &gmst =
             MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>();
 
-        return gmst.find ("fFatigueBase")->getFloat()
-            - gmst.find ("fFatigueMult")->getFloat() * (1-normalised);
+        // Called for every actor and every hit, so skip the ID lookups
+        return gmst.find (fFatigueBase)->getFloat()
+            - gmst.find (fFatigueMult)->getFloat() * (1-normalised);
     }
 
     const AttributeValue &CreatureStats::getAttribute(int index) const
@@ -611,6 +619,14 @@ namespace MWMechanics
         return mActorId!=-1 && id==mActorId;
     }
 
+    void CreatureStats::setUp (const MWWorld::ESMStore& store)
+    {
+        const MWWorld::Store<ESM::GameSetting>& gmst = store.get<ESM::GameSetting>();
+
+        fFatigueBase = gmst.getHandle ("fFatigueBase");
+        fFatigueMult = gmst.getHandle ("fFatigueMult");
+    }
+
     void CreatureStats::cleanup()
     {
         sActorId = 0;
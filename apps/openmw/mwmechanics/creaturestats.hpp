@@ -17,6 +17,11 @@ namespace ESM
     struct CreatureStats;
 }
 
+namespace MWWorld
+{
+    class ESMStore;
+}
+
 namespace MWMechanics
 {
     /// \brief Common creature stats
@@ -275,6 +280,10 @@ namespace MWMechanics
         /// assigned this function will return false).
 
         static void cleanup();
+
+        static void setUp (const MWWorld::ESMStore& store);
+        ///< Look up the game settings used for every actor in every frame. Must be called again
+        /// for another store.
     };
 }
 
@@ -315,6 +315,8 @@ namespace MWMechanics
       mRaceSelected (false), mAI(true)
     {
         //buildPlayer no longer here, needs to be done explicitely after all subsystems are up and running
+
+        CreatureStats::setUp (MWBase::Environment::get().getWorld()->getStore());
     }
 
     void MechanicsManager::add(const MWWorld::Ptr& ptr)
@@ -344,6 +346,11 @@ namespace MWMechanics
             mObjects.updateObject(old, ptr);
     }
 
+    void MechanicsManager::updatePosition(const MWWorld::Ptr& ptr)
+    {
+        mActors.updatePosition(ptr);
+    }
+
 
     void MechanicsManager::drop(const MWWorld::CellStore *cellStore)
     {
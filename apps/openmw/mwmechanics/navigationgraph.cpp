@@ -0,0 +1,580 @@
+#include "navigationgraph.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <components/esm/cachefile.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/esm/loadland.hpp>
+#include <components/misc/hash.hpp>
+
+#include "../mwworld/store.hpp"
+
+namespace
+{
+    /// Increase when the layout of the cache or the way the graph is built changes
+    const int sCacheFormat = 2;
+
+    const uint32_t sGraphRecord = ESM::FourCC<'N','A','V','G'>::value;
+
+    /// Points on either side of a cell border are joined, if they are no further apart than this.
+    /// The graph is built before any cell is loaded, so there is no collision world to test the
+    /// line of sight with. About the usual distance between neighbouring points rarely leaves room
+    /// for a wall in between.
+    const float sMaxLinkDistance = 512;
+
+    float getDistance (const float *left, const float *right)
+    {
+        float x = left[0] - right[0];
+        float y = left[1] - right[1];
+        float z = left[2] - right[2];
+        return std::sqrt (x * x + y * y + z * z);
+    }
+
+    /// Links that climb or drop more than they advance are more likely to pass through a cliff or
+    /// a floor than to follow a slope.
+    bool isWalkable (const float *from, const float *to)
+    {
+        float x = from[0] - to[0];
+        float y = from[1] - to[1];
+        float z = from[2] - to[2];
+        return z * z <= x * x + y * y;
+    }
+
+    template<typename Edge>
+    void addEdge (std::vector<std::vector<Edge> >& edges, int from, int to, float cost)
+    {
+        std::vector<Edge>& fromEdges = edges[from];
+
+        for (typename std::vector<Edge>::const_iterator iter (fromEdges.begin()); iter!=fromEdges.end(); ++iter)
+            if (iter->mTarget==to)
+                return;
+
+        Edge edge;
+        edge.mTarget = to;
+        edge.mCost = cost;
+        fromEdges.push_back (edge);
+    }
+
+    template<typename T>
+    void writeArray (ESM::ESMWriter& writer, const char *name, const std::vector<T>& data)
+    {
+        writer.startSubRecord (name);
+        if (!data.empty())
+            writer.write (reinterpret_cast<const char *> (&data[0]), data.size() * sizeof (T));
+        writer.endRecord (name);
+    }
+
+    template<typename T>
+    void readArray (ESM::ESMReader& reader, const char *name, std::vector<T>& data)
+    {
+        reader.getSubNameIs (name);
+        reader.getSubHeader();
+
+        if (reader.getSubSize() % sizeof (T))
+            throw std::runtime_error (std::string ("invalid size of ") + name);
+
+        data.resize (reader.getSubSize() / sizeof (T));
+        if (!data.empty())
+            reader.getExact (&data[0], static_cast<int> (data.size() * sizeof (T)));
+    }
+}
+
+namespace MWMechanics
+{
+    void NavigationGraph::Level::build (const std::vector<std::vector<Edge> >& edges)
+    {
+        mEdges.clear();
+
+        for (size_t i=0; i<mNodes.size(); ++i)
+        {
+            mNodes[i].mFirstEdge = static_cast<int> (mEdges.size());
+            mNodes[i].mEdgeCount = static_cast<int> (edges[i].size());
+            mEdges.insert (mEdges.end(), edges[i].begin(), edges[i].end());
+        }
+
+        // Flood fill along the edges in both directions
+        std::vector<std::vector<int> > neighbours (mNodes.size());
+        for (size_t i=0; i<mNodes.size(); ++i)
+            for (std::vector<Edge>::const_iterator iter (edges[i].begin()); iter!=edges[i].end(); ++iter)
+            {
+                neighbours[i].push_back (iter->mTarget);
+                neighbours[iter->mTarget].push_back (static_cast<int> (i));
+            }
+
+        for (size_t i=0; i<mNodes.size(); ++i)
+            mNodes[i].mComponent = -1;
+
+        std::vector<int> open;
+        for (size_t i=0; i<mNodes.size(); ++i)
+        {
+            if (mNodes[i].mComponent!=-1)
+                continue;
+
+            mNodes[i].mComponent = static_cast<int> (i);
+            open.push_back (static_cast<int> (i));
+
+            while (!open.empty())
+            {
+                int node = open.back();
+                open.pop_back();
+
+                for (std::vector<int>::const_iterator iter (neighbours[node].begin());
+                    iter!=neighbours[node].end(); ++iter)
+                    if (mNodes[*iter].mComponent==-1)
+                    {
+                        mNodes[*iter].mComponent = static_cast<int> (i);
+                        open.push_back (*iter);
+                    }
+            }
+        }
+    }
+
+    bool NavigationGraph::Level::isValid (size_t cells) const
+    {
+        for (std::vector<Node>::const_iterator iter (mNodes.begin()); iter!=mNodes.end(); ++iter)
+            if (iter->mCell<0 || static_cast<size_t> (iter->mCell)>=cells ||
+                iter->mFirstEdge<0 || iter->mEdgeCount<0 ||
+                static_cast<size_t> (iter->mFirstEdge) + iter->mEdgeCount>mEdges.size() ||
+                iter->mComponent<0 || static_cast<size_t> (iter->mComponent)>=mNodes.size())
+                return false;
+
+        for (std::vector<Edge>::const_iterator iter (mEdges.begin()); iter!=mEdges.end(); ++iter)
+            if (iter->mTarget<0 || static_cast<size_t> (iter->mTarget)>=mNodes.size())
+                return false;
+
+        return true;
+    }
+
+    void NavigationGraph::Level::startSearch() const
+    {
+        ++mSearch;
+
+        if (mReached.size()!=mNodes.size() || mSearch==0)
+        {
+            mReached.assign (mNodes.size(), 0);
+            mClosed.assign (mNodes.size(), 0);
+            mCost.resize (mNodes.size());
+            mParent.resize (mNodes.size());
+            mSearch = 1;
+        }
+
+        mOpen.clear();
+    }
+
+    NavigationGraph::NavigationGraph() {}
+
+    void NavigationGraph::build (const MWWorld::Store<ESM::Pathgrid>& pathgrids,
+        const boost::filesystem::path& cacheFile)
+    {
+        build (pathgrids.extBegin(), pathgrids.extEnd(), cacheFile);
+    }
+
+    void NavigationGraph::build (PathgridIterator begin, PathgridIterator end,
+        const boost::filesystem::path& cacheFile)
+    {
+        uint64_t hash = Misc::sHashSeed;
+
+        for (PathgridIterator iter (begin); iter!=end; ++iter)
+        {
+            const ESM::Pathgrid& pathgrid = iter->second;
+
+            Misc::addHash (hash, iter->first.first);
+            Misc::addHash (hash, iter->first.second);
+            Misc::addHash (hash, static_cast<int> (pathgrid.mPoints.size()));
+            Misc::addHash (hash, static_cast<int> (pathgrid.mEdges.size()));
+
+            for (ESM::Pathgrid::PointList::const_iterator point (pathgrid.mPoints.begin());
+                point!=pathgrid.mPoints.end(); ++point)
+            {
+                Misc::addHash (hash, point->mX);
+                Misc::addHash (hash, point->mY);
+                Misc::addHash (hash, point->mZ);
+            }
+
+            for (ESM::Pathgrid::EdgeList::const_iterator edge (pathgrid.mEdges.begin());
+                edge!=pathgrid.mEdges.end(); ++edge)
+            {
+                Misc::addHash (hash, edge->mV0);
+                Misc::addHash (hash, edge->mV1);
+            }
+        }
+
+        if (!cacheFile.empty() && readCache (cacheFile, hash))
+            return;
+
+        bake (begin, end);
+
+        if (!cacheFile.empty())
+            writeCache (cacheFile, hash);
+    }
+
+    void NavigationGraph::bake (PathgridIterator begin, PathgridIterator end)
+    {
+        const float cellSize = static_cast<float> (ESM::Land::REAL_SIZE);
+
+        mCells.clear();
+        mPoints.mNodes.clear();
+        mCellGraph.mNodes.clear();
+
+        std::vector<std::vector<Edge> > pointEdges;
+
+        for (PathgridIterator iter (begin); iter!=end; ++iter)
+        {
+            const ESM::Pathgrid& pathgrid = iter->second;
+
+            if (pathgrid.mPoints.empty())
+                continue;
+
+            Cell cell;
+            cell.mX = iter->first.first;
+            cell.mY = iter->first.second;
+            cell.mFirstPoint = static_cast<int> (mPoints.mNodes.size());
+            cell.mPointCount = static_cast<int> (pathgrid.mPoints.size());
+
+            for (ESM::Pathgrid::PointList::const_iterator point (pathgrid.mPoints.begin());
+                point!=pathgrid.mPoints.end(); ++point)
+            {
+                Node node;
+                node.mPosition[0] = point->mX + cell.mX * cellSize;
+                node.mPosition[1] = point->mY + cell.mY * cellSize;
+                node.mPosition[2] = static_cast<float> (point->mZ);
+                node.mCell = static_cast<int> (mCells.size());
+                node.mFirstEdge = 0;
+                node.mEdgeCount = 0;
+                node.mComponent = 0;
+                mPoints.mNodes.push_back (node);
+            }
+
+            pointEdges.resize (mPoints.mNodes.size());
+
+            for (ESM::Pathgrid::EdgeList::const_iterator edge (pathgrid.mEdges.begin());
+                edge!=pathgrid.mEdges.end(); ++edge)
+            {
+                if (edge->mV0<0 || edge->mV0>=cell.mPointCount || edge->mV1<0 || edge->mV1>=cell.mPointCount)
+                    continue;
+
+                int from = cell.mFirstPoint + edge->mV0;
+                int to = cell.mFirstPoint + edge->mV1;
+
+                addEdge (pointEdges, from, to,
+                    getDistance (mPoints.mNodes[from].mPosition, mPoints.mNodes[to].mPosition));
+            }
+
+            mCells.push_back (cell);
+        }
+
+        indexCells();
+
+        // Join each point close to a border to the closest point on the other side, in both
+        // directions, as the ESM pathgrids do
+        for (size_t i=0; i<mCells.size(); ++i)
+            for (int x=-1; x<=1; ++x)
+                for (int y=-1; y<=1; ++y)
+                {
+                    boost::unordered_map<std::pair<int, int>, int>::const_iterator neighbour =
+                        mCellIndex.find (std::make_pair (mCells[i].mX + x, mCells[i].mY + y));
+
+                    if ((x==0 && y==0) || neighbour==mCellIndex.end())
+                        continue;
+
+                    const Cell& other = mCells[neighbour->second];
+
+                    float minX = other.mX * cellSize;
+                    float minY = other.mY * cellSize;
+
+                    for (int point=mCells[i].mFirstPoint; point<mCells[i].mFirstPoint+mCells[i].mPointCount; ++point)
+                    {
+                        const float *position = mPoints.mNodes[point].mPosition;
+
+                        // distance to the neighbouring cell
+                        float outsideX = std::max (0.f, std::max (minX - position[0], position[0] - minX - cellSize));
+                        float outsideY = std::max (0.f, std::max (minY - position[1], position[1] - minY - cellSize));
+
+                        if (outsideX*outsideX + outsideY*outsideY>sMaxLinkDistance*sMaxLinkDistance)
+                            continue;
+
+                        int closest = -1;
+                        float closestDistance = sMaxLinkDistance;
+
+                        for (int otherPoint=other.mFirstPoint; otherPoint<other.mFirstPoint+other.mPointCount;
+                            ++otherPoint)
+                        {
+                            const float *otherPosition = mPoints.mNodes[otherPoint].mPosition;
+                            float distance = getDistance (position, otherPosition);
+
+                            if (distance<=closestDistance && isWalkable (position, otherPosition))
+                            {
+                                closest = otherPoint;
+                                closestDistance = distance;
+                            }
+                        }
+
+                        if (closest!=-1)
+                        {
+                            addEdge (pointEdges, point, closest, closestDistance);
+                            addEdge (pointEdges, closest, point, closestDistance);
+                        }
+                    }
+                }
+
+        mPoints.build (pointEdges);
+
+        // The cells are joined wherever their points are
+        std::vector<std::vector<Edge> > cellEdges (mCells.size());
+
+        for (size_t i=0; i<mCells.size(); ++i)
+        {
+            Node node;
+            node.mPosition[0] = (mCells[i].mX + 0.5f) * cellSize;
+            node.mPosition[1] = (mCells[i].mY + 0.5f) * cellSize;
+            node.mPosition[2] = 0;
+            node.mCell = static_cast<int> (i);
+            node.mFirstEdge = 0;
+            node.mEdgeCount = 0;
+            node.mComponent = 0;
+            mCellGraph.mNodes.push_back (node);
+        }
+
+        for (std::vector<Node>::const_iterator point (mPoints.mNodes.begin()); point!=mPoints.mNodes.end(); ++point)
+            for (int i=point->mFirstEdge; i<point->mFirstEdge+point->mEdgeCount; ++i)
+            {
+                int cell = mPoints.mNodes[mPoints.mEdges[i].mTarget].mCell;
+
+                if (cell!=point->mCell)
+                    addEdge (cellEdges, point->mCell, cell,
+                        getDistance (mCellGraph.mNodes[point->mCell].mPosition, mCellGraph.mNodes[cell].mPosition));
+            }
+
+        mCellGraph.build (cellEdges);
+    }
+
+    bool NavigationGraph::readCache (const boost::filesystem::path& file, uint64_t hash)
+    {
+        try
+        {
+            ESM::ESMReader reader;
+
+            if (!ESM::openCacheFile (reader, file, sCacheFormat, hash))
+                return false;
+
+            if (!reader.hasMoreRecs() || reader.getRecName().val!=sGraphRecord)
+                throw std::runtime_error ("missing graph");
+
+            reader.getRecHeader();
+
+            readArray (reader, "CELL", mCells);
+            readArray (reader, "PNOD", mPoints.mNodes);
+            readArray (reader, "PEDG", mPoints.mEdges);
+            readArray (reader, "CNOD", mCellGraph.mNodes);
+            readArray (reader, "CEDG", mCellGraph.mEdges);
+
+            for (std::vector<Cell>::const_iterator iter (mCells.begin()); iter!=mCells.end(); ++iter)
+                if (iter->mFirstPoint<0 || iter->mPointCount<=0 ||
+                    static_cast<size_t> (iter->mFirstPoint) + iter->mPointCount>mPoints.mNodes.size())
+                    throw std::runtime_error ("invalid cell");
+
+            if (mCellGraph.mNodes.size()!=mCells.size() || !mPoints.isValid (mCells.size()) ||
+                !mCellGraph.isValid (mCells.size()))
+                throw std::runtime_error ("invalid graph");
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Ignoring navigation cache " << file.string() << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        indexCells();
+
+        return true;
+    }
+
+    void NavigationGraph::writeCache (const boost::filesystem::path& file, uint64_t hash) const
+    {
+        try
+        {
+            // ESMWriter seeks back for every record size, which is a lot faster in memory
+            std::stringstream buffer;
+
+            ESM::ESMWriter writer;
+            ESM::startCacheFile (writer, buffer, sCacheFormat, hash);
+
+            writer.startRecord (sGraphRecord);
+            writeArray (writer, "CELL", mCells);
+            writeArray (writer, "PNOD", mPoints.mNodes);
+            writeArray (writer, "PEDG", mPoints.mEdges);
+            writeArray (writer, "CNOD", mCellGraph.mNodes);
+            writeArray (writer, "CEDG", mCellGraph.mEdges);
+            writer.endRecord (sGraphRecord);
+
+            writer.close();
+
+            ESM::saveCacheFile (file, buffer.str());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write navigation cache " << file.string() << ": " << e.what() << std::endl;
+        }
+    }
+
+    void NavigationGraph::indexCells()
+    {
+        mCellIndex.clear();
+
+        for (size_t i=0; i<mCells.size(); ++i)
+            mCellIndex[std::make_pair (mCells[i].mX, mCells[i].mY)] = static_cast<int> (i);
+    }
+
+    int NavigationGraph::getCell (const ESM::Pathgrid::Point& point) const
+    {
+        const float cellSize = static_cast<float> (ESM::Land::REAL_SIZE);
+
+        boost::unordered_map<std::pair<int, int>, int>::const_iterator iter = mCellIndex.find (std::make_pair (
+            static_cast<int> (std::floor (point.mX / cellSize)), static_cast<int> (std::floor (point.mY / cellSize))));
+
+        return iter!=mCellIndex.end() ? iter->second : -1;
+    }
+
+    int NavigationGraph::getClosestPoint (int cell, const ESM::Pathgrid::Point& point) const
+    {
+        float position[3] =
+        {
+            static_cast<float> (point.mX), static_cast<float> (point.mY), static_cast<float> (point.mZ)
+        };
+
+        int closest = mCells[cell].mFirstPoint;
+        float closestDistance = getDistance (position, mPoints.mNodes[closest].mPosition);
+
+        for (int i=closest+1; i<mCells[cell].mFirstPoint+mCells[cell].mPointCount; ++i)
+        {
+            float distance = getDistance (position, mPoints.mNodes[i].mPosition);
+
+            if (distance<closestDistance)
+            {
+                closest = i;
+                closestDistance = distance;
+            }
+        }
+
+        return closest;
+    }
+
+    bool NavigationGraph::search (const Level& level, int start, int goal, const std::vector<char> *cells,
+        std::vector<int>& nodes) const
+    {
+        typedef std::pair<float, int> Open;
+
+        level.startSearch();
+
+        const float *goalPosition = level.mNodes[goal].mPosition;
+
+        level.mReached[start] = level.mSearch;
+        level.mCost[start] = 0;
+        level.mParent[start] = -1;
+        level.mOpen.push_back (Open (getDistance (level.mNodes[start].mPosition, goalPosition), start));
+
+        while (!level.mOpen.empty())
+        {
+            // lowest estimated cost at the front
+            std::pop_heap (level.mOpen.begin(), level.mOpen.end(), std::greater<Open>());
+            int current = level.mOpen.back().second;
+            level.mOpen.pop_back();
+
+            if (level.mClosed[current]==level.mSearch)
+                continue; // reached again at a lower cost before
+
+            level.mClosed[current] = level.mSearch;
+
+            if (current==goal)
+            {
+                size_t first = nodes.size();
+
+                for (int node=goal; node!=-1; node=level.mParent[node])
+                    nodes.push_back (node);
+
+                std::reverse (nodes.begin()+first, nodes.end());
+
+                return true;
+            }
+
+            const Node& node = level.mNodes[current];
+
+            for (int i=node.mFirstEdge; i<node.mFirstEdge+node.mEdgeCount; ++i)
+            {
+                int target = level.mEdges[i].mTarget;
+
+                if (level.mClosed[target]==level.mSearch ||
+                    (cells && !(*cells)[level.mNodes[target].mCell]))
+                    continue;
+
+                float cost = level.mCost[current] + level.mEdges[i].mCost;
+
+                if (level.mReached[target]!=level.mSearch || cost<level.mCost[target])
+                {
+                    level.mReached[target] = level.mSearch;
+                    level.mCost[target] = cost;
+                    level.mParent[target] = current;
+                    level.mOpen.push_back (
+                        Open (cost + getDistance (level.mNodes[target].mPosition, goalPosition), target));
+                    std::push_heap (level.mOpen.begin(), level.mOpen.end(), std::greater<Open>());
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool NavigationGraph::findPath (const ESM::Pathgrid::Point& start, const ESM::Pathgrid::Point& end,
+        std::vector<ESM::Pathgrid::Point>& path) const
+    {
+        int startCell = getCell (start);
+        int endCell = getCell (end);
+
+        if (startCell==-1 || endCell==-1)
+            return false;
+
+        int from = getClosestPoint (startCell, start);
+        int to = getClosestPoint (endCell, end);
+
+        if (mPoints.mNodes[from].mComponent!=mPoints.mNodes[to].mComponent)
+            return false;
+
+        std::vector<int> cells;
+        if (!search (mCellGraph, startCell, endCell, NULL, cells))
+            return false;
+
+        // Allow the path to cut corners through the neighbours of the cells on the way
+        std::vector<char> corridor (mCells.size(), 0);
+        for (std::vector<int>::const_iterator iter (cells.begin()); iter!=cells.end(); ++iter)
+        {
+            corridor[*iter] = 1;
+
+            const Node& cell = mCellGraph.mNodes[*iter];
+            for (int i=cell.mFirstEdge; i<cell.mFirstEdge+cell.mEdgeCount; ++i)
+                corridor[mCellGraph.mEdges[i].mTarget] = 1;
+        }
+
+        std::vector<int> points;
+        if (!search (mPoints, from, to, &corridor, points))
+        {
+            // The cells can be joined by points that are not joined to each other within the
+            // corridor. This search is bounded by the component of the points.
+            if (!search (mPoints, from, to, NULL, points))
+                return false;
+        }
+
+        for (std::vector<int>::const_iterator iter (points.begin()); iter!=points.end(); ++iter)
+        {
+            const float *position = mPoints.mNodes[*iter].mPosition;
+            path.push_back (ESM::Pathgrid::Point (static_cast<int> (position[0]), static_cast<int> (position[1]),
+                static_cast<int> (position[2])));
+        }
+
+        return true;
+    }
+}
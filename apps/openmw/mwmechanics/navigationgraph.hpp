@@ -0,0 +1,131 @@
+#ifndef GAME_MWMECHANICS_NAVIGATIONGRAPH_H
+#define GAME_MWMECHANICS_NAVIGATIONGRAPH_H
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <components/esm/loadpgrd.hpp>
+
+namespace MWWorld
+{
+    template<typename T>
+    class Store;
+}
+
+namespace MWMechanics
+{
+    /// \brief Graph for paths across exterior cells
+    ///
+    /// The pathgrids of all exterior cells are joined into one graph, with added edges between
+    /// close points on either side of a cell border. Above it is a graph of the cells, with an
+    /// edge wherever the points of two cells are joined. A search first finds the cells on the
+    /// way on the cell graph, and then searches only the points of those cells and of their
+    /// neighbours. Points that are not connected at all are told apart before any search.
+    class NavigationGraph
+    {
+        public:
+
+            NavigationGraph();
+
+            void build (const MWWorld::Store<ESM::Pathgrid>& pathgrids,
+                const boost::filesystem::path& cacheFile = boost::filesystem::path());
+            ///< Build the graph from the exterior pathgrids in \a pathgrids.
+            ///
+            /// \param cacheFile If not empty, the graph is read from this file, if it has been
+            /// built from the same pathgrids, and written to it otherwise.
+
+            typedef std::map<std::pair<int, int>, ESM::Pathgrid>::const_iterator PathgridIterator;
+
+            void build (PathgridIterator begin, PathgridIterator end,
+                const boost::filesystem::path& cacheFile = boost::filesystem::path());
+            ///< Build the graph from exterior pathgrids by cell position, as they are kept in
+            /// MWWorld::Store<ESM::Pathgrid>.
+
+            bool findPath (const ESM::Pathgrid::Point& start, const ESM::Pathgrid::Point& end,
+                std::vector<ESM::Pathgrid::Point>& path) const;
+            ///< Append the shortest path from the pathgrid point closest to \a start to the
+            /// pathgrid point closest to \a end to \a path. All points are in world co-ordinates.
+            ///
+            /// \return Has a path been found? Fails if \a start or \a end is in a cell without a
+            /// pathgrid.
+
+        private:
+
+            struct Cell
+            {
+                int mX, mY;
+                int mFirstPoint;
+                int mPointCount;
+            };
+
+            struct Node
+            {
+                float mPosition[3];
+                int mCell;
+                int mFirstEdge;
+                int mEdgeCount;
+                int mComponent; // nodes in different components are not connected in any direction
+            };
+
+            struct Edge
+            {
+                int mTarget;
+                float mCost;
+            };
+
+            struct Level
+            {
+                std::vector<Node> mNodes;
+                std::vector<Edge> mEdges;
+
+                // State of the last search, indexed by node. A node has been reached or
+                // closed in the last search, if its entry in mReached or mClosed is mSearch.
+                mutable std::vector<unsigned int> mReached;
+                mutable std::vector<unsigned int> mClosed;
+                mutable std::vector<float> mCost;
+                mutable std::vector<int> mParent;
+                mutable unsigned int mSearch;
+                mutable std::vector<std::pair<float, int> > mOpen; // heap of (estimated cost, node)
+
+                Level() : mSearch (0) {}
+
+                void build (const std::vector<std::vector<Edge> >& edges);
+                ///< Set the edges and the component of each node.
+
+                bool isValid (size_t cells) const;
+
+                void startSearch() const;
+            };
+
+            std::vector<Cell> mCells;
+            boost::unordered_map<std::pair<int, int>, int> mCellIndex;
+            Level mPoints;
+            Level mCellGraph;
+
+            void bake (PathgridIterator begin, PathgridIterator end);
+
+            bool readCache (const boost::filesystem::path& file, uint64_t hash);
+
+            void writeCache (const boost::filesystem::path& file, uint64_t hash) const;
+
+            void indexCells();
+
+            int getCell (const ESM::Pathgrid::Point& point) const;
+            ///< \return Index of the cell containing \a point, or -1 if it has no pathgrid
+
+            int getClosestPoint (int cell, const ESM::Pathgrid::Point& point) const;
+
+            bool search (const Level& level, int start, int goal, const std::vector<char> *cells,
+                std::vector<int>& nodes) const;
+            ///< A* search from \a start to \a goal on \a level, through nodes in the cells that
+            /// are set in \a cells only, unless it is NULL.
+    };
+}
+
+#endif
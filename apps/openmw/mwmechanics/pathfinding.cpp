@@ -1,5 +1,7 @@
 #include "pathfinding.hpp"
 
+#include <cmath>
+
 #include "OgreMath.h"
 #include "OgreVector3.h"
 
@@ -9,6 +11,8 @@
 #include "../mwworld/esmstore.hpp"
 #include "../mwworld/cellstore.hpp"
 
+#include "navigationgraph.hpp"
+
 namespace
 {
     // Slightly cheaper version for comparisons.
@@ -137,7 +141,9 @@ namespace MWMechanics
      *
      * NOTE: startPoint & endPoint are in world co-ordinates
      *
-     * Updates mPath using aStarSearch() or ray test (if shortcut allowed).
+     * Updates mPath using getShortestPath() or ray test (if shortcut allowed).
+     * If endPoint is in another exterior cell, the path is looked up in the
+     * navigation graph of all exterior cells instead.
      * mPath consists of pathgrid points, except the last element which is
      * endPoint.  This may be useful where the endPoint is not on a pathgrid
      * point (e.g. combat).  However, if the caller has already chosen a
@@ -185,6 +191,24 @@ namespace MWMechanics
             }
         }
 
+        // The pathgrid of this cell doesn't lead into other cells
+        if(cell->isExterior())
+        {
+            int endX = static_cast<int>(std::floor(endPoint.mX / static_cast<float>(ESM::Land::REAL_SIZE)));
+            int endY = static_cast<int>(std::floor(endPoint.mY / static_cast<float>(ESM::Land::REAL_SIZE)));
+
+            std::vector<ESM::Pathgrid::Point> path;
+
+            if((endX != cell->getCell()->mData.mX || endY != cell->getCell()->mData.mY)
+                && MWBase::Environment::get().getWorld()->getNavigationGraph().findPath(startPoint, endPoint, path))
+            {
+                mPath.assign(path.begin(), path.end());
+                mPath.push_back(endPoint);
+                mIsPathConstructed = true;
+                return;
+            }
+        }
+
         if(mCell != cell || !mPathgrid)
         {
             mCell = cell;
@@ -230,8 +254,6 @@ namespace MWMechanics
                 // AiWander has logic that depends on whether a path was created,
                 // deleting allowed nodes if not.  Hence a path needs to be created
                 // even if the start and the end points are the same.
-                // NOTE: aStarSearch will return an empty path if the start and end
-                //       nodes are the same
                 if(startNode == endNode.first)
                 {
                     mPath.push_back(endPoint);
@@ -239,7 +261,9 @@ namespace MWMechanics
                     return;
                 }
 
-                mPath = mCell->aStarSearch(startNode, endNode.first);
+                std::vector<ESM::Pathgrid::Point> path;
+                mCell->getShortestPath(startNode, endNode.first, path);
+                mPath.assign(path.begin(), path.end());
 
                 if(!mPath.empty())
                 {
@@ -302,13 +326,13 @@ namespace MWMechanics
     }
 
     // used by AiCombat, see header for the rationale
-    bool PathFinder::syncStart(const std::list<ESM::Pathgrid::Point> &path)
+    bool PathFinder::syncStart(const std::deque<ESM::Pathgrid::Point> &path)
     {
         if (mPath.size() < 2)
             return false; //nothing to pop
 
-        std::list<ESM::Pathgrid::Point>::const_iterator oldStart = path.begin();
-        std::list<ESM::Pathgrid::Point>::iterator iter = ++mPath.begin();
+        std::deque<ESM::Pathgrid::Point>::const_iterator oldStart = path.begin();
+        std::deque<ESM::Pathgrid::Point>::iterator iter = mPath.begin() + 1;
 
         if(    (*iter).mX == oldStart->mX
             && (*iter).mY == oldStart->mY
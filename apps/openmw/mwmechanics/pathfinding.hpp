@@ -3,7 +3,8 @@
 
 #include <components/esm/defs.hpp>
 #include <components/esm/loadpgrd.hpp>
-#include <list>
+#include <deque>
+#include <vector>
 
 #include <OgreMath.h>
 #include <OgreVector3.h>
@@ -56,7 +57,7 @@ namespace MWMechanics
                 return mPath.size();
             }
 
-            const std::list<ESM::Pathgrid::Point>& getPath() const
+            const std::deque<ESM::Pathgrid::Point>& getPath() const
             {
                 return mPath;
             }
@@ -69,7 +70,7 @@ namespace MWMechanics
             @param path - old path
             @return true if such point was found and deleted
              */
-            bool syncStart(const std::list<ESM::Pathgrid::Point> &path);
+            bool syncStart(const std::deque<ESM::Pathgrid::Point> &path);
 
             void addPointToPath(ESM::Pathgrid::Point &point)
             {
@@ -98,7 +99,8 @@ namespace MWMechanics
 
             bool mIsPathConstructed;
 
-            std::list<ESM::Pathgrid::Point> mPath;
+            // waypoints are popped from the front as they are reached
+            std::deque<ESM::Pathgrid::Point> mPath;
 
             const ESM::Pathgrid *mPathgrid;
             const MWWorld::CellStore* mCell;
@@ -1,5 +1,8 @@
 #include "pathgrid.hpp"
 
+#include <queue>
+#include <functional>
+
 #include "../mwbase/world.hpp"
 #include "../mwbase/environment.hpp"
 
@@ -45,6 +48,10 @@ namespace
         //return distance(a, b);
         return manhattan(a, b);
     }
+
+    // Enough for the goals of the actors in a cell, a table for every point
+    // of a large cell takes more memory than the pathgrid itself
+    const size_t sMaxNextHopTables = 32;
 }
 
 namespace MWMechanics
@@ -120,6 +127,9 @@ namespace MWMechanics
             // forward path of the edge
             neighbour.index = mPathgrid->mEdges[i].mV1;
             mGraph[mPathgrid->mEdges[i].mV0].edges.push_back(neighbour);
+            // and the same edge seen from its end, for searching backwards
+            neighbour.index = mPathgrid->mEdges[i].mV0;
+            mGraph[mPathgrid->mEdges[i].mV1].incoming.push_back(neighbour);
             // reverse path of the edge
             // NOTE: These are redundant, ESM already contains the required reverse paths
             //neighbour.index = mPathgrid->mEdges[i].mV0;
@@ -215,104 +225,95 @@ namespace MWMechanics
     }
 
     /*
-     * NOTE: Based on buildPath2(), please check git history if interested
-     *       Should consider using a 3rd party library version (e.g. boost)
-     *
-     * Find the shortest path to the target goal using a well known algorithm.
-     * Uses mGraph which has pre-computed costs for allowed edges.  It is assumed
-     * that mGraph is already constructed.
-     *
-     * Should be possible to make this MT safe.
-     *
-     * Returns path which may be empty.  path contains pathgrid points in local
-     * cell co-ordinates (indoors) or world co-ordinates (external).
+     * Builds the next hop table for paths to the goal, with Dijkstra's
+     * algorithm searching backwards from the goal along incoming edges.  Uses
+     * the same pre-computed edge costs as the old aStarSearch(), so the paths
+     * are as short, but a table is built once per goal and then shared by all
+     * start points, which makes repeated searches for a goal (AiWander points,
+     * AiCombat targets standing still) a walk through the table.
      *
      * Input params:
-     *   start, goal - pathgrid point indexes (for this cell)
+     *   goal - pathgrid point index (for this cell)
      *
      * Variables:
-     *   openset - point indexes to be traversed, lowest cost at the front
-     *   closedset - point indexes already traversed
-     *   gScore - past accumulated costs vector indexed by point index
-     *   fScore - future estimated costs vector indexed by point index
-     *
-     * TODO: An intersting exercise might be to cache the paths created for a
-     *       start/goal pair.  To cache the results the paths need to be in
-     *       pathgrid points form (currently they are converted to world
-     *       co-ordinates).  Essentially trading speed w/ memory.
+     *   openset - (cost to goal, point index) pairs, lowest cost at the top
+     *   gScore - accumulated costs to goal indexed by point index
      */
-    std::list<ESM::Pathgrid::Point> PathgridGraph::aStarSearch(const int start,
-                                                               const int goal) const
+    const std::vector<int>& PathgridGraph::getNextHops(int goal) const
     {
-        std::list<ESM::Pathgrid::Point> path;
-        if(!isPointConnected(start, goal))
+        for(std::list<NextHops>::iterator it = mNextHops.begin(); it != mNextHops.end(); ++it)
         {
-            return path; // there is no path, return an empty path
+            if(it->first == goal)
+            {
+                mNextHops.splice(mNextHops.begin(), mNextHops, it);
+                return it->second;
+            }
         }
 
+        if(mNextHops.size() >= sMaxNextHopTables)
+            mNextHops.pop_back();
+
+        mNextHops.push_front(NextHops(goal, std::vector<int>()));
+        std::vector<int>& nextHops = mNextHops.front().second;
+
         int graphSize = static_cast<int> (mGraph.size());
         std::vector<float> gScore (graphSize, -1);
-        std::vector<float> fScore (graphSize, -1);
-        std::vector<int> graphParent (graphSize, -1);
+        nextHops.resize(graphSize, -1);
 
-        // gScore & fScore keep costs for each pathgrid point in mPoints
-        gScore[start] = 0;
-        fScore[start] = costAStar(mPathgrid->mPoints[start], mPathgrid->mPoints[goal]);
+        typedef std::pair<float, int> Open;
+        std::priority_queue<Open, std::vector<Open>, std::greater<Open> > openset;
 
-        std::list<int> openset;
-        std::list<int> closedset;
-        openset.push_back(start);
-
-        int current = -1;
+        gScore[goal] = 0;
+        nextHops[goal] = goal;
+        openset.push(Open(0, goal));
 
         while(!openset.empty())
         {
-            current = openset.front(); // front has the lowest cost
-            openset.pop_front();
-
-            if(current == goal)
-                break;
+            Open current = openset.top();
+            openset.pop();
 
-            closedset.push_back(current); // remember we've been here
+            if(current.first > gScore[current.second])
+                continue; // already reached at a lower cost
 
-            // check all edges for the current point index
-            for(int j = 0; j < static_cast<int> (mGraph[current].edges.size()); j++)
+            const std::vector<ConnectedPoint>& incoming = mGraph[current.second].incoming;
+            for(int j = 0; j < static_cast<int> (incoming.size()); j++)
             {
-                if(std::find(closedset.begin(), closedset.end(), mGraph[current].edges[j].index) ==
-                   closedset.end())
+                int from = incoming[j].index;
+                float tentative_g = current.first + incoming[j].cost;
+                if(gScore[from] < 0 || tentative_g < gScore[from])
                 {
-                    // not in closedset - i.e. have not traversed this edge destination
-                    int dest = mGraph[current].edges[j].index;
-                    float tentative_g = gScore[current] + mGraph[current].edges[j].cost;
-                    bool isInOpenSet = std::find(openset.begin(), openset.end(), dest) != openset.end();
-                    if(!isInOpenSet
-                        || tentative_g < gScore[dest])
-                    {
-                        graphParent[dest] = current;
-                        gScore[dest] = tentative_g;
-                        fScore[dest] = tentative_g + costAStar(mPathgrid->mPoints[dest],
-                                                               mPathgrid->mPoints[goal]);
-                        if(!isInOpenSet)
-                        {
-                            // add this edge to openset, lowest cost goes to the front
-                            // TODO: if this causes performance problems a hash table may help
-                            std::list<int>::iterator it = openset.begin();
-                            for(it = openset.begin(); it!= openset.end(); ++it)
-                            {
-                                if(fScore[*it] > fScore[dest])
-                                    break;
-                            }
-                            openset.insert(it, dest);
-                        }
-                    }
-                } // if in closedset, i.e. traversed this edge already, try the next edge
+                    gScore[from] = tentative_g;
+                    nextHops[from] = current.second;
+                    openset.push(Open(tentative_g, from));
+                }
             }
         }
 
-        if(current != goal)
-            return path; // for some reason couldn't build a path
+        return nextHops;
+    }
+
+    /*
+     * Find the shortest path to the target goal by following the next hop
+     * table for the goal, see getNextHops().  It is assumed that mGraph is
+     * already constructed.
+     *
+     * Appends the path to path, which is left unchanged if there is no path.
+     * The path contains pathgrid points in local cell co-ordinates (indoors)
+     * or world co-ordinates (external).
+     *
+     * Input params:
+     *   start, goal - pathgrid point indexes (for this cell)
+     */
+    void PathgridGraph::getShortestPath(const int start, const int goal,
+                                        std::vector<ESM::Pathgrid::Point>& path) const
+    {
+        if(!isPointConnected(start, goal))
+            return; // there is no path
+
+        const std::vector<int>& nextHops = getNextHops(goal);
+        if(nextHops[start] == -1)
+            return; // for some reason couldn't build a path
 
-        // reconstruct path to return, using world co-ordinates
         float xCell = 0;
         float yCell = 0;
         if (mIsExterior)
@@ -321,21 +322,15 @@ namespace MWMechanics
             yCell = static_cast<float>(mPathgrid->mData.mY * ESM::Land::REAL_SIZE);
         }
 
-        while(graphParent[current] != -1)
+        for(int current = start; ; current = nextHops[current])
         {
             ESM::Pathgrid::Point pt = mPathgrid->mPoints[current];
             pt.mX += static_cast<int>(xCell);
             pt.mY += static_cast<int>(yCell);
-            path.push_front(pt);
-            current = graphParent[current];
-        }
+            path.push_back(pt);
 
-        // add first node to path explicitly
-        ESM::Pathgrid::Point pt = mPathgrid->mPoints[start];
-        pt.mX += static_cast<int>(xCell);
-        pt.mY += static_cast<int>(yCell);
-        path.push_front(pt);
-        return path;
+            if(current == goal)
+                break;
+        }
     }
 }
-
@@ -3,6 +3,7 @@
 
 #include <components/esm/loadpgrd.hpp>
 #include <list>
+#include <vector>
 
 namespace ESM
 {
@@ -28,12 +29,13 @@ namespace MWMechanics
             bool isPointConnected(const int start, const int end) const;
 
             // the input parameters are pathgrid point indexes
-            // the output list is in local (internal cells) or world (external
-            // cells) co-ordinates
+            // the output path is appended to path, in local (internal cells)
+            // or world (external cells) co-ordinates
             //
-            // NOTE: if start equals end an empty path is returned
-            std::list<ESM::Pathgrid::Point> aStarSearch(const int start,
-                                                        const int end) const;
+            // NOTE: the path includes both start and end; it is left empty
+            //       if there is no path
+            void getShortestPath(const int start, const int end,
+                                 std::vector<ESM::Pathgrid::Point>& path) const;
         private:
 
             const ESM::Cell *mCell;
@@ -50,6 +52,7 @@ namespace MWMechanics
             {
                 int componentId;
                 std::vector<ConnectedPoint> edges; // neighbours
+                std::vector<ConnectedPoint> incoming; // neighbours with an edge to here
             };
 
             // componentId is an integer indicating the groups of connected
@@ -64,6 +67,15 @@ namespace MWMechanics
             std::vector<Node> mGraph;
             bool mIsGraphConstructed;
 
+            // Next hop tables of recently requested goals, most recent first.
+            // In the table for end, [v] is the pathgrid point index after v
+            // on the shortest path from v to end, or -1 if there is none.
+            // Each table takes a point count of memory, so only a few are
+            // kept, instead of one for every point of the cell.
+            typedef std::pair<int, std::vector<int> > NextHops;
+            mutable std::list<NextHops> mNextHops;
+            const std::vector<int>& getNextHops(int end) const;
+
             // variables used to calculate connected components
             int mSCCId;
             int mSCCIndex;
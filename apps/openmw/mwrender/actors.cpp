@@ -2,6 +2,10 @@
 
 #include <OgreSceneNode.h>
 #include <OgreSceneManager.h>
+#include <OgreCamera.h>
+#include <OgreStringConverter.h>
+
+#include <components/settings/settings.hpp>
 
 #include "../mwworld/ptr.hpp"
 #include "../mwworld/class.hpp"
@@ -20,6 +24,22 @@ namespace MWRender
 {
 using namespace Ogre;
 
+Actors::Actors(OEngine::Render::OgreRenderer& _rend, MWRender::RenderingManager* rendering)
+    : mRend(_rend)
+    , mRendering(rendering)
+    , mRootNode(NULL)
+{
+    for(int i = 0;i < sLodTiers;i++)
+    {
+        float distance = Settings::Manager::getFloat("lod distance "+Ogre::StringConverter::toString(i+1), "Animation");
+        mLodDistances[i] = distance > 0 ? distance*distance : 0;
+    }
+
+    // Actors out of view may still cast shadows into it
+    mLodOffscreen = Settings::Manager::getBool("lod offscreen", "Animation") &&
+        !(Settings::Manager::getBool("enabled", "Shadows") && Settings::Manager::getBool("actor shadows", "Shadows"));
+}
+
 Actors::~Actors()
 {
     PtrAnimationMap::iterator it = mAllActors.begin();
@@ -160,9 +180,29 @@ void Actors::update (Ogre::Camera* camera)
     for(PtrAnimationMap::iterator iter = mAllActors.begin();iter != mAllActors.end(); ++iter)
     {
         iter->second->preRender(camera);
+        updateLod(iter->first, iter->second, camera);
     }
 }
 
+void Actors::updateLod(const MWWorld::Ptr &ptr, Animation *anim, Ogre::Camera *camera)
+{
+    float sqrDistance = camera->getRealPosition().squaredDistance(Ogre::Vector3(ptr.getRefData().getPosition().pos));
+
+    // Each tier halves the rate of the one before
+    int tier = 0;
+    while(tier < sLodTiers && mLodDistances[tier] > 0 && sqrDistance > mLodDistances[tier])
+        ++tier;
+
+    int interval = 1 << tier;
+
+    Ogre::SceneNode *node = ptr.getRefData().getBaseNode();
+    if(mLodOffscreen && interval < sOffscreenInterval && node && !camera->isVisible(node->_getWorldAABB()))
+        interval = sOffscreenInterval;
+
+    // Footsteps are too far away to be heard from the second tier on, whether in view or not
+    anim->setLod(interval, tier < 2);
+}
+
 Animation* Actors::getAnimation(const MWWorld::Ptr &ptr)
 {
     PtrAnimationMap::const_iterator iter = mAllActors.find(ptr);
@@ -27,14 +27,22 @@ namespace MWRender
         CellSceneNodeMap mCellSceneNodes;
         PtrAnimationMap mAllActors;
 
+        static const int sLodTiers = 3;
+
+        // Offscreen actors still pose their bones now and then, e.g. for the head position
+        // of their attacks
+        static const int sOffscreenInterval = 16;
+
+        float mLodDistances[sLodTiers]; // squared, 0: tier is not used
+        bool mLodOffscreen;
+
         void insertBegin(const MWWorld::Ptr &ptr);
 
+        /// Pick the animation level of detail of \a ptr, see [Animation] in the settings.
+        void updateLod(const MWWorld::Ptr &ptr, Animation *anim, Ogre::Camera *camera);
+
     public:
-        Actors(OEngine::Render::OgreRenderer& _rend, MWRender::RenderingManager* rendering)
-            : mRend(_rend)
-            , mRendering(rendering)
-            , mRootNode(NULL)
-        {}
+        Actors(OEngine::Render::OgreRenderer& _rend, MWRender::RenderingManager* rendering);
         ~Actors();
 
         void setRootNode(Ogre::SceneNode* root);
@@ -9,7 +9,6 @@
 #include <OgreSubMesh.h>
 #include <OgreSceneManager.h>
 #include <OgreControllerManager.h>
-#include <OgreStaticGeometry.h>
 #include <OgreSceneNode.h>
 #include <OgreTechnique.h>
 
@@ -37,8 +36,15 @@
 #include "../mwworld/esmstore.hpp"
 
 #include "renderconst.hpp"
+#include "cellbatch.hpp"
 
 
+namespace
+{
+    // Spreads the frames on which animations with the same level of detail pose their bones
+    unsigned int sBoneUpdatePhase = 0;
+}
+
 namespace MWRender
 {
 
@@ -73,6 +79,11 @@ Animation::Animation(const MWWorld::Ptr &ptr, Ogre::SceneNode *node)
     , mNonAccumCtrl(NULL)
     , mAccumulate(0.0f)
     , mNullAnimationTimePtr(OGRE_NEW NullAnimationTime)
+    , mBoneUpdateInterval(1)
+    , mBoneUpdateFrame(sBoneUpdatePhase++)
+    , mBoneUpdatePending(false)
+    , mBonesUpdated(true)
+    , mFootsteps(true)
 {
     for(size_t i = 0;i < sNumGroups;i++)
         mAnimationTimePtr[i].bind(OGRE_NEW AnimationTime(this));
@@ -297,6 +308,7 @@ void Animation::addAnimSource(const std::string &model)
 
         ctrls[i].setSource(mAnimationTimePtr[grp]);
         grpctrls[grp].push_back(ctrls[i]);
+        animsrc->mPoses[grp].add(ctrls[i]);
     }
 
     for (unsigned int i = 0; i < mObjectRoot->mControllers.size(); ++i)
@@ -609,8 +621,10 @@ void Animation::updatePosition(float oldtime, float newtime, Ogre::Vector3 &posi
     Ogre::Vector3 off = mNonAccumCtrl->getTranslation(newtime)*mAccumulate;
     position += off - mNonAccumCtrl->getTranslation(oldtime)*mAccumulate;
 
-    /* Translate the accumulation root back to compensate for the move. */
-    mAccumRoot->setPosition(-off);
+    /* Translate the accumulation root back to compensate for the move. Only when the bones are
+     * posed, so that it matches the pose of the non-accumulation root. */
+    if(mBonesUpdated)
+        mAccumRoot->setPosition(-off);
 }
 
 bool Animation::reset(AnimState &state, const NifOgre::TextKeyMap &keys, const std::string &groupname, const std::string &start, const std::string &stop, float startpoint, bool loopfallback)
@@ -728,6 +742,9 @@ void Animation::handleTextKey(AnimState &state, const std::string &groupname, co
                 pitch = Ogre::StringConverter::parseReal(tokens[2]);
         }
 
+        if(!mFootsteps && (soundgen == "left" || soundgen == "right"))
+            return;
+
         std::string sound = mPtr.getClass().getSoundIdFromSndGen(mPtr, soundgen);
         if(!sound.empty())
         {
@@ -1084,6 +1101,12 @@ void Animation::disable(const std::string &groupname)
 Ogre::Vector3 Animation::runAnimation(float duration)
 {
     Ogre::Vector3 movement(0.0f);
+
+    ++mBoneUpdateFrame;
+    mBonesUpdated = mBoneUpdatePending ||
+        (mBoneUpdateInterval > 0 && mBoneUpdateFrame % mBoneUpdateInterval == 0);
+    mBoneUpdatePending = false;
+
     AnimStateMap::iterator stateiter = mStates.begin();
     while(stateiter != mStates.end())
     {
@@ -1160,23 +1183,24 @@ Ogre::Vector3 Animation::runAnimation(float duration)
             mObjectRoot->mControllers[i].update();
     }
 
-    // Apply group controllers
-    for(size_t grp = 0;grp < sNumGroups;grp++)
+    if(mBonesUpdated)
     {
-        const std::string &name = mAnimationTimePtr[grp]->getAnimName();
-        if(!name.empty() && (stateiter=mStates.find(name)) != mStates.end())
+        // Apply group controllers
+        for(size_t grp = 0;grp < sNumGroups;grp++)
         {
-            const Ogre::SharedPtr<AnimSource> &src = stateiter->second.mSource;
-            for(size_t i = 0;i < src->mControllers[grp].size();i++)
-                src->mControllers[grp][i].update();
+            const std::string &name = mAnimationTimePtr[grp]->getAnimName();
+            if(!name.empty() && (stateiter=mStates.find(name)) != mStates.end())
+            {
+                stateiter->second.mSource->mPoses[grp].update(stateiter->second.mTime);
+            }
         }
-    }
 
-    if(mSkelBase)
-    {
-        // HACK: Dirty the animation state set so that Ogre will apply the
-        // transformations to entities this skeleton instance is shared with.
-        mSkelBase->getAllAnimationStates()->_notifyDirty();
+        if(mSkelBase)
+        {
+            // HACK: Dirty the animation state set so that Ogre will apply the
+            // transformations to entities this skeleton instance is shared with.
+            mSkelBase->getAllAnimationStates()->_notifyDirty();
+        }
     }
 
     updateEffects(duration);
@@ -1433,6 +1457,16 @@ void Animation::preRender(Ogre::Camera *camera)
     mObjectRoot->rotateBillboardNodes(camera);
 }
 
+void Animation::setLod(int boneUpdateInterval, bool footsteps)
+{
+    // Pose the bones right away when the interval gets shorter, e.g. when coming into view
+    if(boneUpdateInterval > 0 && (mBoneUpdateInterval <= 0 || boneUpdateInterval < mBoneUpdateInterval))
+        mBoneUpdatePending = true;
+
+    mBoneUpdateInterval = boneUpdateInterval;
+    mFootsteps = footsteps;
+}
+
 // TODO: Should not be here
 Ogre::Vector3 Animation::getEnchantmentColor(MWWorld::Ptr item)
 {
@@ -1537,7 +1571,7 @@ bool ObjectAnimation::canBatch() const
                         FindEntityTransparency()) == mObjectRoot->mEntities.end();
 }
 
-void ObjectAnimation::fillBatch(Ogre::StaticGeometry *sg)
+void ObjectAnimation::fillBatch(CellBatch *sg)
 {
     std::vector<Ogre::Entity*>::reverse_iterator iter = mObjectRoot->mEntities.rbegin();
     for(;iter != mObjectRoot->mEntities.rend();++iter)
@@ -5,6 +5,7 @@
 #include <OgreVector3.h>
 
 #include <components/nifogre/ogrenifloader.hpp>
+#include <components/nifogre/keyframes.hpp>
 
 #include "../mwworld/ptr.hpp"
 
@@ -16,6 +17,7 @@ namespace ESM
 namespace MWRender
 {
 class Camera;
+class CellBatch;
 
 class Animation
 {
@@ -84,6 +86,8 @@ protected:
     struct AnimSource : public Ogre::AnimationAlloc {
         NifOgre::TextKeyMap mTextKeys;
         std::vector<Ogre::Controller<Ogre::Real> > mControllers[sNumGroups];
+        /// Evaluates mControllers, see runAnimation
+        NifOgre::KeyframePose mPoses[sNumGroups];
     };
     typedef std::vector< Ogre::SharedPtr<AnimSource> > AnimSourceList;
 
@@ -144,6 +148,12 @@ protected:
 
     ObjectAttachMap mAttachedObjects;
 
+    int mBoneUpdateInterval;
+    unsigned int mBoneUpdateFrame; // starts at a different phase for each animation
+    bool mBoneUpdatePending;
+    bool mBonesUpdated;
+    bool mFootsteps;
+
 
     /* Sets the appropriate animations on the bone groups based on priority.
      */
@@ -230,6 +240,14 @@ public:
     /// Prepare this animation for being rendered with \a camera (rotates billboard nodes)
     virtual void preRender (Ogre::Camera* camera);
 
+    /// Set the level of detail for an actor far from the camera or out of view. The animation
+    /// time, text keys and movement still advance every frame, only the bones are posed less
+    /// often, at the time the animation has reached by then.
+    /// @param boneUpdateInterval Pose the bones every this many frames, 0 to not pose them at all.
+    /// Animations with the same interval pose their bones on different frames.
+    /// @param footsteps Play the sounds of "left" and "right" text keys?
+    void setLod(int boneUpdateInterval, bool footsteps);
+
     virtual void setAlpha(float alpha) {}
     virtual void setVampire(bool vampire) {}
 
@@ -351,7 +369,7 @@ public:
     ObjectAnimation(const MWWorld::Ptr& ptr, const std::string &model);
 
     bool canBatch() const;
-    void fillBatch(Ogre::StaticGeometry *sg);
+    void fillBatch(CellBatch *sg);
 };
 
 }
@@ -0,0 +1,687 @@
+#include "cellbatch.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include <OgreEntity.h>
+#include <OgreSubEntity.h>
+#include <OgreSubMesh.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreRenderable.h>
+#include <OgreMovableObject.h>
+#include <OgreRenderQueue.h>
+#include <OgreMaterialManager.h>
+#include <OgreHardwareBufferManager.h>
+
+#include <components/esm/cachefile.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/esm/defs.hpp>
+#include <components/misc/hash.hpp>
+#include <components/misc/threadpool.hpp>
+
+namespace
+{
+    /// Increase when the layout of the cache or the way meshes are merged changes
+    const int sCacheFormat = 2;
+
+    const uint32_t sBatchRecord = ESM::FourCC<'B','T','C','H'>::value;
+
+    struct BatchHeader
+    {
+        int mRegion[3];
+        Ogre::uint32 mFirst;
+        Ogre::uint32 mVertexCount;
+        float mBounds[6];
+    };
+
+    using Misc::addHash;
+
+    void addHash (uint64_t& hash, const std::vector<int>& value)
+    {
+        addHash (hash, static_cast<uint32_t> (value.size()));
+        if (!value.empty())
+            addHash (hash, &value[0], value.size()*sizeof (int));
+    }
+
+    std::vector<int> getFormat (const Ogre::VertexDeclaration& declaration)
+    {
+        std::vector<int> format;
+
+        const Ogre::VertexDeclaration::VertexElementList& elements = declaration.getElements();
+        for (Ogre::VertexDeclaration::VertexElementList::const_iterator iter (elements.begin());
+            iter!=elements.end(); ++iter)
+        {
+            format.push_back (iter->getType());
+            format.push_back (iter->getSemantic());
+            format.push_back (iter->getIndex());
+        }
+
+        return format;
+    }
+
+    size_t getVertexSize (const std::vector<int>& format)
+    {
+        size_t size = 0;
+        for (size_t i=0; i<format.size(); i+=3)
+            size += Ogre::VertexElement::getTypeSize (static_cast<Ogre::VertexElementType> (format[i]));
+        return size;
+    }
+
+    const Ogre::VertexData *getVertexData (const Ogre::Mesh& mesh, const Ogre::SubMesh& subMesh)
+    {
+        return subMesh.useSharedVertices ? mesh.sharedVertexData : subMesh.vertexData;
+    }
+
+    /// Vertices and indices of a sub-mesh, read back from its hardware buffers
+    struct Source
+    {
+        std::vector<int> mFormat;
+        size_t mVertexSize;
+        size_t mVertexCount;
+        std::vector<Ogre::uint8> mVertices; // interleaved in the order of mFormat
+        std::vector<Ogre::uint32> mIndices;
+
+        Source() : mVertexSize (0), mVertexCount (0) {}
+    };
+
+    /// @return Can the sub-mesh be batched?
+    bool readSource (const Ogre::Mesh& mesh, const Ogre::SubMesh& subMesh, Source& source)
+    {
+        const Ogre::VertexData *vertexData = getVertexData (mesh, subMesh);
+        const Ogre::IndexData *indexData = subMesh.indexData;
+
+        if (subMesh.operationType!=Ogre::RenderOperation::OT_TRIANGLE_LIST || !vertexData ||
+            vertexData->vertexCount==0 || !indexData || indexData->indexBuffer.isNull() ||
+            indexData->indexCount==0)
+            return false;
+
+        source.mFormat = getFormat (*vertexData->vertexDeclaration);
+        source.mVertexSize = getVertexSize (source.mFormat);
+        source.mVertexCount = vertexData->vertexCount;
+        source.mVertices.resize (source.mVertexSize * source.mVertexCount);
+
+        // Read every buffer once, then interleave its elements
+        std::map<unsigned short, std::vector<Ogre::uint8> > buffers;
+        size_t offset = 0;
+
+        const Ogre::VertexDeclaration::VertexElementList& elements =
+            vertexData->vertexDeclaration->getElements();
+        for (Ogre::VertexDeclaration::VertexElementList::const_iterator element (elements.begin());
+            element!=elements.end(); ++element)
+        {
+            Ogre::HardwareVertexBufferSharedPtr buffer =
+                vertexData->vertexBufferBinding->getBuffer (element->getSource());
+            const size_t stride = buffer->getVertexSize();
+
+            std::vector<Ogre::uint8>& data = buffers[element->getSource()];
+
+            if (data.empty())
+            {
+                data.resize (stride * source.mVertexCount);
+                buffer->readData (stride * vertexData->vertexStart, data.size(), &data[0]);
+            }
+
+            const size_t size = element->getSize();
+
+            for (size_t i=0; i<source.mVertexCount; ++i)
+                std::memcpy (&source.mVertices[i*source.mVertexSize + offset],
+                    &data[i*stride + element->getOffset()], size);
+
+            offset += size;
+        }
+
+        // Indices are relative to vertexStart, which the copy starts from
+        Ogre::HardwareIndexBufferSharedPtr buffer = indexData->indexBuffer;
+
+        if (buffer->getType()==Ogre::HardwareIndexBuffer::IT_16BIT)
+        {
+            std::vector<Ogre::uint16> indices (indexData->indexCount);
+            buffer->readData (indexData->indexStart*sizeof (Ogre::uint16),
+                indices.size()*sizeof (Ogre::uint16), &indices[0]);
+            source.mIndices.assign (indices.begin(), indices.end());
+        }
+        else
+        {
+            source.mIndices.resize (indexData->indexCount);
+            buffer->readData (indexData->indexStart*sizeof (Ogre::uint32),
+                source.mIndices.size()*sizeof (Ogre::uint32), &source.mIndices[0]);
+        }
+
+        return true;
+    }
+
+    /// \brief One merged batch of static geometry
+    class Batch : public Ogre::Renderable, public Ogre::MovableObject
+    {
+        public:
+
+            Batch (const std::vector<int>& format, Ogre::uint32 vertexCount,
+                const std::vector<Ogre::uint8>& vertices, const std::vector<Ogre::uint32>& indices,
+                const Ogre::AxisAlignedBox& bounds, const Ogre::MaterialPtr& material);
+
+            virtual ~Batch();
+
+            // Inherited from MovableObject
+            virtual const Ogre::String& getMovableType() const { static Ogre::String t = "MW_CELLBATCH"; return t; }
+            virtual const Ogre::AxisAlignedBox& getBoundingBox() const { return mBounds; }
+            virtual Ogre::Real getBoundingRadius() const { return mBounds.getHalfSize().length(); }
+            virtual void _updateRenderQueue (Ogre::RenderQueue* queue) { queue->addRenderable (this, mRenderQueueID); }
+            virtual void visitRenderables (Renderable::Visitor* visitor, bool debugRenderables = false)
+            { visitor->visit (this, 0, false); }
+
+            // Inherited from Renderable
+            virtual const Ogre::MaterialPtr& getMaterial() const { return mMaterial; }
+            virtual void getRenderOperation (Ogre::RenderOperation& op);
+            virtual void getWorldTransforms (Ogre::Matrix4* xform) const { *xform = getParentSceneNode()->_getFullTransform(); }
+            virtual Ogre::Real getSquaredViewDepth (const Ogre::Camera* cam) const { return getParentSceneNode()->getSquaredViewDepth (cam); }
+            virtual const Ogre::LightList& getLights() const { return queryLights(); }
+
+        private:
+
+            Ogre::AxisAlignedBox mBounds;
+            Ogre::MaterialPtr mMaterial;
+            Ogre::VertexData* mVertexData;
+            Ogre::IndexData* mIndexData;
+    };
+
+    Batch::Batch (const std::vector<int>& format, Ogre::uint32 vertexCount,
+        const std::vector<Ogre::uint8>& vertices, const std::vector<Ogre::uint32>& indices,
+        const Ogre::AxisAlignedBox& bounds, const Ogre::MaterialPtr& material)
+    : mBounds (bounds), mMaterial (material)
+    {
+        Ogre::HardwareBufferManager* mgr = Ogre::HardwareBufferManager::getSingletonPtr();
+
+        mVertexData = OGRE_NEW Ogre::VertexData;
+        mVertexData->vertexStart = 0;
+        mVertexData->vertexCount = vertexCount;
+
+        size_t offset = 0;
+        for (size_t i=0; i<format.size(); i+=3)
+        {
+            const Ogre::VertexElementType type = static_cast<Ogre::VertexElementType> (format[i]);
+            mVertexData->vertexDeclaration->addElement (0, offset, type,
+                static_cast<Ogre::VertexElementSemantic> (format[i+1]), static_cast<unsigned short> (format[i+2]));
+            offset += Ogre::VertexElement::getTypeSize (type);
+        }
+
+        Ogre::HardwareVertexBufferSharedPtr vertexBuffer = mgr->createVertexBuffer (offset, vertexCount,
+            Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        vertexBuffer->writeData (0, vertexBuffer->getSizeInBytes(), &vertices[0], true);
+        mVertexData->vertexBufferBinding->setBinding (0, vertexBuffer);
+
+        mIndexData = OGRE_NEW Ogre::IndexData;
+        mIndexData->indexStart = 0;
+        mIndexData->indexCount = indices.size();
+
+        if (vertexCount<=65536)
+        {
+            std::vector<Ogre::uint16> shortIndices (indices.begin(), indices.end());
+            mIndexData->indexBuffer = mgr->createIndexBuffer (Ogre::HardwareIndexBuffer::IT_16BIT,
+                shortIndices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            mIndexData->indexBuffer->writeData (0, mIndexData->indexBuffer->getSizeInBytes(), &shortIndices[0], true);
+        }
+        else
+        {
+            mIndexData->indexBuffer = mgr->createIndexBuffer (Ogre::HardwareIndexBuffer::IT_32BIT,
+                indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            mIndexData->indexBuffer->writeData (0, mIndexData->indexBuffer->getSizeInBytes(), &indices[0], true);
+        }
+    }
+
+    Batch::~Batch()
+    {
+        OGRE_DELETE mVertexData;
+        OGRE_DELETE mIndexData;
+    }
+
+    void Batch::getRenderOperation (Ogre::RenderOperation& op)
+    {
+        op.useIndexes = true;
+        op.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+        op.vertexData = mVertexData;
+        op.indexData = mIndexData;
+    }
+}
+
+namespace MWRender
+{
+
+CellBatch::CellBatch (Ogre::SceneManager* sceneMgr, const boost::filesystem::path& cacheDir,
+                      Misc::ThreadPool* writer)
+    : mSceneMgr(sceneMgr)
+    , mCacheDir(cacheDir)
+    , mWriter(writer)
+    , mOrigin(Ogre::Vector3::ZERO)
+    , mRegionDimensions(1000, 1000, 1000)
+    , mRenderingDistance(0)
+    , mVisibilityFlags(0xFFFFFFFF)
+    , mCastShadows(true)
+    , mRenderQueueGroup(Ogre::RENDER_QUEUE_MAIN)
+{
+}
+
+CellBatch::~CellBatch()
+{
+    destroy();
+}
+
+void CellBatch::setOrigin (const Ogre::Vector3& origin)
+{
+    mOrigin = origin;
+}
+
+void CellBatch::setRegionDimensions (const Ogre::Vector3& size)
+{
+    mRegionDimensions = size;
+}
+
+void CellBatch::setRenderingDistance (float distance)
+{
+    mRenderingDistance = distance;
+}
+
+void CellBatch::setVisibilityFlags (Ogre::uint32 flags)
+{
+    mVisibilityFlags = flags;
+}
+
+void CellBatch::setCastShadows (bool castShadows)
+{
+    mCastShadows = castShadows;
+}
+
+void CellBatch::setRenderQueueGroup (Ogre::uint8 group)
+{
+    mRenderQueueGroup = group;
+}
+
+void CellBatch::addEntity (Ogre::Entity* entity, const Ogre::Vector3& position,
+                           const Ogre::Quaternion& orientation, const Ogre::Vector3& scale)
+{
+    for (unsigned int i=0; i<entity->getNumSubEntities(); ++i)
+    {
+        Ogre::SubEntity* subEntity = entity->getSubEntity(i);
+        if (!subEntity->isVisible())
+            continue;
+
+        QueuedSubMesh queued;
+        queued.mMesh = entity->getMesh();
+        queued.mSubMesh = static_cast<unsigned short>(i);
+        queued.mMaterial = subEntity->getMaterialName();
+        queued.mPosition = position;
+        queued.mOrientation = orientation;
+        queued.mScale = scale;
+        mQueue.push_back(queued);
+    }
+}
+
+void CellBatch::build()
+{
+    destroy();
+
+    if (mQueue.empty())
+        return;
+
+    boost::shared_ptr<Buckets> buckets (new Buckets);
+    uint64_t key = 0;
+    bool cached = false;
+
+    if (!mCacheDir.empty())
+    {
+        key = getCacheKey();
+        cached = readCache(key, *buckets);
+    }
+
+    if (!cached)
+        merge(*buckets);
+
+    for (Buckets::const_iterator it = buckets->begin(); it != buckets->end(); ++it)
+        createBatch(*it);
+
+    if (!cached && !mCacheDir.empty())
+    {
+        boost::shared_ptr<const Buckets> data (buckets);
+
+        if (mWriter)
+            mWriter->push(boost::bind(&CellBatch::writeCache, getCacheFile(key), key, data));
+        else
+            writeCache(getCacheFile(key), key, data);
+    }
+}
+
+void CellBatch::destroy()
+{
+    for (size_t i=0; i<mBatches.size(); ++i)
+    {
+        mNodes[i]->detachAllObjects();
+        delete mBatches[i];
+        mSceneMgr->destroySceneNode(mNodes[i]);
+    }
+
+    mBatches.clear();
+    mNodes.clear();
+}
+
+uint64_t CellBatch::getCacheKey() const
+{
+    uint64_t hash = Misc::sHashSeed;
+
+    // Another build may merge differently, even with the same cache format
+    addHash(hash, ESM::getCacheVersion());
+
+    addHash(hash, mOrigin);
+    addHash(hash, mRegionDimensions);
+    addHash(hash, static_cast<uint32_t>(mQueue.size()));
+
+    // Material names depend on the order the meshes have been loaded in, so only which
+    // sub-meshes share a material is part of the key.
+    std::map<std::string, Ogre::uint32> materials;
+
+    for (size_t i=0; i<mQueue.size(); ++i)
+    {
+        const QueuedSubMesh& queued = mQueue[i];
+        const Ogre::SubMesh* subMesh = queued.mMesh->getSubMesh(queued.mSubMesh);
+        const Ogre::VertexData* vertexData = getVertexData(*queued.mMesh, *subMesh);
+
+        addHash(hash, queued.mMesh->getName());
+        // A replaced model with the same name rarely keeps the same bounds
+        addHash(hash, queued.mMesh->getBounds().getMinimum());
+        addHash(hash, queued.mMesh->getBounds().getMaximum());
+        addHash(hash, queued.mSubMesh);
+        addHash(hash, subMesh->operationType);
+        addHash(hash, static_cast<uint64_t>(vertexData ? vertexData->vertexCount : 0));
+        addHash(hash, vertexData ? getFormat(*vertexData->vertexDeclaration) : std::vector<int>());
+        addHash(hash, static_cast<uint64_t>(subMesh->indexData ? subMesh->indexData->indexCount : 0));
+        addHash(hash, materials.insert(std::make_pair(queued.mMaterial, static_cast<Ogre::uint32>(i))).first->second);
+        addHash(hash, queued.mPosition);
+        addHash(hash, queued.mOrientation);
+        addHash(hash, queued.mScale);
+    }
+
+    return hash;
+}
+
+boost::filesystem::path CellBatch::getCacheFile (uint64_t key) const
+{
+    std::ostringstream name;
+    name << "cell_" << std::hex << std::setw(16) << std::setfill('0') << key << ".cache";
+    return mCacheDir / name.str();
+}
+
+bool CellBatch::readCache (uint64_t key, Buckets& buckets) const
+{
+    boost::filesystem::path file = getCacheFile(key);
+
+    try
+    {
+        ESM::ESMReader reader;
+
+        if (!ESM::openCacheFile(reader, file, sCacheFormat, key))
+            return false;
+
+        while (reader.hasMoreRecs())
+        {
+            if (reader.getRecName().val!=sBatchRecord)
+                throw std::runtime_error("unknown record");
+
+            reader.getRecHeader();
+
+            BatchHeader header;
+            reader.getHNT(header, "HEDR");
+
+            if (header.mFirst>=mQueue.size())
+                throw std::runtime_error("material out of range");
+
+            buckets.push_back(Bucket());
+            Bucket& bucket = buckets.back();
+
+            for (int i=0; i<3; ++i)
+                bucket.mRegion[i] = header.mRegion[i];
+            bucket.mFirst = header.mFirst;
+            bucket.mVertexCount = header.mVertexCount;
+            bucket.mBounds.setExtents(header.mBounds[0], header.mBounds[1], header.mBounds[2],
+                header.mBounds[3], header.mBounds[4], header.mBounds[5]);
+
+            reader.getSubNameIs("FRMT");
+            reader.getSubHeader();
+            if (reader.getSubSize()==0 || reader.getSubSize()%(3*sizeof(int))!=0)
+                throw std::runtime_error("invalid vertex format");
+            bucket.mFormat.resize(reader.getSubSize()/sizeof(int));
+            reader.getExact(&bucket.mFormat[0], static_cast<int>(reader.getSubSize()));
+
+            reader.getSubNameIs("VERT");
+            reader.getSubHeader();
+            if (bucket.mVertexCount==0 || reader.getSubSize()!=bucket.mVertexCount*getVertexSize(bucket.mFormat))
+                throw std::runtime_error("vertex data size mismatch");
+            bucket.mVertices.resize(reader.getSubSize());
+            reader.getExact(&bucket.mVertices[0], static_cast<int>(reader.getSubSize()));
+
+            reader.getSubNameIs("INDX");
+            reader.getSubHeader();
+            if (reader.getSubSize()==0 || reader.getSubSize()%sizeof(Ogre::uint32)!=0)
+                throw std::runtime_error("index data size mismatch");
+            bucket.mIndices.resize(reader.getSubSize()/sizeof(Ogre::uint32));
+            reader.getExact(&bucket.mIndices[0], static_cast<int>(reader.getSubSize()));
+
+            for (std::vector<Ogre::uint32>::const_iterator it = bucket.mIndices.begin(); it != bucket.mIndices.end(); ++it)
+                if (*it>=bucket.mVertexCount)
+                    throw std::runtime_error("index out of range");
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Ignoring static geometry cache " << file.string() << ": " << e.what() << std::endl;
+        buckets.clear();
+        return false;
+    }
+
+    // for pruneCache
+    ESM::touchCacheFile(file);
+
+    return true;
+}
+
+void CellBatch::pruneCache (const boost::filesystem::path& cacheDir, uint64_t maxSize)
+{
+    try
+    {
+        ESM::pruneCacheFiles(cacheDir, "cell_", maxSize);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to prune static geometry cache " << cacheDir.string() << ": " << e.what() << std::endl;
+    }
+}
+
+void CellBatch::writeCache (const boost::filesystem::path& file, uint64_t key,
+                            boost::shared_ptr<const Buckets> buckets)
+{
+    try
+    {
+        // ESMWriter seeks back for every record size, which is a lot faster in memory
+        std::stringstream buffer;
+
+        ESM::ESMWriter writer;
+        ESM::startCacheFile(writer, buffer, sCacheFormat, key);
+
+        for (Buckets::const_iterator it = buckets->begin(); it != buckets->end(); ++it)
+        {
+            BatchHeader header;
+            for (int i=0; i<3; ++i)
+            {
+                header.mRegion[i] = it->mRegion[i];
+                header.mBounds[i] = it->mBounds.getMinimum()[i];
+                header.mBounds[i+3] = it->mBounds.getMaximum()[i];
+            }
+            header.mFirst = it->mFirst;
+            header.mVertexCount = it->mVertexCount;
+
+            writer.startRecord(sBatchRecord);
+            writer.writeHNT("HEDR", header);
+
+            writer.startSubRecord("FRMT");
+            writer.write(reinterpret_cast<const char *>(&it->mFormat[0]), it->mFormat.size()*sizeof(int));
+            writer.endRecord("FRMT");
+
+            writer.startSubRecord("VERT");
+            writer.write(reinterpret_cast<const char *>(&it->mVertices[0]), it->mVertices.size());
+            writer.endRecord("VERT");
+
+            writer.startSubRecord("INDX");
+            writer.write(reinterpret_cast<const char *>(&it->mIndices[0]), it->mIndices.size()*sizeof(Ogre::uint32));
+            writer.endRecord("INDX");
+
+            writer.endRecord(sBatchRecord);
+        }
+
+        writer.close();
+
+        ESM::saveCacheFile(file, buffer.str());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to write static geometry cache " << file.string() << ": " << e.what() << std::endl;
+    }
+}
+
+void CellBatch::merge (Buckets& buckets) const
+{
+    // Sub-meshes are shared by many references, so each one is only read back once
+    std::map<const Ogre::SubMesh*, Source> sources;
+    std::map<std::string, Ogre::uint32> materials;
+    std::map<std::pair<std::vector<int>, Format>, size_t> bucketIndex;
+
+    for (size_t i=0; i<mQueue.size(); ++i)
+    {
+        const QueuedSubMesh& queued = mQueue[i];
+        const Ogre::SubMesh* subMesh = queued.mMesh->getSubMesh(queued.mSubMesh);
+
+        std::map<const Ogre::SubMesh*, Source>::iterator found = sources.find(subMesh);
+        if (found == sources.end())
+        {
+            found = sources.insert(std::make_pair(subMesh, Source())).first;
+            if (!readSource(*queued.mMesh, *subMesh, found->second))
+                found->second.mVertexCount = 0;
+        }
+
+        const Source& source = found->second;
+        if (source.mVertexCount == 0)
+            continue;
+
+        const Ogre::uint32 first =
+            materials.insert(std::make_pair(queued.mMaterial, static_cast<Ogre::uint32>(i))).first->second;
+
+        int region[3];
+        for (int j=0; j<3; ++j)
+            region[j] = static_cast<int>(std::floor((queued.mPosition[j] - mOrigin[j]) / mRegionDimensions[j]));
+
+        std::vector<int> bucketKey(region, region+3);
+        bucketKey.push_back(static_cast<int>(first));
+
+        std::map<std::pair<std::vector<int>, Format>, size_t>::iterator index =
+            bucketIndex.find(std::make_pair(bucketKey, source.mFormat));
+
+        if (index == bucketIndex.end())
+        {
+            index = bucketIndex.insert(std::make_pair(std::make_pair(bucketKey, source.mFormat), buckets.size())).first;
+
+            buckets.push_back(Bucket());
+            Bucket& bucket = buckets.back();
+            for (int j=0; j<3; ++j)
+                bucket.mRegion[j] = region[j];
+            bucket.mFirst = first;
+            bucket.mFormat = source.mFormat;
+            bucket.mVertexCount = 0;
+        }
+
+        Bucket& bucket = buckets[index->second];
+
+        const Ogre::Vector3 offset = queued.mPosition - mOrigin - getRegionCentre(region);
+        const size_t start = bucket.mVertices.size();
+
+        bucket.mVertices.insert(bucket.mVertices.end(), source.mVertices.begin(), source.mVertices.end());
+
+        size_t elementOffset = 0;
+        for (size_t e=0; e<source.mFormat.size(); e+=3)
+        {
+            const Ogre::VertexElementType type = static_cast<Ogre::VertexElementType>(source.mFormat[e]);
+            const Ogre::VertexElementSemantic semantic = static_cast<Ogre::VertexElementSemantic>(source.mFormat[e+1]);
+
+            const bool position = semantic == Ogre::VES_POSITION;
+            const bool direction = semantic == Ogre::VES_NORMAL || semantic == Ogre::VES_TANGENT ||
+                                   semantic == Ogre::VES_BINORMAL;
+
+            if ((position || direction) && (type == Ogre::VET_FLOAT3 || type == Ogre::VET_FLOAT4))
+            {
+                for (size_t v=0; v<source.mVertexCount; ++v)
+                {
+                    Ogre::uint8* data = &bucket.mVertices[start + v*source.mVertexSize + elementOffset];
+
+                    Ogre::Vector3 vector;
+                    std::memcpy(vector.ptr(), data, 3*sizeof(float));
+
+                    if (position)
+                    {
+                        vector = queued.mOrientation * (vector * queued.mScale) + offset;
+                        bucket.mBounds.merge(vector);
+                    }
+                    else
+                    {
+                        vector = queued.mOrientation * (vector / queued.mScale);
+                        vector.normalise();
+                    }
+
+                    std::memcpy(data, vector.ptr(), 3*sizeof(float));
+                }
+            }
+
+            elementOffset += Ogre::VertexElement::getTypeSize(type);
+        }
+
+        for (std::vector<Ogre::uint32>::const_iterator it = source.mIndices.begin(); it != source.mIndices.end(); ++it)
+            bucket.mIndices.push_back(bucket.mVertexCount + *it);
+
+        bucket.mVertexCount += static_cast<Ogre::uint32>(source.mVertexCount);
+    }
+}
+
+Ogre::Vector3 CellBatch::getRegionCentre (const int region[3]) const
+{
+    return Ogre::Vector3((region[0] + 0.5f) * mRegionDimensions.x,
+                         (region[1] + 0.5f) * mRegionDimensions.y,
+                         (region[2] + 0.5f) * mRegionDimensions.z);
+}
+
+void CellBatch::createBatch (const Bucket& bucket)
+{
+    Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().getByName(mQueue[bucket.mFirst].mMaterial);
+    if (material.isNull())
+        material = Ogre::MaterialManager::getSingleton().getByName("BaseWhite");
+
+    Batch* batch = new Batch(bucket.mFormat, bucket.mVertexCount, bucket.mVertices, bucket.mIndices,
+                             bucket.mBounds, material);
+    batch->setVisibilityFlags(mVisibilityFlags);
+    batch->setRenderingDistance(mRenderingDistance);
+    batch->setCastShadows(mCastShadows);
+    batch->setRenderQueueGroup(mRenderQueueGroup);
+
+    Ogre::SceneNode* node = mSceneMgr->getRootSceneNode()->createChildSceneNode(
+        mOrigin + getRegionCentre(bucket.mRegion));
+    node->attachObject(batch);
+
+    mNodes.push_back(node);
+    mBatches.push_back(batch);
+}
+
+}
@@ -0,0 +1,134 @@
+#ifndef GAME_RENDER_CELLBATCH_H
+#define GAME_RENDER_CELLBATCH_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <OgreMesh.h>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+#include <OgreAxisAlignedBox.h>
+
+namespace Ogre
+{
+    class Entity;
+    class SceneManager;
+    class SceneNode;
+    class MovableObject;
+}
+
+namespace Misc
+{
+    class ThreadPool;
+}
+
+namespace MWRender
+{
+    ///
+    /// \brief Static geometry of a cell, merged into one batch per region and material
+    ///
+    /// Used like Ogre::StaticGeometry, but the merged vertex and index data is kept in a cache
+    /// file, keyed by the meshes that have been added and where they have been placed. Building
+    /// the same cell again only has to copy the cached data into hardware buffers, instead of
+    /// reading back and transforming the vertices of every mesh.
+    ///
+    class CellBatch
+    {
+    public:
+        /// @param cacheDir Directory for the cache files (empty: no cache)
+        /// @param writer Writes the cache files in the background
+        CellBatch (Ogre::SceneManager* sceneMgr, const boost::filesystem::path& cacheDir,
+                   Misc::ThreadPool* writer);
+        ~CellBatch();
+
+        void setOrigin (const Ogre::Vector3& origin);
+        void setRegionDimensions (const Ogre::Vector3& size);
+        void setRenderingDistance (float distance);
+        void setVisibilityFlags (Ogre::uint32 flags);
+        void setCastShadows (bool castShadows);
+        void setRenderQueueGroup (Ogre::uint8 group);
+
+        /// Queue the sub-entities of \a entity. Only its meshes and materials are kept, so the
+        /// entity can be destroyed afterwards.
+        void addEntity (Ogre::Entity* entity, const Ogre::Vector3& position,
+                        const Ogre::Quaternion& orientation, const Ogre::Vector3& scale);
+
+        /// Create the batches from the queued meshes.
+        void build();
+
+        /// Destroy the batches, but keep the queued meshes for the next build.
+        void destroy();
+
+        /// Remove the least recently used cache files in \a cacheDir, until they take up no
+        /// more than \a maxSize bytes.
+        /// @note Can run on the cache writer thread
+        static void pruneCache (const boost::filesystem::path& cacheDir, uint64_t maxSize);
+
+    private:
+        struct QueuedSubMesh
+        {
+            Ogre::MeshPtr mMesh;
+            unsigned short mSubMesh;
+            std::string mMaterial;
+            Ogre::Vector3 mPosition;
+            Ogre::Quaternion mOrientation;
+            Ogre::Vector3 mScale;
+        };
+
+        // type, semantic and index of each vertex element, in the order of the declaration
+        typedef std::vector<int> Format;
+
+        struct Bucket
+        {
+            int mRegion[3];
+            Ogre::uint32 mFirst; // queued sub-mesh whose material the bucket uses
+            Format mFormat;
+            Ogre::uint32 mVertexCount;
+            std::vector<Ogre::uint8> mVertices; // interleaved, relative to the region centre
+            std::vector<Ogre::uint32> mIndices;
+            Ogre::AxisAlignedBox mBounds;
+        };
+
+        typedef std::vector<Bucket> Buckets;
+
+        Ogre::SceneManager* mSceneMgr;
+        boost::filesystem::path mCacheDir;
+        Misc::ThreadPool* mWriter;
+
+        Ogre::Vector3 mOrigin;
+        Ogre::Vector3 mRegionDimensions;
+        float mRenderingDistance;
+        Ogre::uint32 mVisibilityFlags;
+        bool mCastShadows;
+        Ogre::uint8 mRenderQueueGroup;
+
+        std::vector<QueuedSubMesh> mQueue;
+
+        std::vector<Ogre::SceneNode*> mNodes;
+        std::vector<Ogre::MovableObject*> mBatches;
+
+        uint64_t getCacheKey() const;
+
+        boost::filesystem::path getCacheFile (uint64_t key) const;
+
+        /// Reading a cache file marks it as recently used.
+        bool readCache (uint64_t key, Buckets& buckets) const;
+
+        static void writeCache (const boost::filesystem::path& file, uint64_t key,
+                                boost::shared_ptr<const Buckets> buckets);
+
+        /// Merge the queued sub-meshes on the CPU.
+        void merge (Buckets& buckets) const;
+
+        Ogre::Vector3 getRegionCentre (const int region[3]) const;
+
+        void createBatch (const Bucket& bucket);
+    };
+}
+
+#endif
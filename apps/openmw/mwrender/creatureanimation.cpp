@@ -185,7 +185,7 @@ Ogre::Vector3 CreatureWeaponAnimation::runAnimation(float duration)
 {
     Ogre::Vector3 ret = Animation::runAnimation(duration);
 
-    if (mSkelBase)
+    if (mSkelBase && mBonesUpdated)
         pitchSkeleton(mPtr.getRefData().getPosition().rot[0], mSkelBase->getSkeleton());
 
     if (!mWeapon.isNull())
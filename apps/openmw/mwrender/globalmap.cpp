@@ -1,7 +1,16 @@
 #include "globalmap.hpp"
 
+#include <set>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include <OgreImage.h>
 #include <OgreTextureManager.h>
@@ -13,15 +22,78 @@
 #include <components/loadinglistener/loadinglistener.hpp>
 #include <components/settings/settings.hpp>
 
+#include <components/esm/cachefile.hpp>
 #include <components/esm/globalmap.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/misc/hash.hpp>
+#include <components/misc/threadpool.hpp>
 
 #include "../mwbase/environment.hpp"
 #include "../mwbase/world.hpp"
 
 #include "../mwworld/esmstore.hpp"
 
+namespace
+{
+    /// Increase when the layout of the cache or the colours of the map change
+    const int sCacheFormat = 1;
+
+    const uint32_t sMapRecord = ESM::FourCC<'G','M','A','P'>::value;
+
+    using Misc::addHash;
+
+    /// Colour of the map at height \a y, scaled from the WNAM heights of a land record
+    void getColour (float y, unsigned char& r, unsigned char& g, unsigned char& b)
+    {
+        if (y < 0)
+        {
+            r = static_cast<unsigned char>(14 * y + 38);
+            g = static_cast<unsigned char>(20 * y + 56);
+            b = static_cast<unsigned char>(18 * y + 51);
+        }
+        else if (y < 0.3f)
+        {
+            if (y < 0.1f)
+                y *= 8.f;
+            else
+            {
+                y -= 0.1f;
+                y += 0.8f;
+            }
+            r = static_cast<unsigned char>(66 - 32 * y);
+            g = static_cast<unsigned char>(48 - 23 * y);
+            b = static_cast<unsigned char>(33 - 16 * y);
+        }
+        else
+        {
+            y -= 0.3f;
+            y *= 1.428f;
+            r = static_cast<unsigned char>(34 - 29 * y);
+            g = static_cast<unsigned char>(25 - 20 * y);
+            b = static_cast<unsigned char>(17 - 12 * y);
+        }
+    }
+}
+
 namespace MWRender
 {
+    /// A range of columns of cells. Tiles write to disjoint columns of the image, so they can be
+    /// filled in parallel.
+    struct GlobalMap::Tile
+    {
+        int mMinX, mMaxX;
+        bool mDone;
+        std::string mError;
+
+        Tile (int minX, int maxX) : mMinX (minX), mMaxX (maxX), mDone (false) {}
+    };
+
+    struct GlobalMap::TileQueue
+    {
+        boost::mutex mMutex;
+        boost::condition_variable mTileDone;
+    };
 
     GlobalMap::GlobalMap(const std::string &cacheDir)
         : mCacheDir(cacheDir)
@@ -63,81 +135,70 @@ namespace MWRender
         mWidth = mCellSize*(mMaxX-mMinX+1);
         mHeight = mCellSize*(mMaxY-mMinY+1);
 
-        loadingListener->loadingOn();
-        loadingListener->setLabel("Creating map");
-        loadingListener->setProgressRange((mMaxX-mMinX+1) * (mMaxY-mMinY+1));
-        loadingListener->setProgress(0);
+        const int columns = mMaxX-mMinX+1;
+        const int rows = mMaxY-mMinY+1;
+
+        // by column, then row
+        std::vector<ESM::Land*> lands (columns * rows);
+        for (int x = mMinX; x <= mMaxX; ++x)
+            for (int y = mMinY; y <= mMaxY; ++y)
+                lands[(x-mMinX) * rows + (y-mMinY)] = esmStore.get<ESM::Land>().search (x,y);
 
         std::vector<Ogre::uchar> data (mWidth * mHeight * 3);
 
-        for (int x = mMinX; x <= mMaxX; ++x)
+        std::string cacheFile;
+        uint64_t key = 0;
+
+        if (!mCacheDir.empty())
         {
-            for (int y = mMinY; y <= mMaxY; ++y)
-            {
-                ESM::Land* land = esmStore.get<ESM::Land>().search (x,y);
+            cacheFile = (boost::filesystem::path (mCacheDir) / "globalmap.cache").string();
+            key = getCacheKey (lands);
+        }
 
-                if (land)
-                {
-                    int mask = ESM::Land::DATA_WNAM;
-                    if (!land->isDataLoaded(mask))
-                        land->loadData(mask);
-                }
+        if (cacheFile.empty() || !readCache (cacheFile, key, data))
+        {
+            loadingListener->loadingOn();
+            loadingListener->setLabel("Creating map");
+            loadingListener->setProgressRange(columns * rows);
+            loadingListener->setProgress(0);
 
-                for (int cellY=0; cellY<mCellSize; ++cellY)
-                {
-                    for (int cellX=0; cellX<mCellSize; ++cellX)
-                    {
-                        int vertexX = static_cast<int>(float(cellX)/float(mCellSize) * 9);
-                        int vertexY = static_cast<int>(float(cellY) / float(mCellSize) * 9);
+            // A few tiles per thread, so that the progress keeps moving
+            Misc::ThreadPool pool;
+            int tileWidth = std::max (1, columns / static_cast<int> (pool.getThreadCount() * 4));
 
+            std::vector<Tile> tiles;
+            for (int x = mMinX; x <= mMaxX; x += tileWidth)
+                tiles.push_back (Tile (x, std::min (x + tileWidth - 1, mMaxX)));
 
-                        int texelX = (x-mMinX) * mCellSize + cellX;
-                        int texelY = (mHeight-1) - ((y-mMinY) * mCellSize + cellY);
+            TileQueue queue;
 
-                        unsigned char r,g,b;
+            for (std::vector<Tile>::iterator iter (tiles.begin()); iter!=tiles.end(); ++iter)
+                pool.push (boost::bind (&GlobalMap::renderTile, this, boost::ref (*iter), boost::cref (lands),
+                    boost::ref (data), boost::ref (queue)));
 
-                        float y = 0;
-                        if (land && land->mDataTypes & ESM::Land::DATA_WNAM)
-                            y = (land->mLandData->mWnam[vertexY * 9 + vertexX] << 4) / 2048.f;
-                        else
-                            y = (SCHAR_MIN << 4) / 2048.f;
-                        if (y < 0)
-                        {
-                            r = static_cast<unsigned char>(14 * y + 38);
-                            g = static_cast<unsigned char>(20 * y + 56);
-                            b = static_cast<unsigned char>(18 * y + 51);
-                        }
-                        else if (y < 0.3f)
-                        {
-                            if (y < 0.1f)
-                                y *= 8.f;
-                            else
-                            {
-                                y -= 0.1f;
-                                y += 0.8f;
-                            }
-                            r = static_cast<unsigned char>(66 - 32 * y);
-                            g = static_cast<unsigned char>(48 - 23 * y);
-                            b = static_cast<unsigned char>(33 - 16 * y);
-                        }
-                        else
-                        {
-                            y -= 0.3f;
-                            y *= 1.428f;
-                            r = static_cast<unsigned char>(34 - 29 * y);
-                            g = static_cast<unsigned char>(25 - 20 * y);
-                            b = static_cast<unsigned char>(17 - 12 * y);
-                        }
+            for (std::vector<Tile>::iterator iter (tiles.begin()); iter!=tiles.end(); ++iter)
+            {
+                {
+                    boost::mutex::scoped_lock lock (queue.mMutex);
+                    while (!iter->mDone)
+                        queue.mTileDone.wait (lock);
+                }
 
-                        data[texelY * mWidth * 3 + texelX * 3] = r;
-                        data[texelY * mWidth * 3 + texelX * 3+1] = g;
-                        data[texelY * mWidth * 3 + texelX * 3+2] = b;
-                    }
+                if (!iter->mError.empty())
+                {
+                    pool.wait();
+                    throw std::runtime_error ("failed to create global map: " + iter->mError);
                 }
-                loadingListener->increaseProgress();
-                if (land)
-                    land->unloadData();
+
+                loadingListener->increaseProgress((iter->mMaxX - iter->mMinX + 1) * rows);
             }
+
+            pool.wait();
+
+            if (!cacheFile.empty())
+                writeCache (cacheFile, key, data);
+
+            loadingListener->loadingOff();
         }
 
         Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(&data[0], data.size()));
@@ -152,8 +213,166 @@ namespace MWRender
             Ogre::TEX_TYPE_2D, mWidth, mHeight, 0, Ogre::PF_A8B8G8R8, Ogre::TU_DYNAMIC, this);
 
         clear();
+    }
 
-        loadingListener->loadingOff();
+    void GlobalMap::renderTile(Tile& tile, const std::vector<ESM::Land*>& lands, std::vector<Ogre::uchar>& data,
+                               TileQueue& queue)
+    {
+        try
+        {
+            // The readers of the content files are shared, so every tile needs its own
+            ESM::ESMReader reader;
+
+            const int rows = mMaxY-mMinY+1;
+
+            for (int x = tile.mMinX; x <= tile.mMaxX; ++x)
+            {
+                for (int y = mMinY; y <= mMaxY; ++y)
+                {
+                    ESM::Land* land = lands[(x-mMinX) * rows + (y-mMinY)];
+
+                    if (land)
+                    {
+                        int mask = ESM::Land::DATA_WNAM;
+                        if (!land->isDataLoaded(mask))
+                            land->loadData(mask, reader);
+                    }
+
+                    for (int cellY=0; cellY<mCellSize; ++cellY)
+                    {
+                        for (int cellX=0; cellX<mCellSize; ++cellX)
+                        {
+                            int vertexX = static_cast<int>(float(cellX)/float(mCellSize) * 9);
+                            int vertexY = static_cast<int>(float(cellY) / float(mCellSize) * 9);
+
+
+                            int texelX = (x-mMinX) * mCellSize + cellX;
+                            int texelY = (mHeight-1) - ((y-mMinY) * mCellSize + cellY);
+
+                            unsigned char r,g,b;
+
+                            float y = 0;
+                            if (land && land->mDataTypes & ESM::Land::DATA_WNAM)
+                                y = (land->mLandData->mWnam[vertexY * 9 + vertexX] << 4) / 2048.f;
+                            else
+                                y = (SCHAR_MIN << 4) / 2048.f;
+
+                            getColour(y, r, g, b);
+
+                            data[texelY * mWidth * 3 + texelX * 3] = r;
+                            data[texelY * mWidth * 3 + texelX * 3+1] = g;
+                            data[texelY * mWidth * 3 + texelX * 3+2] = b;
+                        }
+                    }
+                    if (land)
+                        land->unloadData();
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            tile.mError = e.what();
+        }
+
+        boost::mutex::scoped_lock lock (queue.mMutex);
+        tile.mDone = true;
+        queue.mTileDone.notify_all();
+    }
+
+    uint64_t GlobalMap::getCacheKey(const std::vector<ESM::Land*>& lands) const
+    {
+        uint64_t hash = Misc::sHashSeed;
+
+        addHash(hash, mCellSize);
+        addHash(hash, mMinX);
+        addHash(hash, mMaxX);
+        addHash(hash, mMinY);
+        addHash(hash, mMaxY);
+
+        // Reading the WNAM data of every land record is what takes most of the time, so the
+        // records are identified by their place in the content files instead of their data.
+        std::set<std::string> files;
+
+        for (std::vector<ESM::Land*>::const_iterator iter (lands.begin()); iter!=lands.end(); ++iter)
+        {
+            if (!*iter)
+            {
+                addHash(hash, 0);
+                continue;
+            }
+
+            addHash(hash, 1);
+            addHash(hash, (*iter)->mDataTypes);
+            addHash(hash, (*iter)->mContext.filename);
+            addHash(hash, static_cast<uint64_t>((*iter)->mContext.filePos));
+
+            files.insert((*iter)->mContext.filename);
+        }
+
+        for (std::set<std::string>::const_iterator iter (files.begin()); iter!=files.end(); ++iter)
+        {
+            boost::system::error_code error;
+            addHash(hash, static_cast<uint64_t>(boost::filesystem::file_size(*iter, error)));
+            addHash(hash, static_cast<uint64_t>(boost::filesystem::last_write_time(*iter, error)));
+        }
+
+        return hash;
+    }
+
+    bool GlobalMap::readCache(const std::string& file, uint64_t key, std::vector<Ogre::uchar>& data)
+    {
+        try
+        {
+            ESM::ESMReader reader;
+
+            if (!ESM::openCacheFile(reader, file, sCacheFormat, key))
+                return false;
+
+            if (!reader.hasMoreRecs() || reader.getRecName().val!=sMapRecord)
+                throw std::runtime_error("missing map");
+
+            reader.getRecHeader();
+            reader.getSubNameIs("DATA");
+            reader.getSubHeader();
+
+            if (reader.getSubSize()!=data.size())
+                throw std::runtime_error("map size mismatch");
+
+            reader.getExact(&data[0], static_cast<int>(data.size()));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Ignoring global map cache " << file << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void GlobalMap::writeCache(const std::string& file, uint64_t key, const std::vector<Ogre::uchar>& data)
+    {
+        try
+        {
+            // ESMWriter seeks back for every record size, which is a lot faster in memory
+            std::stringstream buffer;
+
+            ESM::ESMWriter writer;
+            ESM::startCacheFile(writer, buffer, sCacheFormat, key);
+
+            writer.startRecord(sMapRecord);
+            writer.startSubRecord("DATA");
+            writer.write(reinterpret_cast<const char *>(&data[0]), data.size());
+            writer.endRecord("DATA");
+            writer.endRecord(sMapRecord);
+
+            writer.close();
+
+            ESM::saveCacheFile(file, buffer.str());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write global map cache " << file << ": " << e.what() << std::endl;
+        }
     }
 
     void GlobalMap::worldPosToImageSpace(float x, float z, float& imageX, float& imageY)
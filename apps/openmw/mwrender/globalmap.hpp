@@ -2,6 +2,9 @@
 #define GAME_RENDER_GLOBALMAP_H
 
 #include <string>
+#include <vector>
+
+#include <stdint.h>
 
 #include <OgreTexture.h>
 
@@ -13,6 +16,7 @@ namespace Loading
 namespace ESM
 {
     struct GlobalMap;
+    struct Land;
 }
 
 namespace MWRender
@@ -21,9 +25,12 @@ namespace MWRender
     class GlobalMap : public Ogre::ManualResourceLoader
     {
     public:
+        /// @param cacheDir Directory for the disk cache of the map image (empty: no cache)
         GlobalMap(const std::string& cacheDir);
         ~GlobalMap();
 
+        /// Create the map image from the land records, or load it from the cache, if it has been
+        /// created from the same land records.
         void render(Loading::Listener* loadingListener);
 
         int getWidth() const { return mWidth; }
@@ -46,6 +53,19 @@ namespace MWRender
         void read (ESM::GlobalMap& map);
 
     private:
+        struct Tile;
+        struct TileQueue;
+
+        /// Fill the texels of the cells in \a tile's columns into \a data
+        void renderTile(Tile& tile, const std::vector<ESM::Land*>& lands, std::vector<Ogre::uchar>& data,
+                        TileQueue& queue);
+
+        uint64_t getCacheKey(const std::vector<ESM::Land*>& lands) const;
+
+        bool readCache(const std::string& file, uint64_t key, std::vector<Ogre::uchar>& data);
+
+        void writeCache(const std::string& file, uint64_t key, const std::vector<Ogre::uchar>& data);
+
         std::string mCacheDir;
 
         int mCellSize;
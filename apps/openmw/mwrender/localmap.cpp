@@ -1,5 +1,14 @@
 #include "localmap.hpp"
 
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/bind.hpp>
+
 #include <OgreMaterialManager.h>
 #include <OgreHardwarePixelBuffer.h>
 #include <OgreSceneManager.h>
@@ -9,7 +18,13 @@
 #include <OgreRenderTexture.h>
 #include <OgreViewport.h>
 
+#include <components/esm/cachefile.hpp>
 #include <components/esm/fogstate.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/esm/loadland.hpp>
+#include <components/misc/hash.hpp>
+#include <components/misc/threadpool.hpp>
 
 #include "../mwbase/environment.hpp"
 #include "../mwbase/world.hpp"
@@ -17,6 +32,7 @@
 
 #include "../mwworld/esmstore.hpp"
 #include "../mwworld/cellstore.hpp"
+#include "../mwworld/class.hpp"
 
 #include "renderconst.hpp"
 #include "renderingmanager.hpp"
@@ -24,11 +40,56 @@
 using namespace MWRender;
 using namespace Ogre;
 
-LocalMap::LocalMap(OEngine::Render::OgreRenderer* rend, MWRender::RenderingManager* rendering)
+namespace
+{
+    /// Increase when the layout of the cache or the way maps are rendered changes
+    const int sCacheFormat = 2;
+
+    const uint32_t sMapRecord = ESM::FourCC<'L','M','A','P'>::value;
+
+    using Misc::addHash;
+
+    struct ContentHashFunctor
+    {
+        uint64_t& mHash;
+
+        ContentHashFunctor (uint64_t& hash) : mHash (hash) {}
+
+        bool operator() (const MWWorld::Ptr& ptr)
+        {
+            // actors are not rendered on the map
+            if (ptr.getRefData().isDeleted() || !ptr.getRefData().isEnabled() || ptr.getClass().isActor())
+                return true;
+
+            addHash (mHash, ptr.getClass().getModel (ptr));
+
+            const ESM::Position& position = ptr.getRefData().getPosition();
+            // e.g. open doors
+            const MWWorld::LocalRotation& localRotation = ptr.getRefData().getLocalRotation();
+            for (int i=0; i<3; ++i)
+            {
+                addHash (mHash, position.pos[i]);
+                addHash (mHash, position.rot[i]);
+                addHash (mHash, localRotation.rot[i]);
+            }
+
+            addHash (mHash, ptr.getCellRef().getScale());
+
+            return true;
+        }
+    };
+}
+
+LocalMap::LocalMap(OEngine::Render::OgreRenderer* rend, MWRender::RenderingManager* rendering,
+                   const boost::filesystem::path& cacheDir)
     : mMapResolution(Settings::Manager::getInt("local map resolution", "Map"))
     , mAngle(0.f)
+    , mCacheDir(cacheDir)
     , mInterior(false)
 {
+    if (!mCacheDir.empty())
+        mCacheWriter.reset(new Misc::ThreadPool(1));
+
     mRendering = rend;
     mRenderingManager = rendering;
 
@@ -158,7 +219,171 @@ void LocalMap::saveFogOfWar(MWWorld::CellStore* cell)
     }
 }
 
-void LocalMap::requestMap(MWWorld::CellStore* cell, float zMin, float zMax)
+uint64_t LocalMap::getContentHash(MWWorld::CellStore* cell)
+{
+    uint64_t hash = Misc::sHashSeed;
+
+    ContentHashFunctor functor (hash);
+    cell->forEachUnchanged (functor);
+
+    if (cell->getCell()->isExterior())
+    {
+        const ESM::Land* land = MWBase::Environment::get().getWorld()->getStore().get<ESM::Land>().search(
+            cell->getCell()->getGridX(), cell->getCell()->getGridY());
+
+        if (land && land->mLandData)
+        {
+            if (land->isDataLoaded(ESM::Land::DATA_VHGT))
+                addHash(hash, land->mLandData->mHeights, sizeof(land->mLandData->mHeights));
+            if (land->isDataLoaded(ESM::Land::DATA_VTEX))
+                addHash(hash, land->mLandData->mTextures, sizeof(land->mLandData->mTextures));
+            if (land->isDataLoaded(ESM::Land::DATA_VCLR))
+                addHash(hash, land->mLandData->mColours, sizeof(land->mLandData->mColours));
+        }
+    }
+    else
+    {
+        addHash(hash, cell->getCell()->hasWater());
+        addHash(hash, cell->getWaterLevel());
+    }
+
+    return hash;
+}
+
+boost::filesystem::path LocalMap::getCacheFile(const std::string& texture) const
+{
+    // Texture names contain cell names, which can contain any character. Files with the same
+    // name are told apart by the texture name stored in them.
+    std::string name = texture;
+
+    for (std::string::iterator iter (name.begin()); iter!=name.end(); ++iter)
+        if (!std::isalnum(static_cast<unsigned char>(*iter)) && *iter!='-')
+            *iter = '_';
+
+    return mCacheDir / (name + ".cache");
+}
+
+bool LocalMap::readCachedMap(const std::string& texture, uint64_t hash, Ogre::TexturePtr tex)
+{
+    if (mCacheDir.empty())
+        return false;
+
+    boost::filesystem::path file = getCacheFile(texture);
+
+    try
+    {
+        ESM::ESMReader reader;
+
+        if (!ESM::openCacheFile(reader, file, sCacheFormat))
+            return false;
+
+        std::string cachedVersion = reader.getHNString("VERS");
+        std::string cachedTexture = reader.getHNString("NAME");
+        uint64_t cachedHash = 0;
+        reader.getHNT(cachedHash, "HASH");
+
+        if (cachedVersion!=ESM::getCacheVersion() || cachedTexture!=texture || cachedHash!=hash)
+            return false;
+
+        if (!reader.hasMoreRecs() || reader.getRecName().val!=sMapRecord)
+            throw std::runtime_error("missing map");
+
+        reader.getRecHeader();
+        reader.getSubNameIs("DATA");
+        reader.getSubHeader();
+
+        std::vector<char> data(reader.getSubSize());
+        if (data.empty())
+            throw std::runtime_error("empty map");
+        reader.getExact(&data[0], static_cast<int>(data.size()));
+
+        Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(&data[0], data.size()));
+        Ogre::Image image;
+        image.load(stream, "tga");
+
+        if (int(image.getWidth()) != mMapResolution || int(image.getHeight()) != mMapResolution)
+            throw std::runtime_error("map size mismatch");
+
+        tex->getBuffer()->blitFromMemory(image.getPixelBox());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Ignoring local map cache " << file.string() << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    mCachedHashes[texture] = hash;
+
+    return true;
+}
+
+void LocalMap::writeCachedMap(const std::string& texture, uint64_t hash, Ogre::TexturePtr tex)
+{
+    if (mCacheDir.empty())
+        return;
+
+    // The file has this map already, or will have once the queued write is done
+    std::map<std::string, uint64_t>::const_iterator iter = mCachedHashes.find(texture);
+    if (iter != mCachedHashes.end() && iter->second == hash)
+        return;
+
+    // Reading the texture back needs the render system, only the file is written in the background
+    boost::shared_ptr<std::vector<char> > data(new std::vector<char>);
+
+    try
+    {
+        Ogre::Image image;
+        tex->convertToImage(image);
+
+        Ogre::DataStreamPtr encoded = image.encode("tga");
+        data->resize(encoded->size());
+        encoded->read(&(*data)[0], data->size());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to write local map cache " << getCacheFile(texture).string() << ": " << e.what() << std::endl;
+        return;
+    }
+
+    mCachedHashes[texture] = hash;
+
+    mCacheWriter->push(boost::bind(&LocalMap::writeCache, getCacheFile(texture), texture, hash,
+                                   boost::shared_ptr<const std::vector<char> >(data)));
+}
+
+void LocalMap::writeCache(const boost::filesystem::path& file, const std::string& texture, uint64_t hash,
+                          boost::shared_ptr<const std::vector<char> > data)
+{
+    try
+    {
+        // ESMWriter seeks back for every record size, which is a lot faster in memory
+        std::stringstream buffer;
+
+        ESM::ESMWriter writer;
+        ESM::startCacheFile(writer, buffer, sCacheFormat);
+        writer.writeHNString("VERS", ESM::getCacheVersion());
+        writer.writeHNString("NAME", texture);
+        writer.writeHNT("HASH", hash);
+        writer.endRecord(ESM::sCacheKeyRecord);
+
+        writer.startRecord(sMapRecord);
+        writer.startSubRecord("DATA");
+        writer.write(&(*data)[0], data->size());
+        writer.endRecord("DATA");
+        writer.endRecord(sMapRecord);
+
+        writer.close();
+
+        ESM::saveCacheFile(file, buffer.str());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to write local map cache " << file.string() << ": " << e.what() << std::endl;
+    }
+}
+
+void LocalMap::requestMap(MWWorld::CellStore* cell, float zMin, float zMax,
+                          const std::vector<MWWorld::CellStore*>& neighbours)
 {
     mInterior = false;
 
@@ -172,10 +397,31 @@ void LocalMap::requestMap(MWWorld::CellStore* cell, float zMin, float zMax)
 
     mCameraPosNode->setPosition(Vector3(0,0,0));
 
-    // Note: using force=true for exterior cell maps.
-    // They must be updated even if they were visited before, because the set of surrounding active cells might be different
-    // (and objects in a different cell can "bleed" into another cell's map if they cross the border)
-    render((x+0.5f)*sSize, (y+0.5f)*sSize, zMin, zMax, static_cast<float>(sSize), static_cast<float>(sSize), name, true);
+    uint64_t hash = Misc::sHashSeed;
+    addHash(hash, mMapResolution);
+    addHash(hash, zMin);
+    addHash(hash, zMax);
+    addHash(hash, getContentHash(cell));
+
+    // Exterior cell maps must be updated even if they were visited before, because the set of surrounding active cells might be different
+    // (and objects in a different cell can "bleed" into another cell's map if they cross the border).
+    // That's why the neighbours are part of the hash.
+    std::vector<std::pair<std::pair<int, int>, uint64_t> > neighbourHashes;
+    for (std::vector<MWWorld::CellStore*>::const_iterator iter (neighbours.begin()); iter!=neighbours.end(); ++iter)
+        neighbourHashes.push_back(std::make_pair(
+            std::make_pair((*iter)->getCell()->getGridX(), (*iter)->getCell()->getGridY()), getContentHash(*iter)));
+
+    std::sort(neighbourHashes.begin(), neighbourHashes.end());
+
+    for (std::vector<std::pair<std::pair<int, int>, uint64_t> >::const_iterator iter (neighbourHashes.begin());
+        iter!=neighbourHashes.end(); ++iter)
+    {
+        addHash(hash, iter->first.first);
+        addHash(hash, iter->first.second);
+        addHash(hash, iter->second);
+    }
+
+    render((x+0.5f)*sSize, (y+0.5f)*sSize, zMin, zMax, static_cast<float>(sSize), static_cast<float>(sSize), name, hash);
 
     if (mBuffers.find(name) == mBuffers.end())
     {
@@ -284,6 +530,17 @@ void LocalMap::requestMap(MWWorld::CellStore* cell,
 
     mInteriorName = cell->getCell()->mName;
 
+    uint64_t cellHash = Misc::sHashSeed;
+    addHash(cellHash, mMapResolution);
+    addHash(cellHash, getContentHash(cell));
+    addHash(cellHash, mAngle);
+    addHash(cellHash, min.x);
+    addHash(cellHash, min.y);
+    addHash(cellHash, max.x);
+    addHash(cellHash, max.y);
+    addHash(cellHash, zMin);
+    addHash(cellHash, zMax);
+
     int i=0;
     for (int x=0; x<segsX; ++x)
     {
@@ -294,7 +551,11 @@ void LocalMap::requestMap(MWWorld::CellStore* cell,
 
             std::string texturePrefix = cell->getCell()->mName + "_" + coordStr(x,y);
 
-            render(newcenter.x - center.x, newcenter.y - center.y, zMin, zMax, static_cast<float>(sSize), static_cast<float>(sSize), texturePrefix);
+            uint64_t hash = cellHash;
+            addHash(hash, x);
+            addHash(hash, y);
+
+            render(newcenter.x - center.x, newcenter.y - center.y, zMin, zMax, static_cast<float>(sSize), static_cast<float>(sSize), texturePrefix, hash);
 
             if (!cell->getFog())
                 createFogOfWar(texturePrefix);
@@ -380,8 +641,33 @@ void LocalMap::loadFogOfWar (const std::string& texturePrefix, ESM::FogTexture&
 
 void LocalMap::render(const float x, const float y,
                     const float zlow, const float zhigh,
-                    const float xw, const float yw, const std::string& texture, bool force)
+                    const float xw, const float yw, const std::string& texture, uint64_t hash)
 {
+    // try loading from memory
+    TexturePtr tex = TextureManager::getSingleton().getByName(texture);
+    if (tex.isNull())
+    {
+        tex = TextureManager::getSingleton().createManual(
+                        texture,
+                        ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                        TEX_TYPE_2D,
+                        mMapResolution, mMapResolution,
+                        0,
+                        PF_R8G8B8);
+    }
+    else
+    {
+        std::map<std::string, uint64_t>::const_iterator iter = mTextureHashes.find(texture);
+        if (iter != mTextureHashes.end() && iter->second == hash)
+            return;
+    }
+
+    mTextureHashes[texture] = hash;
+
+    // try loading from disk
+    if (readCachedMap(texture, hash, tex))
+        return;
+
     mCellCamera->setFarClipDistance( (zhigh-zlow) + 2000 );
     mCellCamera->setNearClipDistance(50);
 
@@ -401,29 +687,9 @@ void LocalMap::render(const float x, const float y,
     mRenderingManager->disableLights(true);
     mLight->setVisible(true);
 
-    TexturePtr tex;
-    // try loading from memory
-    tex = TextureManager::getSingleton().getByName(texture);
-    if (tex.isNull())
-    {
-        // render
-        mRenderTarget->update();
-
-        // create a new texture and blit to it
-        Ogre::TexturePtr tex = TextureManager::getSingleton().createManual(
-                        texture,
-                        ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-                        TEX_TYPE_2D,
-                        mMapResolution, mMapResolution,
-                        0,
-                        PF_R8G8B8);
-        tex->getBuffer()->blit(mRenderTexture->getBuffer());
-    }
-    else if (force)
-    {
-        mRenderTarget->update();
-        tex->getBuffer()->blit(mRenderTexture->getBuffer());
-    }
+    // render and blit to the map texture
+    mRenderTarget->update();
+    tex->getBuffer()->blit(mRenderTexture->getBuffer());
 
     mRenderingManager->enableLights(true);
     mLight->setVisible(false);
@@ -431,6 +697,8 @@ void LocalMap::render(const float x, const float y,
     // re-enable fog
     mRendering->getScene()->setFog(FOG_LINEAR, oldFogColour, 0, oldFogStart, oldFogEnd);
     mRendering->getScene()->setAmbientLight(oldAmbient);
+
+    writeCachedMap(texture, hash, tex);
 }
 
 void LocalMap::worldToInteriorMapPosition (Ogre::Vector2 pos, float& nX, float& nY, int& x, int& y)
@@ -581,29 +849,50 @@ void LocalMap::updatePlayer (const Ogre::Vector3& position, const Ogre::Quaterni
                 if (anIter == mBuffers.end()) return;
 
                 std::vector<Ogre::uint32>& aBuffer = (*anIter).second;
-                int i=0;
-                for (int texV = 0; texV<sFogOfWarResolution; ++texV)
+
+                // only texels within the explore radius can change
+                float centerU = u*(sFogOfWarResolution-1) - mx*(sFogOfWarResolution-1);
+                float centerV = v*(sFogOfWarResolution-1) - my*(sFogOfWarResolution-1);
+                int minU = std::max(0, static_cast<int>(std::floor(centerU - exploreRadius)));
+                int maxU = std::min(sFogOfWarResolution-1, static_cast<int>(std::ceil(centerU + exploreRadius)));
+                int minV = std::max(0, static_cast<int>(std::floor(centerV - exploreRadius)));
+                int maxV = std::min(sFogOfWarResolution-1, static_cast<int>(std::ceil(centerV + exploreRadius)));
+
+                // the rectangle of texels that changed
+                int dirtyLeft = sFogOfWarResolution, dirtyTop = sFogOfWarResolution;
+                int dirtyRight = 0, dirtyBottom = 0;
+
+                for (int texV = minV; texV<=maxV; ++texV)
                 {
-                    for (int texU = 0; texU<sFogOfWarResolution; ++texU)
+                    for (int texU = minU; texU<=maxU; ++texU)
                     {
-                        float sqrDist = Math::Sqr((texU + mx*(sFogOfWarResolution-1)) - u*(sFogOfWarResolution-1))
-                                + Math::Sqr((texV + my*(sFogOfWarResolution-1)) - v*(sFogOfWarResolution-1));
+                        float sqrDist = Math::Sqr(texU - centerU) + Math::Sqr(texV - centerV);
+                        int i = texV * sFogOfWarResolution + texU;
                         uint32 clr = aBuffer[i];
                         uint8 alpha = (clr >> 24);
-                        alpha = std::min( alpha, (uint8) (std::max(0.f, std::min(1.f, (sqrDist/sqrExploreRadius)))*255) );
-                        aBuffer[i] = (uint32) (alpha << 24);
+                        uint8 newAlpha = std::min( alpha, (uint8) (std::max(0.f, std::min(1.f, (sqrDist/sqrExploreRadius)))*255) );
 
-                        ++i;
+                        if (newAlpha != alpha)
+                        {
+                            aBuffer[i] = (uint32) (newAlpha << 24);
+
+                            dirtyLeft = std::min(dirtyLeft, texU);
+                            dirtyRight = std::max(dirtyRight, texU+1);
+                            dirtyTop = std::min(dirtyTop, texV);
+                            dirtyBottom = std::max(dirtyBottom, texV+1);
+                        }
                     }
                 }
 
+                if (dirtyLeft >= dirtyRight)
+                    continue;
+
                 tex->load();
 
-                // copy to the texture
-                // NOTE: Could be optimized later. We actually only need to update the region that changed.
-                // Not a big deal at the moment, the FoW is only 32x32 anyway.
-                memcpy(tex->getBuffer()->lock(HardwareBuffer::HBL_DISCARD), &aBuffer[0], sFogOfWarResolution*sFogOfWarResolution*4);
-                tex->getBuffer()->unlock();
+                // copy the changed region to the texture
+                Ogre::Box dirty(dirtyLeft, dirtyTop, dirtyRight, dirtyBottom);
+                Ogre::PixelBox pixels(sFogOfWarResolution, sFogOfWarResolution, 1, PF_A8R8G8B8, &aBuffer[0]);
+                tex->getBuffer()->blitFromMemory(pixels.getSubVolume(dirty), dirty);
             }
         }
     }
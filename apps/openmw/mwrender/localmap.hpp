@@ -1,6 +1,15 @@
 #ifndef GAME_RENDER_LOCALMAP_H
 #define GAME_RENDER_LOCALMAP_H
 
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include <openengine/ogre/renderer.hpp>
 
 #include <OgreAxisAlignedBox.h>
@@ -17,6 +26,11 @@ namespace ESM
     struct FogTexture;
 }
 
+namespace Misc
+{
+    class ThreadPool;
+}
+
 namespace MWRender
 {
     class RenderingManager;
@@ -27,7 +41,9 @@ namespace MWRender
     class LocalMap : public Ogre::ManualResourceLoader
     {
     public:
-        LocalMap(OEngine::Render::OgreRenderer*, MWRender::RenderingManager* rendering);
+        /// @param cacheDir Directory for the disk cache of rendered map segments (empty: no cache)
+        LocalMap(OEngine::Render::OgreRenderer*, MWRender::RenderingManager* rendering,
+                 const boost::filesystem::path& cacheDir);
         ~LocalMap();
 
         virtual void loadResource(Ogre::Resource* resource);
@@ -44,8 +60,10 @@ namespace MWRender
          * @param cell exterior cell
          * @param zMin min height of objects or terrain in cell
          * @param zMax max height of objects or terrain in cell
+         * @param neighbours active cells around \a cell, whose objects can reach into its map
          */
-        void requestMap (MWWorld::CellStore* cell, float zMin, float zMax);
+        void requestMap (MWWorld::CellStore* cell, float zMin, float zMax,
+                         const std::vector<MWWorld::CellStore*>& neighbours);
 
         /**
          * Request the local map for an interior cell.
@@ -109,11 +127,28 @@ namespace MWRender
         float mAngle;
         const Ogre::Vector2 rotatePoint(const Ogre::Vector2& p, const Ogre::Vector2& c, const float angle);
 
-        /// @param force Always render, even if we already have a cached map
+        /// Render a map segment into \a texture, unless it already shows content with the same hash,
+        /// or a map with that hash is found in the disk cache.
+        /// @param hash identifies the content of the segment, see getContentHash
         void render(const float x, const float y,
                     const float zlow, const float zhigh,
                     const float xw, const float yw,
-                    const std::string& texture, bool force=false);
+                    const std::string& texture, uint64_t hash);
+
+        /// Hash of everything in \a cell that shows up on the map (objects and terrain, not actors)
+        uint64_t getContentHash(MWWorld::CellStore* cell);
+
+        boost::filesystem::path getCacheFile(const std::string& texture) const;
+
+        bool readCachedMap(const std::string& texture, uint64_t hash, Ogre::TexturePtr tex);
+
+        /// Queue the map in \a tex to be written to the disk cache in the background, unless the
+        /// cache has it already.
+        void writeCachedMap(const std::string& texture, uint64_t hash, Ogre::TexturePtr tex);
+
+        /// @note Runs on the cache writer thread
+        static void writeCache(const boost::filesystem::path& file, const std::string& texture, uint64_t hash,
+                               boost::shared_ptr<const std::vector<char> > data);
 
         // Creates a fog of war texture and initializes it to full black
         void createFogOfWar(const std::string& texturePrefix);
@@ -129,6 +164,15 @@ namespace MWRender
         // Both interior and exterior maps are possibly divided into multiple textures.
         std::map <std::string, std::vector<Ogre::uint32> > mBuffers;
 
+        // The content hash of the map each map texture shows
+        std::map <std::string, uint64_t> mTextureHashes;
+
+        // The content hash of the map in the disk cache file of each map texture, as far as known
+        std::map <std::string, uint64_t> mCachedHashes;
+
+        boost::filesystem::path mCacheDir;
+        boost::scoped_ptr<Misc::ThreadPool> mCacheWriter;
+
         // The render texture we will use to create the map images
         Ogre::TexturePtr mRenderTexture;
         Ogre::RenderTarget* mRenderTarget;
@@ -635,7 +635,8 @@ Ogre::Vector3 NpcAnimation::runAnimation(float timepassed)
 
     mHeadAnimationTime->update(timepassed);
 
-    if (mSkelBase)
+    // The adjustments below are relative to the pose of the animation
+    if (mSkelBase && mBonesUpdated)
     {
         Ogre::SkeletonInstance *baseinst = mSkelBase->getSkeleton();
         if(mViewMode == VM_FirstPerson)
@@ -668,7 +669,7 @@ Ogre::Vector3 NpcAnimation::runAnimation(float timepassed)
         for(;ctrl != mObjectParts[i]->mControllers.end();++ctrl)
             ctrl->update();
 
-        if (!isSkinned(mObjectParts[i]))
+        if (!isSkinned(mObjectParts[i]) || !mBonesUpdated)
             continue;
 
         if (mSkelBase)
@@ -1,6 +1,9 @@
 #include "objects.hpp"
 
 #include <cmath>
+#include <algorithm>
+
+#include <boost/bind.hpp>
 
 #include <OgreSceneNode.h>
 #include <OgreSceneManager.h>
@@ -9,13 +12,13 @@
 #include <OgreSubEntity.h>
 #include <OgreParticleSystem.h>
 #include <OgreParticleEmitter.h>
-#include <OgreStaticGeometry.h>
 
 #include <components/esm/loadligh.hpp>
 #include <components/esm/loadstat.hpp>
 
 #include <components/nifogre/ogrenifloader.hpp>
 #include <components/settings/settings.hpp>
+#include <components/misc/threadpool.hpp>
 
 #include "../mwworld/ptr.hpp"
 #include "../mwworld/class.hpp"
@@ -23,10 +26,33 @@
 
 #include "renderconst.hpp"
 #include "animation.hpp"
+#include "cellbatch.hpp"
 
 using namespace MWRender;
 
-int Objects::uniqueID = 0;
+Objects::Objects(OEngine::Render::OgreRenderer &renderer, const boost::filesystem::path& cacheDir)
+    : mRenderer(renderer)
+    , mRootNode(NULL)
+    , mCacheDir(cacheDir)
+{
+    if (!mCacheDir.empty())
+    {
+        mCacheWriter.reset(new Misc::ThreadPool(1));
+
+        uint64_t maxSize = static_cast<uint64_t>(
+            std::max(0, Settings::Manager::getInt("static geometry cache size", "General"))) * 1024 * 1024;
+        mCacheWriter->push(boost::bind(&CellBatch::pruneCache, mCacheDir, maxSize));
+    }
+}
+
+Objects::~Objects()
+{
+    for (std::map<MWWorld::CellStore *, CellBatch*>::iterator it = mStaticGeometry.begin(); it != mStaticGeometry.end(); ++it)
+        delete it->second;
+
+    for (std::map<MWWorld::CellStore *, CellBatch*>::iterator it = mStaticGeometrySmall.begin(); it != mStaticGeometrySmall.end(); ++it)
+        delete it->second;
+}
 
 void Objects::setRootNode(Ogre::SceneNode* root)
 {
@@ -100,14 +126,13 @@ void Objects::insertModel(const MWWorld::Ptr &ptr, const std::string &mesh, bool
            Settings::Manager::getBool("use static geometry", "Objects") &&
            anim->canBatch())
         {
-            Ogre::StaticGeometry* sg = 0;
+            CellBatch* sg = 0;
 
             if (small)
             {
                 if(mStaticGeometrySmall.find(ptr.getCell()) == mStaticGeometrySmall.end())
                 {
-                    uniqueID = uniqueID+1;
-                    sg = mRenderer.getScene()->createStaticGeometry("sg" + Ogre::StringConverter::toString(uniqueID));
+                    sg = new CellBatch(mRenderer.getScene(), mCacheDir, mCacheWriter.get());
                     sg->setOrigin(ptr.getRefData().getBaseNode()->getPosition());
                     mStaticGeometrySmall[ptr.getCell()] = sg;
 
@@ -120,8 +145,7 @@ void Objects::insertModel(const MWWorld::Ptr &ptr, const std::string &mesh, bool
             {
                 if(mStaticGeometry.find(ptr.getCell()) == mStaticGeometry.end())
                 {
-                    uniqueID = uniqueID+1;
-                    sg = mRenderer.getScene()->createStaticGeometry("sg" + Ogre::StringConverter::toString(uniqueID));
+                    sg = new CellBatch(mRenderer.getScene(), mCacheDir, mCacheWriter.get());
                     sg->setOrigin(ptr.getRefData().getBaseNode()->getPosition());
                     mStaticGeometry[ptr.getCell()] = sg;
                 }
@@ -148,8 +172,8 @@ void Objects::insertModel(const MWWorld::Ptr &ptr, const std::string &mesh, bool
 
             anim->fillBatch(sg);
             /* TODO: We could hold on to this and just detach it from the scene graph, so if the Ptr
-             * ever needs to modify we can reattach it and rebuild the StaticGeometry object without
-             * it. Would require associating the Ptr with the StaticGeometry. */
+             * ever needs to modify we can reattach it and rebuild the CellBatch without
+             * it. Would require associating the Ptr with the CellBatch. */
             anim.reset();
         }
     }
@@ -191,20 +215,20 @@ void Objects::removeCell(MWWorld::CellStore* store)
             ++iter;
     }
 
-    std::map<MWWorld::CellStore*,Ogre::StaticGeometry*>::iterator geom = mStaticGeometry.find(store);
+    std::map<MWWorld::CellStore*,CellBatch*>::iterator geom = mStaticGeometry.find(store);
     if(geom != mStaticGeometry.end())
     {
-        Ogre::StaticGeometry *sg = geom->second;
+        CellBatch *sg = geom->second;
         mStaticGeometry.erase(geom);
-        mRenderer.getScene()->destroyStaticGeometry(sg);
+        delete sg;
     }
 
     geom = mStaticGeometrySmall.find(store);
     if(geom != mStaticGeometrySmall.end())
     {
-        Ogre::StaticGeometry *sg = geom->second;
+        CellBatch *sg = geom->second;
         mStaticGeometrySmall.erase(store);
-        mRenderer.getScene()->destroyStaticGeometry(sg);
+        delete sg;
     }
 
     mBounds.erase(store);
@@ -222,12 +246,12 @@ void Objects::buildStaticGeometry(MWWorld::CellStore& cell)
 {
     if(mStaticGeometry.find(&cell) != mStaticGeometry.end())
     {
-        Ogre::StaticGeometry* sg = mStaticGeometry[&cell];
+        CellBatch* sg = mStaticGeometry[&cell];
         sg->build();
     }
     if(mStaticGeometrySmall.find(&cell) != mStaticGeometrySmall.end())
     {
-        Ogre::StaticGeometry* sg = mStaticGeometrySmall[&cell];
+        CellBatch* sg = mStaticGeometrySmall[&cell];
         sg->build();
     }
 }
@@ -251,13 +275,13 @@ void Objects::update(float dt, Ogre::Camera* camera)
 
 void Objects::rebuildStaticGeometry()
 {
-    for (std::map<MWWorld::CellStore *, Ogre::StaticGeometry*>::iterator it = mStaticGeometry.begin(); it != mStaticGeometry.end(); ++it)
+    for (std::map<MWWorld::CellStore *, CellBatch*>::iterator it = mStaticGeometry.begin(); it != mStaticGeometry.end(); ++it)
     {
         it->second->destroy();
         it->second->build();
     }
 
-    for (std::map<MWWorld::CellStore *, Ogre::StaticGeometry*>::iterator it = mStaticGeometrySmall.begin(); it != mStaticGeometrySmall.end(); ++it)
+    for (std::map<MWWorld::CellStore *, CellBatch*>::iterator it = mStaticGeometrySmall.begin(); it != mStaticGeometrySmall.end(); ++it)
     {
         it->second->destroy();
         it->second->build();
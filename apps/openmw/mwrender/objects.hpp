@@ -4,6 +4,9 @@
 #include <OgreColourValue.h>
 #include <OgreAxisAlignedBox.h>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/filesystem/path.hpp>
+
 #include <openengine/ogre/renderer.hpp>
 
 namespace MWWorld
@@ -12,9 +15,15 @@ namespace MWWorld
     class CellStore;
 }
 
+namespace Misc
+{
+    class ThreadPool;
+}
+
 namespace MWRender{
 
 class ObjectAnimation;
+class CellBatch;
 
 class Objects{
     typedef std::map<MWWorld::Ptr,ObjectAnimation*> PtrAnimationMap;
@@ -22,25 +31,24 @@ class Objects{
     OEngine::Render::OgreRenderer &mRenderer;
 
     std::map<MWWorld::CellStore*,Ogre::SceneNode*> mCellSceneNodes;
-    std::map<MWWorld::CellStore*,Ogre::StaticGeometry*> mStaticGeometry;
-    std::map<MWWorld::CellStore*,Ogre::StaticGeometry*> mStaticGeometrySmall;
+    std::map<MWWorld::CellStore*,CellBatch*> mStaticGeometry;
+    std::map<MWWorld::CellStore*,CellBatch*> mStaticGeometrySmall;
     std::map<MWWorld::CellStore*,Ogre::AxisAlignedBox> mBounds;
     PtrAnimationMap mObjects;
 
     Ogre::SceneNode* mRootNode;
 
-    static int uniqueID;
+    boost::filesystem::path mCacheDir;
+    boost::scoped_ptr<Misc::ThreadPool> mCacheWriter;
 
     void insertBegin(const MWWorld::Ptr& ptr);
 
 
 
 public:
-    Objects(OEngine::Render::OgreRenderer &renderer)
-        : mRenderer(renderer)
-        , mRootNode(NULL)
-    {}
-    ~Objects(){}
+    /// @param cacheDir Directory for the disk cache of static geometry (empty: no cache)
+    Objects(OEngine::Render::OgreRenderer &renderer, const boost::filesystem::path& cacheDir = boost::filesystem::path());
+    ~Objects();
     void insertModel(const MWWorld::Ptr& ptr, const std::string &model, bool batch=false);
 
     ObjectAnimation* getAnimation(const MWWorld::Ptr &ptr);
@@ -1,6 +1,7 @@
 #include "renderingmanager.hpp"
 
 #include <cassert>
+#include <cstdlib>
 
 #include <OgreRoot.h>
 #include <OgreRenderWindow.h>
@@ -67,7 +68,8 @@ RenderingManager::RenderingManager(OEngine::Render::OgreRenderer& _rend, const b
     , mRenderWorld(true)
 {
     mActors = new MWRender::Actors(mRendering, this);
-    mObjects = new MWRender::Objects(mRendering);
+    mObjects = new MWRender::Objects(mRendering,
+        Settings::Manager::getBool("static geometry cache", "General") ? cacheDir / "statics" : boost::filesystem::path());
     mEffectManager = new EffectManager(mRendering.getScene());
     // select best shader mode
     bool openGL = (Ogre::Root::getSingleton ().getRenderSystem ()->getName().find("OpenGL") != std::string::npos);
@@ -171,10 +173,14 @@ RenderingManager::RenderingManager(OEngine::Render::OgreRenderer& _rend, const b
     mSun = 0;
 
     mDebugging = new Debugging(mRootNode, engine);
-    mLocalMap = new MWRender::LocalMap(&mRendering, this);
+    mLocalMap = new MWRender::LocalMap(&mRendering, this,
+        Settings::Manager::getBool("local map cache", "General") ? cacheDir / "maps" : boost::filesystem::path());
 
     mWater = new MWRender::Water(mRendering.getCamera(), this, mFallback);
 
+    if (Settings::Manager::getBool("terrain cache", "General"))
+        mTerrainCacheDir = cacheDir / "terrain";
+
     setMenuTransparency(Settings::Manager::getFloat("menu transparency", "GUI"));
 }
 
@@ -655,7 +661,7 @@ void RenderingManager::updateTerrain()
     }
 }
 
-void RenderingManager::requestMap(MWWorld::CellStore* cell)
+void RenderingManager::requestMap(MWWorld::CellStore* cell, const std::set<MWWorld::CellStore*>& activeCells)
 {
     if (cell->getCell()->isExterior())
     {
@@ -665,7 +671,14 @@ void RenderingManager::requestMap(MWWorld::CellStore* cell)
         Ogre::Vector2 center (cell->getCell()->getGridX() + 0.5f, cell->getCell()->getGridY() + 0.5f);
         dims.merge(mTerrain->getWorldBoundingBox(center));
 
-        mLocalMap->requestMap(cell, dims.getMinimum().z, dims.getMaximum().z);
+        std::vector<MWWorld::CellStore*> neighbours;
+        for (std::set<MWWorld::CellStore*>::const_iterator iter (activeCells.begin()); iter!=activeCells.end(); ++iter)
+            if (*iter != cell && (*iter)->getCell()->isExterior() &&
+                std::abs((*iter)->getCell()->getGridX() - cell->getCell()->getGridX()) <= 1 &&
+                std::abs((*iter)->getCell()->getGridY() - cell->getCell()->getGridY()) <= 1)
+                neighbours.push_back(*iter);
+
+        mLocalMap->requestMap(cell, dims.getMinimum().z, dims.getMaximum().z, neighbours);
     }
     else
         mLocalMap->requestMap(cell, mObjects->getDimensions(cell));
@@ -1038,10 +1051,10 @@ void RenderingManager::enableTerrain(bool enable)
         if (!mTerrain)
         {
             if (Settings::Manager::getBool("distant land", "Terrain"))
-                mTerrain = new Terrain::DefaultWorld(mRendering.getScene(), new MWRender::TerrainStorage(true), RV_Terrain,
+                mTerrain = new Terrain::DefaultWorld(mRendering.getScene(), new MWRender::TerrainStorage(true, mTerrainCacheDir), RV_Terrain,
                                                 Settings::Manager::getBool("shader", "Terrain"), Terrain::Align_XY, 1, 64);
             else
-                mTerrain = new Terrain::TerrainGrid(mRendering.getScene(), new MWRender::TerrainStorage(false), RV_Terrain,
+                mTerrain = new Terrain::TerrainGrid(mRendering.getScene(), new MWRender::TerrainStorage(false, mTerrainCacheDir), RV_Terrain,
                                                 Settings::Manager::getBool("shader", "Terrain"), Terrain::Align_XY);
             mTerrain->applyMaterials(Settings::Manager::getBool("enabled", "Shadows"),
                                      Settings::Manager::getBool("split", "Shadows"));
@@ -4,6 +4,8 @@
 #include "sky.hpp"
 #include "debugging.hpp"
 
+#include <set>
+
 #include <components/settings/settings.hpp>
 
 #include <boost/filesystem.hpp>
@@ -179,8 +181,9 @@ public:
     ///< update the terrain according to the player position. Usually done automatically, but should be done manually
     /// before calling requestMap
 
-    void requestMap (MWWorld::CellStore* cell);
+    void requestMap (MWWorld::CellStore* cell, const std::set<MWWorld::CellStore*>& activeCells);
     ///< request the local map for a cell
+    /// \param activeCells the active cells, whose objects can reach into the map of \a cell
 
     /// configure fog according to cell
     void configureFog(const MWWorld::CellStore &mCell);
@@ -234,6 +237,7 @@ private:
     OcclusionQuery* mOcclusionQuery;
 
     Terrain::World* mTerrain;
+    boost::filesystem::path mTerrainCacheDir;
 
     MWRender::Water *mWater;
 
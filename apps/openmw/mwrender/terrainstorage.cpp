@@ -1,6 +1,13 @@
 #include "terrainstorage.hpp"
 
+#include <algorithm>
+#include <set>
+
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <components/misc/hash.hpp>
+#include <components/settings/settings.hpp>
 
 #include "../mwbase/world.hpp"
 #include "../mwbase/environment.hpp"
@@ -9,7 +16,7 @@
 namespace MWRender
 {
 
-    TerrainStorage::TerrainStorage(bool preload)
+    TerrainStorage::TerrainStorage(bool preload, const boost::filesystem::path& cacheDir)
     {
         if (preload)
         {
@@ -23,6 +30,60 @@ namespace MWRender
                 land->loadData(ESM::Land::DATA_VCLR|ESM::Land::DATA_VHGT|ESM::Land::DATA_VNML|ESM::Land::DATA_VTEX);
             }
         }
+
+        if (!cacheDir.empty())
+        {
+            uint64_t maxSize = static_cast<uint64_t>(
+                std::max(0, Settings::Manager::getInt("terrain cache size", "General"))) * 1024 * 1024;
+            setCache(cacheDir, getCacheKey(), maxSize);
+        }
+    }
+
+    uint64_t TerrainStorage::getCacheKey()
+    {
+        const MWWorld::ESMStore &esmStore =
+            MWBase::Environment::get().getWorld()->getStore();
+
+        uint64_t hash = Misc::sHashSeed;
+
+        // Same as the global map cache: the land records are identified by their place in the
+        // content files, so that their texture data doesn't need to be read.
+        std::set<std::string> files;
+
+        const MWWorld::Store<ESM::Land>& lands = esmStore.get<ESM::Land>();
+        for (MWWorld::Store<ESM::Land>::iterator it = lands.begin(); it != lands.end(); ++it)
+        {
+            Misc::addHash(hash, it->mX);
+            Misc::addHash(hash, it->mY);
+            Misc::addHash(hash, it->mPlugin);
+            Misc::addHash(hash, it->mDataTypes);
+            Misc::addHash(hash, it->mContext.filename);
+            Misc::addHash(hash, static_cast<uint64_t>(it->mContext.filePos));
+
+            files.insert(it->mContext.filename);
+        }
+
+        for (std::set<std::string>::const_iterator it = files.begin(); it != files.end(); ++it)
+        {
+            boost::system::error_code error;
+            Misc::addHash(hash, static_cast<uint64_t>(boost::filesystem::file_size(*it, error)));
+            Misc::addHash(hash, static_cast<uint64_t>(boost::filesystem::last_write_time(*it, error)));
+        }
+
+        const MWWorld::Store<ESM::LandTexture>& textures = esmStore.get<ESM::LandTexture>();
+        for (size_t plugin = 0; plugin < textures.getSize(); ++plugin)
+        {
+            Misc::addHash(hash, static_cast<uint64_t>(textures.getSize(plugin)));
+
+            for (size_t index = 0; index < textures.getSize(plugin); ++index)
+            {
+                const ESM::LandTexture* texture = textures.search(index, plugin);
+                Misc::addHash(hash, texture->mIndex);
+                Misc::addHash(hash, texture->mTexture);
+            }
+        }
+
+        return hash;
     }
 
     void TerrainStorage::getBounds(float& minX, float& maxX, float& minY, float& maxY)
@@ -1,6 +1,8 @@
 #ifndef MWRENDER_TERRAINSTORAGE_H
 #define MWRENDER_TERRAINSTORAGE_H
 
+#include <boost/filesystem/path.hpp>
+
 #include <components/esmterrain/storage.hpp>
 
 namespace MWRender
@@ -12,11 +14,15 @@ namespace MWRender
     private:
         virtual ESM::Land* getLand (int cellX, int cellY);
         virtual const ESM::LandTexture* getLandTexture(int index, short plugin);
+
+        /// Identifies the land and land texture records, which the blendmaps are created from
+        uint64_t getCacheKey();
     public:
 
         ///@param preload Preload all Land records at startup? If using the multithreaded terrain component, this
         /// should be set to "true" in order to avoid race conditions.
-        TerrainStorage(bool preload);
+        ///@param cacheDir If not empty, blendmaps and composite maps are kept in this directory
+        TerrainStorage(bool preload, const boost::filesystem::path& cacheDir = boost::filesystem::path());
 
         /// Get bounds of the whole terrain in cell units
         virtual void getBounds(float& minX, float& maxX, float& minY, float& maxY);
@@ -5,11 +5,17 @@
 #include <iostream>
 #include <sstream>
 #include <exception>
+#include <stdexcept>
 #include <algorithm>
 
+#include <components/esm/cachefile.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+
 #include <components/esm/loadscpt.hpp>
 
 #include <components/misc/stringops.hpp>
+#include <components/misc/hash.hpp>
 
 #include <components/compiler/scanner.hpp>
 #include <components/compiler/context.hpp>
@@ -20,6 +26,17 @@
 
 #include "extensions.hpp"
 
+namespace
+{
+    /// Increase when the layout of the cache or the bytecode changes
+    const int sCacheFormat = 1;
+
+    const uint32_t sScriptRecord = ESM::FourCC<'C','S','C','R'>::value;
+
+    const char sLocalTypes[] = { 's', 'l', 'f' };
+    const char *sLocalRecords[] = { "LOCS", "LOCL", "LOCF" };
+}
+
 namespace MWScript
 {
     ScriptManager::ScriptManager (const MWWorld::ESMStore& store, bool verbose,
@@ -27,7 +44,7 @@ namespace MWScript
         const std::vector<std::string>& scriptBlacklist)
     : mErrorHandler (std::cerr), mStore (store), mVerbose (verbose),
       mCompilerContext (compilerContext), mParser (mErrorHandler, mCompilerContext),
-      mOpcodesInstalled (false), mGlobalScripts (store)
+      mOpcodesInstalled (false), mGlobalScripts (store), mCacheChanged (false)
     {
         mErrorHandler.setWarningsMode (warningsMode);
 
@@ -38,6 +55,120 @@ namespace MWScript
         std::sort (mScriptBlacklist.begin(), mScriptBlacklist.end());
     }
 
+    ScriptManager::~ScriptManager()
+    {
+        if (mCacheChanged)
+            writeCache();
+    }
+
+    void ScriptManager::enableCache (const boost::filesystem::path& file, const std::string& key)
+    {
+        mCacheFile = file;
+        mCacheKey = key;
+        mCache.clear();
+
+        readCache();
+    }
+
+    void ScriptManager::readCache()
+    {
+        try
+        {
+            ESM::ESMReader reader;
+
+            if (!ESM::openCacheFile (reader, mCacheFile, sCacheFormat) ||
+                reader.getHNString ("KEYS")!=mCacheKey)
+                return;
+
+            while (reader.hasMoreRecs())
+            {
+                if (reader.getRecName().val!=sScriptRecord)
+                    throw std::runtime_error ("unexpected record");
+
+                reader.getRecHeader();
+
+                std::string id = reader.getHNString ("NAME");
+
+                CachedScript& cached = mCache[id];
+                reader.getHNT (cached.mHash, "HASH");
+
+                for (int i=0; i<3; ++i)
+                    while (reader.isNextSub (sLocalRecords[i]))
+                        cached.mScript.second.declare (sLocalTypes[i], reader.getHString());
+
+                reader.getSubNameIs ("CODE");
+                reader.getSubHeader();
+
+                std::vector<Interpreter::Type_Code>& code = cached.mScript.first;
+                code.resize (reader.getSubSize() / sizeof (Interpreter::Type_Code));
+
+                if (!code.empty())
+                    reader.getExact (&code[0], code.size() * sizeof (Interpreter::Type_Code));
+            }
+
+            if (mVerbose)
+                std::cout << "loaded " << mCache.size() << " compiled scripts from " << mCacheFile.string()
+                    << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Ignoring script cache " << mCacheFile.string() << ": " << e.what() << std::endl;
+            mCache.clear();
+        }
+    }
+
+    void ScriptManager::writeCache()
+    {
+        try
+        {
+            // ESMWriter seeks back for every record size, which is a lot faster in memory
+            std::stringstream buffer;
+
+            ESM::ESMWriter writer;
+            ESM::startCacheFile (writer, buffer, sCacheFormat);
+            writer.writeHNString ("KEYS", mCacheKey);
+            writer.endRecord (ESM::sCacheKeyRecord);
+
+            for (ScriptCache::const_iterator iter (mCache.begin()); iter!=mCache.end(); ++iter)
+            {
+                writer.startRecord (sScriptRecord);
+                writer.writeHNString ("NAME", iter->first);
+                writer.writeHNT ("HASH", iter->second.mHash);
+
+                const Compiler::Locals& locals = iter->second.mScript.second;
+
+                for (int i=0; i<3; ++i)
+                {
+                    const std::vector<std::string>& names = locals.get (sLocalTypes[i]);
+
+                    for (std::vector<std::string>::const_iterator local (names.begin());
+                        local!=names.end(); ++local)
+                        writer.writeHNString (sLocalRecords[i], *local);
+                }
+
+                const std::vector<Interpreter::Type_Code>& code = iter->second.mScript.first;
+
+                writer.startSubRecord ("CODE");
+                if (!code.empty())
+                    writer.write (reinterpret_cast<const char *> (&code[0]),
+                        code.size() * sizeof (Interpreter::Type_Code));
+                writer.endRecord ("CODE");
+
+                writer.endRecord (sScriptRecord);
+            }
+
+            writer.close();
+
+            ESM::saveCacheFile (mCacheFile, buffer.str());
+
+            mCacheChanged = false;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write script cache " << mCacheFile.string() << ": " << e.what() << std::endl;
+        }
+    }
+
     bool ScriptManager::compile (const std::string& name)
     {
         mParser.reset();
@@ -45,6 +176,22 @@ namespace MWScript
 
         if (const ESM::Script *script = mStore.get<ESM::Script>().find (name))
         {
+            std::string id = Misc::StringUtils::lowerCase (name);
+            uint64_t hash = 0;
+
+            if (!mCacheFile.empty())
+            {
+                hash = Misc::getHash (script->mScriptText.data(), script->mScriptText.size());
+
+                ScriptCache::const_iterator iter = mCache.find (id);
+
+                if (iter!=mCache.end() && iter->second.mHash==hash)
+                {
+                    mScripts.insert (std::make_pair (name, iter->second.mScript));
+                    return true;
+                }
+            }
+
             if (mVerbose)
                 std::cout << "compiling script: " << name << std::endl;
 
@@ -85,6 +232,14 @@ namespace MWScript
                 mParser.getCode (code);
                 mScripts.insert (std::make_pair (name, std::make_pair (code, mParser.getLocals())));
 
+                if (!mCacheFile.empty())
+                {
+                    CachedScript& cached = mCache[id];
+                    cached.mHash = hash;
+                    cached.mScript = std::make_pair (code, mParser.getLocals());
+                    mCacheChanged = true;
+                }
+
                 return true;
             }
         }
@@ -150,6 +305,9 @@ namespace MWScript
                     ++success;
             }
 
+        if (mCacheChanged)
+            writeCache();
+
         return std::make_pair (count, success);
     }
 
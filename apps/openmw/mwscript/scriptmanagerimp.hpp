@@ -4,6 +4,10 @@
 #include <map>
 #include <string>
 
+#include <stdint.h>
+
+#include <boost/filesystem/path.hpp>
+
 #include <components/compiler/streamerrorhandler.hpp>
 #include <components/compiler/fileparser.hpp>
 
@@ -45,17 +49,43 @@ namespace MWScript
             typedef std::pair<std::vector<Interpreter::Type_Code>, Compiler::Locals> CompiledScript;
             typedef std::map<std::string, CompiledScript> ScriptCollection;
 
+            struct CachedScript
+            {
+                uint64_t mHash; // of the script text
+                CompiledScript mScript;
+            };
+
+            typedef std::map<std::string, CachedScript> ScriptCache;
+
             ScriptCollection mScripts;
             GlobalScripts mGlobalScripts;
             std::map<std::string, Compiler::Locals> mOtherLocals;
             std::vector<std::string> mScriptBlacklist;
 
+            boost::filesystem::path mCacheFile;
+            std::string mCacheKey;
+            ScriptCache mCache; // indexed by lower case script id
+            bool mCacheChanged;
+
+            void readCache();
+
+            void writeCache();
+
         public:
 
             ScriptManager (const MWWorld::ESMStore& store, bool verbose,
                 Compiler::Context& compilerContext, int warningsMode,
                 const std::vector<std::string>& scriptBlacklist);
 
+            virtual ~ScriptManager();
+            ///< Writes newly compiled scripts to the cache.
+
+            void enableCache (const boost::filesystem::path& file, const std::string& key);
+            ///< Keep compiled scripts in \a file, so that they don't need to be compiled again on
+            /// the next start. \a key must identify everything besides the script text that the
+            /// compiled code depends on (the engine version and the content files); the cache is
+            /// discarded when it changes.
+
             virtual void run (const std::string& name, Interpreter::Context& interpreterContext);
             ///< Run the script with the given name (compile first, if not compiled yet)
 
@@ -0,0 +1,291 @@
+#include "cellpreloader.hpp"
+
+#include <algorithm>
+
+#include <OgreTimer.h>
+#include <OgreVector3.h>
+
+#include <components/nifcache/nifcache.hpp>
+#include <components/misc/resourcehelpers.hpp>
+#include <components/settings/settings.hpp>
+
+#include "../mwbase/environment.hpp"
+#include "../mwbase/world.hpp"
+
+#include "physicssystem.hpp"
+#include "esmstore.hpp"
+#include "class.hpp"
+#include "cellstore.hpp"
+
+namespace
+{
+    /// References handled by one step
+    const size_t sReferencesPerStep = 32;
+
+    /// Queue the models of some references of a cell for loading in the background and list the
+    /// collision shapes that Scene::insertCell is going to need.
+    struct ModelFunctor
+    {
+        std::vector<std::pair<std::string, float> >& mShapes;
+        size_t mFirst;
+        size_t mIndex;
+
+        /// \param first Index of the first reference to handle
+        ModelFunctor (std::vector<std::pair<std::string, float> >& shapes, size_t first)
+        : mShapes (shapes), mFirst (first), mIndex (0)
+        {}
+
+        bool operator() (const MWWorld::Ptr& ptr)
+        {
+            size_t index = mIndex++;
+
+            if (index<mFirst)
+                return true;
+
+            if (index>=mFirst+sReferencesPerStep)
+                return false;
+
+            if (ptr.getRefData().isDeleted() || !ptr.getRefData().isEnabled())
+                return true;
+
+            std::string model =
+                Misc::ResourceHelpers::correctActorModelPath (ptr.getClass().getModel (ptr));
+
+            if (model.empty())
+                return true;
+
+            Nif::Cache::getInstance().loadInBackground (model);
+
+            if (!ptr.getClass().isActor())
+            {
+                // same as the rescaling in Scene::insertCell
+                float scale = std::max (0.5f, std::min (2.0f, ptr.getCellRef().getScale()));
+                mShapes.push_back (std::make_pair (model, scale));
+            }
+
+            return true;
+        }
+    };
+
+    int clampStep (int step)
+    {
+        return std::max (-1, std::min (1, step));
+    }
+
+    bool isActive (int x, int y, const std::set<MWWorld::CellStore *>& activeCells)
+    {
+        for (std::set<MWWorld::CellStore *>::const_iterator iter (activeCells.begin());
+            iter!=activeCells.end(); ++iter)
+            if ((*iter)->getCell()->isExterior() &&
+                (*iter)->getCell()->getGridX()==x && (*iter)->getCell()->getGridY()==y)
+                return true;
+
+        return false;
+    }
+}
+
+namespace MWWorld
+{
+    CellPreloader::CellPreloader (PhysicsSystem& physics)
+    : mPhysics (physics), mTimePerFrame (Settings::Manager::getFloat ("preload time per frame", "Cells")),
+      mPredictionTime (Settings::Manager::getFloat ("preload prediction time", "Cells")),
+      mHalfGridSize (Settings::Manager::getInt ("exterior grid size", "Cells")/2),
+      mTargetX (0), mTargetY (0), mHasTarget (false)
+    {}
+
+    void CellPreloader::setTarget (int x, int y, const std::set<CellStore *>& activeCells)
+    {
+        if (mHasTarget && x==mTargetX && y==mTargetY)
+            return;
+
+        mTargetX = x;
+        mTargetY = y;
+        mHasTarget = true;
+
+        std::vector<Job> jobs;
+
+        for (int cellX=x-mHalfGridSize; cellX<=x+mHalfGridSize; ++cellX)
+            for (int cellY=y-mHalfGridSize; cellY<=y+mHalfGridSize; ++cellY)
+            {
+                if (isActive (cellX, cellY, activeCells))
+                    continue;
+
+                // keep the progress on cells that are still in the grid
+                std::vector<Job>::iterator iter = mJobs.begin();
+
+                for (; iter!=mJobs.end(); ++iter)
+                    if (iter->mX==cellX && iter->mY==cellY)
+                        break;
+
+                if (iter!=mJobs.end())
+                {
+                    jobs.push_back (*iter);
+                    mJobs.erase (iter);
+                }
+                else
+                    jobs.push_back (Job (cellX, cellY));
+            }
+
+        // cells that left the grid without becoming active
+        for (std::vector<Job>::iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+            if (!isActive (iter->mX, iter->mY, activeCells))
+                unloadLand (*iter);
+
+        mJobs.swap (jobs);
+    }
+
+    void CellPreloader::unloadLand (const Job& job)
+    {
+        if (!job.mLoadedLand)
+            return;
+
+        if (ESM::Land *land =
+            MWBase::Environment::get().getWorld()->getStore().get<ESM::Land>().search (job.mX, job.mY))
+            land->unloadData();
+    }
+
+    bool CellPreloader::runStep (Job& job)
+    {
+        MWBase::World *world = MWBase::Environment::get().getWorld();
+
+        switch (job.mStep)
+        {
+            case Step_References:
+
+                if (world->preloadExterior (job.mX, job.mY, sReferencesPerStep))
+                    job.mStep = Step_Models;
+
+                break;
+
+            case Step_Models:
+            {
+                ModelFunctor functor (job.mShapes, job.mNextReference);
+
+                if (world->getExterior (job.mX, job.mY)->forEachUnchanged (functor))
+                {
+                    std::sort (job.mShapes.begin(), job.mShapes.end());
+                    job.mShapes.erase (std::unique (job.mShapes.begin(), job.mShapes.end()), job.mShapes.end());
+
+                    job.mStep = Step_Land;
+                }
+                else
+                    job.mNextReference += sReferencesPerStep;
+
+                break;
+            }
+
+            case Step_Land:
+            {
+                ESM::Land* land = world->getStore().get<ESM::Land>().search (job.mX, job.mY);
+
+                // same as in Scene::loadCell, one type at a time
+                static const int types[] =
+                {
+                    ESM::Land::DATA_VHGT, ESM::Land::DATA_VNML, ESM::Land::DATA_VCLR, ESM::Land::DATA_VTEX
+                };
+
+                job.mStep = Step_Shapes;
+
+                if (land && land->mDataTypes&ESM::Land::DATA_VHGT)
+                    for (size_t i=0; i<sizeof (types)/sizeof (types[0]); ++i)
+                        if (!land->isDataLoaded (types[i]))
+                        {
+                            land->loadData (types[i]);
+                            job.mLoadedLand = true;
+                            job.mStep = Step_Land;
+                            break;
+                        }
+
+                break;
+            }
+
+            case Step_Shapes:
+            {
+                // Building a shape from a file that is still loading in the background would wait
+                // for it, so the shapes of files that are ready go first.
+                size_t next = job.mNextShape;
+
+                while (next<job.mShapes.size() && Nif::Cache::getInstance().isLoading (job.mShapes[next].first))
+                    ++next;
+
+                if (next<job.mShapes.size())
+                {
+                    std::swap (job.mShapes[job.mNextShape], job.mShapes[next]);
+
+                    try
+                    {
+                        mPhysics.preloadShape (job.mShapes[job.mNextShape].first,
+                            job.mShapes[job.mNextShape].second);
+                    }
+                    catch (const std::exception&)
+                    {
+                        // Scene::insertCell will report it
+                    }
+
+                    ++job.mNextShape;
+                }
+                else if (job.mNextShape<job.mShapes.size())
+                    return false;
+
+                if (job.mNextShape>=job.mShapes.size())
+                {
+                    job.mShapes.clear();
+                    job.mStep = Step_Done;
+                }
+
+                break;
+            }
+
+            case Step_Done:
+
+                break;
+        }
+
+        return true;
+    }
+
+    void CellPreloader::update (const Ogre::Vector3& position, const Ogre::Vector3& velocity,
+        int gridX, int gridY, const std::set<CellStore *>& activeCells)
+    {
+        if (mTimePerFrame<=0)
+            return;
+
+        MWBase::World *world = MWBase::Environment::get().getWorld();
+
+        Ogre::Vector3 predicted = position + velocity * mPredictionTime;
+
+        int cellX, cellY;
+        world->positionToIndex (predicted.x, predicted.y, cellX, cellY);
+
+        // The grid moves by at most one cell at a time, towards the cell the player is heading to.
+        int targetX = gridX + clampStep (cellX-gridX);
+        int targetY = gridY + clampStep (cellY-gridY);
+
+        if (targetX==gridX && targetY==gridY)
+            return;
+
+        setTarget (targetX, targetY, activeCells);
+
+        Ogre::Timer timer;
+        const unsigned long budget = static_cast<unsigned long> (mTimePerFrame * 1000);
+
+        for (std::vector<Job>::iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+            while (iter->mStep!=Step_Done)
+            {
+                if (timer.getMicroseconds()>=budget)
+                    return;
+
+                if (!runStep (*iter))
+                    break;
+            }
+    }
+
+    void CellPreloader::clear()
+    {
+        for (std::vector<Job>::iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+            unloadLand (*iter);
+
+        mJobs.clear();
+        mHasTarget = false;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef GAME_MWWORLD_CELLPRELOADER_H
+#define GAME_MWWORLD_CELLPRELOADER_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace Ogre
+{
+    class Vector3;
+}
+
+namespace MWWorld
+{
+    class CellStore;
+    class PhysicsSystem;
+
+    /// \brief Prepares the exterior cells that the player is heading into
+    ///
+    /// The player's movement predicts where the cell grid is going to move next. The cells of that
+    /// grid that are not active yet are prepared in small steps, within a time budget per frame:
+    /// their references are loaded, their models queued for loading in the background, their land
+    /// data read and the collision shapes of their objects built. When the player crosses the
+    /// border, Scene::loadCell finds all of that ready and only has to insert the objects.
+    ///
+    /// Each step does a bounded amount of work: a few references, one type of land data or one
+    /// shape. Shapes of models that are still loading in the background wait, so that a step never
+    /// blocks on a worker thread. Land data of cells that leave the grid without becoming active is
+    /// unloaded again.
+    ///
+    /// \note Ogre and Bullet are not thread-safe, so all steps run on the main thread, except for
+    /// the NIF files, which Nif::Cache loads on its worker threads.
+    class CellPreloader
+    {
+            enum Step
+            {
+                Step_References,
+                Step_Models,
+                Step_Land,
+                Step_Shapes,
+                Step_Done
+            };
+
+            struct Job
+            {
+                int mX;
+                int mY;
+                Step mStep;
+                size_t mNextReference;
+                std::vector<std::pair<std::string, float> > mShapes; // mesh, scale
+                size_t mNextShape;
+                bool mLoadedLand;
+
+                Job (int x, int y)
+                : mX (x), mY (y), mStep (Step_References), mNextReference (0), mNextShape (0),
+                  mLoadedLand (false)
+                {}
+            };
+
+            PhysicsSystem& mPhysics;
+            float mTimePerFrame; // in milliseconds
+            float mPredictionTime; // in seconds
+            int mHalfGridSize;
+            std::vector<Job> mJobs;
+            int mTargetX;
+            int mTargetY;
+            bool mHasTarget;
+
+            void setTarget (int x, int y, const std::set<CellStore *>& activeCells);
+
+            bool runStep (Job& job);
+            ///< \return false, if \a job has to wait for the background loading.
+
+            void unloadLand (const Job& job);
+
+        public:
+
+            CellPreloader (PhysicsSystem& physics);
+
+            void update (const Ogre::Vector3& position, const Ogre::Vector3& velocity, int gridX, int gridY,
+                const std::set<CellStore *>& activeCells);
+            ///< Continue preparing the cells of the grid that the player is heading into.
+            ///
+            /// \param gridX, gridY Center of the active cell grid
+
+            void clear();
+            ///< Stop preparing cells, e.g. after moving into an interior.
+            ///
+            /// \note Call after unloading the active cells.
+    };
+}
+
+#endif
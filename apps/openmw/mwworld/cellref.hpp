@@ -25,7 +25,7 @@ namespace MWWorld
         // Note: Currently unused for items in containers
         const ESM::RefNum& getRefNum() const;
 
-        // Set RefNum to its default state.
+        // Set RefNum to its default state. Not for references in a cell, see CellRefList::insert.
         void unsetRefNum();
 
         /// Does the RefNum have a content file?
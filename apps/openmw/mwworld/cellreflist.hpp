@@ -1,20 +1,55 @@
 #ifndef GAME_MWWORLD_CELLREFLIST_H
 #define GAME_MWWORLD_CELLREFLIST_H
 
-#include <list>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include <components/misc/chunkedvector.hpp>
 
 #include "livecellref.hpp"
 
 namespace MWWorld
 {
     /// \brief Collection of references of one type
+    ///
+    /// References are stored in chunks, so that they never move and Ptrs to them stay valid. Lookups
+    /// by ID, handle and RefNum go through hash indices, which are brought up to date on demand,
+    /// because references can be appended to mList directly. The handle index is rebuilt after
+    /// the base node of one of the references has changed.
     template <typename X>
     struct CellRefList
     {
         typedef LiveCellRef<X> LiveRef;
-        typedef std::list<LiveRef> List;
+        typedef Misc::ChunkedVector<LiveRef, 32> List;
         List mList;
 
+        CellRefList()
+        : mIdsIndexed (0), mRefNumsIndexed (0), mBaseNodeChanges (0), mHandleChanges (0), mHandlesIndexed (0)
+        {}
+
+        /// The references of a copy count their base node changes in the copy, once it has been
+        /// searched by handle.
+        CellRefList (const CellRefList& list)
+        : mList (list.mList), mIdIndex (list.mIdIndex), mIdsIndexed (list.mIdsIndexed),
+          mRefNumIndex (list.mRefNumIndex), mRefNumsIndexed (list.mRefNumsIndexed),
+          mBaseNodeChanges (0), mHandleChanges (0), mHandlesIndexed (0)
+        {}
+
+        CellRefList& operator= (const CellRefList& list)
+        {
+            mList = list.mList;
+            mIdIndex = list.mIdIndex;
+            mIdsIndexed = list.mIdsIndexed;
+            mRefNumIndex = list.mRefNumIndex;
+            mRefNumsIndexed = list.mRefNumsIndexed;
+            mHandleIndex.clear();
+            mHandlesIndexed = 0;
+            return *this;
+        }
+
         /// Search for the given reference in the given reclist from
         /// ESMStore. Insert the reference into the list if a match is
         /// found. If not, throw an exception.
@@ -26,29 +61,102 @@ namespace MWWorld
 
         LiveRef *find (const std::string& name)
         {
-            for (typename List::iterator iter (mList.begin()); iter!=mList.end(); ++iter)
-                if (!iter->mData.isDeletedByContentFile()
-                        && (iter->mRef.hasContentFile() || iter->mData.getCount() > 0)
-                        && iter->mRef.getRefId() == name)
-                    return &*iter;
+            indexIds();
+
+            typename IdIndex::const_iterator indices = mIdIndex.find (name);
+
+            if (indices!=mIdIndex.end())
+                for (std::vector<size_t>::const_iterator index (indices->second.begin());
+                    index!=indices->second.end(); ++index)
+                {
+                    LiveRef& ref = mList[*index];
+
+                    if (!ref.mData.isDeletedByContentFile()
+                            && (ref.mRef.hasContentFile() || ref.mData.getCount() > 0))
+                        return &ref;
+                }
 
             return 0;
         }
 
+        /// Insert a copy of \a item without its RefNum, which is only valid within the original
+        /// cell of the reference. The RefNum of a reference must not change once it is in mList.
         LiveRef &insert (const LiveRef &item)
         {
             mList.push_back(item);
+            mList.back().mRef.unsetRefNum();
             return mList.back();
         }
 
         LiveCellRef<X> *searchViaHandle (const std::string& handle)
         {
-            for (typename List::iterator iter (mList.begin()); iter!=mList.end(); ++iter)
-                if (iter->mData.getBaseNode() &&
-                    iter->mData.getHandle()==handle)
-                    return &*iter;
+            if (mHandleChanges!=mBaseNodeChanges || mHandlesIndexed>mList.size())
+            {
+                mHandleIndex.clear();
+                mHandlesIndexed = 0;
+                mHandleChanges = mBaseNodeChanges;
+            }
 
-            return 0;
+            for (; mHandlesIndexed<mList.size(); ++mHandlesIndexed)
+            {
+                RefData& data = mList[mHandlesIndexed].mData;
+                data.setBaseNodeChanges (&mBaseNodeChanges);
+
+                if (data.getBaseNode())
+                    mHandleIndex.insert (std::make_pair (data.getHandle(), mHandlesIndexed));
+            }
+
+            typename HandleIndex::const_iterator iter = mHandleIndex.find (handle);
+
+            return iter!=mHandleIndex.end() ? &mList[iter->second] : 0;
+        }
+
+        /// Return the first reference with this RefNum, or 0.
+        LiveRef *searchViaRefNum (const ESM::RefNum& refNum)
+        {
+            for (; mRefNumsIndexed<mList.size(); ++mRefNumsIndexed)
+                mRefNumIndex.insert (std::make_pair (getKey (mList[mRefNumsIndexed].mRef.getRefNum()),
+                    mRefNumsIndexed));
+
+            typename RefNumIndex::const_iterator iter = mRefNumIndex.find (getKey (refNum));
+
+            return iter!=mRefNumIndex.end() ? &mList[iter->second] : 0;
+        }
+
+        /// Must be called after a reference in mList has been overwritten, because the ID may have
+        /// changed.
+        void refChanged()
+        {
+            mIdIndex.clear();
+            mIdsIndexed = 0;
+        }
+
+    private:
+
+        typedef boost::unordered_map<std::string, std::vector<size_t> > IdIndex;
+        typedef boost::unordered_map<uint64_t, size_t> RefNumIndex;
+        typedef boost::unordered_map<std::string, size_t> HandleIndex;
+
+        IdIndex mIdIndex; // indices of all references with an ID, in order
+        size_t mIdsIndexed;
+
+        RefNumIndex mRefNumIndex; // index of the first reference with a RefNum
+        size_t mRefNumsIndexed;
+
+        HandleIndex mHandleIndex;
+        unsigned int mBaseNodeChanges; // increased by the RefData of indexed references
+        unsigned int mHandleChanges; // mBaseNodeChanges when mHandleIndex was last rebuilt
+        size_t mHandlesIndexed;
+
+        static uint64_t getKey (const ESM::RefNum& refNum)
+        {
+            return (static_cast<uint64_t> (static_cast<uint32_t> (refNum.mContentFile)) << 32) | refNum.mIndex;
+        }
+
+        void indexIds()
+        {
+            for (; mIdsIndexed<mList.size(); ++mIdsIndexed)
+                mIdIndex[mList[mIdsIndexed].mRef.getRefId()].push_back (mIdsIndexed);
         }
     };
 }
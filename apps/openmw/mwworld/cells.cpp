@@ -89,7 +89,7 @@ MWWorld::Cells::Cells (const MWWorld::ESMStore& store, std::vector<ESM::ESMReade
   mIdCacheIndex (0)
 {}
 
-MWWorld::CellStore *MWWorld::Cells::getExterior (int x, int y)
+MWWorld::CellStore *MWWorld::Cells::searchOrCreateExterior (int x, int y)
 {
     std::map<std::pair<int, int>, CellStore>::iterator result =
         mExteriors.find (std::make_pair (x, y));
@@ -116,13 +116,25 @@ MWWorld::CellStore *MWWorld::Cells::getExterior (int x, int y)
             std::make_pair (x, y), CellStore (cell))).first;
     }
 
-    if (result->second.getState()!=CellStore::State_Loaded)
+    return &result->second;
+}
+
+MWWorld::CellStore *MWWorld::Cells::getExterior (int x, int y)
+{
+    CellStore *cell = searchOrCreateExterior (x, y);
+
+    if (cell->getState()!=CellStore::State_Loaded)
     {
         // Multiple plugin support for landscape data is much easier than for references. The last plugin wins.
-        result->second.load (mStore, mReader);
+        cell->load (mStore, mReader);
     }
 
-    return &result->second;
+    return cell;
+}
+
+bool MWWorld::Cells::preloadExterior (int x, int y, size_t references)
+{
+    return searchOrCreateExterior (x, y)->load (mStore, mReader, references);
 }
 
 MWWorld::CellStore *MWWorld::Cells::getInterior (const std::string& name)
@@ -39,6 +39,9 @@ namespace MWWorld
 
             CellStore *getCellStore (const ESM::Cell *cell);
 
+            CellStore *searchOrCreateExterior (int x, int y);
+            ///< Does not load the references of the cell.
+
             Ptr getPtrAndCache (const std::string& name, CellStore& cellStore);
 
             void writeCell (ESM::ESMWriter& writer, CellStore& cell) const;
@@ -51,6 +54,11 @@ namespace MWWorld
 
             CellStore *getExterior (int x, int y);
 
+            bool preloadExterior (int x, int y, size_t references);
+            ///< Load at most \a references more references of an exterior cell.
+            ///
+            /// \return Are all references of the cell loaded?
+
             CellStore *getInterior (const std::string& name);
 
             CellStore *getCell (const ESM::CellId& id);
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <limits>
 
 #include <components/esm/cellstate.hpp>
 #include <components/esm/cellid.hpp>
@@ -125,14 +126,13 @@ namespace
 
         if (state.mRef.mRefNum.hasContentFile())
         {
-            for (typename MWWorld::CellRefList<T>::List::iterator iter (collection.mList.begin());
-                iter!=collection.mList.end(); ++iter)
-                if (iter->mRef.getRefNum()==state.mRef.mRefNum)
-                {
-                    // overwrite existing reference
-                    iter->load (state);
-                    return;
-                }
+            if (MWWorld::LiveCellRef<T> *ref = collection.searchViaRefNum (state.mRef.mRefNum))
+            {
+                // overwrite existing reference
+                ref->load (state);
+                collection.refChanged();
+                return;
+            }
         }
 
         // new reference
@@ -152,16 +152,16 @@ namespace MWWorld
 
         if (const X *ptr = store.search (ref.mRefID))
         {
-            typename std::list<LiveRef>::iterator iter =
-                std::find(mList.begin(), mList.end(), ref.mRefNum);
-
             LiveRef liveCellRef (ref, ptr);
 
             if (deleted)
                 liveCellRef.mData.setDeleted(true);
 
-            if (iter != mList.end())
-                *iter = liveCellRef;
+            if (LiveRef *existing = searchViaRefNum (ref.mRefNum))
+            {
+                *existing = liveCellRef;
+                refChanged();
+            }
             else
                 mList.push_back (liveCellRef);
         }
@@ -179,7 +179,8 @@ namespace MWWorld
     }
 
     CellStore::CellStore (const ESM::Cell *cell)
-      : mCell (cell), mState (State_Unloaded), mHasState (false), mLastRespawn(0,0)
+      : mCell (cell), mState (State_Unloaded), mHasState (false), mNextContext (0), mHasNextRef (false),
+        mLastRespawn(0,0)
     {
         mWaterLevel = cell->mWater;
     }
@@ -401,20 +402,28 @@ namespace MWWorld
     }
 
     void CellStore::load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm)
+    {
+        load (store, esm, std::numeric_limits<size_t>::max());
+    }
+
+    bool CellStore::load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm, size_t references)
     {
         if (mState!=State_Loaded)
         {
+            if (!loadRefs (store, esm, references))
+                return false;
+
             if (mState==State_Preloaded)
                 mIds.clear();
 
-            loadRefs (store, esm);
-
             mState = State_Loaded;
 
             // TODO: the pathgrid graph only needs to be loaded for active cells, so move this somewhere else.
             // In a simple test, loading the graph for all cells in MW + expansions took 200 ms
             mPathgridGraph.load(this);
         }
+
+        return true;
     }
 
     void CellStore::preload (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm)
@@ -472,27 +481,43 @@ namespace MWWorld
         std::sort (mIds.begin(), mIds.end());
     }
 
-    void CellStore::loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm)
+    bool CellStore::loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm, size_t references)
     {
         assert (mCell);
 
         if (mCell->mContextList.empty())
-            return; // this is a dynamically generated cell -> skipping.
+            return true; // this is a dynamically generated cell -> skipping.
 
         // Load references from all plugins that do something with this cell.
-        for (size_t i = 0; i < mCell->mContextList.size(); i++)
+        for (; mNextContext < mCell->mContextList.size(); ++mNextContext)
         {
             // Reopen the ESM reader and seek to the right position.
-            int index = mCell->mContextList.at(i).index;
-            mCell->restore (esm[index], i);
+            int index = mCell->mContextList.at(mNextContext).index;
+            if (mHasNextRef)
+                esm[index].restoreContext (mNextRef);
+            else
+                mCell->restore (esm[index], mNextContext);
 
             ESM::CellRef ref;
             ref.mRefNum.mContentFile = ESM::RefNum::RefNum_NoContentFile;
 
             // Get each reference in turn
             bool deleted = false;
-            while(mCell->getNextRef(esm[index], ref, deleted))
+            while(true)
             {
+                if (references==0)
+                {
+                    // Other cells use the same reader meanwhile
+                    mNextRef = esm[index].getContext();
+                    mHasNextRef = true;
+                    return false;
+                }
+
+                if (!mCell->getNextRef(esm[index], ref, deleted))
+                    break;
+
+                --references;
+
                 // Don't load reference if it was moved to a different cell.
                 ESM::MovedCellRefTracker::const_iterator iter =
                     std::find(mCell->mMovedRefs.begin(), mCell->mMovedRefs.end(), ref.mRefNum);
@@ -502,6 +527,8 @@ namespace MWWorld
 
                 loadRef (ref, deleted, store);
             }
+
+            mHasNextRef = false;
         }
 
         // Load moved references, from separately tracked list.
@@ -511,6 +538,8 @@ namespace MWWorld
 
             loadRef (ref, false, store);
         }
+
+        return true;
     }
 
     bool CellStore::isExterior() const
@@ -780,9 +809,9 @@ namespace MWWorld
         return mPathgridGraph.isPointConnected(start, end);
     }
 
-    std::list<ESM::Pathgrid::Point> CellStore::aStarSearch(const int start, const int end) const
+    void CellStore::getShortestPath(const int start, const int end, std::vector<ESM::Pathgrid::Point>& path) const
     {
-        return mPathgridGraph.aStarSearch(start, end);
+        mPathgridGraph.getShortestPath(start, end, path);
     }
 
     void CellStore::setFog(ESM::FogState *fog)
@@ -52,6 +52,11 @@ namespace MWWorld
             std::vector<std::string> mIds;
             float mWaterLevel;
 
+            // where loadRefs continues, if it stopped before loading all references
+            size_t mNextContext;
+            ESM::ESM_Context mNextRef;
+            bool mHasNextRef;
+
             MWWorld::TimeStamp mLastRespawn;
 
             CellRefList<ESM::Activator>         mActivators;
@@ -115,6 +120,12 @@ namespace MWWorld
             void load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
             ///< Load references from content file.
 
+            bool load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm, size_t references);
+            ///< Load at most \a references more references from content file, continuing where the
+            /// last call stopped.
+            ///
+            /// \return Are all references loaded?
+
             void preload (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
             ///< Build ID list from content file.
 
@@ -129,6 +140,14 @@ namespace MWWorld
             {
                 mHasState = true;
 
+                return forEachUnchanged (functor);
+            }
+
+            /// Same as forEach, but doesn't mark the cell as having a state to save. functor must
+            /// not change the references.
+            template<class Functor>
+            bool forEachUnchanged (Functor& functor)
+            {
                 return
                     forEachImp (functor, mActivators) &&
                     forEachImp (functor, mPotions) &&
@@ -194,7 +213,8 @@ namespace MWWorld
 
             bool isPointConnected(const int start, const int end) const;
 
-            std::list<ESM::Pathgrid::Point> aStarSearch(const int start, const int end) const;
+            /// Append the shortest path between the pathgrid points \a start and \a end to \a path.
+            void getShortestPath(const int start, const int end, std::vector<ESM::Pathgrid::Point>& path) const;
 
         private:
 
@@ -215,7 +235,8 @@ namespace MWWorld
             /// Run through references and store IDs
             void listRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
 
-            void loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
+            bool loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm, size_t references);
+            ///< \return Are all references loaded?
 
             void loadRef (ESM::CellRef& ref, bool deleted, const ESMStore& store);
             ///< Make case-adjustments to \a ref and insert it into the respective container.
@@ -349,9 +349,8 @@ namespace MWWorld
     MWWorld::Ptr
     Class::copyToCell(const Ptr &ptr, CellStore &cell) const
     {
-        Ptr newPtr = copyToCellImpl(ptr, cell);
-        newPtr.getCellRef().unsetRefNum(); // This RefNum is only valid within the original cell of the reference
-        return newPtr;
+        // CellRefList::insert drops the RefNum, which is only valid within the original cell of the reference
+        return copyToCellImpl(ptr, cell);
     }
 
     MWWorld::Ptr
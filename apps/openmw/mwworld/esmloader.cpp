@@ -1,18 +1,77 @@
 #include "esmloader.hpp"
 #include "esmstore.hpp"
 
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <components/esm/cachefile.hpp>
 #include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/misc/hash.hpp>
+#include <components/misc/threadpool.hpp>
+#include <components/to_utf8/to_utf8.hpp>
+
+namespace
+{
+  /// Increase when the snapshot layout or the way records are loaded changes
+  const int sCacheFormat = 2;
+
+  /// Hash of everything after \a offset in \a file
+  uint64_t hashFile(const boost::filesystem::path& file, size_t offset)
+  {
+    boost::filesystem::ifstream stream(file, std::ios::binary);
+    if (!stream || !stream.seekg(offset))
+      throw std::runtime_error("can't read " + file.string());
+
+    uint64_t hash = Misc::sHashSeed;
+    char data[65536];
+    while (stream.read(data, sizeof(data)) || stream.gcount()>0)
+      Misc::addHash(hash, data, static_cast<size_t>(stream.gcount()));
+
+    if (stream.bad())
+      throw std::runtime_error("read error on " + file.string());
+
+    return hash;
+  }
+}
 
 namespace MWWorld
 {
 
+struct EsmLoader::ParseJob
+{
+  boost::filesystem::path mPath;
+  int mIndex;
+  ESMStore::ParsedFile mParsed;
+  bool mDone;
+  std::string mError;
+
+  ParseJob(const boost::filesystem::path& path, int index)
+    : mPath(path), mIndex(index), mDone(false)
+  {
+  }
+};
+
 EsmLoader::EsmLoader(MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& readers,
-  ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener)
+  ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener, unsigned int threads)
   : ContentLoader(listener)
   , mEsm(readers)
   , mStore(store)
   , mEncoder(encoder)
+  , mThreads(threads ? threads : Misc::ThreadPool::getHardwareThreadCount())
+{
+}
+
+void EsmLoader::enableCache(const boost::filesystem::path& file)
 {
+  mCacheFile = file;
 }
 
 void EsmLoader::load(const boost::filesystem::path& filepath, int& index)
@@ -25,7 +84,216 @@ void EsmLoader::load(const boost::filesystem::path& filepath, int& index)
   lEsm.setGlobalReaderList(&mEsm);
   lEsm.open(filepath.string());
   mEsm[index] = lEsm;
-  mStore.load(mEsm[index], &mListener);
+
+  if (mThreads>1 || !mCacheFile.empty())
+    mJobs.push_back(boost::shared_ptr<ParseJob>(new ParseJob(filepath, index)));
+  else
+    mStore.load(mEsm[index], &mListener);
+}
+
+void EsmLoader::parse(ParseJob& job)
+{
+  try
+  {
+    // The encoder keeps a conversion buffer, so every thread needs its own
+    std::auto_ptr<ToUTF8::Utf8Encoder> encoder;
+    if (mEncoder)
+      encoder.reset(new ToUTF8::Utf8Encoder(*mEncoder));
+
+    ESM::ESMReader esm;
+    esm.setEncoder(encoder.get());
+    esm.setIndex(job.mIndex);
+    esm.open(job.mPath.string());
+
+    mStore.parse(esm, job.mParsed);
+  }
+  catch (const std::exception& e)
+  {
+    job.mError = e.what();
+  }
+
+  boost::mutex::scoped_lock lock(mMutex);
+  job.mDone = true;
+  mJobDone.notify_all();
+}
+
+void EsmLoader::finish()
+{
+  if (mJobs.empty())
+    return;
+
+  std::string key;
+
+  if (!mCacheFile.empty())
+  {
+    key = getCacheKey();
+
+    if (readCache(key))
+    {
+      mJobs.clear();
+      return;
+    }
+  }
+
+  if (mThreads>1)
+    loadParallel();
+  else
+  {
+    for (std::vector<boost::shared_ptr<ParseJob> >::iterator iter(mJobs.begin()); iter!=mJobs.end(); ++iter)
+    {
+      mListener.setLabel((*iter)->mPath.filename().string());
+      mStore.load(mEsm[(*iter)->mIndex], &mListener);
+    }
+  }
+
+  mJobs.clear();
+
+  if (!mCacheFile.empty())
+    writeCache(key);
+}
+
+void EsmLoader::loadParallel()
+{
+  Misc::ThreadPool pool(std::min(mThreads, static_cast<unsigned int>(mJobs.size())));
+
+  for (std::vector<boost::shared_ptr<ParseJob> >::iterator iter(mJobs.begin()); iter!=mJobs.end(); ++iter)
+    pool.push(boost::bind(&EsmLoader::parse, this, boost::ref(**iter)));
+
+  // Merge in load order, while the files further down the list are still being parsed
+  for (std::vector<boost::shared_ptr<ParseJob> >::iterator iter(mJobs.begin()); iter!=mJobs.end(); ++iter)
+  {
+    ParseJob& job = **iter;
+
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+      while (!job.mDone)
+        mJobDone.wait(lock);
+    }
+
+    if (!job.mError.empty())
+    {
+      // Let the workers run out before unwinding
+      pool.wait();
+      mJobs.clear();
+      throw std::runtime_error(job.mError);
+    }
+
+    mListener.setLabel(job.mPath.filename().string());
+    mStore.load(mEsm[job.mIndex], job.mParsed, &mListener);
+
+    // Release the parsed records as early as possible
+    std::vector<ESMStore::ParsedFile::Entry>().swap(job.mParsed.mEntries);
+  }
+
+  pool.wait();
+}
+
+std::string EsmLoader::getCacheKey() const
+{
+  std::vector<boost::filesystem::path> files;
+  for (std::vector<boost::shared_ptr<ParseJob> >::const_iterator iter(mJobs.begin()); iter!=mJobs.end(); ++iter)
+    files.push_back((*iter)->mPath);
+
+  // Record loading changes between versions, even without a change of the snapshot layout
+  std::string key = ESM::getCacheKey(files);
+
+  // Strings are stored converted, so the snapshot is only valid for the same encoding
+  if (mEncoder)
+  {
+    std::string legacy;
+    for (int c=0x80; c<=0xff; ++c)
+      legacy += static_cast<char>(c);
+
+    std::string utf8 = mEncoder->getUtf8(legacy);
+
+    std::ostringstream stream;
+    stream << "encoding " << std::hex << Misc::getHash(utf8.data(), utf8.size()) << "\n";
+    key += stream.str();
+  }
+
+  return key;
+}
+
+bool EsmLoader::readCache(const std::string& key)
+{
+  ESM::ESMReader reader;
+  reader.setGlobalReaderList(&mEsm);
+
+  try
+  {
+    if (!ESM::openCacheFile(reader, mCacheFile, sCacheFormat) || reader.getHNString("KEYS")!=key)
+      return false;
+
+    // Check the whole snapshot before touching the store, a failure while reading it would leave
+    // the store partially filled
+    uint64_t hash;
+    reader.getHNT(hash, "HASH");
+
+    if (hashFile(mCacheFile, reader.getFileOffset())!=hash)
+    {
+      std::cerr << "Ignoring content cache " << mCacheFile.string() << ": checksum mismatch" << std::endl;
+      return false;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Ignoring content cache " << mCacheFile.string() << ": " << e.what() << std::endl;
+    return false;
+  }
+
+  std::cout << "Loading content from cache " << mCacheFile.string() << std::endl;
+
+  for (std::vector<boost::shared_ptr<ParseJob> >::iterator iter(mJobs.begin()); iter!=mJobs.end(); ++iter)
+    mStore.resolveMasters(mEsm[(*iter)->mIndex]);
+
+  mListener.setLabel(mCacheFile.filename().string());
+
+  try
+  {
+    mStore.readSnapshot(reader, &mListener);
+  }
+  catch (const std::exception& e)
+  {
+    // The snapshot passed the checksum, so this is a bug rather than a damaged file. The store is
+    // partially filled at this point, so there is no way to fall back to the content files.
+    reader.close();
+    boost::system::error_code error;
+    boost::filesystem::remove(mCacheFile, error);
+    throw std::runtime_error("Failed to read content cache " + mCacheFile.string() + ": " + e.what());
+  }
+
+  return true;
+}
+
+void EsmLoader::writeCache(const std::string& key)
+{
+  try
+  {
+    // ESMWriter seeks back for every record size, which is a lot faster in memory
+    std::stringstream buffer;
+
+    ESM::ESMWriter writer;
+    ESM::startCacheFile(writer, buffer, sCacheFormat);
+    writer.writeHNString("KEYS", key);
+    writer.writeHNT("HASH", static_cast<uint64_t>(0)); // Filled in below
+    writer.endRecord(ESM::sCacheKeyRecord);
+
+    size_t snapshotStart = static_cast<size_t>(buffer.tellp());
+
+    mStore.writeSnapshot(writer);
+    writer.close();
+
+    // The hash of the snapshot is the last thing in the key record, right before the snapshot
+    std::string data = buffer.str();
+    uint64_t hash = Misc::getHash(data.data()+snapshotStart, data.size()-snapshotStart);
+    data.replace(snapshotStart-sizeof(hash), sizeof(hash), reinterpret_cast<const char*>(&hash), sizeof(hash));
+
+    ESM::saveCacheFile(mCacheFile, data);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Failed to write content cache " << mCacheFile.string() << ": " << e.what() << std::endl;
+  }
 }
 
 } /* namespace MWWorld */
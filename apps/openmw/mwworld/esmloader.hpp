@@ -2,6 +2,11 @@
 #define ESMLOADER_HPP
 
 #include <vector>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "contentloader.hpp"
 
@@ -22,15 +27,45 @@ class ESMStore;
 
 struct EsmLoader : public ContentLoader
 {
+    /// \param threads Number of threads used for parsing content files in parallel, 0 for one
+    /// per hardware thread. 1 loads each file serially as soon as load() is called.
     EsmLoader(MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& readers,
-      ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener);
+      ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener, unsigned int threads = 1);
+
+    /// Keep a snapshot of the loaded content in \a file. As long as the content files do not
+    /// change, finish() restores the store from the snapshot instead of loading them.
+    void enableCache(const boost::filesystem::path& file);
 
     void load(const boost::filesystem::path& filepath, int& index);
 
+    /// Parse all files passed to load() so far on a thread pool, then merge them into the store
+    /// in load order. Does nothing in serial mode, unless the cache is enabled.
+    void finish();
+
     private:
+      struct ParseJob;
+
+      void parse(ParseJob& job);
+
+      void loadParallel();
+
+      std::string getCacheKey() const;
+      ///< Identifies the content files in load order and the encoding they are read with
+
+      bool readCache(const std::string& key);
+      ///< \return false, if there is no valid snapshot for \a key. The store is left untouched then.
+
+      void writeCache(const std::string& key);
+
       std::vector<ESM::ESMReader>& mEsm;
       MWWorld::ESMStore& mStore;
       ToUTF8::Utf8Encoder* mEncoder;
+      unsigned int mThreads;
+      boost::filesystem::path mCacheFile;
+
+      std::vector<boost::shared_ptr<ParseJob> > mJobs;
+      boost::mutex mMutex;
+      boost::condition_variable mJobDone;
 };
 
 } /* namespace MWWorld */
@@ -25,12 +25,8 @@ static bool isCacheableRecord(int id)
     return false;
 }
 
-void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
+void ESMStore::resolveMasters(ESM::ESMReader &esm)
 {
-    listener->setProgressRange(1000);
-
-    ESM::Dialogue *dialogue = 0;
-
     /// \todo Move this to somewhere else. ESMReader?
     // Cache parent esX files by tracking their indices in the global list of
     //  all files/readers used by the engine. This will greaty accelerate
@@ -58,72 +54,239 @@ void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
         }
         mast.index = index;
     }
+}
+
+void ESMStore::loadRecord(ESM::ESMReader &esm, ESM::Dialogue *&dialogue)
+{
+    ESM::NAME n = esm.getRecName();
+    esm.getRecHeader();
+
+    // Look up the record type.
+    std::map<int, StoreBase *>::iterator it = mStores.find(n.val);
+
+    if (it == mStores.end()) {
+        if (n.val == ESM::REC_INFO) {
+            if (dialogue)
+            {
+                dialogue->readInfo(esm, esm.getIndex() != 0);
+            }
+            else
+            {
+                std::cerr << "error: info record without dialog" << std::endl;
+                esm.skipRecord();
+            }
+        } else if (n.val == ESM::REC_MGEF) {
+            mMagicEffects.load (esm);
+        } else if (n.val == ESM::REC_SKIL) {
+            mSkills.load (esm);
+        }
+        else if (n.val==ESM::REC_FILT || n.val == ESM::REC_DBGP)
+        {
+            // ignore project file only records
+            esm.skipRecord();
+        }
+        else {
+            std::stringstream error;
+            error << "Unknown record: " << n.toString();
+            throw std::runtime_error(error.str());
+        }
+    } else {
+        // Load it
+        std::string id = esm.getHNOString("NAME");
+        // ... unless it got deleted! This means that the following record
+        //  has been deleted, and trying to load it using standard assumptions
+        //  on the structure will (probably) fail.
+        if (esm.isNextSub("DELE")) {
+          esm.skipRecord();
+          it->second->eraseStatic(id);
+          return;
+        }
+        it->second->load(esm, id);
+
+        // DELE can also occur after the usual subrecords
+        if (esm.isNextSub("DELE")) {
+          esm.skipRecord();
+          it->second->eraseStatic(id);
+          return;
+        }
+
+        if (n.val==ESM::REC_DIAL) {
+            dialogue = const_cast<ESM::Dialogue*>(mDialogs.find(id));
+        } else {
+            dialogue = 0;
+        }
+        // Insert the reference into the global lookup
+        if (!id.empty() && isCacheableRecord(n.val)) {
+            mIds[Misc::StringUtils::lowerCase (id)] = n.val;
+        }
+    }
+}
+
+void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
+{
+    listener->setProgressRange(1000);
+
+    ESM::Dialogue *dialogue = 0;
+
+    resolveMasters(esm);
 
     // Loop through all records
     while(esm.hasMoreRecs())
     {
+        loadRecord(esm, dialogue);
+        listener->setProgress(static_cast<size_t>(esm.getFileOffset() / (float)esm.getFileSize() * 1000));
+    }
+}
+
+void ESMStore::parse(ESM::ESMReader &esm, ParsedFile &file) const
+{
+    file.mEntries.clear();
+    file.mEntries.reserve(esm.getRecordCount());
+
+    while(esm.hasMoreRecs())
+    {
+        ParsedFile::Entry entry;
+        entry.mOffset = esm.getFileOffset();
+
         ESM::NAME n = esm.getRecName();
         esm.getRecHeader();
+        entry.mType = n.val;
 
-        // Look up the record type.
-        std::map<int, StoreBase *>::iterator it = mStores.find(n.val);
+        std::map<int, StoreBase *>::const_iterator it = mStores.find(n.val);
 
-        if (it == mStores.end()) {
-            if (n.val == ESM::REC_INFO) {
-                if (dialogue)
-                {
-                    dialogue->readInfo(esm, esm.getIndex() != 0);
-                }
-                else
-                {
-                    std::cerr << "error: info record without dialog" << std::endl;
-                    esm.skipRecord();
-                }
-            } else if (n.val == ESM::REC_MGEF) {
-                mMagicEffects.load (esm);
-            } else if (n.val == ESM::REC_SKIL) {
-                mSkills.load (esm);
-            }
-            else if (n.val==ESM::REC_FILT || n.val == ESM::REC_DBGP)
+        if (it != mStores.end())
+        {
+            std::string id = esm.getHNOString("NAME");
+
+            // Deleted records are rare, leave them to the in-place loading
+            if (!esm.isNextSub("DELE"))
             {
-                // ignore project file only records
-                esm.skipRecord();
+                entry.mRecord.reset(it->second->parse(esm, id));
+
+                if (entry.mRecord && esm.isNextSub("DELE"))
+                    entry.mRecord.reset();
             }
-            else {
-                std::stringstream error;
-                error << "Unknown record: " << n.toString();
-                throw std::runtime_error(error.str());
+
+            if (entry.mRecord)
+                entry.mCacheable = !id.empty() && isCacheableRecord(n.val);
+        }
+
+        if (entry.mRecord)
+            entry.mStore = it->second;
+        else
+            esm.skipRecord();
+
+        file.mEntries.push_back(entry);
+    }
+}
+
+void ESMStore::load(ESM::ESMReader &esm, const ParsedFile &file, Loading::Listener* listener)
+{
+    listener->setProgressRange(1000);
+
+    ESM::Dialogue *dialogue = 0;
+
+    resolveMasters(esm);
+
+    const size_t fileSize = esm.getFileSize();
+
+    for (std::vector<ParsedFile::Entry>::const_iterator iter (file.mEntries.begin());
+        iter!=file.mEntries.end(); ++iter)
+    {
+        listener->setProgress(static_cast<size_t>(iter->mOffset / (float)fileSize * 1000));
+
+        if (iter->mRecord)
+        {
+            LoadedRecord &record = *iter->mRecord;
+
+            if (iter->mStore->insertParsed(record))
+            {
+                dialogue = 0;
+
+                if (iter->mCacheable)
+                    mIds[record.getId()] = iter->mType;
+
+                continue;
             }
+
+            // Overrides an existing record: fall through and load it in place
+        }
+
+        if (esm.getFileOffset()!=iter->mOffset)
+        {
+            ESM::ESM_Context context = esm.getContext();
+            context.filePos = iter->mOffset;
+            context.leftFile = fileSize - iter->mOffset;
+            context.leftRec = 0;
+            context.leftSub = 0;
+            context.subCached = false;
+            esm.restoreContext(context);
+        }
+
+        loadRecord(esm, dialogue);
+    }
+}
+
+void ESMStore::writeSnapshot(ESM::ESMWriter &writer) const
+{
+    for (std::map<int, StoreBase *>::const_iterator it = mStores.begin(); it != mStores.end(); ++it) {
+        it->second->writeSnapshot(writer);
+    }
+
+    for (Store<ESM::MagicEffect>::iterator it = mMagicEffects.begin(); it != mMagicEffects.end(); ++it) {
+        writer.startRecord(ESM::REC_MGEF);
+        it->second.save(writer);
+        writer.endRecord(ESM::REC_MGEF);
+    }
+
+    for (Store<ESM::Skill>::iterator it = mSkills.begin(); it != mSkills.end(); ++it) {
+        writer.startRecord(ESM::REC_SKIL);
+        it->second.save(writer);
+        writer.endRecord(ESM::REC_SKIL);
+    }
+}
+
+void ESMStore::readSnapshot(ESM::ESMReader &esm, Loading::Listener* listener)
+{
+    listener->setProgressRange(1000);
+
+    ESM::Dialogue *dialogue = 0;
+
+    while(esm.hasMoreRecs())
+    {
+        ESM::NAME n = esm.getRecName();
+        esm.getRecHeader();
+
+        if (n.val == ESM::REC_INFO) {
+            if (!dialogue)
+                esm.fail("info record without dialog");
+
+            // The infos are already merged and in order
+            dialogue->readInfo(esm, false);
+        } else if (n.val == ESM::REC_MGEF) {
+            mMagicEffects.load (esm);
+        } else if (n.val == ESM::REC_SKIL) {
+            mSkills.load (esm);
         } else {
-            // Load it
-            std::string id = esm.getHNOString("NAME");
-            // ... unless it got deleted! This means that the following record
-            //  has been deleted, and trying to load it using standard assumptions
-            //  on the structure will (probably) fail.
-            if (esm.isNextSub("DELE")) {
-              esm.skipRecord();
-              it->second->eraseStatic(id);
-              continue;
-            }
-            it->second->load(esm, id);
+            std::map<int, StoreBase *>::iterator it = mStores.find(n.val);
 
-            // DELE can also occur after the usual subrecords
-            if (esm.isNextSub("DELE")) {
-              esm.skipRecord();
-              it->second->eraseStatic(id);
-              continue;
-            }
+            if (it == mStores.end())
+                esm.fail("Unknown record: " + n.toString());
+
+            std::string id = esm.getHNString("NAME");
+            it->second->readSnapshot(esm, id);
 
             if (n.val==ESM::REC_DIAL) {
                 dialogue = const_cast<ESM::Dialogue*>(mDialogs.find(id));
             } else {
                 dialogue = 0;
             }
-            // Insert the reference into the global lookup
+
             if (!id.empty() && isCacheableRecord(n.val)) {
                 mIds[Misc::StringUtils::lowerCase (id)] = n.val;
             }
         }
+
         listener->setProgress(static_cast<size_t>(esm.getFileOffset() / (float)esm.getFileSize() * 1000));
     }
 }
@@ -3,6 +3,8 @@
 
 #include <stdexcept>
 
+#include <boost/shared_ptr.hpp>
+
 #include <components/esm/records.hpp>
 #include "store.hpp"
 
@@ -73,7 +75,27 @@ namespace MWWorld
 
         unsigned int mDynamicCount;
 
+        void loadRecord(ESM::ESMReader &esm, ESM::Dialogue *&dialogue);
+        ///< Load the next record of \a esm in place.
+
     public:
+        /// Records of one content file, parsed ahead of time by parse().
+        struct ParsedFile
+        {
+            struct Entry
+            {
+                size_t mOffset; // file offset of the record name
+                uint32_t mType;
+                bool mCacheable;
+                StoreBase *mStore;
+                boost::shared_ptr<LoadedRecord> mRecord; // empty, if the record must be loaded in place
+
+                Entry() : mOffset(0), mType(0), mCacheable(false), mStore(0) {}
+            };
+
+            std::vector<Entry> mEntries;
+        };
+
         /// \todo replace with SharedIterator<StoreBase>
         typedef std::map<int, StoreBase *>::const_iterator iterator;
 
@@ -159,6 +181,25 @@ namespace MWWorld
 
         void load(ESM::ESMReader &esm, Loading::Listener* listener);
 
+        void parse(ESM::ESMReader &esm, ParsedFile &file) const;
+        ///< Parse all records of \a esm that don't depend on previously loaded content, without
+        /// modifying the store. Thread safe, as long as the store is not set up or cleared concurrently.
+
+        void load(ESM::ESMReader &esm, const ParsedFile &file, Loading::Listener* listener);
+        ///< Merge records parsed from \a esm into the store, loading all other records in place.
+        /// The result is the same as load(esm, listener).
+
+        void resolveMasters(ESM::ESMReader &esm);
+        ///< Look up the readers of the masters of \a esm. Done by load(), but also required
+        /// when the content comes from a snapshot.
+
+        void writeSnapshot(ESM::ESMWriter &writer) const;
+        ///< Write all records loaded from content files. Must be called before setUp().
+
+        void readSnapshot(ESM::ESMReader &esm, Loading::Listener* listener);
+        ///< Restore the records written by writeSnapshot() into an empty store. The global reader
+        /// list of \a esm must contain the open content files the snapshot was taken from.
+
         template <class T>
         const Store<T> &get() const {
             throw std::runtime_error("Storage for this type not exist");
@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 
+#include <boost/bind.hpp>
+
 #include <OgreRoot.h>
 #include <OgreRenderWindow.h>
 #include <OgreSceneManager.h>
@@ -19,6 +21,8 @@
 #include <components/nifbullet/bulletnifloader.hpp>
 #include <components/nifogre/skeleton.hpp>
 #include <components/misc/resourcehelpers.hpp>
+#include <components/misc/threadpool.hpp>
+#include <components/settings/settings.hpp>
 
 #include <components/esm/loadgmst.hpp>
 
@@ -43,12 +47,13 @@ using namespace Ogre;
 namespace
 {
 
-void animateCollisionShapes (std::map<OEngine::Physic::RigidBody*, OEngine::Physic::AnimatedShapeInstance>& map, btDynamicsWorld* dynamicsWorld)
+void animateCollisionShapes (std::map<OEngine::Physic::RigidBody*, OEngine::Physic::AnimatedShapeInstance>& map, btDynamicsWorld* dynamicsWorld,
+    const MWWorld::PhysicsSystem& physics)
 {
     for (std::map<OEngine::Physic::RigidBody*, OEngine::Physic::AnimatedShapeInstance>::iterator it = map.begin();
          it != map.end(); ++it)
     {
-        MWWorld::Ptr ptr = MWBase::Environment::get().getWorld()->searchPtrViaHandle(it->first->mName);
+        MWWorld::Ptr ptr = physics.getPtr(it->first->mObjectId);
         if (ptr.isEmpty()) // Shouldn't happen
             throw std::runtime_error("can't find Ptr");
 
@@ -100,6 +105,30 @@ namespace MWWorld
     // Arbitrary number. To prevent infinite loops. They shouldn't happen but it's good to be prepared.
     static const int sMaxIterations = 8;
 
+    /// World state used by the movement solver, gathered on the main thread
+    struct MovementEnvironment
+    {
+        float mSwimHeightScale;
+        float mStormWalkMult;
+        bool mInStorm;
+        Ogre::Vector3 mStormDirection;
+    };
+
+    /// Input and result of the movement of one actor
+    struct ActorMovement
+    {
+        Ptr mPtr;
+        OEngine::Physic::PhysicActor *mPhysicActor;
+        Ogre::Vector3 mMovement;
+        bool mIsFlying;
+        float mWaterlevel;
+        float mSlowFall;
+
+        Ogre::Vector3 mPosition;
+        int mCollision; ///< ID of the object the actor ran into, -1: none
+        int mStandingCollision; ///< ID of the object the actor stands on, -1: none
+    };
+
     class MovementSolver
     {
     private:
@@ -272,10 +301,26 @@ namespace MWWorld
             }
         }
 
-        static Ogre::Vector3 move(const MWWorld::Ptr &ptr, const Ogre::Vector3 &movement, float time,
-                                  bool isFlying, float waterlevel, float slowFall, OEngine::Physic::PhysicEngine *engine
-                                  , std::map<std::string, std::string>& collisionTracker
-                                  , std::map<std::string, std::string>& standingCollisionTracker)
+        /// Solve the movements in [begin, end). Only touches the data of these actors and only reads
+        /// the collision world, so that disjoint ranges can be solved in parallel.
+        static void solve(std::vector<ActorMovement>& movements, size_t begin, size_t end, float time,
+                          const MovementEnvironment& environment, OEngine::Physic::PhysicEngine *engine)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                ActorMovement& movement = movements[i];
+                movement.mPosition = move(movement.mPtr, movement.mPhysicActor, movement.mMovement, time,
+                                          movement.mIsFlying, movement.mWaterlevel, movement.mSlowFall,
+                                          environment, engine, movement.mCollision, movement.mStandingCollision);
+            }
+        }
+
+        static Ogre::Vector3 move(const MWWorld::Ptr &ptr, OEngine::Physic::PhysicActor *physicActor,
+                                  const Ogre::Vector3 &movement, float time,
+                                  bool isFlying, float waterlevel, float slowFall,
+                                  const MovementEnvironment& environment, OEngine::Physic::PhysicEngine *engine
+                                  , int& collision
+                                  , int& standingCollision)
         {
             const ESM::Position &refpos = ptr.getRefData().getPosition();
             Ogre::Vector3 position(refpos.pos);
@@ -285,10 +330,6 @@ namespace MWWorld
             if (!ptr.getClass().isMobile(ptr))
                 return position;
 
-            OEngine::Physic::PhysicActor *physicActor = engine->getCharacter(ptr.getRefData().getHandle());
-            if (!physicActor)
-                return position;
-
             // Reset per-frame data
             physicActor->setWalkingOnWater(false);
             // Anything to collide with?
@@ -303,9 +344,7 @@ namespace MWWorld
             Ogre::Vector3 halfExtents = physicActor->getHalfExtents();
             position.z += halfExtents.z;
 
-            static const float fSwimHeightScale = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
-                    .find("fSwimHeightScale")->getFloat();
-            float swimlevel = waterlevel + halfExtents.z - (halfExtents.z * 2 * fSwimHeightScale);
+            float swimlevel = waterlevel + halfExtents.z - (halfExtents.z * 2 * environment.mSwimHeightScale);
 
             OEngine::Physic::ActorTracer tracer;
             Ogre::Vector3 inertia = physicActor->getInertialForce();
@@ -327,16 +366,12 @@ namespace MWWorld
                     velocity = velocity + physicActor->getInertialForce();
                 }
             }
-            ptr.getClass().getMovementSettings(ptr).mPosition[2] = 0;
 
             // Now that we have the effective movement vector, apply wind forces to it
-            if (MWBase::Environment::get().getWorld()->isInStorm())
+            if (environment.mInStorm)
             {
-                Ogre::Vector3 stormDirection = MWBase::Environment::get().getWorld()->getStormDirection();
-                Ogre::Degree angle = stormDirection.angleBetween(velocity);
-                static const float fStromWalkMult = MWBase::Environment::get().getWorld()->getStore().get<ESM::GameSetting>()
-                        .find("fStromWalkMult")->getFloat();
-                velocity *= 1.f-(fStromWalkMult * (angle.valueDegrees()/180.f));
+                Ogre::Degree angle = environment.mStormDirection.angleBetween(velocity);
+                velocity *= 1.f-(environment.mStormWalkMult * (angle.valueDegrees()/180.f));
             }
 
             Ogre::Vector3 origVelocity = velocity;
@@ -383,7 +418,7 @@ namespace MWWorld
                         const btCollisionObject* standingOn = tracer.mHitObject;
                         if (const OEngine::Physic::RigidBody* body = dynamic_cast<const OEngine::Physic::RigidBody*>(standingOn))
                         {
-                            collisionTracker[ptr.getRefData().getHandle()] = body->mName;
+                            collision = body->mObjectId;
                         }
                     }
                 }
@@ -449,7 +484,7 @@ namespace MWWorld
                     const btCollisionObject* standingOn = tracer.mHitObject;
                     if (const OEngine::Physic::RigidBody* body = dynamic_cast<const OEngine::Physic::RigidBody*>(standingOn))
                     {
-                        standingCollisionTracker[ptr.getRefData().getHandle()] = body->mName;
+                        standingCollision = body->mObjectId;
                     }
                     if (standingOn->getBroadphaseHandle()->m_collisionFilterGroup == OEngine::Physic::CollisionType_Water)
                         physicActor->setWalkingOnWater(true);
@@ -504,6 +539,10 @@ namespace MWWorld
         // Create physics. shapeLoader is deleted by the physic engine
         NifBullet::ManualBulletShapeLoader* shapeLoader = new NifBullet::ManualBulletShapeLoader();
         mEngine = new OEngine::Physic::PhysicEngine(shapeLoader);
+
+        int threads = Settings::Manager::getInt("worker threads", "Physics");
+        if (threads > 0)
+            mWorkers.reset(new Misc::ThreadPool(threads));
     }
 
     PhysicsSystem::~PhysicsSystem()
@@ -519,7 +558,83 @@ namespace MWWorld
         return mEngine;
     }
 
-    std::pair<float, std::string> PhysicsSystem::getFacedHandle(float queryDistance)
+    Ptr PhysicsSystem::getPtr (int objectId) const
+    {
+        if (objectId<=0 || objectId>=static_cast<int> (mObjects.size()))
+            return Ptr();
+
+        return mObjects[objectId];
+    }
+
+    int PhysicsSystem::getObjectId (const Ptr& ptr) const
+    {
+        int id = ptr.getRefData().getObjectId();
+
+        if (id<=0 || id>=static_cast<int> (mObjects.size()) || mObjects[id]!=ptr)
+            return 0;
+
+        return id;
+    }
+
+    void PhysicsSystem::addObjectId (const Ptr& ptr)
+    {
+        // Objects that have already been added keep their ID
+        int id = getObjectId (ptr);
+
+        if (!id)
+        {
+            if (!mFreeObjectIds.empty())
+            {
+                id = mFreeObjectIds.back();
+                mFreeObjectIds.pop_back();
+                mObjects[id] = ptr;
+            }
+            else
+            {
+                if (mObjects.empty())
+                    mObjects.push_back (Ptr()); // ID 0
+
+                id = static_cast<int> (mObjects.size());
+                mObjects.push_back (ptr);
+            }
+
+            ptr.getRefData().setObjectId (id);
+        }
+
+        const std::string& handle = ptr.getRefData().getHandle();
+
+        if (OEngine::Physic::RigidBody *body = mEngine->getRigidBody (handle))
+            body->mObjectId = id;
+
+        if (OEngine::Physic::RigidBody *body = mEngine->getRigidBody (handle, true))
+            body->mObjectId = id;
+
+        if (OEngine::Physic::PhysicActor *actor = mEngine->getCharacter (handle))
+            actor->setObjectId (id);
+    }
+
+    void PhysicsSystem::removeObjectId (int id)
+    {
+        if (id<=0 || id>=static_cast<int> (mObjects.size()) || mObjects[id].isEmpty())
+            return;
+
+        mObjects[id] = Ptr();
+        mFreeObjectIds.push_back (id);
+
+        // The ID may be reused before the collisions are cleared
+        mCollisions.erase (id);
+        mStandingCollisions.erase (id);
+
+        for (std::map<int, int>::iterator iter (mCollisions.begin()); iter!=mCollisions.end(); ++iter)
+            if (iter->second==id)
+                iter->second = 0;
+
+        for (std::map<int, int>::iterator iter (mStandingCollisions.begin()); iter!=mStandingCollisions.end(); ++iter)
+            if (iter->second==id)
+                iter->second = 0;
+    }
+
+    std::pair<float, Ptr> PhysicsSystem::getFacedObject(float queryDistance)
     {
         Ray ray = mRender.getCamera()->getCameraToViewportRay(0.5, 0.5);
 
@@ -529,13 +644,29 @@ namespace MWWorld
         btVector3 dir(dir_.x, dir_.y, dir_.z);
 
         btVector3 dest = origin + dir * queryDistance;
-        std::pair <std::string, float> result = mEngine->rayTest(origin, dest);
-        result.second *= queryDistance;
+        std::pair <const OEngine::Physic::RigidBody*, float> result = mEngine->rayTest(origin, dest);
+
+        Ptr object;
+        if (result.first)
+            object = getPtr (result.first->mObjectId);
 
-        return std::make_pair (result.second, result.first);
+        return std::make_pair (result.second * queryDistance, object);
     }
 
-    std::vector < std::pair <float, std::string> > PhysicsSystem::getFacedHandles (float queryDistance)
+    std::vector < std::pair <float, Ptr> > PhysicsSystem::toObjects (
+        const std::vector < std::pair <float, const OEngine::Physic::RigidBody*> >& hits, float queryDistance) const
+    {
+        std::vector < std::pair <float, Ptr> > results;
+        results.reserve (hits.size());
+
+        for (std::vector < std::pair <float, const OEngine::Physic::RigidBody*> >::const_iterator i = hits.begin();
+            i != hits.end(); ++i)
+            results.push_back (std::make_pair (i->first * queryDistance, getPtr (i->second->mObjectId)));
+
+        return results;
+    }
+
+    std::vector < std::pair <float, Ptr> > PhysicsSystem::getFacedObjects (float queryDistance)
     {
         Ray ray = mRender.getCamera()->getCameraToViewportRay(0.5, 0.5);
 
@@ -545,15 +676,10 @@ namespace MWWorld
         btVector3 dir(dir_.x, dir_.y, dir_.z);
 
         btVector3 dest = origin + dir * queryDistance;
-        std::vector < std::pair <float, std::string> > results;
-        /* auto */ results = mEngine->rayTest2(origin, dest);
-        std::vector < std::pair <float, std::string> >::iterator i;
-        for (/* auto */ i = results.begin (); i != results.end (); ++i)
-            i->first *= queryDistance;
-        return results;
+        return toObjects(mEngine->rayTest2(origin, dest), queryDistance);
     }
 
-    std::vector < std::pair <float, std::string> > PhysicsSystem::getFacedHandles (float mouseX, float mouseY, float queryDistance)
+    std::vector < std::pair <float, Ptr> > PhysicsSystem::getFacedObjects (float mouseX, float mouseY, float queryDistance)
     {
         Ray ray = mRender.getCamera()->getCameraToViewportRay(mouseX, mouseY);
         Ogre::Vector3 from = ray.getOrigin();
@@ -563,15 +689,10 @@ namespace MWWorld
         _from = btVector3(from.x, from.y, from.z);
         _to = btVector3(to.x, to.y, to.z);
 
-        std::vector < std::pair <float, std::string> > results;
-        /* auto */ results = mEngine->rayTest2(_from,_to);
-        std::vector < std::pair <float, std::string> >::iterator i;
-        for (/* auto */ i = results.begin (); i != results.end (); ++i)
-            i->first *= queryDistance;
-        return results;
+        return toObjects(mEngine->rayTest2(_from,_to), queryDistance);
     }
 
-    std::pair<std::string,Ogre::Vector3> PhysicsSystem::getHitContact(const std::string &name,
+    std::pair<Ptr,Ogre::Vector3> PhysicsSystem::getHitContact(const Ptr &actor,
                                                                       const Ogre::Vector3 &origin,
                                                                       const Ogre::Quaternion &orient,
                                                                       float queryDistance)
@@ -592,11 +713,15 @@ namespace MWWorld
         object.setWorldTransform(btTransform(btQuaternion(orient.x, orient.y, orient.z, orient.w),
                                              btVector3(center.x, center.y, center.z)));
 
+        const btCollisionObject* filter = NULL;
+        if (OEngine::Physic::PhysicActor* physicActor = mEngine->getCharacter(actor.getRefData().getHandle()))
+            filter = physicActor->getCollisionBody();
+
         std::pair<const OEngine::Physic::RigidBody*,btVector3> result = mEngine->getFilteredContact(
-                name, btVector3(origin.x, origin.y, origin.z), &object);
+                filter, btVector3(origin.x, origin.y, origin.z), &object);
         if(!result.first)
-            return std::make_pair(std::string(), Ogre::Vector3(&result.second[0]));
-        return std::make_pair(result.first->mName, Ogre::Vector3(&result.second[0]));
+            return std::make_pair(Ptr(), Ogre::Vector3(&result.second[0]));
+        return std::make_pair(getPtr(result.first->mObjectId), Ogre::Vector3(&result.second[0]));
     }
 
 
@@ -606,8 +731,8 @@ namespace MWWorld
         _from = btVector3(from.x, from.y, from.z);
         _to = btVector3(to.x, to.y, to.z);
 
-        std::pair<std::string, float> result = mEngine->rayTest(_from, _to, raycastingObjectOnly,ignoreHeightMap);
-        return !(result.first == "");
+        std::pair<const OEngine::Physic::RigidBody*, float> result = mEngine->rayTest(_from, _to, raycastingObjectOnly,ignoreHeightMap);
+        return result.first != NULL;
     }
 
     std::pair<bool, Ogre::Vector3>
@@ -619,14 +744,14 @@ namespace MWWorld
         btVector3 btFrom = btVector3(orig.x, orig.y, orig.z);
         btVector3 btTo = btVector3(to.x, to.y, to.z);
 
-        std::pair<std::string, float> test = mEngine->rayTest(btFrom, btTo);
+        std::pair<const OEngine::Physic::RigidBody*, float> test = mEngine->rayTest(btFrom, btTo);
         if (test.second == -1) {
             return std::make_pair(false, Ogre::Vector3());
         }
         return std::make_pair(true, ray.getPoint(len * test.second));
     }
 
-    std::pair<bool, Ogre::Vector3> PhysicsSystem::castRay(float mouseX, float mouseY, Ogre::Vector3* normal, std::string* hit)
+    std::pair<bool, Ogre::Vector3> PhysicsSystem::castRay(float mouseX, float mouseY, Ogre::Vector3* normal, Ptr* hit)
     {
         Ogre::Ray ray = mRender.getCamera()->getCameraToViewportRay(
             mouseX,
@@ -638,21 +763,38 @@ namespace MWWorld
         _from = btVector3(from.x, from.y, from.z);
         _to = btVector3(to.x, to.y, to.z);
 
-        std::pair<std::string, float> result = mEngine->rayTest(_from, _to, true, false, normal);
+        std::pair<const OEngine::Physic::RigidBody*, float> result = mEngine->rayTest(_from, _to, true, false, normal);
 
-        if (result.first == "")
+        if (!result.first)
             return std::make_pair(false, Ogre::Vector3());
         else
         {
             if (hit != NULL)
-                *hit = result.first;
+                *hit = getPtr(result.first->mObjectId);
             return std::make_pair(true, ray.getPoint(200*result.second));  /// \todo make this distance (ray length) configurable
         }
     }
 
-    std::vector<std::string> PhysicsSystem::getCollisions(const Ptr &ptr, int collisionGroup, int collisionMask)
+    void PhysicsSystem::queryBatch(const std::vector<OEngine::Physic::RayQuery>& queries,
+                                   std::vector<OEngine::Physic::RayQueryResult>& results)
     {
-        return mEngine->getCollisions(ptr.getRefData().getBaseNode()->getName(), collisionGroup, collisionMask);
+        mEngine->queryBatch(queries, results, mWorkers.get());
+    }
+
+    std::vector<Ptr> PhysicsSystem::getCollisions(const Ptr &ptr, int collisionGroup, int collisionMask)
+    {
+        std::vector<const OEngine::Physic::RigidBody*> bodies =
+            mEngine->getCollisions(ptr.getRefData().getBaseNode()->getName(), collisionGroup, collisionMask);
+
+        std::vector<Ptr> result;
+        result.reserve(bodies.size());
+        for (std::vector<const OEngine::Physic::RigidBody*>::const_iterator it = bodies.begin(); it != bodies.end(); ++it)
+        {
+            Ptr object = getPtr((*it)->mObjectId);
+            if (!object.isEmpty())
+                result.push_back(object);
+        }
+        return result;
     }
 
     Ogre::Vector3 PhysicsSystem::traceDown(const MWWorld::Ptr &ptr, float maxHeight)
@@ -680,6 +822,12 @@ namespace MWWorld
             mesh, node->getName(), ptr.getCellRef().getScale(), node->getPosition(), node->getOrientation(), 0, 0, false, placeable);
         mEngine->createAndAdjustRigidBody(
             mesh, node->getName(), ptr.getCellRef().getScale(), node->getPosition(), node->getOrientation(), 0, 0, true, placeable);
+        addObjectId(ptr);
+    }
+
+    void PhysicsSystem::preloadShape (const std::string& mesh, float scale)
+    {
+        mEngine->preloadShape(mesh, scale);
     }
 
     void PhysicsSystem::addActor (const Ptr& ptr, const std::string& mesh)
@@ -687,10 +835,18 @@ namespace MWWorld
         Ogre::SceneNode* node = ptr.getRefData().getBaseNode();
         //TODO:optimize this. Searching the std::map isn't very efficient i think.
         mEngine->addCharacter(node->getName(), mesh, node->getPosition(), node->getScale().x, node->getOrientation());
+        addObjectId(ptr);
     }
 
     void PhysicsSystem::removeObject (const std::string& handle)
     {
+        if (OEngine::Physic::PhysicActor* act = mEngine->getCharacter(handle))
+            removeObjectId(act->getObjectId());
+        else if (OEngine::Physic::RigidBody* body = mEngine->getRigidBody(handle))
+            removeObjectId(body->mObjectId);
+        else if (OEngine::Physic::RigidBody* body = mEngine->getRigidBody(handle, true))
+            removeObjectId(body->mObjectId);
+
         mEngine->removeCharacter(handle);
         mEngine->removeRigidBody(handle);
         mEngine->deleteRigidBody(handle);
@@ -701,22 +857,35 @@ namespace MWWorld
         Ogre::SceneNode *node = ptr.getRefData().getBaseNode();
         const std::string &handle = node->getName();
         const Ogre::Vector3 &position = node->getPosition();
+        int id = 0;
 
         if(OEngine::Physic::RigidBody *body = mEngine->getRigidBody(handle))
         {
             body->getWorldTransform().setOrigin(btVector3(position.x,position.y,position.z));
             mEngine->mDynamicsWorld->updateSingleAabb(body);
+            id = body->mObjectId;
         }
 
         if(OEngine::Physic::RigidBody *body = mEngine->getRigidBody(handle, true))
         {
             body->getWorldTransform().setOrigin(btVector3(position.x,position.y,position.z));
             mEngine->mDynamicsWorld->updateSingleAabb(body);
+            id = body->mObjectId;
         }
 
         // Actors update their AABBs every frame (DISABLE_DEACTIVATION), so no need to do it manually
         if(OEngine::Physic::PhysicActor *physact = mEngine->getCharacter(handle))
+        {
             physact->setPosition(position);
+            id = physact->getObjectId();
+        }
+
+        // The object may have been moved to another cell, and with it to another Ptr
+        if (id)
+        {
+            mObjects[id] = ptr;
+            ptr.getRefData().setObjectId(id);
+        }
     }
 
     void PhysicsSystem::rotateObject (const Ptr& ptr)
@@ -858,6 +1027,21 @@ namespace MWWorld
             mStandingCollisions.clear();
 
             const MWBase::World *world = MWBase::Environment::get().getWorld();
+            const MWWorld::Store<ESM::GameSetting>& gmst = world->getStore().get<ESM::GameSetting>();
+
+            MovementEnvironment environment;
+            environment.mSwimHeightScale = gmst.find("fSwimHeightScale")->getFloat();
+            environment.mStormWalkMult = gmst.find("fStromWalkMult")->getFloat();
+            environment.mInStorm = world->isInStorm();
+            environment.mStormDirection = world->getStormDirection();
+
+            // Everything that isn't specific to one actor or that changes the collision world is
+            // done here, before any movement is solved. Solving does not move the collision
+            // bodies, so the actors don't see each other's new positions and the results don't
+            // depend on the order in which the actors are solved.
+            std::vector<ActorMovement> movements;
+            movements.reserve(mMovementQueue.size());
+
             PtrVelocityList::iterator iter = mMovementQueue.begin();
             for(;iter != mMovementQueue.end();++iter)
             {
@@ -866,8 +1050,6 @@ namespace MWWorld
                 if(cell->getCell()->hasWater())
                     waterlevel = cell->getWaterLevel();
 
-                float oldHeight = iter->first.getRefData().getPosition().pos[2];
-
                 const MWMechanics::MagicEffects& effects = iter->first.getClass().getCreatureStats(iter->first).getMagicEffects();
 
                 bool waterCollision = false;
@@ -882,19 +1064,50 @@ namespace MWWorld
                     continue;
                 physicActor->setCanWaterWalk(waterCollision);
 
+                if (iter->first.getClass().isMobile(iter->first) && physicActor->getCollisionMode())
+                    iter->first.getClass().getMovementSettings(iter->first).mPosition[2] = 0;
+
+                ActorMovement movement;
+                movement.mPtr = iter->first;
+                movement.mPhysicActor = physicActor;
+                movement.mMovement = iter->second;
+                movement.mIsFlying = world->isFlying(iter->first);
+                movement.mWaterlevel = waterlevel;
                 // Slow fall reduces fall speed by a factor of (effect magnitude / 200)
-                float slowFall = 1.f - std::max(0.f, std::min(1.f, effects.get(ESM::MagicEffect::SlowFall).getMagnitude() * 0.005f));
+                movement.mSlowFall = 1.f - std::max(0.f, std::min(1.f, effects.get(ESM::MagicEffect::SlowFall).getMagnitude() * 0.005f));
+                movement.mCollision = -1;
+                movement.mStandingCollision = -1;
+                movements.push_back(movement);
+            }
 
-                Ogre::Vector3 newpos = MovementSolver::move(iter->first, iter->second, mTimeAccum,
-                                                            world->isFlying(iter->first),
-                                                            waterlevel, slowFall, mEngine, mCollisions, mStandingCollisions);
+            if (mWorkers.get() && movements.size() > 1)
+            {
+                // A few ranges per thread, so that a thread that got a range of cheap actors can
+                // help with the others
+                size_t ranges = std::min(movements.size(), static_cast<size_t>(mWorkers->getThreadCount() * 4));
+                for (size_t i = 0; i < ranges; ++i)
+                    mWorkers->push(boost::bind(&MovementSolver::solve, boost::ref(movements),
+                        movements.size() * i / ranges, movements.size() * (i+1) / ranges, mTimeAccum,
+                        boost::cref(environment), mEngine));
+                mWorkers->wait();
+            }
+            else
+                MovementSolver::solve(movements, 0, movements.size(), mTimeAccum, environment, mEngine);
 
-                float heightDiff = newpos.z - oldHeight;
+            for (std::vector<ActorMovement>::const_iterator it = movements.begin(); it != movements.end(); ++it)
+            {
+                float heightDiff = it->mPosition.z - it->mPtr.getRefData().getPosition().pos[2];
 
                 if (heightDiff < 0)
-                    iter->first.getClass().getCreatureStats(iter->first).addToFallHeight(-heightDiff);
+                    it->mPtr.getClass().getCreatureStats(it->mPtr).addToFallHeight(-heightDiff);
+
+                int actorId = it->mPhysicActor->getObjectId();
+                if (it->mCollision != -1)
+                    mCollisions[actorId] = it->mCollision;
+                if (it->mStandingCollision != -1)
+                    mStandingCollisions[actorId] = it->mStandingCollision;
 
-                mMovementResults.push_back(std::make_pair(iter->first, newpos));
+                mMovementResults.push_back(std::make_pair(it->mPtr, it->mPosition));
             }
 
             mTimeAccum = 0.0f;
@@ -906,61 +1119,57 @@ namespace MWWorld
 
     void PhysicsSystem::stepSimulation(float dt)
     {
-        animateCollisionShapes(mEngine->mAnimatedShapes, mEngine->mDynamicsWorld);
-        animateCollisionShapes(mEngine->mAnimatedRaycastingShapes, mEngine->mDynamicsWorld);
+        animateCollisionShapes(mEngine->mAnimatedShapes, mEngine->mDynamicsWorld, *this);
+        animateCollisionShapes(mEngine->mAnimatedRaycastingShapes, mEngine->mDynamicsWorld, *this);
 
         mEngine->stepSimulation(dt);
     }
 
     bool PhysicsSystem::isActorStandingOn(const Ptr &actor, const Ptr &object) const
     {
-        const std::string& actorHandle = actor.getRefData().getHandle();
-        const std::string& objectHandle = object.getRefData().getHandle();
+        int objectId = getObjectId(object);
+        if (!objectId)
+            return false;
 
-        for (std::map<std::string, std::string>::const_iterator it = mStandingCollisions.begin();
-             it != mStandingCollisions.end(); ++it)
-        {
-            if (it->first == actorHandle && it->second == objectHandle)
-                return true;
-        }
-        return false;
+        std::map<int, int>::const_iterator it = mStandingCollisions.find(getObjectId(actor));
+        return it != mStandingCollisions.end() && it->second == objectId;
     }
 
-    void PhysicsSystem::getActorsStandingOn(const Ptr &object, std::vector<std::string> &out) const
+    void PhysicsSystem::getActorsStandingOn(const Ptr &object, std::vector<Ptr> &out) const
     {
-        const std::string& objectHandle = object.getRefData().getHandle();
+        int objectId = getObjectId(object);
+        if (!objectId)
+            return;
 
-        for (std::map<std::string, std::string>::const_iterator it = mStandingCollisions.begin();
+        for (std::map<int, int>::const_iterator it = mStandingCollisions.begin();
              it != mStandingCollisions.end(); ++it)
         {
-            if (it->second == objectHandle)
-                out.push_back(it->first);
+            if (it->second == objectId)
+                out.push_back(getPtr(it->first));
         }
     }
 
     bool PhysicsSystem::isActorCollidingWith(const Ptr &actor, const Ptr &object) const
     {
-        const std::string& actorHandle = actor.getRefData().getHandle();
-        const std::string& objectHandle = object.getRefData().getHandle();
+        int objectId = getObjectId(object);
+        if (!objectId)
+            return false;
 
-        for (std::map<std::string, std::string>::const_iterator it = mCollisions.begin();
-             it != mCollisions.end(); ++it)
-        {
-            if (it->first == actorHandle && it->second == objectHandle)
-                return true;
-        }
-        return false;
+        std::map<int, int>::const_iterator it = mCollisions.find(getObjectId(actor));
+        return it != mCollisions.end() && it->second == objectId;
     }
 
-    void PhysicsSystem::getActorsCollidingWith(const Ptr &object, std::vector<std::string> &out) const
+    void PhysicsSystem::getActorsCollidingWith(const Ptr &object, std::vector<Ptr> &out) const
     {
-        const std::string& objectHandle = object.getRefData().getHandle();
+        int objectId = getObjectId(object);
+        if (!objectId)
+            return;
 
-        for (std::map<std::string, std::string>::const_iterator it = mCollisions.begin();
+        for (std::map<int, int>::const_iterator it = mCollisions.begin();
              it != mCollisions.end(); ++it)
         {
-            if (it->second == objectHandle)
-                out.push_back(it->first);
+            if (it->second == objectId)
+                out.push_back(getPtr(it->first));
         }
     }
 
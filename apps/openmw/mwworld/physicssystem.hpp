@@ -2,6 +2,8 @@
 #define GAME_MWWORLD_PHYSICSSYSTEM_H
 
 #include <memory>
+#include <map>
+#include <vector>
 
 #include <OgreVector3.h>
 
@@ -10,6 +12,11 @@
 #include "ptr.hpp"
 
 
+namespace Misc
+{
+    class ThreadPool;
+}
+
 namespace OEngine
 {
     namespace Render
@@ -19,6 +26,9 @@ namespace OEngine
     namespace Physic
     {
         class PhysicEngine;
+        class RigidBody;
+        struct RayQuery;
+        struct RayQueryResult;
     }
 }
 
@@ -42,6 +52,9 @@ namespace MWWorld
 
             void addActor (const MWWorld::Ptr& ptr, const std::string& mesh);
 
+            void preloadShape (const std::string& mesh, float scale);
+            ///< Build the collision shape that addObject will need for \a mesh at \a scale.
+
             void addHeightField (float* heights,
                 int x, int y, float yoffset,
                 float triSize, float sqrtVerts);
@@ -61,16 +74,17 @@ namespace MWWorld
 
             void stepSimulation(float dt);
 
-            std::vector<std::string> getCollisions(const MWWorld::Ptr &ptr, int collisionGroup, int collisionMask); ///< get handles this object collides with
+            std::vector<Ptr> getCollisions(const MWWorld::Ptr &ptr, int collisionGroup, int collisionMask); ///< get objects this object collides with
             Ogre::Vector3 traceDown(const MWWorld::Ptr &ptr, float maxHeight);
 
-            std::pair<float, std::string> getFacedHandle(float queryDistance);
-            std::pair<std::string,Ogre::Vector3> getHitContact(const std::string &name,
-                                                               const Ogre::Vector3 &origin,
-                                                               const Ogre::Quaternion &orientation,
-                                                               float queryDistance);
-            std::vector < std::pair <float, std::string> > getFacedHandles (float queryDistance);
-            std::vector < std::pair <float, std::string> > getFacedHandles (float mouseX, float mouseY, float queryDistance);
+            /// \note Results with an empty Ptr are bodies that don't belong to an object (terrain).
+            std::pair<float, Ptr> getFacedObject(float queryDistance);
+            std::pair<Ptr,Ogre::Vector3> getHitContact(const Ptr &actor,
+                                                       const Ogre::Vector3 &origin,
+                                                       const Ogre::Quaternion &orientation,
+                                                       float queryDistance);
+            std::vector < std::pair <float, Ptr> > getFacedObjects (float queryDistance);
+            std::vector < std::pair <float, Ptr> > getFacedObjects (float mouseX, float mouseY, float queryDistance);
 
             // cast ray, return true if it hit something. if raycasringObjectOnlt is set to false, it ignores NPCs and objects with no collisions.
             bool castRay(const Ogre::Vector3& from, const Ogre::Vector3& to, bool raycastingObjectOnly = true,bool ignoreHeightMap = false);
@@ -78,13 +92,21 @@ namespace MWWorld
             std::pair<bool, Ogre::Vector3>
             castRay(const Ogre::Vector3 &orig, const Ogre::Vector3 &dir, float len);
 
-            std::pair<bool, Ogre::Vector3> castRay(float mouseX, float mouseY, Ogre::Vector3* normal = NULL, std::string* hit = NULL);
+            std::pair<bool, Ogre::Vector3> castRay(float mouseX, float mouseY, Ogre::Vector3* normal = NULL, Ptr* hit = NULL);
             ///< cast ray from the mouse, return true if it hit something and the first result
             /// @param normal if non-NULL, the hit normal will be written there (if there is a hit)
-            /// @param hit if non-NULL, the string handle of the hit object will be written there (if there is a hit)
+            /// @param hit if non-NULL, the hit object will be written there (if there is a hit)
+
+            /// Run independent ray and sphere queries together, on the worker threads if enabled.
+            void queryBatch(const std::vector<OEngine::Physic::RayQuery>& queries,
+                            std::vector<OEngine::Physic::RayQueryResult>& results);
 
             OEngine::Physic::PhysicEngine* getEngine();
 
+            /// Return the object with the given ID (see RefData::getObjectId), or an empty Ptr if
+            /// the ID is not in use.
+            Ptr getPtr (int objectId) const;
+
             bool getObjectAABB(const MWWorld::Ptr &ptr, Ogre::Vector3 &min, Ogre::Vector3 &max);
 
             /// Queues velocity movement for a Ptr. If a Ptr is already queued, its velocity will
@@ -102,36 +124,57 @@ namespace MWWorld
             /// It doesn't matter if the actor is stationary or moving.
             bool isActorStandingOn(const MWWorld::Ptr& actor, const MWWorld::Ptr& object) const;
 
-            /// Get the handle of all actors standing on \a object in this frame.
-            void getActorsStandingOn(const MWWorld::Ptr& object, std::vector<std::string>& out) const;
+            /// Get all actors standing on \a object in this frame.
+            void getActorsStandingOn(const MWWorld::Ptr& object, std::vector<Ptr>& out) const;
 
             /// Return true if \a actor has collided with \a object in this frame.
             /// This will detect running into objects, but will not detect climbing stairs, stepping up a small object, etc.
             bool isActorCollidingWith(const MWWorld::Ptr& actor, const MWWorld::Ptr& object) const;
 
-            /// Get the handle of all actors colliding with \a object in this frame.
-            void getActorsCollidingWith(const MWWorld::Ptr& object, std::vector<std::string>& out) const;
+            /// Get all actors colliding with \a object in this frame.
+            void getActorsCollidingWith(const MWWorld::Ptr& object, std::vector<Ptr>& out) const;
 
         private:
 
             void updateWater();
 
+            /// Give \a ptr an ID and assign it to the bodies with the handle of \a ptr.
+            void addObjectId (const Ptr& ptr);
+
+            void removeObjectId (int id);
+
+            /// Return the ID of \a ptr, or 0 if the ID is not (or no longer) in use by \a ptr.
+            int getObjectId (const Ptr& ptr) const;
+
+            /// Resolve ray test hits to objects, scaling the distances by \a queryDistance.
+            std::vector < std::pair <float, Ptr> > toObjects (
+                const std::vector < std::pair <float, const OEngine::Physic::RigidBody*> >& hits,
+                float queryDistance) const;
+
             OEngine::Render::OgreRenderer &mRender;
             OEngine::Physic::PhysicEngine* mEngine;
             std::map<std::string, std::string> handleToMesh;
 
-            // Tracks all movement collisions happening during a single frame. <actor handle, collided handle>
+            // Objects by ID. IDs are indices into this vector; 0 is never used, so that it can stand
+            // for no object.
+            std::vector<Ptr> mObjects;
+            std::vector<int> mFreeObjectIds;
+
+            // Tracks all movement collisions happening during a single frame. <actor ID, collided ID>
             // This will detect e.g. running against a vertical wall. It will not detect climbing up stairs,
             // stepping up small objects, etc.
-            std::map<std::string, std::string> mCollisions;
+            std::map<int, int> mCollisions;
 
-            std::map<std::string, std::string> mStandingCollisions;
+            std::map<int, int> mStandingCollisions;
 
             PtrVelocityList mMovementQueue;
             PtrVelocityList mMovementResults;
 
             float mTimeAccum;
 
+            /// Solves actor movements and batched queries in parallel, if enabled
+            std::auto_ptr<Misc::ThreadPool> mWorkers;
+
             float mWaterHeight;
             float mWaterEnabled;
 
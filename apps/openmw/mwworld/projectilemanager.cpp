@@ -11,6 +11,7 @@
 #include "../mwworld/class.hpp"
 #include "../mwworld/esmstore.hpp"
 #include "../mwworld/inventorystore.hpp"
+#include "../mwworld/physicssystem.hpp"
 
 #include "../mwbase/soundmanager.hpp"
 #include "../mwbase/world.hpp"
@@ -29,8 +30,9 @@
 namespace MWWorld
 {
 
-    ProjectileManager::ProjectileManager(Ogre::SceneManager* sceneMgr, OEngine::Physic::PhysicEngine &engine)
-        : mPhysEngine(engine)
+    ProjectileManager::ProjectileManager(Ogre::SceneManager* sceneMgr, PhysicsSystem &physics)
+        : mPhysics(physics)
+        , mPhysEngine(*physics.getEngine())
         , mSceneMgr(sceneMgr)
     {
 
@@ -166,12 +168,12 @@ namespace MWWorld
             btVector3 from(pos.x, pos.y, pos.z);
             btVector3 to(newPos.x, newPos.y, newPos.z);
 
-            std::vector<std::pair<float, std::string> > collisions = mPhysEngine.rayTest2(from, to, OEngine::Physic::CollisionType_Projectile);
+            std::vector<std::pair<float, const OEngine::Physic::RigidBody*> > collisions = mPhysEngine.rayTest2(from, to, OEngine::Physic::CollisionType_Projectile);
             bool hit=false;
 
-            for (std::vector<std::pair<float, std::string> >::iterator cIt = collisions.begin(); cIt != collisions.end() && !hit; ++cIt)
+            for (std::vector<std::pair<float, const OEngine::Physic::RigidBody*> >::iterator cIt = collisions.begin(); cIt != collisions.end() && !hit; ++cIt)
             {
-                MWWorld::Ptr obstacle = MWBase::Environment::get().getWorld()->searchPtrViaHandle(cIt->second);
+                MWWorld::Ptr obstacle = mPhysics.getPtr(cIt->second->mObjectId);
 
                 MWWorld::Ptr caster = MWBase::Environment::get().getWorld()->searchPtrViaHandle(it->mCasterHandle);
                 if (caster.isEmpty())
@@ -242,12 +244,12 @@ namespace MWWorld
             // TODO: use a proper btRigidBody / btGhostObject?
             btVector3 from(pos.x, pos.y, pos.z);
             btVector3 to(newPos.x, newPos.y, newPos.z);
-            std::vector<std::pair<float, std::string> > collisions = mPhysEngine.rayTest2(from, to, OEngine::Physic::CollisionType_Projectile);
+            std::vector<std::pair<float, const OEngine::Physic::RigidBody*> > collisions = mPhysEngine.rayTest2(from, to, OEngine::Physic::CollisionType_Projectile);
             bool hit=false;
 
-            for (std::vector<std::pair<float, std::string> >::iterator cIt = collisions.begin(); cIt != collisions.end() && !hit; ++cIt)
+            for (std::vector<std::pair<float, const OEngine::Physic::RigidBody*> >::iterator cIt = collisions.begin(); cIt != collisions.end() && !hit; ++cIt)
             {
-                MWWorld::Ptr obstacle = MWBase::Environment::get().getWorld()->searchPtrViaHandle(cIt->second);
+                MWWorld::Ptr obstacle = mPhysics.getPtr(cIt->second->mObjectId);
 
                 MWWorld::Ptr caster = MWBase::Environment::get().getWorld()->searchPtrViaActorId(it->mActorId);
 
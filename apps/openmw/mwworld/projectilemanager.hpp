@@ -32,12 +32,12 @@ namespace Ogre
 
 namespace MWWorld
 {
+    class PhysicsSystem;
 
     class ProjectileManager
     {
     public:
-        ProjectileManager (Ogre::SceneManager* sceneMgr,
-                OEngine::Physic::PhysicEngine& engine);
+        ProjectileManager (Ogre::SceneManager* sceneMgr, PhysicsSystem& physics);
 
         /// If caster is an actor, the actor's facing orientation is used. Otherwise fallbackDirection is used.
         void launchMagicBolt (const std::string& model, const std::string &sound, const std::string &spellId,
@@ -57,6 +57,7 @@ namespace MWWorld
         int countSavedGameRecords() const;
 
     private:
+        PhysicsSystem& mPhysics;
         OEngine::Physic::PhysicEngine& mPhysEngine;
         Ogre::SceneManager* mSceneMgr;
 
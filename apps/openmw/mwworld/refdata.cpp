@@ -16,6 +16,7 @@ namespace MWWorld
     void RefData::copy (const RefData& refData)
     {
         mBaseNode = refData.mBaseNode;
+        mObjectId = refData.mObjectId;
         mLocals = refData.mLocals;
         mHasLocals = refData.mHasLocals;
         mEnabled = refData.mEnabled;
@@ -31,13 +32,14 @@ namespace MWWorld
     void RefData::cleanup()
     {
         mBaseNode = 0;
+        mObjectId = 0;
 
         delete mCustomData;
         mCustomData = 0;
     }
 
     RefData::RefData()
-    : mBaseNode(0), mDeleted(false), mHasLocals (false), mEnabled (true), mCount (1), mCustomData (0), mChanged(false)
+    : mBaseNode(0), mBaseNodeChanges (0), mObjectId (0), mDeleted(false), mHasLocals (false), mEnabled (true), mCount (1), mCustomData (0), mChanged(false)
     {
         for (int i=0; i<3; ++i)
         {
@@ -48,7 +50,7 @@ namespace MWWorld
     }
 
     RefData::RefData (const ESM::CellRef& cellRef)
-    : mBaseNode(0), mDeleted(false),  mHasLocals (false), mEnabled (true),
+    : mBaseNode(0), mBaseNodeChanges (0), mObjectId (0), mDeleted(false),  mHasLocals (false), mEnabled (true),
       mCount (1), mPosition (cellRef.mPos),
       mCustomData (0),
       mChanged(false) // Loading from ESM/ESP files -> assume unchanged
@@ -59,7 +61,7 @@ namespace MWWorld
     }
 
     RefData::RefData (const ESM::ObjectState& objectState)
-    : mBaseNode (0), mDeleted(false), mHasLocals (false),
+    : mBaseNode (0), mBaseNodeChanges (0), mObjectId (0), mDeleted(false), mHasLocals (false),
       mEnabled (objectState.mEnabled != 0),
       mCount (objectState.mCount),
       mPosition (objectState.mPosition),
@@ -71,7 +73,7 @@ namespace MWWorld
     }
 
     RefData::RefData (const RefData& refData)
-    : mBaseNode(0), mCustomData (0)
+    : mBaseNode(0), mBaseNodeChanges (0), mObjectId (0), mCustomData (0)
     {
         try
         {
@@ -101,6 +103,9 @@ namespace MWWorld
 
     RefData& RefData::operator= (const RefData& refData)
     {
+        if (mBaseNodeChanges && (mBaseNode || refData.mBaseNode))
+            ++*mBaseNodeChanges;
+
         try
         {
             cleanup();
@@ -144,6 +149,27 @@ namespace MWWorld
     void RefData::setBaseNode(Ogre::SceneNode* base)
     {
          mBaseNode = base;
+
+         if (mBaseNodeChanges)
+             ++*mBaseNodeChanges;
+
+         if (!base)
+             mObjectId = 0;
+    }
+
+    void RefData::setBaseNodeChanges (unsigned int *changes)
+    {
+        mBaseNodeChanges = changes;
+    }
+
+    int RefData::getObjectId() const
+    {
+        return mObjectId;
+    }
+
+    void RefData::setObjectId (int id)
+    {
+        mObjectId = id;
     }
 
     int RefData::getCount() const
@@ -29,6 +29,10 @@ namespace MWWorld
     {
             Ogre::SceneNode* mBaseNode;
 
+            unsigned int *mBaseNodeChanges; // counter of the CellRefList holding this reference, or 0
+
+            int mObjectId;
+
 
             MWScript::Locals mLocals; // if we find the overhead of heaving a locals
                                       // object in the refdata of refs without a script,
@@ -83,6 +87,17 @@ namespace MWWorld
             /// Set OGRE base node (can be a null pointer).
             void setBaseNode (Ogre::SceneNode* base);
 
+            /// Increase \a changes whenever the base node, and with it the handle, changes. Used by
+            /// CellRefList to tell when its lookups by handle need to be redone. Copies of this
+            /// RefData do not increase it.
+            void setBaseNodeChanges (unsigned int *changes);
+
+            /// Return the ID the physics system has given to this object (0: none). Only valid
+            /// while the object has a base node.
+            int getObjectId() const;
+
+            void setObjectId (int id);
+
             int getCount() const;
 
             void setLocals (const ESM::Script& script);
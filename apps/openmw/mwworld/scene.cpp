@@ -3,6 +3,7 @@
 #include <OgreSceneNode.h>
 
 #include <components/nif/niffile.hpp>
+#include <components/nifcache/nifcache.hpp>
 #include <components/misc/resourcehelpers.hpp>
 
 #include "../mwbase/environment.hpp"
@@ -113,6 +114,25 @@ namespace
 
         return true;
     }
+
+    /// Start loading the models of a cell in the background, while the main thread is still busy
+    /// with inserting objects.
+    struct PreloadFunctor
+    {
+        bool operator() (const MWWorld::Ptr& ptr)
+        {
+            if (!ptr.getRefData().isDeleted() && ptr.getRefData().isEnabled())
+            {
+                std::string model =
+                    Misc::ResourceHelpers::correctActorModelPath (ptr.getClass().getModel (ptr));
+
+                if (!model.empty())
+                    Nif::Cache::getInstance().loadInBackground (model);
+            }
+
+            return true;
+        }
+    };
 }
 
 
@@ -162,7 +182,7 @@ namespace MWWorld
             // Note: exterior cell maps must be updated, even if they were visited before, because the set of surrounding cells might be different
             // (and objects in a different cell can "bleed" into another cells map if they cross the border)
             for (CellStoreCollection::iterator active = mActiveCells.begin(); active!=mActiveCells.end(); ++active)
-                mRendering.requestMap(*active);
+                mRendering.requestMap(*active, mActiveCells);
             mNeedMapUpdate = false;
 
             if (mCurrentCell->isExterior())
@@ -173,6 +193,22 @@ namespace MWWorld
             }
         }
 
+        if (!paused && mCurrentCell && mCurrentCell->isExterior() && duration>0)
+        {
+            Ogre::Vector3 position (
+                MWBase::Environment::get().getWorld()->getPlayerPtr().getRefData().getPosition().pos);
+
+            if (mHasLastPlayerPosition)
+            {
+                int cellX, cellY;
+                getGridCenter(cellX, cellY);
+                mPreloader.update (position, (position-mLastPlayerPosition) / duration, cellX, cellY, mActiveCells);
+            }
+
+            mLastPlayerPosition = position;
+            mHasLastPlayerPosition = true;
+        }
+
         mRendering.update (duration, paused);
     }
 
@@ -282,6 +318,8 @@ namespace MWWorld
             unloadCell (active++);
         assert(mActiveCells.empty());
         mCurrentCell = NULL;
+        mPreloader.clear();
+        mHasLastPlayerPosition = false;
     }
 
     void Scene::playerMoved(const Ogre::Vector3 &pos)
@@ -360,6 +398,8 @@ namespace MWWorld
         loadingListener->setProgressRange(refsToLoad);
 
         // Load cells
+        std::vector<CellStore *> cellsToLoad;
+
         for (int x=X-halfGridSize; x<=X+halfGridSize; ++x)
         {
             for (int y=Y-halfGridSize; y<=Y+halfGridSize; ++y)
@@ -381,11 +421,17 @@ namespace MWWorld
                 {
                     CellStore *cell = MWBase::Environment::get().getWorld()->getExterior(x, y);
 
-                    loadCell (cell, loadingListener);
+                    PreloadFunctor preload;
+                    cell->forEachUnchanged (preload);
+
+                    cellsToLoad.push_back (cell);
                 }
             }
         }
 
+        for (std::vector<CellStore *>::iterator iter (cellsToLoad.begin()); iter!=cellsToLoad.end(); ++iter)
+            loadCell (*iter, loadingListener);
+
         CellStore* current = MWBase::Environment::get().getWorld()->getExterior(X,Y);
         MWBase::Environment::get().getWindowManager()->changeCell(current);
 
@@ -429,7 +475,8 @@ namespace MWWorld
 
     //We need the ogre renderer and a scene node.
     Scene::Scene (MWRender::RenderingManager& rendering, PhysicsSystem *physics)
-    : mCurrentCell (0), mCellChanged (false), mPhysics(physics), mRendering(rendering), mNeedMapUpdate(false)
+    : mCurrentCell (0), mCellChanged (false), mPhysics(physics), mRendering(rendering), mNeedMapUpdate(false),
+      mPreloader (*physics), mLastPlayerPosition (Ogre::Vector3::ZERO), mHasLastPlayerPosition (false)
     {
     }
 
@@ -489,9 +536,15 @@ namespace MWWorld
             ++current;
         }
 
+        mPreloader.clear();
+        mHasLastPlayerPosition = false;
+
         int refsToLoad = cell->count();
         loadingListener->setProgressRange(refsToLoad);
 
+        PreloadFunctor preload;
+        cell->forEachUnchanged (preload);
+
         // Load cell.
         loadCell (cell, loadingListener);
 
@@ -519,6 +572,9 @@ namespace MWWorld
 
         MWBase::Environment::get().getWorld()->positionToIndex (position.pos[0], position.pos[1], x, y);
 
+        // a teleport, not a movement to predict the next cells from
+        mHasLastPlayerPosition = false;
+
         changeCellGrid(x, y);
 
         CellStore* current = MWBase::Environment::get().getWorld()->getExterior(x, y);
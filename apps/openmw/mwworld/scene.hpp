@@ -1,10 +1,13 @@
 #ifndef GAME_MWWORLD_SCENE_H
 #define GAME_MWWORLD_SCENE_H
 
+#include <OgreVector3.h>
+
 #include "../mwrender/renderingmanager.hpp"
 
 #include "ptr.hpp"
 #include "globals.hpp"
+#include "cellpreloader.hpp"
 
 namespace Ogre
 {
@@ -60,6 +63,10 @@ namespace MWWorld
 
             bool mNeedMapUpdate;
 
+            CellPreloader mPreloader;
+            Ogre::Vector3 mLastPlayerPosition;
+            bool mHasLastPlayerPosition; // false after a cell change that is not a movement
+
             void insertCell (CellStore &cell, bool rescale, Loading::Listener* loadingListener);
 
             // Load and unload cells as necessary to create a cell grid with "X" and "Y" in the center
@@ -3,6 +3,78 @@
 
 #include <components/esm/esmreader.hpp>
 
+namespace
+{
+    void writeSnapshotContext(ESM::ESMWriter& writer, const ESM::ESM_Context& context)
+    {
+        writer.writeHNString("CTXF", context.filename);
+
+        writer.startSubRecord("CTXT");
+        writer.writeT(context.leftRec);
+        writer.writeT(context.leftSub);
+        writer.writeT(static_cast<uint64_t>(context.leftFile));
+        writer.writeT(context.recName);
+        writer.writeT(context.subName);
+        writer.writeT(context.index);
+        writer.writeT(static_cast<unsigned char>(context.subCached));
+        writer.writeT(static_cast<uint64_t>(context.filePos));
+        writer.endRecord("CTXT");
+    }
+
+    /// \note The CTXF subrecord name must have been read already
+    ESM::ESM_Context readSnapshotContext(ESM::ESMReader& esm)
+    {
+        ESM::ESM_Context context;
+        context.filename = esm.getHString();
+
+        uint64_t leftFile;
+        unsigned char subCached;
+        uint64_t filePos;
+
+        esm.getSubNameIs("CTXT");
+        esm.getSubHeader();
+        esm.getT(context.leftRec);
+        esm.getT(context.leftSub);
+        esm.getT(leftFile);
+        esm.getT(context.recName);
+        esm.getT(context.subName);
+        esm.getT(context.index);
+        esm.getT(subCached);
+        esm.getT(filePos);
+
+        context.leftFile = static_cast<size_t>(leftFile);
+        context.subCached = subCached != 0;
+        context.filePos = static_cast<size_t>(filePos);
+        return context;
+    }
+
+    void writeSnapshotCell(ESM::ESMWriter& writer, const ESM::Cell& cell)
+    {
+        writer.startRecord(ESM::REC_CELL);
+        writer.writeHNString("NAME", cell.mName);
+        writer.writeHNT("DATA", cell.mData, 12);
+        writer.writeHNCString("RGNN", cell.mRegion);
+        writer.writeHNT("AMBI", cell.mAmbi, 16);
+        writer.writeHNT("WHGT", cell.mWater);
+        writer.writeHNT("WINT", static_cast<int>(cell.mWaterInt));
+        writer.writeHNT("NAM5", cell.mMapColor);
+        writer.writeHNT("NAM0", cell.mRefNumCounter);
+
+        for (std::vector<ESM::ESM_Context>::const_iterator it = cell.mContextList.begin(); it != cell.mContextList.end(); ++it)
+            writeSnapshotContext(writer, *it);
+
+        for (ESM::MovedCellRefTracker::const_iterator it = cell.mMovedRefs.begin(); it != cell.mMovedRefs.end(); ++it)
+            writer.writeHNT("MOVE", *it);
+
+        // Leased references keep their content file, so they have to be written with wide RefNums
+        writer.writeHNT("LEAS", static_cast<int>(cell.mLeasedRefs.size()));
+        for (ESM::CellRefTracker::const_iterator it = cell.mLeasedRefs.begin(); it != cell.mLeasedRefs.end(); ++it)
+            it->save(writer, true);
+
+        writer.endRecord(ESM::REC_CELL);
+    }
+}
+
 namespace MWWorld {
 
 void Store<ESM::Cell>::handleMovedCellRefs(ESM::ESMReader& esm, ESM::Cell* cell)
@@ -124,4 +196,167 @@ void Store<ESM::LandTexture>::load(ESM::ESMReader &esm, const std::string &id)
     load(esm, id, esm.getIndex());
 }
 
+void Store<ESM::LandTexture>::writeSnapshot(ESM::ESMWriter &writer) const
+{
+    for (size_t plugin = 0; plugin < mStatic.size(); ++plugin)
+    {
+        // Unused slots are written as well, so that the indices stay the same
+        const LandTextureList &ltexl = mStatic[plugin];
+        for (size_t index = 0; index < ltexl.size(); ++index)
+        {
+            writer.startRecord(ESM::REC_LTEX);
+            writer.writeHNString("NAME", ltexl[index].mId);
+            writer.writeHNT("PLGN", static_cast<int>(plugin));
+            writer.writeHNT("INDX", static_cast<int>(index));
+            ltexl[index].save(writer);
+            writer.endRecord(ESM::REC_LTEX);
+        }
+    }
+}
+
+void Store<ESM::LandTexture>::readSnapshot(ESM::ESMReader &esm, const std::string &id)
+{
+    int plugin;
+    int index;
+    esm.getHNT(plugin, "PLGN");
+    esm.getHNT(index, "INDX");
+
+    ESM::LandTexture lt;
+    lt.load(esm);
+    lt.mId = id;
+
+    if (plugin >= (int)mStatic.size())
+        mStatic.resize(plugin+1);
+
+    LandTextureList &ltexl = mStatic[plugin];
+    if (index >= (int)ltexl.size())
+        ltexl.resize(index+1);
+
+    ltexl[index] = lt;
+}
+
+void Store<ESM::Land>::writeSnapshot(ESM::ESMWriter &writer) const
+{
+    for (std::vector<ESM::Land *>::const_iterator it = mStatic.begin(); it != mStatic.end(); ++it)
+    {
+        const ESM::Land &land = **it;
+
+        writer.startRecord(ESM::REC_LAND);
+        writer.writeHNString("NAME", "");
+        writer.startSubRecord("INTV");
+        writer.writeT(land.mX);
+        writer.writeT(land.mY);
+        writer.endRecord("INTV");
+        writer.writeHNT("DATA", land.mFlags);
+        writer.writeHNT("DTYP", land.mDataTypes);
+        writeSnapshotContext(writer, land.mContext);
+        writer.endRecord(ESM::REC_LAND);
+    }
+}
+
+void Store<ESM::Land>::readSnapshot(ESM::ESMReader &esm, const std::string &id)
+{
+    std::auto_ptr<ESM::Land> land(new ESM::Land());
+
+    esm.getSubNameIs("INTV");
+    esm.getSubHeaderIs(8);
+    esm.getT(land->mX);
+    esm.getT(land->mY);
+    esm.getHNT(land->mFlags, "DATA");
+    esm.getHNT(land->mDataTypes, "DTYP");
+    esm.getSubNameIs("CTXF");
+    land->mContext = readSnapshotContext(esm);
+
+    // The land data is read from the content file's reader, like after a regular load
+    land->mPlugin = land->mContext.index;
+    land->mEsm = &esm.getGlobalReaderList()->at(land->mPlugin);
+
+    mStatic.push_back(land.release());
+}
+
+void Store<ESM::Cell>::writeSnapshot(ESM::ESMWriter &writer) const
+{
+    for (DynamicInt::const_iterator it = mInt.begin(); it != mInt.end(); ++it)
+        writeSnapshotCell(writer, it->second);
+
+    for (DynamicExt::const_iterator it = mExt.begin(); it != mExt.end(); ++it)
+        writeSnapshotCell(writer, it->second);
+}
+
+void Store<ESM::Cell>::readSnapshot(ESM::ESMReader &esm, const std::string &id)
+{
+    ESM::Cell cell;
+    cell.mName = id;
+
+    esm.getHNT(cell.mData, "DATA", 12);
+    cell.mRegion = esm.getHNString("RGNN");
+    esm.getHNT(cell.mAmbi, "AMBI", 16);
+    esm.getHNT(cell.mWater, "WHGT");
+    int waterInt;
+    esm.getHNT(waterInt, "WINT");
+    cell.mWaterInt = waterInt != 0;
+    esm.getHNT(cell.mMapColor, "NAM5");
+    esm.getHNT(cell.mRefNumCounter, "NAM0");
+
+    while (esm.isNextSub("CTXF"))
+        cell.mContextList.push_back(readSnapshotContext(esm));
+
+    while (esm.isNextSub("MOVE"))
+    {
+        ESM::MovedCellRef ref;
+        esm.getHT(ref);
+        cell.mMovedRefs.push_back(ref);
+    }
+
+    int leased;
+    esm.getHNT(leased, "LEAS");
+    for (int i = 0; i < leased; ++i)
+    {
+        ESM::CellRef ref;
+        ref.load(esm, true);
+        cell.mLeasedRefs.push_back(ref);
+    }
+
+    if (cell.mData.mFlags & ESM::Cell::Interior)
+        mInt[Misc::StringUtils::lowerCase(id)] = cell;
+    else
+        mExt[std::make_pair(cell.mData.mX, cell.mData.mY)] = cell;
+}
+
+void Store<ESM::Pathgrid>::writeSnapshot(ESM::ESMWriter &writer) const
+{
+    // Whether a pathgrid belongs to an interior is stored explicitly, as the cells may not be loaded yet
+    for (Interior::const_iterator it = mInt.begin(); it != mInt.end(); ++it)
+    {
+        writer.startRecord(ESM::REC_PGRD);
+        writer.writeHNString("NAME", "");
+        writer.writeHNT("INTR", 1);
+        it->second.save(writer);
+        writer.endRecord(ESM::REC_PGRD);
+    }
+
+    for (Exterior::const_iterator it = mExt.begin(); it != mExt.end(); ++it)
+    {
+        writer.startRecord(ESM::REC_PGRD);
+        writer.writeHNString("NAME", "");
+        writer.writeHNT("INTR", 0);
+        it->second.save(writer);
+        writer.endRecord(ESM::REC_PGRD);
+    }
+}
+
+void Store<ESM::Pathgrid>::readSnapshot(ESM::ESMReader &esm, const std::string &id)
+{
+    int interior;
+    esm.getHNT(interior, "INTR");
+
+    ESM::Pathgrid pathgrid;
+    pathgrid.load(esm);
+
+    if (interior)
+        mInt[pathgrid.mCell] = pathgrid;
+    else
+        mExt[std::make_pair(pathgrid.mData.mX, pathgrid.mData.mY)] = pathgrid;
+}
+
 }
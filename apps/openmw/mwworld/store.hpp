@@ -4,9 +4,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <stdexcept>
 #include <sstream>
 
+#include <boost/unordered_map.hpp>
+
 #include <openengine/misc/rng.hpp>
 
 #include <components/esm/esmwriter.hpp>
@@ -17,6 +20,22 @@
 
 namespace MWWorld
 {
+    /// Record that has been loaded outside of its store, see StoreBase::parse.
+    struct LoadedRecord
+    {
+        virtual ~LoadedRecord() {}
+
+        virtual const std::string &getId() const = 0;
+    };
+
+    template <class T>
+    struct LoadedRecordT : public LoadedRecord
+    {
+        T mRecord;
+
+        const std::string &getId() const { return mRecord.mId; }
+    };
+
     struct StoreBase
     {
         virtual ~StoreBase() {}
@@ -28,6 +47,22 @@ namespace MWWorld
         virtual int getDynamicSize() const { return 0; }
         virtual void load(ESM::ESMReader &esm, const std::string &id) = 0;
 
+        virtual LoadedRecord *parse(ESM::ESMReader &esm, const std::string &id) const { return 0; }
+        ///< Load a record into a new object without touching the store. Must be thread safe.
+        /// \return 0, if records of this type can only be loaded in place (in load order).
+
+        virtual bool insertParsed(LoadedRecord &record) { return false; }
+        ///< Insert a record returned by parse().
+        /// \return false, if a record with this ID already exists. The record then has to be
+        /// loaded in place via load() to keep the override semantics.
+
+        virtual void writeSnapshot (ESM::ESMWriter& writer) const {}
+        ///< Write all static records, so that readSnapshot() can restore the store without
+        /// the content files.
+
+        virtual void readSnapshot (ESM::ESMReader& reader, const std::string& id) { load (reader, id); }
+        ///< Read a record written by writeSnapshot()
+
         virtual bool eraseStatic(const std::string &id) {return false;}
         virtual void clearDynamic() {}
 
@@ -98,6 +133,17 @@ namespace MWWorld
 
     class ESMStore;
 
+    /// Interned record ID, see Store::getHandle
+    typedef int RecordHandle;
+
+    /// Record flags that are not covered by the save() method of a record
+    template <class T>
+    inline uint32_t getSnapshotFlags (const T& record) { return 0; }
+
+    inline uint32_t getSnapshotFlags (const ESM::NPC& record) { return record.mPersistent ? 0x0400 : 0; }
+    inline uint32_t getSnapshotFlags (const ESM::Creature& record) { return record.mPersistent ? 0x0400 : 0; }
+    inline uint32_t getSnapshotFlags (const ESM::Static& record) { return record.mPersistent ? 0x0400 : 0; }
+
     template <class T>
     class Store : public StoreBase
     {
@@ -110,6 +156,34 @@ namespace MWWorld
         typedef std::map<std::string, T> Dynamic;
         typedef std::map<std::string, T> Static;
 
+        /// The static and the dynamic record for an ID
+        struct IdSlot
+        {
+            const std::string *mId;
+            T *mStatic;
+            T *mDynamic;
+        };
+
+        typedef boost::unordered_map<std::string, RecordHandle,
+            Misc::StringUtils::CiHash, Misc::StringUtils::CiEqual> IdIndex;
+
+        // Every ID that has ever been added gets a slot and keeps it, so that handles stay valid.
+        IdIndex mIdIndex;
+        std::vector<IdSlot> mIds;
+
+        IdSlot &getSlot(const std::string &id)
+        {
+            std::pair<typename IdIndex::iterator, bool> inserted =
+                mIdIndex.insert(std::make_pair(id, static_cast<RecordHandle>(mIds.size())));
+
+            if (inserted.second) {
+                IdSlot slot = { &inserted.first->first, 0, 0 };
+                mIds.push_back(slot);
+            }
+
+            return mIds[inserted.first->second];
+        }
+
         class GetRecords {
             const std::string mFind;
             std::vector<const T*> *mRecords;
@@ -145,25 +219,47 @@ namespace MWWorld
             // remove the dynamic part of mShared
             assert(mShared.size() >= mStatic.size());
             mShared.erase(mShared.begin() + mStatic.size(), mShared.end());
+
+            for (typename Dynamic::const_iterator it = mDynamic.begin(); it != mDynamic.end(); ++it)
+                getSlot(it->first).mDynamic = 0;
             mDynamic.clear();
         }
 
         const T *search(const std::string &id) const {
-            T item;
-            item.mId = Misc::StringUtils::lowerCase(id);
+            typename IdIndex::const_iterator it = mIdIndex.find(id);
+            return it != mIdIndex.end() ? search(it->second) : 0;
+        }
 
-            typename Dynamic::const_iterator dit = mDynamic.find(item.mId);
-            if (dit != mDynamic.end()) {
-                return &dit->second;
-            }
+        /// Return a handle for a record ID, that can be used instead of the ID for faster lookups.
+        /// The handle stays valid for the lifetime of the store, even when the record is erased and
+        /// added again.
+        /// \return -1, if no record with this ID has been added to the store.
+        RecordHandle getHandle(const std::string &id) const {
+            typename IdIndex::const_iterator it = mIdIndex.find(id);
+            return it != mIdIndex.end() ? it->second : -1;
+        }
 
-            typename std::map<std::string, T>::const_iterator it = mStatic.find(item.mId);
+        const T *search(RecordHandle handle) const {
+            if (handle < 0 || handle >= static_cast<RecordHandle>(mIds.size()))
+                return 0;
 
-            if (it != mStatic.end() && Misc::StringUtils::ciEqual(it->second.mId, id)) {
-                return &(it->second);
-            }
+            const IdSlot &slot = mIds[handle];
+            return slot.mDynamic ? slot.mDynamic : slot.mStatic;
+        }
 
-            return 0;
+        const T *find(RecordHandle handle) const {
+            const T *ptr = search(handle);
+            if (ptr == 0) {
+                std::ostringstream msg;
+                msg << "Object '";
+                if (handle >= 0 && handle < static_cast<RecordHandle>(mIds.size()))
+                    msg << *mIds[handle].mId;
+                else
+                    msg << "#" << handle;
+                msg << "' not found (const)";
+                throw std::runtime_error(msg.str());
+            }
+            return ptr;
         }
 
         /**
@@ -212,13 +308,35 @@ namespace MWWorld
             std::string idLower = Misc::StringUtils::lowerCase(id);
 
             std::pair<typename Static::iterator, bool> inserted = mStatic.insert(std::make_pair(idLower, T()));
-            if (inserted.second)
+            if (inserted.second) {
                 mShared.push_back(&inserted.first->second);
+                getSlot(idLower).mStatic = &inserted.first->second;
+            }
 
             inserted.first->second.mId = idLower;
             inserted.first->second.load(esm);
         }
 
+        LoadedRecord *parse(ESM::ESMReader &esm, const std::string &id) const {
+            std::auto_ptr<LoadedRecordT<T> > record (new LoadedRecordT<T>);
+            record->mRecord.mId = Misc::StringUtils::lowerCase(id);
+            record->mRecord.load(esm);
+            return record.release();
+        }
+
+        bool insertParsed(LoadedRecord &record) {
+            T &item = static_cast<LoadedRecordT<T>&>(record).mRecord;
+
+            std::pair<typename Static::iterator, bool> inserted = mStatic.insert(std::make_pair(item.mId, T()));
+            if (!inserted.second)
+                return false;
+
+            inserted.first->second = item;
+            mShared.push_back(&inserted.first->second);
+            getSlot(item.mId).mStatic = &inserted.first->second;
+            return true;
+        }
+
         void setUp() {
         }
 
@@ -254,6 +372,7 @@ namespace MWWorld
             T *ptr = &result.first->second;
             if (result.second) {
                 mShared.push_back(ptr);
+                getSlot(id).mDynamic = ptr;
             } else {
                 *ptr = item;
             }
@@ -267,6 +386,7 @@ namespace MWWorld
             T *ptr = &result.first->second;
             if (result.second) {
                 mShared.push_back(ptr);
+                getSlot(id).mStatic = ptr;
             } else {
                 *ptr = item;
             }
@@ -292,6 +412,7 @@ namespace MWWorld
                     }
                     ++sharedIter;
                 }
+                getSlot(it->first).mStatic = 0;
                 mStatic.erase(it);
             }
 
@@ -304,6 +425,7 @@ namespace MWWorld
             if (it == mDynamic.end()) {
                 return false;
             }
+            getSlot(key).mDynamic = 0;
             mDynamic.erase(it);
 
             // have to reinit the whole shared part
@@ -338,8 +460,61 @@ namespace MWWorld
             record.load (reader);
             insert (record);
         }
+
+        void writeSnapshot (ESM::ESMWriter& writer) const
+        {
+            // The static records come first in mShared, in load order
+            typename std::vector<T *>::const_iterator end = mShared.begin() + mStatic.size();
+
+            for (typename std::vector<T *>::const_iterator iter (mShared.begin()); iter!=end; ++iter)
+            {
+                writer.startRecord (T::sRecordId, getSnapshotFlags (**iter));
+                writer.writeHNString ("NAME", (*iter)->mId);
+                (*iter)->save (writer);
+                writer.endRecord (T::sRecordId);
+            }
+        }
     };
 
+    // Dialogues collect the following INFO records and scripts are keyed by their SCHD
+    // subrecord, so both have to be loaded in place.
+    template <>
+    inline LoadedRecord *Store<ESM::Dialogue>::parse(ESM::ESMReader &esm, const std::string &id) const {
+        return 0;
+    }
+
+    template <>
+    inline LoadedRecord *Store<ESM::Script>::parse(ESM::ESMReader &esm, const std::string &id) const {
+        return 0;
+    }
+
+    template <>
+    inline LoadedRecord *Store<ESM::StartScript>::parse(ESM::ESMReader &esm, const std::string &id) const {
+        return 0;
+    }
+
+    template <>
+    inline void Store<ESM::Dialogue>::writeSnapshot(ESM::ESMWriter &writer) const {
+        // mShared is only filled by setUp(). The INFO records follow their dialogue, see ESMStore::readSnapshot.
+        for (Static::const_iterator it = mStatic.begin(); it != mStatic.end(); ++it) {
+            const ESM::Dialogue &dialogue = it->second;
+
+            writer.startRecord(ESM::REC_DIAL);
+            writer.writeHNString("NAME", dialogue.mId);
+            dialogue.save(writer);
+            writer.endRecord(ESM::REC_DIAL);
+
+            for (ESM::Dialogue::InfoContainer::const_iterator info = dialogue.mInfo.begin();
+                info != dialogue.mInfo.end(); ++info)
+            {
+                writer.startRecord(ESM::REC_INFO);
+                writer.writeHNCString("INAM", info->mId);
+                info->save(writer);
+                writer.endRecord(ESM::REC_INFO);
+            }
+        }
+    }
+
     template <>
     inline void Store<ESM::Dialogue>::load(ESM::ESMReader &esm, const std::string &id) {
         std::string idLower = Misc::StringUtils::lowerCase(id);
@@ -348,6 +523,7 @@ namespace MWWorld
         if (it == mStatic.end()) {
             it = mStatic.insert( std::make_pair( idLower, ESM::Dialogue() ) ).first;
             it->second.mId = id; // don't smash case here, as this line is printed
+            getSlot(idLower).mStatic = &it->second;
         }
 
         it->second.load(esm);
@@ -360,8 +536,10 @@ namespace MWWorld
         Misc::StringUtils::toLower(scpt.mId);
 
         std::pair<typename Static::iterator, bool> inserted = mStatic.insert(std::make_pair(scpt.mId, scpt));
-        if (inserted.second)
+        if (inserted.second) {
             mShared.push_back(&inserted.first->second);
+            getSlot(scpt.mId).mStatic = &inserted.first->second;
+        }
         else
             inserted.first->second = scpt;
     }
@@ -373,8 +551,10 @@ namespace MWWorld
         s.load(esm);
         s.mId = Misc::StringUtils::toLower(s.mId);
         std::pair<typename Static::iterator, bool> inserted = mStatic.insert(std::make_pair(s.mId, s));
-        if (inserted.second)
+        if (inserted.second) {
             mShared.push_back(&inserted.first->second);
+            getSlot(s.mId).mStatic = &inserted.first->second;
+        }
         else
             inserted.first->second = s;
     }
@@ -445,6 +625,9 @@ namespace MWWorld
 
         void load(ESM::ESMReader &esm, const std::string &id);
 
+        void writeSnapshot(ESM::ESMWriter &writer) const;
+        void readSnapshot(ESM::ESMReader &esm, const std::string &id);
+
         iterator begin(size_t plugin) const {
             assert(plugin < mStatic.size());
             return mStatic[plugin].begin();
@@ -540,6 +723,10 @@ namespace MWWorld
             mStatic.push_back(ptr);
         }
 
+        // Only the record header and file context are stored, the land data is loaded on demand as usual
+        void writeSnapshot(ESM::ESMWriter &writer) const;
+        void readSnapshot(ESM::ESMReader &esm, const std::string &id);
+
         void setUp() {
             std::sort(mStatic.begin(), mStatic.end(), Compare());
         }
@@ -690,6 +877,9 @@ namespace MWWorld
         //  this method.
         void load(ESM::ESMReader &esm, const std::string &id);
 
+        void writeSnapshot(ESM::ESMWriter &writer) const;
+        void readSnapshot(ESM::ESMReader &esm, const std::string &id);
+
         iterator intBegin() const {
             return iterator(mSharedInt.begin());
         }
@@ -847,6 +1037,8 @@ namespace MWWorld
 
     public:
 
+        typedef Exterior::const_iterator ExtIterator;
+
         Store<ESM::Pathgrid>()
             : mCells(NULL)
         {
@@ -883,6 +1075,9 @@ namespace MWWorld
             }
         }
 
+        void writeSnapshot(ESM::ESMWriter &writer) const;
+        void readSnapshot(ESM::ESMReader &esm, const std::string &id);
+
         size_t getSize() const {
             return mInt.size() + mExt.size();
         }
@@ -926,6 +1121,15 @@ namespace MWWorld
             return pathgrid;
         }
 
+        /// Exterior pathgrids, ordered by cell position
+        ExtIterator extBegin() const {
+            return mExt.begin();
+        }
+
+        ExtIterator extEnd() const {
+            return mExt.end();
+        }
+
         const ESM::Pathgrid *search(const ESM::Cell &cell) const {
             if (!(cell.mData.mFlags & ESM::Cell::Interior))
                 return search(cell.mData.mX, cell.mData.mY);
@@ -19,8 +19,10 @@
 #include <components/bsa/bsa_archive.hpp>
 #include <components/files/collections.hpp>
 #include <components/compiler/locals.hpp>
+#include <components/esm/esmreader.hpp>
 #include <components/esm/cellid.hpp>
 #include <components/misc/resourcehelpers.hpp>
+#include <components/settings/settings.hpp>
 
 #include <boost/math/special_functions/sign.hpp>
 
@@ -157,7 +159,7 @@ namespace MWWorld
         mPhysics = new PhysicsSystem(renderer);
         mPhysEngine = mPhysics->getEngine();
 
-        mProjectileManager.reset(new ProjectileManager(renderer.getScene(), *mPhysEngine));
+        mProjectileManager.reset(new ProjectileManager(renderer.getScene(), *mPhysics));
 
         mRendering = new MWRender::RenderingManager(renderer, resDir, cacheDir, mPhysEngine,&mFallback);
 
@@ -169,8 +171,14 @@ namespace MWWorld
         Loading::Listener* listener = MWBase::Environment::get().getWindowManager()->getLoadingScreen();
         listener->loadingOn();
 
+        ESM::ESMReader::setUseMemoryMapping(Settings::Manager::getBool("memory mapped content files", "General"));
+
         GameContentLoader gameContentLoader(*listener);
-        EsmLoader esmLoader(mStore, mEsm, encoder, *listener);
+        EsmLoader esmLoader(mStore, mEsm, encoder, *listener,
+            std::max(0, Settings::Manager::getInt("content loading threads", "General")));
+
+        if (Settings::Manager::getBool("content cache", "General"))
+            esmLoader.enableCache(cacheDir / "content.cache");
 
         gameContentLoader.addLoader(".esm", &esmLoader);
         gameContentLoader.addLoader(".esp", &esmLoader);
@@ -179,6 +187,7 @@ namespace MWWorld
         gameContentLoader.addLoader(".project", &esmLoader);
 
         loadContentFiles(fileCollections, contentFiles, gameContentLoader);
+        esmLoader.finish();
 
         listener->loadingOff();
 
@@ -189,6 +198,10 @@ namespace MWWorld
         mStore.setUp();
         mStore.movePlayerRecord();
 
+        mNavigationGraph.build(mStore.get<ESM::Pathgrid>(),
+            Settings::Manager::getBool("navigation cache", "General") ?
+            cacheDir / "navigation.cache" : boost::filesystem::path());
+
         mSwimHeightScale = mStore.get<ESM::GameSetting>().find("fSwimHeightScale")->getFloat();
 
         mGlobalVariables.fill (mStore);
@@ -504,6 +517,11 @@ namespace MWWorld
         return mCells.getExterior (x, y);
     }
 
+    bool World::preloadExterior (int x, int y, size_t references)
+    {
+        return mCells.preloadExterior (x, y, references);
+    }
+
     CellStore *World::getInterior (const std::string& name)
     {
         return mCells.getInterior (name);
@@ -538,6 +556,11 @@ namespace MWWorld
         return mStore;
     }
 
+    const MWMechanics::NavigationGraph& World::getNavigationGraph() const
+    {
+        return mNavigationGraph;
+    }
+
     std::vector<ESM::ESMReader>& World::getEsmReader()
     {
         return mEsm;
@@ -1022,11 +1045,9 @@ namespace MWWorld
 
     MWWorld::Ptr World::getFacedObject()
     {
-        std::string facedHandle;
-
         if (MWBase::Environment::get().getWindowManager()->isGuiMode() &&
                 MWBase::Environment::get().getWindowManager()->isConsoleMode())
-            getFacedHandle(facedHandle, getMaxActivationDistance() * 50, false);
+            return getFacedObject(getMaxActivationDistance() * 50, false);
         else
         {
             float telekinesisRangeBonus =
@@ -1036,13 +1057,8 @@ namespace MWWorld
 
             float activationDistance = getMaxActivationDistance() + telekinesisRangeBonus;
 
-            getFacedHandle(facedHandle, activationDistance);
+            return getFacedObject(activationDistance);
         }
-
-        if (facedHandle.empty())
-            return MWWorld::Ptr();
-
-        return getPtrViaHandle(facedHandle);
     }
 
     std::pair<MWWorld::Ptr,Ogre::Vector3> World::getHitContact(const MWWorld::Ptr &ptr, float distance)
@@ -1062,12 +1078,11 @@ namespace MWWorld
                 pos += node->_getDerivedPosition();
         }
 
-        std::pair<std::string,Ogre::Vector3> result = mPhysics->getHitContact(ptr.getRefData().getHandle(),
-                                                                              pos, rot, distance);
-        if(result.first.empty())
+        std::pair<MWWorld::Ptr,Ogre::Vector3> result = mPhysics->getHitContact(ptr, pos, rot, distance);
+        if(result.first.isEmpty())
             return std::make_pair(MWWorld::Ptr(), Ogre::Vector3(0.0f));
 
-        return std::make_pair(searchPtrViaHandle(result.first), result.second);
+        return result;
     }
 
     void World::deleteObject (const Ptr& ptr)
@@ -1196,6 +1211,7 @@ namespace MWWorld
         {
             mRendering->moveObject(newPtr, vec);
             mPhysics->moveObject (newPtr);
+            MWBase::Environment::get().getMechanicsManager()->updatePosition(newPtr);
         }
         if (isPlayer)
         {
@@ -1440,11 +1456,11 @@ namespace MWWorld
                 bool reached = (targetRot == 90.f && it->second) || targetRot == 0.f;
 
                 /// \todo should use convexSweepTest here
-                std::vector<std::string> collisions = mPhysics->getCollisions(it->first, OEngine::Physic::CollisionType_Actor
-                                                                              , OEngine::Physic::CollisionType_Actor);
-                for (std::vector<std::string>::iterator cit = collisions.begin(); cit != collisions.end(); ++cit)
+                std::vector<MWWorld::Ptr> collisions = mPhysics->getCollisions(it->first, OEngine::Physic::CollisionType_Actor
+                                                                               , OEngine::Physic::CollisionType_Actor);
+                for (std::vector<MWWorld::Ptr>::iterator cit = collisions.begin(); cit != collisions.end(); ++cit)
                 {
-                    MWWorld::Ptr ptr = getPtrViaHandle(*cit);
+                    MWWorld::Ptr ptr = *cit;
                     if (ptr.getClass().isActor())
                     {
                         // Collided with actor, ask actor to try to avoid door
@@ -1640,31 +1656,31 @@ namespace MWWorld
         }
     }
 
-    void World::getFacedHandle(std::string& facedHandle, float maxDistance, bool ignorePlayer)
+    MWWorld::Ptr World::getFacedObject(float maxDistance, bool ignorePlayer)
     {
         maxDistance += mRendering->getCameraDistance();
 
-        std::vector < std::pair < float, std::string > > results;
+        std::vector < std::pair < float, MWWorld::Ptr > > results;
         if (MWBase::Environment::get().getWindowManager()->isGuiMode())
         {
             float x, y;
             MWBase::Environment::get().getWindowManager()->getMousePosition(x, y);
-            results = mPhysics->getFacedHandles(x, y, maxDistance);
+            results = mPhysics->getFacedObjects(x, y, maxDistance);
         }
         else
         {
-            results = mPhysics->getFacedHandles(maxDistance);
+            results = mPhysics->getFacedObjects(maxDistance);
         }
 
         if (ignorePlayer &&
-                !results.empty() && results.front().second == "player")
+                !results.empty() && results.front().second == getPlayerPtr())
             results.erase(results.begin());
 
-        if (results.empty()
-                || results.front().second.find("HeightField") != std::string::npos) // Blocked by terrain
-            facedHandle = "";
+        // An empty Ptr means we are blocked by terrain
+        if (results.empty())
+            return MWWorld::Ptr();
         else
-            facedHandle = results.front().second;
+            return results.front().second;
     }
 
     bool World::isCellExterior() const
@@ -1832,8 +1848,8 @@ namespace MWWorld
     bool World::canPlaceObject(float cursorX, float cursorY)
     {
         Ogre::Vector3 normal(0,0,0);
-        std::string handle;
-        std::pair<bool, Ogre::Vector3> result = mPhysics->castRay(cursorX, cursorY, &normal, &handle);
+        MWWorld::Ptr hitObject;
+        std::pair<bool, Ogre::Vector3> result = mPhysics->castRay(cursorX, cursorY, &normal, &hitObject);
 
         if (result.first)
         {
@@ -1841,7 +1857,6 @@ namespace MWWorld
             if (normal.angleBetween(Ogre::Vector3(0.f,0.f,1.f)).valueDegrees() >= 30)
                 return false;
 
-            MWWorld::Ptr hitObject = searchPtrViaHandle(handle);
             if (!hitObject.isEmpty() && hitObject.getClass().isActor())
                 return false;
 
@@ -1892,7 +1907,6 @@ namespace MWWorld
         localRotation.rot[2] = 0;
         dropped.getRefData().setLocalRotation(localRotation);
         dropped.getCellRef().setPosition(pos);
-        dropped.getCellRef().unsetRefNum();
 
         if (mWorldScene->isCellActive(*cell)) {
             if (dropped.getRefData().isEnabled()) {
@@ -2181,7 +2195,7 @@ namespace MWWorld
 
     bool World::getActorStandingOn (const MWWorld::Ptr& object)
     {
-        std::vector<std::string> actors;
+        std::vector<MWWorld::Ptr> actors;
         mPhysics->getActorsStandingOn(object, actors);
         return !actors.empty();
     }
@@ -2194,7 +2208,7 @@ namespace MWWorld
 
     bool World::getActorCollidingWith (const MWWorld::Ptr& object)
     {
-        std::vector<std::string> actors;
+        std::vector<MWWorld::Ptr> actors;
         mPhysics->getActorsCollidingWith(object, actors);
         return !actors.empty();
     }
@@ -2204,11 +2218,11 @@ namespace MWWorld
         if (MWBase::Environment::get().getWindowManager()->isGuiMode())
             return;
 
-        std::vector<std::string> actors;
+        std::vector<MWWorld::Ptr> actors;
         mPhysics->getActorsStandingOn(object, actors);
-        for (std::vector<std::string>::iterator it = actors.begin(); it != actors.end(); ++it)
+        for (std::vector<MWWorld::Ptr>::iterator it = actors.begin(); it != actors.end(); ++it)
         {
-            MWWorld::Ptr actor = searchPtrViaHandle(*it); // Collision events are from the last frame, actor might no longer exist
+            MWWorld::Ptr actor = *it; // Collision events are from the last frame, actor might no longer exist
             if (actor.isEmpty())
                 continue;
 
@@ -2235,11 +2249,11 @@ namespace MWWorld
         if (MWBase::Environment::get().getWindowManager()->isGuiMode())
             return;
 
-        std::vector<std::string> actors;
+        std::vector<MWWorld::Ptr> actors;
         mPhysics->getActorsCollidingWith(object, actors);
-        for (std::vector<std::string>::iterator it = actors.begin(); it != actors.end(); ++it)
+        for (std::vector<MWWorld::Ptr>::iterator it = actors.begin(); it != actors.end(); ++it)
         {
-            MWWorld::Ptr actor = searchPtrViaHandle(*it); // Collision events are from the last frame, actor might no longer exist
+            MWWorld::Ptr actor = *it; // Collision events are from the last frame, actor might no longer exist
             if (actor.isEmpty())
                 continue;
 
@@ -2330,7 +2344,7 @@ namespace MWWorld
         }
     }
 
-    bool World::getLOS(const MWWorld::Ptr& actor,const MWWorld::Ptr& targetActor)
+    bool World::getLOSRay(const Ptr& actor, const Ptr& targetActor, Ogre::Vector3& from, Ogre::Vector3& to)
     {
         if (!targetActor.getRefData().isEnabled() || !actor.getRefData().isEnabled())
             return false; // cannot get LOS unless both NPC's are enabled
@@ -2348,15 +2362,52 @@ namespace MWWorld
         Ogre::Vector3 halfExt2 = actor2->getHalfExtents();
         const float* pos2 = targetActor.getRefData().getPosition().pos;
 
-        btVector3 from(pos1[0],pos1[1],pos1[2]+halfExt1.z*2*0.9f); // eye level
-        btVector3 to(pos2[0],pos2[1],pos2[2]+halfExt2.z*2*0.9f);
+        from = Ogre::Vector3(pos1[0],pos1[1],pos1[2]+halfExt1.z*2*0.9f); // eye level
+        to = Ogre::Vector3(pos2[0],pos2[1],pos2[2]+halfExt2.z*2*0.9f);
+        return true;
+    }
 
-        std::pair<std::string, float> result = mPhysEngine->rayTest(from, to,false);
-        if(result.first == "") return true;
+    bool World::getLOS(const MWWorld::Ptr& actor,const MWWorld::Ptr& targetActor)
+    {
+        Ogre::Vector3 from, to;
+        if (!getLOSRay(actor, targetActor, from, to))
+            return false;
+
+        std::pair<const OEngine::Physic::RigidBody*, float> result = mPhysEngine->rayTest(
+            btVector3(from.x, from.y, from.z), btVector3(to.x, to.y, to.z), false);
+        if(!result.first) return true;
 
         return false;
     }
 
+    void World::getLOS(const MWWorld::Ptr& actor, const std::vector<MWWorld::Ptr>& targetActors,
+        std::vector<bool>& out)
+    {
+        out.assign(targetActors.size(), false);
+
+        std::vector<OEngine::Physic::RayQuery> queries;
+        std::vector<size_t> indices;
+
+        for (size_t i = 0; i < targetActors.size(); ++i)
+        {
+            Ogre::Vector3 from, to;
+            if (getLOSRay(actor, targetActors[i], from, to))
+            {
+                // same filter as getLOS
+                queries.push_back(OEngine::Physic::RayQuery(btVector3(from.x, from.y, from.z),
+                    btVector3(to.x, to.y, to.z),
+                    OEngine::Physic::CollisionType_World|OEngine::Physic::CollisionType_HeightMap));
+                indices.push_back(i);
+            }
+        }
+
+        std::vector<OEngine::Physic::RayQueryResult> results;
+        mPhysics->queryBatch(queries, results);
+
+        for (size_t i = 0; i < results.size(); ++i)
+            out[indices[i]] = !results[i].mObject;
+    }
+
     float World::getDistToNearestRayHit(const Ogre::Vector3& from, const Ogre::Vector3& dir, float maxDist)
     {
         btVector3 btFrom(from.x, from.y, from.z);
@@ -2364,7 +2415,7 @@ namespace MWWorld
         btTo.normalize();
         btTo = btFrom + btTo * maxDist;
 
-        std::pair<std::string, float> result = mPhysEngine->rayTest(btFrom, btTo, false);
+        std::pair<const OEngine::Physic::RigidBody*, float> result = mPhysEngine->rayTest(btFrom, btTo, false);
 
         if(result.second == -1) return maxDist;
         else return result.second*(btTo-btFrom).length();
@@ -2670,10 +2721,7 @@ namespace MWWorld
         if (actor == getPlayerPtr())
         {
             // For the player, use camera to aim
-            std::string facedHandle;
-            getFacedHandle(facedHandle, distance);
-            if (!facedHandle.empty())
-                target = getPtrViaHandle(facedHandle);
+            target = getFacedObject(distance);
         }
         else
         {
@@ -2695,10 +2743,10 @@ namespace MWWorld
             Ogre::Vector3 dest = origin + direction * distance;
 
 
-            std::vector<std::pair<float, std::string> > collisions = mPhysEngine->rayTest2(btVector3(origin.x, origin.y, origin.z), btVector3(dest.x, dest.y, dest.z));
-            for (std::vector<std::pair<float, std::string> >::iterator cIt = collisions.begin(); cIt != collisions.end(); ++cIt)
+            std::vector<std::pair<float, const OEngine::Physic::RigidBody*> > collisions = mPhysEngine->rayTest2(btVector3(origin.x, origin.y, origin.z), btVector3(dest.x, dest.y, dest.z));
+            for (std::vector<std::pair<float, const OEngine::Physic::RigidBody*> >::iterator cIt = collisions.begin(); cIt != collisions.end(); ++cIt)
             {
-                MWWorld::Ptr collided = getPtrViaHandle(cIt->second);
+                MWWorld::Ptr collided = mPhysics->getPtr(cIt->second->mObjectId);
                 if (collided != actor)
                 {
                     target = collided;
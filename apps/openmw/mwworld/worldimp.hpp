@@ -17,6 +17,8 @@
 
 #include "../mwbase/world.hpp"
 
+#include "../mwmechanics/navigationgraph.hpp"
+
 #include "contentloader.hpp"
 
 namespace Ogre
@@ -68,6 +70,7 @@ namespace MWWorld
             MWWorld::Player *mPlayer;
             std::vector<ESM::ESMReader> mEsm;
             MWWorld::ESMStore mStore;
+            MWMechanics::NavigationGraph mNavigationGraph;
             LocalScripts mLocalScripts;
             MWWorld::Globals mGlobalVariables;
             MWWorld::PhysicsSystem *mPhysics;
@@ -113,7 +116,11 @@ namespace MWWorld
             void updateSoundListener();
             void updateWindowManager ();
             void performUpdateSceneQueries ();
-            void getFacedHandle(std::string& facedHandle, float maxDistance, bool ignorePlayer=true);
+            Ptr getFacedObject(float maxDistance, bool ignorePlayer=true);
+
+            bool getLOSRay(const Ptr& actor, const Ptr& targetActor, Ogre::Vector3& from, Ogre::Vector3& to);
+            ///< Get the eye level ray for a line of sight check.
+            /// @return false, if there can't be a line of sight
 
             void removeContainerScripts(const Ptr& reference);
             void addContainerScripts(const Ptr& reference, CellStore* cell);
@@ -176,6 +183,8 @@ namespace MWWorld
 
             virtual CellStore *getExterior (int x, int y);
 
+            virtual bool preloadExterior (int x, int y, size_t references);
+
             virtual CellStore *getInterior (const std::string& name);
 
             virtual CellStore *getCell (const ESM::CellId& id);
@@ -199,6 +208,9 @@ namespace MWWorld
 
             virtual const MWWorld::ESMStore& getStore() const;
 
+            virtual const MWMechanics::NavigationGraph& getNavigationGraph() const;
+            ///< Graph of the pathgrids of all exterior cells
+
             virtual std::vector<ESM::ESMReader>& getEsmReader();
 
             virtual LocalScripts& getLocalScripts();
@@ -529,6 +541,11 @@ namespace MWWorld
             virtual bool getLOS(const MWWorld::Ptr& actor,const MWWorld::Ptr& targetActor);
             ///< get Line of Sight (morrowind stupid implementation)
 
+            virtual void getLOS(const MWWorld::Ptr& actor, const std::vector<MWWorld::Ptr>& targetActors,
+                std::vector<bool>& out);
+            ///< Same as getLOS for each of \a targetActors, with the rays cast in one batch.
+            /// \a out gets one entry per target.
+
             virtual float getDistToNearestRayHit(const Ogre::Vector3& from, const Ogre::Vector3& dir, float maxDist);
 
             virtual void enableActorCollision(const MWWorld::Ptr& actor, bool enable);
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include "components/bsa/bsa_file.hpp"
+
+namespace
+{
+    /// Writes an archive with the layout described in BSAFile::readHeader
+    void writeArchive(const std::string& path, const std::vector<std::string>& names)
+    {
+        const uint32_t count = names.size();
+
+        std::vector<uint32_t> sizes;
+        std::vector<uint32_t> nameOffsets;
+        std::string nameBuffer;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            sizes.push_back(i % 7);
+            sizes.push_back(0);
+            nameOffsets.push_back(nameBuffer.size());
+            nameBuffer.append(names[i].c_str(), names[i].size() + 1);
+        }
+
+        // Data offsets relative to the data buffer
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            sizes[2*i+1] = offset;
+            offset += sizes[2*i];
+        }
+
+        uint32_t header[3] = { 0x100, 12*count + static_cast<uint32_t>(nameBuffer.size()), count };
+
+        std::ofstream stream(path.c_str(), std::ios::binary);
+        stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(&sizes[0]), sizes.size()*4);
+        stream.write(reinterpret_cast<const char*>(&nameOffsets[0]), nameOffsets.size()*4);
+        stream.write(nameBuffer.data(), nameBuffer.size());
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint64_t hash = Bsa::BSAFile::getHash(names[i].c_str());
+            stream.write(reinterpret_cast<const char*>(&hash), 8);
+        }
+
+        stream.write(std::string(offset, 'x').data(), offset);
+    }
+
+    std::string toUpper(std::string name)
+    {
+        for (std::string::iterator iter = name.begin(); iter != name.end(); ++iter)
+            if (*iter >= 'a' && *iter <= 'z')
+                *iter -= 'a' - 'A';
+        return name;
+    }
+}
+
+struct BSAFileTest : public ::testing::Test
+{
+  protected:
+    // Shared by all tests, writing the archive takes longer than the tests
+    static std::string sPath;
+    static bool sTemporary;
+    static Bsa::BSAFile *sFile;
+
+    static void SetUpTestCase()
+    {
+        // Set OPENMW_TEST_BSA to run the tests on a real archive, e.g. Morrowind.bsa
+        const char *path = std::getenv("OPENMW_TEST_BSA");
+        sTemporary = !path;
+
+        if (path)
+            sPath = path;
+        else
+        {
+            static const char *folders[] = { "meshes\\f\\", "meshes\\x\\", "meshes\\i\\", "textures\\", "icons\\m\\" };
+            static const char *extensions[] = { ".nif", ".nif", ".nif", ".dds", ".tga" };
+
+            std::vector<std::string> names;
+            for (int i = 0; i < 500; ++i)
+            {
+                std::ostringstream name;
+                name << folders[i % 5] << "furn_de_" << (i * 7919 % 500) << extensions[i % 5];
+                names.push_back(name.str());
+            }
+
+            sPath = (boost::filesystem::temp_directory_path()
+                / boost::filesystem::unique_path("openmw-test-%%%%%%%%.bsa")).string();
+            writeArchive(sPath, names);
+        }
+
+        sFile = new Bsa::BSAFile;
+        sFile->open(sPath);
+    }
+
+    static void TearDownTestCase()
+    {
+        delete sFile;
+        sFile = 0;
+
+        if (sTemporary)
+            boost::filesystem::remove(sPath);
+    }
+};
+
+std::string BSAFileTest::sPath;
+bool BSAFileTest::sTemporary = false;
+Bsa::BSAFile *BSAFileTest::sFile = 0;
+
+TEST_F(BSAFileTest, finds_all_files_case_insensitively)
+{
+    const Bsa::BSAFile::FileList &files = sFile->getList();
+    ASSERT_FALSE (files.empty());
+
+    for (Bsa::BSAFile::FileList::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+    {
+        ASSERT_TRUE (sFile->exists(iter->name));
+        ASSERT_TRUE (sFile->exists(toUpper(iter->name).c_str()));
+    }
+}
+
+TEST_F(BSAFileTest, does_not_find_missing_files)
+{
+    const Bsa::BSAFile::FileList &files = sFile->getList();
+
+    for (Bsa::BSAFile::FileList::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+        ASSERT_FALSE (sFile->exists((std::string(iter->name) + "x").c_str()));
+
+    ASSERT_FALSE (sFile->exists(""));
+}
+
+TEST_F(BSAFileTest, hash_is_case_insensitive)
+{
+    ASSERT_EQ (Bsa::BSAFile::getHash("meshes\\f\\furn_de_bed_01.nif"),
+               Bsa::BSAFile::getHash("Meshes\\F\\Furn_De_Bed_01.NIF"));
+    ASSERT_NE (Bsa::BSAFile::getHash("meshes\\f\\furn_de_bed_01.nif"),
+               Bsa::BSAFile::getHash("meshes\\f\\furn_de_bed_02.nif"));
+}
+
+TEST_F(BSAFileTest, hash_matches_the_archive_format)
+{
+    // Worked out by hand from the TES3 BSA format description: the first half of the name is
+    // xor'ed into the low word, the second half into the high word, rotating right as it goes.
+    // "a" goes into the low word, "b" into the high word, rotated right by 'b' & 0x1f = 2.
+    ASSERT_EQ (0x8000001800000061ull, Bsa::BSAFile::getHash("ab"));
+
+    ASSERT_EQ (0xea2972bc7c5a703aull, Bsa::BSAFile::getHash("meshes\\f\\furn_de_bed_01.nif"));
+    ASSERT_EQ (0x759a30e45865635dull, Bsa::BSAFile::getHash("textures\\tx_sky_clear.dds"));
+}
+
+TEST_F(BSAFileTest, hash_matches_the_hash_table_of_the_archive)
+{
+    // With OPENMW_TEST_BSA set, these are the hashes the original tools stored in the archive
+    std::ifstream stream(sPath.c_str(), std::ios::binary);
+
+    uint32_t header[3];
+    stream.read(reinterpret_cast<char*>(header), sizeof(header));
+    ASSERT_TRUE (stream.good());
+
+    std::vector<uint64_t> stored(header[2]);
+    stream.seekg(12 + header[1]);
+    stream.read(reinterpret_cast<char*>(&stored[0]), stored.size()*8);
+    ASSERT_TRUE (stream.good());
+
+    const Bsa::BSAFile::FileList &files = sFile->getList();
+    ASSERT_EQ (stored.size(), files.size());
+
+    // The table is sorted by hash, which need not be the order of the names
+    std::vector<uint64_t> computed;
+    for (Bsa::BSAFile::FileList::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+        computed.push_back(Bsa::BSAFile::getHash(iter->name));
+
+    std::sort(stored.begin(), stored.end());
+    std::sort(computed.begin(), computed.end());
+    ASSERT_TRUE (stored == computed);
+}
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "components/compiler/context.hpp"
+#include "components/compiler/fileparser.hpp"
+#include "components/compiler/scanner.hpp"
+#include "components/compiler/streamerrorhandler.hpp"
+#include "components/interpreter/context.hpp"
+#include "components/interpreter/installopcodes.hpp"
+#include "components/interpreter/interpreter.hpp"
+#include "components/interpreter/opcodes.hpp"
+
+namespace
+{
+    class TestCompilerContext : public Compiler::Context
+    {
+        public:
+
+            virtual bool canDeclareLocals() const { return true; }
+            virtual char getGlobalType (const std::string& name) const { return ' '; }
+            virtual std::pair<char, bool> getMemberType (const std::string& name,
+                const std::string& id) const { return std::make_pair (' ', false); }
+            virtual bool isId (const std::string& name) const { return false; }
+            virtual bool isJournalId (const std::string& name) const { return false; }
+    };
+
+    /// Only locals are supported, everything else is unused by the scripts in this test.
+    class TestContext : public Interpreter::Context
+    {
+        public:
+
+            std::vector<int> mShorts;
+            std::vector<int> mLongs;
+            std::vector<float> mFloats;
+
+            TestContext (const Compiler::Locals& locals)
+            : mShorts (locals.get ('s').size()), mLongs (locals.get ('l').size()),
+              mFloats (locals.get ('f').size())
+            {}
+
+            virtual int getLocalShort (int index) const { return mShorts.at (index); }
+            virtual int getLocalLong (int index) const { return mLongs.at (index); }
+            virtual float getLocalFloat (int index) const { return mFloats.at (index); }
+            virtual void setLocalShort (int index, int value) { mShorts.at (index) = value; }
+            virtual void setLocalLong (int index, int value) { mLongs.at (index) = value; }
+            virtual void setLocalFloat (int index, float value) { mFloats.at (index) = value; }
+
+            virtual void messageBox (const std::string& message, const std::vector<std::string>& buttons) {}
+            virtual void report (const std::string& message) {}
+            virtual bool menuMode() { return false; }
+            virtual int getGlobalShort (const std::string& name) const { return 0; }
+            virtual int getGlobalLong (const std::string& name) const { return 0; }
+            virtual float getGlobalFloat (const std::string& name) const { return 0; }
+            virtual void setGlobalShort (const std::string& name, int value) {}
+            virtual void setGlobalLong (const std::string& name, int value) {}
+            virtual void setGlobalFloat (const std::string& name, float value) {}
+            virtual std::vector<std::string> getGlobals () const { return std::vector<std::string>(); }
+            virtual char getGlobalType (const std::string& name) const { return ' '; }
+            virtual std::string getActionBinding (const std::string& action) const { return ""; }
+            virtual std::string getNPCName() const { return ""; }
+            virtual std::string getNPCRace() const { return ""; }
+            virtual std::string getNPCClass() const { return ""; }
+            virtual std::string getNPCFaction() const { return ""; }
+            virtual std::string getNPCRank() const { return ""; }
+            virtual std::string getPCName() const { return ""; }
+            virtual std::string getPCRace() const { return ""; }
+            virtual std::string getPCClass() const { return ""; }
+            virtual std::string getPCRank() const { return ""; }
+            virtual std::string getPCNextRank() const { return ""; }
+            virtual int getPCBounty() const { return 0; }
+            virtual std::string getCurrentCellName() const { return ""; }
+            virtual bool isScriptRunning (const std::string& name) const { return false; }
+            virtual void startScript (const std::string& name, const std::string& targetId) {}
+            virtual void stopScript (const std::string& name) {}
+            virtual float getDistance (const std::string& name, const std::string& id) const { return 0; }
+            virtual float getSecondsPassed() const { return 0; }
+            virtual bool isDisabled (const std::string& id) const { return false; }
+            virtual void enable (const std::string& id) {}
+            virtual void disable (const std::string& id) {}
+            virtual int getMemberShort (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual int getMemberLong (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual float getMemberFloat (const std::string& id, const std::string& name, bool global) const { return 0; }
+            virtual void setMemberShort (const std::string& id, const std::string& name, int value, bool global) {}
+            virtual void setMemberLong (const std::string& id, const std::string& name, int value, bool global) {}
+            virtual void setMemberFloat (const std::string& id, const std::string& name, float value, bool global) {}
+            virtual std::string getTargetId() const { return ""; }
+    };
+
+    class OpNop : public Interpreter::Opcode0
+    {
+        public:
+
+            virtual void execute (Interpreter::Runtime& runtime) {}
+    };
+
+    /// Arithmetic, comparisons, branches and local variable accesses, as in a typical local script
+    const char *sLoopScript =
+        "begin loop\n"
+        "short i\n"
+        "long sum\n"
+        "float f\n"
+        "while ( i < 1000 )\n"
+        "    set sum to sum + i * 3\n"
+        "    set f to f * 0.5 + 1\n"
+        "    if ( sum > 100000 )\n"
+        "        set sum to sum - 100000\n"
+        "    endif\n"
+        "    set i to i + 1\n"
+        "endwhile\n"
+        "end\n";
+}
+
+struct InterpreterTest : public ::testing::Test
+{
+    TestCompilerContext mCompilerContext;
+    Compiler::StreamErrorHandler mErrorHandler;
+    Compiler::FileParser mParser;
+    std::vector<Interpreter::Type_Code> mCode;
+    Interpreter::Interpreter mInterpreter;
+
+    InterpreterTest()
+    : mErrorHandler (std::cerr), mParser (mErrorHandler, mCompilerContext)
+    {
+        Interpreter::installOpcodes (mInterpreter);
+    }
+
+    void compile (const std::string& source)
+    {
+        std::istringstream input (source);
+        Compiler::Scanner scanner (mErrorHandler, input, mCompilerContext.getExtensions());
+        scanner.scan (mParser);
+        ASSERT_TRUE (mErrorHandler.isGood());
+        mParser.getCode (mCode);
+    }
+};
+
+TEST_F(InterpreterTest, runs_loop_script)
+{
+    compile (sLoopScript);
+
+    TestContext context (mParser.getLocals());
+    mInterpreter.run (&mCode[0], mCode.size(), context);
+
+    int sum = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        sum += i * 3;
+        if (sum > 100000)
+            sum -= 100000;
+    }
+
+    EXPECT_EQ (1000, context.mShorts[0]);
+    EXPECT_EQ (sum, context.mLongs[0]);
+    EXPECT_FLOAT_EQ (2.0f, context.mFloats[0]);
+}
+
+TEST_F(InterpreterTest, rejects_invalid_opcodes_at_install_time)
+{
+    // Already installed by installOpcodes
+    EXPECT_THROW (mInterpreter.installSegment5 (0, new OpNop), std::logic_error);
+
+    // Segment 5 has 26 bits of opcode
+    EXPECT_THROW (mInterpreter.installSegment5 (0x4000000, new OpNop), std::logic_error);
+
+    // Far beyond the opcodes allocated by the compiler
+    EXPECT_THROW (mInterpreter.installSegment5 (0x3ffffff, new OpNop), std::logic_error);
+
+    mInterpreter.installSegment5 (0x200ffff, new OpNop);
+}
+
+TEST_F(InterpreterTest, aborts_on_unknown_opcodes)
+{
+    const Interpreter::Type_Code segment5 = 0xc8000000;
+
+    // header, then a single opcode that has not been installed
+    Interpreter::Type_Code code[] = { 1, 0, 0, 0, segment5 | 0x2000000 };
+
+    TestContext context (mParser.getLocals());
+    EXPECT_THROW (mInterpreter.run (code, 5, context), std::runtime_error);
+
+    code[4] = segment5 | 0x3fffffe;
+    EXPECT_THROW (mInterpreter.run (code, 5, context), std::runtime_error);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "components/misc/chunkedvector.hpp"
+
+namespace
+{
+    /// About the size of a LiveCellRef
+    struct Reference
+    {
+        int mIndex;
+        std::string mId;
+        float mData[48];
+
+        Reference (int index) : mIndex (index), mId ("reference") {}
+
+        bool operator== (int index) const { return mIndex==index; }
+    };
+
+    typedef Misc::ChunkedVector<Reference, 8> Vector;
+}
+
+TEST(ChunkedVectorTest, elements_never_move)
+{
+    Vector vector;
+
+    std::vector<Reference *> pointers;
+    for (int i=0; i<100; ++i)
+    {
+        vector.push_back (Reference (i));
+        pointers.push_back (&vector.back());
+    }
+
+    ASSERT_EQ (100u, vector.size());
+
+    for (int i=0; i<100; ++i)
+    {
+        EXPECT_EQ (pointers[i], &vector[i]);
+        EXPECT_EQ (i, pointers[i]->mIndex);
+    }
+}
+
+TEST(ChunkedVectorTest, iterators_stay_valid)
+{
+    Vector vector;
+    vector.push_back (Reference (0));
+
+    Vector::iterator first = vector.begin();
+    Vector::iterator last = --vector.end();
+
+    for (int i=1; i<20; ++i)
+        vector.push_back (Reference (i));
+
+    EXPECT_EQ (0, first->mIndex);
+    EXPECT_EQ (0, last->mIndex);
+    EXPECT_EQ (19, (--vector.end())->mIndex);
+    EXPECT_EQ (20, std::distance (vector.begin(), vector.end()));
+
+    Vector::iterator found = std::find (vector.begin(), vector.end(), 12);
+    ASSERT_TRUE (found!=vector.end());
+    EXPECT_EQ (&vector[12], &*found);
+
+    const Vector& constVector = vector;
+    int sum = 0;
+    for (Vector::const_iterator iter (constVector.begin()); iter!=vector.end(); ++iter)
+        sum += iter->mIndex;
+    EXPECT_EQ (190, sum);
+}
+
+TEST(ChunkedVectorTest, copies_elements)
+{
+    Vector vector;
+    for (int i=0; i<20; ++i)
+        vector.push_back (Reference (i));
+
+    Vector copy (vector);
+    ASSERT_EQ (20u, copy.size());
+    EXPECT_NE (&vector[5], &copy[5]);
+    EXPECT_EQ (5, copy[5].mIndex);
+
+    Vector assigned;
+    assigned.push_back (Reference (42));
+    assigned = vector;
+    ASSERT_EQ (20u, assigned.size());
+    EXPECT_EQ (19, assigned.back().mIndex);
+
+    assigned.clear();
+    EXPECT_TRUE (assigned.empty());
+}
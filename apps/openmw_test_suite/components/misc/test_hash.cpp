@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "components/misc/hash.hpp"
+#include "components/misc/stringops.hpp"
+
+TEST(HashTest, matches_the_fnv1a_reference_values)
+{
+    ASSERT_EQ (0xcbf29ce484222325ull, Misc::getHash ("", 0));
+    ASSERT_EQ (0xaf63dc4c8601ec8cull, Misc::getHash ("a", 1));
+    ASSERT_EQ (0x85944171f73967e8ull, Misc::getHash ("foobar", 6));
+}
+
+TEST(HashTest, adding_in_parts_is_the_same_as_adding_at_once)
+{
+    uint64_t hash = Misc::sHashSeed;
+    Misc::addHash (hash, "foo", 3);
+    Misc::addHash (hash, "bar", 3);
+
+    ASSERT_EQ (Misc::getHash ("foobar", 6), hash);
+}
+
+TEST(HashTest, strings_are_told_apart_by_their_boundaries)
+{
+    uint64_t first = Misc::sHashSeed;
+    Misc::addHash (first, std::string ("foo"));
+    Misc::addHash (first, std::string ("bar"));
+
+    uint64_t second = Misc::sHashSeed;
+    Misc::addHash (second, std::string ("foob"));
+    Misc::addHash (second, std::string ("ar"));
+
+    ASSERT_NE (first, second);
+}
+
+TEST(HashTest, case_insensitive_hash_ignores_case)
+{
+    Misc::StringUtils::CiHash hash;
+
+    ASSERT_EQ (hash ("Meshes\\Furn_De_Bed_01.NIF"), hash ("meshes\\furn_de_bed_01.nif"));
+    ASSERT_NE (hash ("meshes\\furn_de_bed_01.nif"), hash ("meshes\\furn_de_bed_02.nif"));
+}
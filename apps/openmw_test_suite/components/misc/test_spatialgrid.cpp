@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "components/misc/spatialgrid.hpp"
+
+namespace
+{
+    struct Point
+    {
+        float mX, mY, mZ;
+    };
+
+    typedef Misc::SpatialGrid<int> Grid;
+
+    float getSquaredDistance (const Point& point, float x, float y, float z)
+    {
+        return (point.mX-x)*(point.mX-x) + (point.mY-y)*(point.mY-y) + (point.mZ-z)*(point.mZ-z);
+    }
+
+    std::vector<int> queryBruteForce (const std::vector<Point>& points, float x, float y, float z, float radius)
+    {
+        std::vector<int> result;
+        for (size_t i=0; i<points.size(); ++i)
+            if (getSquaredDistance (points[i], x, y, z)<=radius*radius)
+                result.push_back (static_cast<int> (i));
+        return result;
+    }
+
+    Point getRandomPoint()
+    {
+        Point point;
+        point.mX = std::rand() % 20000 - 10000;
+        point.mY = std::rand() % 20000 - 10000;
+        point.mZ = std::rand() % 2000 - 1000;
+        return point;
+    }
+}
+
+TEST(SpatialGridTest, query_matches_brute_force)
+{
+    std::srand (1);
+
+    Grid grid (1024);
+    std::vector<Point> points;
+
+    for (int i=0; i<500; ++i)
+    {
+        points.push_back (getRandomPoint());
+        grid.update (i, points[i].mX, points[i].mY, points[i].mZ);
+    }
+
+    // Move some of the points, most of them into another cell
+    for (int i=0; i<500; i+=3)
+    {
+        points[i] = getRandomPoint();
+        grid.update (i, points[i].mX, points[i].mY, points[i].mZ);
+    }
+
+    const float radii[] = { 0, 100, 1024, 5000, 50000 };
+
+    for (int i=0; i<50; ++i)
+    {
+        Point center = getRandomPoint();
+
+        for (size_t j=0; j<sizeof (radii)/sizeof (radii[0]); ++j)
+        {
+            std::vector<int> result;
+            grid.query (center.mX, center.mY, center.mZ, radii[j], result);
+            std::sort (result.begin(), result.end());
+
+            EXPECT_EQ (queryBruteForce (points, center.mX, center.mY, center.mZ, radii[j]), result);
+        }
+    }
+}
+
+TEST(SpatialGridTest, removed_keys_are_not_found)
+{
+    Grid grid (100);
+
+    grid.update (1, 10, 10, 0);
+    grid.update (2, 20, 20, 0);
+    grid.update (3, 500, 500, 0);
+    grid.remove (2);
+    grid.remove (4);
+
+    EXPECT_EQ (2u, grid.size());
+
+    std::vector<int> result;
+    grid.query (0, 0, 0, 1000, result);
+    std::sort (result.begin(), result.end());
+
+    ASSERT_EQ (2u, result.size());
+    EXPECT_EQ (1, result[0]);
+    EXPECT_EQ (3, result[1]);
+
+    grid.clear();
+    result.clear();
+    grid.query (0, 0, 0, 1000, result);
+
+    EXPECT_TRUE (result.empty());
+}
+
+TEST(SpatialGridTest, query_nearest_returns_closest_first)
+{
+    Grid grid (10);
+
+    grid.update (0, 1000, 0, 0);
+    grid.update (1, 5, 0, 0);
+    grid.update (2, 0, -50, 0);
+    grid.update (3, 0, 0, 20);
+    grid.update (4, -5, 0, 0);
+
+    std::vector<int> result;
+    grid.queryNearest (0, 0, 0, 4, result);
+
+    ASSERT_EQ (4u, result.size());
+    EXPECT_EQ (1, result[0]); // tied with 4, ordered by key
+    EXPECT_EQ (4, result[1]);
+    EXPECT_EQ (3, result[2]);
+    EXPECT_EQ (2, result[3]);
+
+    result.clear();
+    grid.queryNearest (0, 0, 0, 10, result);
+
+    ASSERT_EQ (5u, result.size());
+    EXPECT_EQ (0, result[4]);
+}
+
+TEST(SpatialGridTest, query_nearest_finds_keys_beyond_the_grid_along_z)
+{
+    Grid grid (10);
+
+    grid.update (0, 0, 0, 1e30f);
+    grid.update (1, 5, 5, -1e38f);
+
+    std::vector<int> result;
+    grid.queryNearest (0, 0, 0, 2, result);
+
+    ASSERT_EQ (2u, result.size());
+    EXPECT_EQ (0, result[0]);
+    EXPECT_EQ (1, result[1]);
+}
+
+TEST(SpatialGridTest, extreme_positions_are_clamped_to_the_grid)
+{
+    Grid grid (10);
+
+    grid.update (0, 3e38f, -3e38f, 0);
+    grid.update (1, -3e38f, 3e38f, 0);
+    grid.update (2, 0, 0, 0);
+
+    std::vector<int> result;
+    grid.query (3e38f, -3e38f, 0, 1, result);
+
+    ASSERT_EQ (1u, result.size());
+    EXPECT_EQ (0, result[0]);
+
+    result.clear();
+    grid.queryNearest (1e15f, 1e15f, 0, 3, result);
+
+    ASSERT_EQ (3u, result.size());
+    EXPECT_EQ (2, result[0]);
+}
+
+TEST(SpatialGridTest, query_nearest_at_nan_returns)
+{
+    Grid grid (10);
+
+    grid.update (0, 0, 0, 0);
+
+    std::vector<int> result;
+    grid.queryNearest (std::numeric_limits<float>::quiet_NaN(), 0, 0, 1, result);
+
+    EXPECT_TRUE (result.empty());
+}
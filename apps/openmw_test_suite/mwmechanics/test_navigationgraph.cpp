@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "components/esm/loadland.hpp"
+#include "apps/openmw/mwmechanics/navigationgraph.hpp"
+
+namespace
+{
+    const int sCellSize = ESM::Land::REAL_SIZE;
+
+    typedef std::map<std::pair<int, int>, ESM::Pathgrid> Pathgrids;
+
+    /// A row of points across the cell at height \a z, joined in both directions
+    ESM::Pathgrid makeRow (int x, int y, int first, int last, int z = 0)
+    {
+        ESM::Pathgrid pathgrid;
+        pathgrid.mData.mX = x;
+        pathgrid.mData.mY = y;
+
+        for (int position=first; position<=last; position+=256)
+        {
+            pathgrid.mPoints.push_back (ESM::Pathgrid::Point (position, sCellSize/2, z));
+
+            int index = static_cast<int> (pathgrid.mPoints.size()) - 1;
+            if (index>0)
+            {
+                ESM::Pathgrid::Edge forward = { index-1, index };
+                ESM::Pathgrid::Edge back = { index, index-1 };
+                pathgrid.mEdges.push_back (forward);
+                pathgrid.mEdges.push_back (back);
+            }
+        }
+
+        return pathgrid;
+    }
+
+    void addRow (Pathgrids& pathgrids, int x, int y, int first, int last, int z = 0)
+    {
+        pathgrids[std::make_pair (x, y)] = makeRow (x, y, first, last, z);
+    }
+
+    ESM::Pathgrid::Point makePoint (int x, int y, int localX, int z = 0)
+    {
+        return ESM::Pathgrid::Point (x * sCellSize + localX, y * sCellSize + sCellSize/2, z);
+    }
+}
+
+struct NavigationGraphTest : public ::testing::Test
+{
+    Pathgrids mPathgrids;
+    MWMechanics::NavigationGraph mGraph;
+    std::vector<ESM::Pathgrid::Point> mPath;
+
+    bool findPath (const ESM::Pathgrid::Point& start, const ESM::Pathgrid::Point& end)
+    {
+        mGraph.build (mPathgrids.begin(), mPathgrids.end());
+        mPath.clear();
+        return mGraph.findPath (start, end, mPath);
+    }
+};
+
+TEST_F(NavigationGraphTest, joins_close_points_across_cell_borders)
+{
+    addRow (mPathgrids, 0, 0, 100, sCellSize-92);
+    addRow (mPathgrids, 1, 0, 100, 1000);
+
+    ASSERT_TRUE (findPath (makePoint (0, 0, 100), makePoint (1, 0, 868)));
+
+    ASSERT_FALSE (mPath.empty());
+    EXPECT_EQ (makePoint (0, 0, 100).mX, mPath.front().mX);
+    EXPECT_EQ (makePoint (1, 0, 868).mX, mPath.back().mX);
+
+    for (size_t i=1; i<mPath.size(); ++i)
+        EXPECT_LT (mPath[i-1].mX, mPath[i].mX);
+}
+
+TEST_F(NavigationGraphTest, does_not_join_distant_points)
+{
+    addRow (mPathgrids, 0, 0, 100, sCellSize-1100);
+    addRow (mPathgrids, 1, 0, 1000, 2000);
+
+    EXPECT_FALSE (findPath (makePoint (0, 0, 100), makePoint (1, 0, 1000)));
+}
+
+TEST_F(NavigationGraphTest, does_not_join_steep_points)
+{
+    addRow (mPathgrids, 0, 0, 100, sCellSize-92);
+    addRow (mPathgrids, 1, 0, 100, 1000, 400);
+
+    EXPECT_FALSE (findPath (makePoint (0, 0, 100), makePoint (1, 0, 868, 400)));
+}
+
+TEST_F(NavigationGraphTest, finds_paths_through_several_cells)
+{
+    for (int x=0; x<4; ++x)
+        addRow (mPathgrids, x, 0, 100, sCellSize-92);
+
+    // a dead end to the side
+    addRow (mPathgrids, 1, 1, 100, sCellSize-92);
+
+    ASSERT_TRUE (findPath (makePoint (0, 0, 150), makePoint (3, 0, 4000)));
+
+    EXPECT_EQ (makePoint (0, 0, 100).mX, mPath.front().mX);
+    EXPECT_EQ (makePoint (3, 0, 3940).mX, mPath.back().mX);
+
+    for (size_t i=0; i<mPath.size(); ++i)
+        EXPECT_EQ (sCellSize/2, mPath[i].mY);
+}
+
+TEST_F(NavigationGraphTest, fails_between_unconnected_points)
+{
+    addRow (mPathgrids, 0, 0, 100, sCellSize-92);
+    addRow (mPathgrids, 1, 0, 100, 1000);
+    addRow (mPathgrids, 3, 0, 100, 1000);
+
+    EXPECT_FALSE (findPath (makePoint (0, 0, 100), makePoint (3, 0, 100)));
+
+    // no pathgrid at the end
+    EXPECT_FALSE (findPath (makePoint (0, 0, 100), makePoint (2, 0, 100)));
+}
+
+TEST_F(NavigationGraphTest, reads_the_same_graph_from_the_cache)
+{
+    for (int x=0; x<3; ++x)
+        addRow (mPathgrids, x, 0, 100, sCellSize-92);
+
+    boost::filesystem::path cacheFile = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path ("openmw-test-%%%%%%%%.cache");
+
+    ESM::Pathgrid::Point start = makePoint (0, 0, 100);
+    ESM::Pathgrid::Point end = makePoint (2, 0, 4000);
+
+    MWMechanics::NavigationGraph built;
+    built.build (mPathgrids.begin(), mPathgrids.end(), cacheFile);
+    ASSERT_TRUE (boost::filesystem::exists (cacheFile));
+
+    MWMechanics::NavigationGraph cached;
+    cached.build (mPathgrids.begin(), mPathgrids.end(), cacheFile);
+    boost::filesystem::remove (cacheFile);
+
+    std::vector<ESM::Pathgrid::Point> builtPath;
+    std::vector<ESM::Pathgrid::Point> cachedPath;
+    ASSERT_TRUE (built.findPath (start, end, builtPath));
+    ASSERT_TRUE (cached.findPath (start, end, cachedPath));
+
+    ASSERT_EQ (builtPath.size(), cachedPath.size());
+    for (size_t i=0; i<builtPath.size(); ++i)
+        EXPECT_EQ (builtPath[i].mX, cachedPath[i].mX);
+}
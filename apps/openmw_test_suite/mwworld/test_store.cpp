@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+
+#include "components/esm/loadgmst.hpp"
+#include "components/misc/stringops.hpp"
+#include "apps/openmw/mwworld/store.hpp"
+
+namespace
+{
+    ESM::GameSetting makeSetting (const std::string& id, int value)
+    {
+        ESM::GameSetting setting;
+        setting.mId = id;
+        setting.mValue.setType (ESM::VT_Int);
+        setting.mValue.setInteger (value);
+        return setting;
+    }
+}
+
+struct StoreTest : public ::testing::Test
+{
+    MWWorld::Store<ESM::GameSetting> mStore;
+
+    StoreTest()
+    {
+        mStore.insertStatic (makeSetting ("iStatic", 1));
+        mStore.insertStatic (makeSetting ("iOverridden", 2));
+        mStore.insert (makeSetting ("iOverridden", 3));
+        mStore.insert (makeSetting ("iDynamic", 4));
+    }
+};
+
+TEST_F(StoreTest, search_ignores_case)
+{
+    ASSERT_TRUE (mStore.search ("istatic"));
+    EXPECT_EQ (1, mStore.search ("ISTATIC")->getInt());
+    EXPECT_EQ (1, mStore.search ("iStatic")->getInt());
+    EXPECT_EQ (4, mStore.search ("IDynamic")->getInt());
+    EXPECT_TRUE (mStore.search ("iMissing")==0);
+    EXPECT_THROW (mStore.find ("iMissing"), std::runtime_error);
+}
+
+TEST_F(StoreTest, dynamic_records_override_static_records)
+{
+    EXPECT_EQ (3, mStore.find ("iOverridden")->getInt());
+
+    mStore.erase ("iOverridden");
+    EXPECT_EQ (2, mStore.find ("iOverridden")->getInt());
+
+    mStore.insert (makeSetting ("iOverridden", 5));
+    mStore.clearDynamic();
+    EXPECT_EQ (2, mStore.find ("iOverridden")->getInt());
+    EXPECT_TRUE (mStore.search ("iDynamic")==0);
+}
+
+TEST_F(StoreTest, handles_stay_valid)
+{
+    MWWorld::RecordHandle overridden = mStore.getHandle ("IOVERRIDDEN");
+    MWWorld::RecordHandle dynamic = mStore.getHandle ("idynamic");
+
+    EXPECT_EQ (-1, mStore.getHandle ("iMissing"));
+    EXPECT_TRUE (mStore.search (-1)==0);
+    EXPECT_THROW (mStore.find (-1), std::runtime_error);
+
+    ASSERT_NE (-1, overridden);
+    EXPECT_EQ (overridden, mStore.getHandle ("iOverridden"));
+    EXPECT_NE (overridden, dynamic);
+    EXPECT_EQ (mStore.search ("iOverridden"), mStore.search (overridden));
+
+    mStore.clearDynamic();
+    EXPECT_EQ (2, mStore.find (overridden)->getInt());
+    EXPECT_TRUE (mStore.search (dynamic)==0);
+    EXPECT_THROW (mStore.find (dynamic), std::runtime_error);
+
+    mStore.insert (makeSetting ("IDYNAMIC", 6));
+    EXPECT_EQ (dynamic, mStore.getHandle ("iDynamic"));
+    EXPECT_EQ (6, mStore.find (dynamic)->getInt());
+
+    mStore.eraseStatic ("iStatic");
+    EXPECT_TRUE (mStore.search ("iStatic")==0);
+}
+
+TEST_F(StoreTest, ids_and_handles_find_the_same_records)
+{
+    std::vector<std::string> ids;
+
+    for (int i=0; i<200; ++i)
+    {
+        std::ostringstream id;
+        id << "fSetting" << i << "Mult";
+        ids.push_back (id.str());
+        mStore.insertStatic (makeSetting (id.str(), i));
+    }
+
+    for (int i=0; i<200; ++i)
+    {
+        const ESM::GameSetting *setting = mStore.find (Misc::StringUtils::lowerCase (ids[i]));
+        EXPECT_EQ (i, setting->getInt());
+        EXPECT_EQ (setting, mStore.find (mStore.getHandle (ids[i])));
+    }
+}
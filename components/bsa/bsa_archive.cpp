@@ -31,6 +31,7 @@
 #include <OgreArchiveManager.h>
 #include <OgreResourceGroupManager.h>
 #include "bsa_file.hpp"
+#include "vfsindex.hpp"
 
 #include "../files/constrainedfiledatastream.hpp"
 
@@ -293,6 +294,119 @@ public:
     }
 };
 
+/// An OGRE Archive wrapping a VFSIndex of all data directories and BSAs
+class VFSArchive : public Archive
+{
+  boost::shared_ptr<const Bsa::VFSIndex> mIndex;
+
+  // The real name of an entry with forward slashes, as the resources are listed
+  // under it and fs-strict lookups have to find them again
+  static std::string getName(const Bsa::VFSIndex::Entry &entry)
+  {
+    std::string name = entry.mName;
+    std::replace(name.begin(), name.end(), '\\', '/');
+    return name;
+  }
+
+  FileInfo getFileInfo(const Bsa::VFSIndex::Index::value_type &entry) const
+  {
+    std::string name = getName(entry.second);
+    std::string::size_type pt = name.rfind('/');
+    if(pt == std::string::npos)
+        pt = 0;
+
+    FileInfo fi;
+    fi.archive = const_cast<VFSArchive*>(this);
+    fi.path = name.substr(0, pt);
+    fi.filename = name.substr((name[pt]=='/') ? pt+1 : pt);
+    fi.compressedSize = fi.uncompressedSize = entry.second.mSize;
+    return fi;
+  }
+
+public:
+  VFSArchive(const String& name, const boost::shared_ptr<const Bsa::VFSIndex> &index)
+    : Archive(name, "VFS"), mIndex(index)
+  {}
+
+  // The index takes care of the case
+  bool isCaseSensitive() const { return false; }
+
+  void load() {}
+  void unload() {}
+
+  DataStreamPtr open(const String& filename, bool readonly = true) const
+  {
+    return mIndex->open(filename);
+  }
+
+  bool exists(const String& filename)
+  {
+    return mIndex->find(filename) != 0;
+  }
+
+  time_t getModifiedTime(const String& filename)
+  {
+    // Files in archives report the time of their archive
+    const Bsa::VFSIndex::Entry *entry = mIndex->find(filename);
+    if(!entry)
+        return 0;
+
+    boost::system::error_code ec;
+    std::time_t time = boost::filesystem::last_write_time(mIndex->getPath(*entry), ec);
+    return ec ? 0 : time;
+  }
+
+  StringVectorPtr list(bool recursive = true, bool dirs = false)
+  {
+    return find ("*", recursive, dirs);
+  }
+
+  FileInfoListPtr listFileInfo(bool recursive = true, bool dirs = false)
+  {
+    return findFileInfo ("*", recursive, dirs);
+  }
+
+  StringVectorPtr find(const String& pattern, bool recursive = true,
+                       bool dirs = false)
+  {
+    std::string normalizedPattern = mIndex->normalize(pattern);
+    StringVectorPtr ptr = StringVectorPtr(new StringVector());
+    const Bsa::VFSIndex::Index &index = mIndex->getIndex();
+    ptr->reserve(index.size());
+    for(Bsa::VFSIndex::Index::const_iterator iter = index.begin();iter != index.end();++iter)
+    {
+      if(normalizedPattern == "*" || Ogre::StringUtil::match(iter->first, normalizedPattern) ||
+         (recursive && Ogre::StringUtil::match(iter->first, "*/"+normalizedPattern)))
+        ptr->push_back(getName(iter->second));
+    }
+    return ptr;
+  }
+
+  FileInfoListPtr findFileInfo(const String& pattern, bool recursive = true,
+                               bool dirs = false) const
+  {
+    std::string normalizedPattern = mIndex->normalize(pattern);
+    FileInfoListPtr ptr = FileInfoListPtr(new FileInfoList());
+    const Bsa::VFSIndex::Index &index = mIndex->getIndex();
+
+    Bsa::VFSIndex::Index::const_iterator i = index.find(normalizedPattern);
+    if(i != index.end())
+    {
+      ptr->push_back(getFileInfo(*i));
+      return ptr;
+    }
+
+    for(Bsa::VFSIndex::Index::const_iterator iter = index.begin();iter != index.end();++iter)
+    {
+      if(Ogre::StringUtil::match(iter->first, normalizedPattern) ||
+         (recursive && Ogre::StringUtil::match(iter->first, "*/"+normalizedPattern)))
+        ptr->push_back(getFileInfo(*iter));
+    }
+
+    return ptr;
+  }
+};
+
 // An archive factory for BSA archives
 class BSAArchiveFactory : public ArchiveFactory
 {
@@ -339,8 +453,40 @@ public:
 };
 
 
+// An archive factory for VFS indices. OGRE only passes the location name, so the
+// indices are registered by name beforehand.
+class VFSArchiveFactory : public ArchiveFactory
+{
+public:
+    typedef std::map<std::string, boost::shared_ptr<const Bsa::VFSIndex> > Indices;
+    Indices mIndices;
+
+    const String& getType() const
+    {
+      static String name = "VFS";
+      return name;
+    }
+
+    Archive *createInstance( const String& name )
+    {
+      Indices::const_iterator iter = mIndices.find(name);
+      if (iter == mIndices.end())
+        throw std::runtime_error("No VFS index registered as " + name);
+      return new VFSArchive(name, iter->second);
+    }
+
+    virtual Archive* createInstance(const String& name, bool readOnly)
+    {
+      return createInstance(name);
+    }
+
+    void destroyInstance( Archive* arch) { delete arch; }
+};
+
+
 static bool init = false;
 static bool init2 = false;
+static VFSArchiveFactory *vfsFactory = 0;
 
 static void insertBSAFactory()
 {
@@ -361,6 +507,16 @@ static void insertDirFactory()
 }
 
 
+static void insertVFSFactory()
+{
+  if(!vfsFactory)
+    {
+      vfsFactory = new VFSArchiveFactory;
+      ArchiveManager::getSingleton().addArchiveFactory( vfsFactory );
+    }
+}
+
+
 namespace Bsa
 {
 
@@ -382,4 +538,13 @@ void addDir(const std::string& name, const bool& fs, const std::string& group)
     addResourceLocation(name, "Dir", group, true);
 }
 
+void addVFS(const boost::shared_ptr<const VFSIndex>& index, const std::string& name, const std::string& group)
+{
+    insertVFSFactory();
+    vfsFactory->mIndices[name] = index;
+
+    ResourceGroupManager::getSingleton().
+    addResourceLocation(name, "VFS", group, true);
+}
+
 }
@@ -24,17 +24,26 @@
 #include <string>
 #include <algorithm>
 
+#include <boost/shared_ptr.hpp>
+
 #ifndef BSA_BSA_ARCHIVE_H
 #define BSA_BSA_ARCHIVE_H
 
 namespace Bsa
 {
 
+class VFSIndex;
+
 /// Add the given BSA file as an input archive in the Ogre resource
 /// system.
 void addBSA(const std::string& file, const std::string& group="General");
 void addDir(const std::string& file, const bool& fs, const std::string& group="General");
 
+/// Add all files of \a index as a single input archive in the Ogre resource
+/// system. \a name identifies the archive and must be unique.
+void addVFS(const boost::shared_ptr<const VFSIndex>& index, const std::string& name,
+    const std::string& group="General");
+
 }
 
 #endif
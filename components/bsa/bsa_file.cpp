@@ -24,6 +24,8 @@
 #include "bsa_file.hpp"
 
 #include <stdexcept>
+#include <cstring>
+#include <cassert>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -64,7 +66,8 @@ void BSAFile::readHeader()
      *
      * ---------- end of directory block -------------
      *
-     * - 8*filenum - hash table block, we currently ignore this
+     * - 8*filenum - hash table block, sorted by hash. We compute the
+     *   hashes from the names instead, see below.
      *
      * ----------- start of data buffer --------------
      *
@@ -130,6 +133,12 @@ void BSAFile::readHeader()
     // (skipped)
     size_t fileDataOffset = 12 + dirsize + 8*filenum;
 
+    // Size the lookup table to keep it at most half full
+    size_t tableSize = 16;
+    while(tableSize < 2*filenum)
+        tableSize *= 2;
+    lookup.assign(tableSize, -1);
+
     // Set up the the FileStruct table
     files.resize(filenum);
     for(size_t i=0;i<filenum;i++)
@@ -142,23 +151,103 @@ void BSAFile::readHeader()
         if(fs.offset + fs.fileSize > fsize)
             fail("Archive contains offsets outside itself");
 
-        // Add the file name to the lookup
-        lookup[fs.name] = i;
+        // Add the file name to the lookup. The archive's own hash table
+        // is not trusted here, archives written by third party tools may
+        // hash the names differently.
+        fs.hash = getHash(fs.name);
+        addToLookup(i);
     }
 
     isLoaded = true;
 }
 
+/// Spread the hash over the lookup table. The hash itself varies little
+/// in its lowest bits, as most names start with the same folder names.
+static size_t getSlot(uint64_t hash, size_t mask)
+{
+    uint32_t h = static_cast<uint32_t>(hash) ^ static_cast<uint32_t>(hash >> 32);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h & mask;
+}
+
+static inline uint32_t lowerChar(char c)
+{
+    unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? u + ('a' - 'A') : u;
+}
+
+uint64_t BSAFile::getHash(const char *name)
+{
+    size_t len = strlen(name);
+    size_t half = len / 2;
+    size_t i = 0;
+
+    // The first half of the name is xor'ed into the low word...
+    uint32_t low = 0;
+    uint32_t off = 0;
+    for(; i < half; i++)
+    {
+        low ^= lowerChar(name[i]) << (off & 0x1f);
+        off += 8;
+    }
+
+    // ...the second half into the high word, which is rotated as it goes
+    uint32_t high = 0;
+    off = 0;
+    for(; i < len; i++)
+    {
+        uint32_t temp = lowerChar(name[i]) << (off & 0x1f);
+        high ^= temp;
+        uint32_t n = temp & 0x1f;
+        if(n)
+            high = (high >> n) | (high << (32 - n));
+        off += 8;
+    }
+
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+void BSAFile::addToLookup(int index)
+{
+    const FileStruct &fs = files[index];
+    size_t mask = lookup.size() - 1;
+
+    size_t slot = getSlot(fs.hash, mask);
+    while(lookup[slot] != -1)
+    {
+        const FileStruct &other = files[lookup[slot]];
+        if(other.hash == fs.hash && strcasecmp(other.name, fs.name) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    lookup[slot] = index;
+}
+
 /// Get the index of a given file name, or -1 if not found
 int BSAFile::getIndex(const char *str) const
 {
-    Lookup::const_iterator it = lookup.find(str);
-    if(it == lookup.end())
+    if(lookup.empty())
         return -1;
 
-    int res = it->second;
-    assert(res >= 0 && (size_t)res < files.size());
-    return res;
+    uint64_t hash = getHash(str);
+    size_t mask = lookup.size() - 1;
+
+    for(size_t slot = getSlot(hash, mask); lookup[slot] != -1; slot = (slot + 1) & mask)
+    {
+        int res = lookup[slot];
+        assert(res >= 0 && (size_t)res < files.size());
+
+        const FileStruct &fs = files[res];
+        if(fs.hash == hash && strcasecmp(fs.name, str) == 0)
+            return res;
+    }
+
+    return -1;
 }
 
 /// Open an archive file.
@@ -28,7 +28,6 @@
 #include <libs/platform/strings.h>
 #include <string>
 #include <vector>
-#include <map>
 
 #include <OgreDataStream.h>
 
@@ -52,6 +51,9 @@ public:
 
         // Zero-terminated file name
         const char *name;
+
+        // Case insensitive hash of the name, see getHash()
+        uint64_t hash;
     };
     typedef std::vector<FileStruct> FileList;
 
@@ -68,19 +70,11 @@ private:
     /// Used for error messages
     std::string filename;
 
-    /// Case insensitive string comparison
-    struct iltstr
-    {
-        bool operator()(const char *s1, const char *s2) const
-        { return strcasecmp(s1,s2) < 0; }
-    };
-
-    /** A map used for fast file name lookup. The value is the index into
-        the files[] vector above. The iltstr ensures that file name
-        checks are case insensitive.
+    /** An open addressing hash table used for fast file name lookup.
+        Each slot holds an index into the files[] vector above, or -1
+        if it is empty. The size is always a power of two.
     */
-    typedef std::map<const char*, int, iltstr> Lookup;
-    Lookup lookup;
+    std::vector<int> lookup;
 
     /// Error handling
     void fail(const std::string &msg);
@@ -88,6 +82,10 @@ private:
     /// Read header information from the input source
     void readHeader();
 
+    /// Add files[index] to the lookup table, replacing an earlier file
+    /// with the same name
+    void addToLookup(int index);
+
     /// Get the index of a given file name, or -1 if not found
     int getIndex(const char *str) const;
 
@@ -121,6 +119,10 @@ public:
     /// Get a list of all files
     const FileList &getList() const
     { return files; }
+
+    /// Case insensitive hash of a file name. This is the hash the archive
+    /// format uses for its own hash table.
+    static uint64_t getHash(const char *name);
 };
 
 }
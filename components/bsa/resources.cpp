@@ -4,44 +4,25 @@
 #include <iostream>
 
 #include <OgreResourceGroupManager.h>
-#include <OgreStringConverter.h>
 
 #include "bsa_archive.hpp"
+#include "vfsindex.hpp"
 
 void Bsa::registerResources (const Files::Collections& collections,
     const std::vector<std::string>& archives, bool useLooseFiles, bool fsStrict)
 {
-    const Files::PathContainer& dataDirs = collections.getPaths();
+    // One index over all sources, so that a resource lookup doesn't have to walk a
+    // resource group per data directory and archive
+    boost::shared_ptr<VFSIndex> index (new VFSIndex (fsStrict));
 
-    int i=0;
-
-    if (useLooseFiles)
-        for (Files::PathContainer::const_iterator iter = dataDirs.begin(); iter != dataDirs.end(); ++iter)
-        {
-            // Last data dir has the highest priority
-            std::string groupName = "Data" + Ogre::StringConverter::toString(dataDirs.size()-i, 8, '0');
-            Ogre::ResourceGroupManager::getSingleton ().createResourceGroup (groupName);
-
-            std::string dataDirectory = iter->string();
-            std::cout << "Data dir " << dataDirectory << std::endl;
-            Bsa::addDir(dataDirectory, fsStrict, groupName);
-            ++i;
-        }
-
-    i=0;
+    // Last BSA has the highest priority
     for (std::vector<std::string>::const_iterator archive = archives.begin(); archive != archives.end(); ++archive)
     {
         if (collections.doesExist(*archive))
         {
-            // Last BSA has the highest priority
-            std::string groupName = "DataBSA" + Ogre::StringConverter::toString(archives.size()-i, 8, '0');
-
-            Ogre::ResourceGroupManager::getSingleton ().createResourceGroup (groupName);
-
             const std::string archivePath = collections.getPath(*archive).string();
             std::cout << "Adding BSA archive " << archivePath << std::endl;
-            Bsa::addBSA(archivePath, groupName);
-            ++i;
+            index->addArchive(archivePath);
         }
         else
         {
@@ -50,4 +31,22 @@ void Bsa::registerResources (const Files::Collections& collections,
             throw std::runtime_error(message.str());
         }
     }
+
+    // Loose files override archives, the last data dir has the highest priority
+    if (useLooseFiles)
+    {
+        const Files::PathContainer& dataDirs = collections.getPaths();
+
+        for (Files::PathContainer::const_iterator iter = dataDirs.begin(); iter != dataDirs.end(); ++iter)
+        {
+            std::string dataDirectory = iter->string();
+            std::cout << "Data dir " << dataDirectory << std::endl;
+            index->addDirectory(dataDirectory);
+        }
+    }
+
+    std::cout << "Indexed " << index->getIndex().size() << " resources" << std::endl;
+
+    Ogre::ResourceGroupManager::getSingleton ().createResourceGroup ("Data");
+    Bsa::addVFS(index, "Data", "Data");
 }
@@ -0,0 +1,197 @@
+#include "vfsindex.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <locale>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include "bsa_file.hpp"
+
+#include "../files/constrainedfiledatastream.hpp"
+
+namespace
+{
+    char normalizeChar (char ch)
+    {
+        return ch == '\\' ? '/' : std::tolower (ch, std::locale::classic());
+    }
+
+    char normalizeSlash (char ch)
+    {
+        return ch == '\\' ? '/' : ch;
+    }
+
+    bool compareKeys (const Bsa::VFSIndex::Index::value_type *left,
+        const Bsa::VFSIndex::Index::value_type *right)
+    {
+        return left->first < right->first;
+    }
+}
+
+Bsa::VFSIndex::VFSIndex (bool fsStrict)
+: mFsStrict (fsStrict)
+{}
+
+void Bsa::VFSIndex::addArchive (const std::string& path)
+{
+    BSAFile archive;
+    archive.open (path);
+
+    Source source;
+    source.mPath = path;
+    source.mIsArchive = true;
+    mSources.push_back (source);
+
+    const BSAFile::FileList& files = archive.getList();
+
+    Entry entry;
+    entry.mSource = mSources.size()-1;
+
+    for (BSAFile::FileList::const_iterator iter (files.begin()); iter!=files.end(); ++iter)
+    {
+        entry.mOffset = iter->offset;
+        entry.mSize = iter->fileSize;
+        entry.mName = iter->name;
+        insert (normalize (entry.mName), entry);
+    }
+}
+
+void Bsa::VFSIndex::addDirectory (const std::string& path)
+{
+    typedef boost::filesystem::recursive_directory_iterator directory_iterator;
+
+    Source source;
+    source.mPath = path;
+    source.mIsArchive = false;
+    mSources.push_back (source);
+
+    Entry entry;
+    entry.mSource = mSources.size()-1;
+    entry.mOffset = 0;
+    entry.mSize = 0;
+
+    size_t prefix = path.size();
+
+    if (!path.empty() && path[prefix-1]!='\\' && path[prefix-1]!='/')
+        ++prefix;
+
+    for (directory_iterator iter (path), end; iter!=end; ++iter)
+    {
+        if (boost::filesystem::is_directory (*iter))
+            continue;
+
+        std::string proper = iter->path().string();
+
+        entry.mName.resize (proper.size()-prefix);
+        std::transform (proper.begin()+prefix, proper.end(), entry.mName.begin(), normalizeSlash);
+
+        insert (normalize (entry.mName), entry);
+    }
+}
+
+void Bsa::VFSIndex::insert (const std::string& key, const Entry& entry)
+{
+    std::pair<Index::iterator, bool> result = mIndex.insert (std::make_pair (key, entry));
+
+    if (!result.second)
+        result.first->second = entry;
+}
+
+const Bsa::VFSIndex::Entry *Bsa::VFSIndex::find (const std::string& name) const
+{
+    Index::const_iterator iter = mIndex.find (normalize (name));
+
+    if (iter==mIndex.end())
+        return 0;
+
+    if (mFsStrict && !mSources[iter->second.mSource].mIsArchive)
+    {
+        // Archives are always case insensitive
+        std::string strict (name.size(), '\0');
+        std::transform (name.begin(), name.end(), strict.begin(), normalizeSlash);
+
+        if (strict!=iter->second.mName)
+            return 0;
+    }
+
+    return &iter->second;
+}
+
+Ogre::DataStreamPtr Bsa::VFSIndex::open (const std::string& name) const
+{
+    const Entry *entry = find (name);
+
+    if (!entry)
+    {
+        std::ostringstream stream;
+        stream << "The file '" << name << "' could not be found.";
+        throw std::runtime_error (stream.str());
+    }
+
+    if (mSources[entry->mSource].mIsArchive)
+        return openConstrainedFileDataStream (mSources[entry->mSource].mPath.c_str(),
+            entry->mOffset, entry->mSize);
+
+    return openConstrainedFileDataStream (getPath (*entry).c_str());
+}
+
+std::string Bsa::VFSIndex::getPath (const Entry& entry) const
+{
+    const Source& source = mSources[entry.mSource];
+
+    if (source.mIsArchive)
+        return source.mPath;
+
+    return (boost::filesystem::path (source.mPath) / entry.mName).string();
+}
+
+std::string Bsa::VFSIndex::normalize (const std::string& name) const
+{
+    std::string normalized (name.size(), '\0');
+    std::transform (name.begin(), name.end(), normalized.begin(), normalizeChar);
+    return normalized;
+}
+
+const std::vector<Bsa::VFSIndex::Source>& Bsa::VFSIndex::getSources() const
+{
+    return mSources;
+}
+
+const Bsa::VFSIndex::Index& Bsa::VFSIndex::getIndex() const
+{
+    return mIndex;
+}
+
+void Bsa::VFSIndex::dump (std::ostream& stream, bool longFormat) const
+{
+    std::vector<const Index::value_type *> entries;
+    entries.reserve (mIndex.size());
+
+    for (Index::const_iterator iter (mIndex.begin()); iter!=mIndex.end(); ++iter)
+        entries.push_back (&*iter);
+
+    std::sort (entries.begin(), entries.end(), compareKeys);
+
+    for (std::vector<const Index::value_type *>::const_iterator iter (entries.begin());
+        iter!=entries.end(); ++iter)
+    {
+        const Entry& entry = (*iter)->second;
+        const Source& source = mSources[entry.mSource];
+
+        if (longFormat)
+        {
+            std::ios::fmtflags flags (stream.flags());
+            stream << std::setw (50) << std::left << (*iter)->first << " " << source.mPath;
+            if (source.mIsArchive)
+                stream << " " << std::dec << entry.mSize << " @ 0x" << std::hex << entry.mOffset;
+            stream << std::endl;
+            stream.flags (flags);
+        }
+        else
+            stream << (*iter)->first << " " << source.mPath << std::endl;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef BSA_VFSINDEX_H
+#define BSA_VFSINDEX_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include <OgreDataStream.h>
+
+namespace Bsa
+{
+    /// \brief Index of all resources in the data directories and BSA archives
+    ///
+    /// Every normalized path (lower case, forward slashes) is mapped to the one data source that
+    /// provides it, so that resolving a resource is a single hash lookup.
+    class VFSIndex
+    {
+        public:
+
+            struct Source
+            {
+                std::string mPath;
+                bool mIsArchive;
+            };
+
+            struct Entry
+            {
+                int mSource; // index into getSources()
+                uint32_t mOffset; // offset in the archive, 0 for loose files
+                uint32_t mSize; // 0 for loose files
+                std::string mName; // name in the archive or relative to the data directory
+            };
+
+            typedef boost::unordered_map<std::string, Entry> Index;
+
+            /// \param fsStrict Loose files are matched case sensitively
+            explicit VFSIndex (bool fsStrict = false);
+
+            void addArchive (const std::string& path);
+            ///< Files of sources added later override those of earlier ones.
+
+            void addDirectory (const std::string& path);
+            ///< Files of sources added later override those of earlier ones.
+
+            const Entry *find (const std::string& name) const;
+            ///< \return 0, if there is no such file
+
+            Ogre::DataStreamPtr open (const std::string& name) const;
+            ///< Throws an exception, if there is no such file
+
+            std::string getPath (const Entry& entry) const;
+            ///< Path of the archive or loose file containing \a entry
+
+            std::string normalize (const std::string& name) const;
+
+            const std::vector<Source>& getSources() const;
+
+            const Index& getIndex() const;
+
+            void dump (std::ostream& stream, bool longFormat = false) const;
+            ///< List every file with the source it is loaded from, sorted by name
+
+        private:
+
+            void insert (const std::string& key, const Entry& entry);
+
+            bool mFsStrict;
+            std::vector<Source> mSources;
+            Index mIndex;
+    };
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include "cachefile.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <components/version/version.hpp>
+
+#include "esmreader.hpp"
+#include "esmwriter.hpp"
+
+void ESM::startCacheFile (ESMWriter& writer, std::ostream& stream, int format)
+{
+    writer.setFormat (format);
+    writer.setVersion();
+    writer.setType (0);
+    writer.save (stream);
+
+    writer.startRecord (sCacheKeyRecord);
+}
+
+void ESM::startCacheFile (ESMWriter& writer, std::ostream& stream, int format, uint64_t key)
+{
+    startCacheFile (writer, stream, format);
+    writer.writeHNT ("HASH", key);
+    writer.endRecord (sCacheKeyRecord);
+}
+
+bool ESM::openCacheFile (ESMReader& reader, const boost::filesystem::path& file, int format)
+{
+    if (!boost::filesystem::exists (file))
+        return false;
+
+    reader.open (file.string());
+
+    if (reader.getFormat()!=format || !reader.hasMoreRecs() || reader.getRecName().val!=sCacheKeyRecord)
+        return false;
+
+    reader.getRecHeader();
+
+    return true;
+}
+
+bool ESM::openCacheFile (ESMReader& reader, const boost::filesystem::path& file, int format, uint64_t key)
+{
+    if (!openCacheFile (reader, file, format))
+        return false;
+
+    uint64_t cachedKey = 0;
+    reader.getHNT (cachedKey, "HASH");
+
+    return cachedKey==key;
+}
+
+void ESM::saveCacheFile (const boost::filesystem::path& file, const char *data, size_t size)
+{
+    boost::filesystem::path tmpFile = file.string() + ".tmp";
+
+    try
+    {
+        if (file.has_parent_path())
+            boost::filesystem::create_directories (file.parent_path());
+
+        {
+            boost::filesystem::ofstream stream (tmpFile, std::ios::binary);
+            if (!stream)
+                throw std::runtime_error ("can't open " + tmpFile.string());
+
+            stream.write (data, size);
+            stream.flush();
+            if (!stream)
+                throw std::runtime_error ("write error on " + tmpFile.string());
+        }
+
+        boost::filesystem::rename (tmpFile, file);
+    }
+    catch (...)
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove (tmpFile, error);
+        throw;
+    }
+}
+
+void ESM::saveCacheFile (const boost::filesystem::path& file, const std::string& data)
+{
+    saveCacheFile (file, data.data(), data.size());
+}
+
+void ESM::touchCacheFile (const boost::filesystem::path& file)
+{
+    boost::system::error_code error;
+    boost::filesystem::last_write_time (file, std::time (0), error);
+}
+
+void ESM::pruneCacheFiles (const boost::filesystem::path& dir, const std::string& prefix, uint64_t maxSize)
+{
+    if (!boost::filesystem::is_directory (dir))
+        return;
+
+    // last use, size, file
+    std::vector<std::pair<std::pair<std::time_t, uint64_t>, boost::filesystem::path> > files;
+    uint64_t size = 0;
+
+    for (boost::filesystem::directory_iterator iter (dir); iter!=boost::filesystem::directory_iterator(); ++iter)
+    {
+        const boost::filesystem::path& file = iter->path();
+        std::string name = file.filename().string();
+
+        if (name.compare (0, prefix.size(), prefix)!=0 || file.extension()!=".cache" ||
+            !boost::filesystem::is_regular_file (file))
+            continue;
+
+        uint64_t fileSize = boost::filesystem::file_size (file);
+        files.push_back (std::make_pair (std::make_pair (boost::filesystem::last_write_time (file), fileSize), file));
+        size += fileSize;
+    }
+
+    std::sort (files.begin(), files.end());
+
+    for (size_t i=0; i<files.size() && size>maxSize; ++i)
+    {
+        boost::filesystem::remove (files[i].second);
+        size -= files[i].first.second;
+    }
+}
+
+std::string ESM::getCacheVersion()
+{
+    return std::string (OPENMW_VERSION) + " " + OPENMW_VERSION_COMMITHASH;
+}
+
+std::string ESM::getCacheKey (const std::vector<boost::filesystem::path>& files)
+{
+    std::ostringstream stream;
+
+    stream << getCacheVersion() << "\n";
+
+    for (std::vector<boost::filesystem::path>::const_iterator iter (files.begin()); iter!=files.end(); ++iter)
+        stream << iter->string() << " " << boost::filesystem::file_size (*iter)
+            << " " << boost::filesystem::last_write_time (*iter) << "\n";
+
+    return stream.str();
+}
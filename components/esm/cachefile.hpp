@@ -0,0 +1,58 @@
+#ifndef OPENMW_COMPONENTS_ESM_CACHEFILE_H
+#define OPENMW_COMPONENTS_ESM_CACHEFILE_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "defs.hpp"
+
+namespace ESM
+{
+    class ESMReader;
+    class ESMWriter;
+
+    // Cache files of data derived from the content files are ESM files with a format number of
+    // their own. The first record is a key record, which identifies what the cache has been made
+    // from. Files with another format or key are ignored and eventually overwritten.
+
+    const uint32_t sCacheKeyRecord = FourCC<'C','K','E','Y'>::value;
+
+    /// Set up \a writer for a cache file of \a format in \a stream and start the key record.
+    /// The caller writes the key and ends the record with writer.endRecord (sCacheKeyRecord).
+    void startCacheFile (ESMWriter& writer, std::ostream& stream, int format);
+
+    /// Same as above, with a key record holding just \a key
+    void startCacheFile (ESMWriter& writer, std::ostream& stream, int format, uint64_t key);
+
+    /// Open \a file and read the header of its key record, so that the key can be read next.
+    /// \return Is \a file a cache file of \a format?
+    bool openCacheFile (ESMReader& reader, const boost::filesystem::path& file, int format);
+
+    /// \return Is \a file a cache file of \a format with \a key?
+    bool openCacheFile (ESMReader& reader, const boost::filesystem::path& file, int format, uint64_t key);
+
+    /// Replace \a file with \a size bytes of \a data, creating its directory if necessary.
+    /// The data goes to a temporary file first, so that an interrupted write never leaves a
+    /// truncated cache. Throws an exception on failure.
+    void saveCacheFile (const boost::filesystem::path& file, const char *data, size_t size);
+
+    void saveCacheFile (const boost::filesystem::path& file, const std::string& data);
+
+    /// Mark \a file as used now, for pruneCacheFiles. Errors are ignored.
+    void touchCacheFile (const boost::filesystem::path& file);
+
+    /// Remove the least recently used cache files in \a dir with names starting with \a prefix,
+    /// until they take up no more than \a maxSize bytes. Throws an exception on failure.
+    void pruneCacheFiles (const boost::filesystem::path& dir, const std::string& prefix, uint64_t maxSize);
+
+    /// Caches made by another build may differ, even with the same content and cache format
+    std::string getCacheVersion();
+
+    /// Identifies the engine build and \a files with their sizes and modification times
+    std::string getCacheKey (const std::vector<boost::filesystem::path>& files);
+}
+
+#endif
@@ -8,6 +8,8 @@ namespace ESM
 
 using namespace Misc;
 
+bool ESMReader::sUseMemoryMapping = true;
+
     std::string ESMReader::getName() const
     {
         return mCtx.filename;
@@ -16,12 +18,15 @@ using namespace Misc;
 ESM_Context ESMReader::getContext()
 {
     // Update the file position before returning
-    mCtx.filePos = mEsm->tell();
+    mCtx.filePos = tell();
     return mCtx;
 }
 
 ESMReader::ESMReader()
     : mIdx(0)
+    , mMapped(NULL)
+    , mMappedSize(0)
+    , mMappedPos(0)
     , mRecordFlags(0)
     , mBuffer(50*1024)
     , mGlobalReaderList(NULL)
@@ -44,12 +49,16 @@ void ESMReader::restoreContext(const ESM_Context &rc)
     mCtx = rc;
 
     // Make sure we seek to the right place
-    mEsm->seek(mCtx.filePos);
+    seek(mCtx.filePos);
 }
 
 void ESMReader::close()
 {
     mEsm.setNull();
+    mMappedFile.reset();
+    mMapped = NULL;
+    mMappedSize = 0;
+    mMappedPos = 0;
     mCtx.filename.clear();
     mCtx.leftFile = 0;
     mCtx.leftRec = 0;
@@ -79,13 +88,72 @@ void ESMReader::open(Ogre::DataStreamPtr _esm, const std::string &name)
     mHeader.load (*this);
 }
 
+void ESMReader::openRaw(MemoryMappedFilePtr _esm, const std::string &name)
+{
+    close();
+    mMappedFile = _esm;
+    mMapped = mMappedFile->data();
+    mMappedSize = mMappedFile->size();
+    mMappedPos = 0;
+    mCtx.filename = name;
+    mCtx.leftFile = mMappedSize;
+}
+
+void ESMReader::open(MemoryMappedFilePtr _esm, const std::string &name)
+{
+    openRaw(_esm, name);
+
+    if (getRecName() != "TES3")
+        fail("Not a valid Morrowind file");
+
+    getRecHeader();
+
+    mHeader.load (*this);
+}
+
 void ESMReader::open(const std::string &file)
 {
+    if (sUseMemoryMapping)
+    {
+        MemoryMappedFilePtr mapped;
+        try
+        {
+            mapped = openMemoryMappedFile (file.c_str ());
+        }
+        catch (std::exception&)
+        {
+            // Fall back to the stream below
+        }
+        if (mapped)
+        {
+            open (mapped, file);
+            return;
+        }
+    }
+
     open (openConstrainedFileDataStream (file.c_str ()), file);
 }
 
 void ESMReader::openRaw(const std::string &file)
 {
+    if (sUseMemoryMapping)
+    {
+        MemoryMappedFilePtr mapped;
+        try
+        {
+            mapped = openMemoryMappedFile (file.c_str ());
+        }
+        catch (std::exception&)
+        {
+            // Fall back to the stream below
+        }
+        if (mapped)
+        {
+            openRaw (mapped, file);
+            return;
+        }
+    }
+
     openRaw (openConstrainedFileDataStream (file.c_str ()), file);
 }
 
@@ -292,7 +360,19 @@ void ESMReader::getRecHeader(uint32_t &flags)
  *
  *************************************************************************/
 
-void ESMReader::getExact(void*x, int size)
+void ESMReader::seek(size_t pos)
+{
+    if (mMapped)
+    {
+        // Same semantics as the constrained stream: out of range seeks are ignored
+        if (pos < mMappedSize)
+            mMappedPos = pos;
+    }
+    else
+        mEsm->seek(pos);
+}
+
+void ESMReader::getExactFromStream(void*x, int size)
 {
     try
     {
@@ -306,8 +386,17 @@ void ESMReader::getExact(void*x, int size)
     }
 }
 
-std::string ESMReader::getString(int size)
+const char *ESMReader::getSpan(int size)
 {
+    if (mMapped)
+    {
+        if (static_cast<size_t>(size) > mMappedSize - mMappedPos)
+            fail("Read error");
+        const char *ptr = mMapped + mMappedPos;
+        mMappedPos += size;
+        return ptr;
+    }
+
     size_t s = size;
     if (mBuffer.size() <= s)
         // Add some extra padding to reduce the chance of having to resize
@@ -319,9 +408,29 @@ std::string ESMReader::getString(int size)
 
     // read ESM data
     char *ptr = &mBuffer[0];
-    getExact(ptr, size);
+    getExactFromStream(ptr, size);
+    return ptr;
+}
+
+std::string ESMReader::getString(int size)
+{
+    // In memory mapped mode the string is converted straight from the mapping
+    const char *ptr = getSpan(size);
+
+    int len = strnlen(ptr, size);
+
+    // The encoder expects a zero terminated string. Strings that fill their
+    // whole subrecord have no terminator in the mapping, so copy those.
+    if (mMapped && mEncoder && len == size)
+    {
+        if (mBuffer.size() <= static_cast<size_t>(size))
+            mBuffer.resize(3*size);
+        memcpy(&mBuffer[0], ptr, size);
+        mBuffer[size] = 0;
+        ptr = &mBuffer[0];
+    }
 
-    size = strnlen(ptr, size);
+    size = len;
 
     // Convert to UTF8 and return
     if (mEncoder)
@@ -340,8 +449,8 @@ void ESMReader::fail(const std::string &msg)
     ss << "\n  File: " << mCtx.filename;
     ss << "\n  Record: " << mCtx.recName.toString();
     ss << "\n  Subrecord: " << mCtx.subName.toString();
-    if (!mEsm.isNull())
-        ss << "\n  Offset: 0x" << hex << mEsm->tell();
+    if (mMapped || !mEsm.isNull())
+        ss << "\n  Offset: 0x" << hex << tell();
     throw std::runtime_error(ss.str());
 }
 
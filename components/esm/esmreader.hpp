@@ -11,6 +11,8 @@
 
 #include <components/misc/stringops.hpp>
 
+#include <components/files/memorymappedfile.hpp>
+
 #include <components/to_utf8/to_utf8.hpp>
 
 #include "esmcommon.hpp"
@@ -73,10 +75,23 @@ public:
 
   void openRaw(const std::string &file);
 
+  /// Raw opening from a memory mapped file. Subrecord data is read straight from the mapping.
+  void openRaw(MemoryMappedFilePtr _esm, const std::string &name);
+
+  /// Load ES file from a memory mapped file, parses the header.
+  void open(MemoryMappedFilePtr _esm, const std::string &name);
+
+  /// Enable or disable memory mapping for files opened by name (enabled by default). If a file
+  /// can not be mapped, the reader falls back to stream-based reading.
+  static void setUseMemoryMapping(bool enabled) { sUseMemoryMapping = enabled; }
+
+  /// Is the currently open file read from a memory mapping?
+  bool isMemoryMapped() const { return mMapped != NULL; }
+
   /// Get the file size. Make sure that the file has been opened!
-  size_t getFileSize() { return mEsm->size(); }
+  size_t getFileSize() { return mMapped ? mMappedSize : mEsm->size(); }
   /// Get the current position in the file. Make sure that the file has been opened!
-  size_t getFileOffset() { return mEsm->tell(); }
+  size_t getFileOffset() { return tell(); }
 
   // This is a quick hack for multiple esm/esp files. Each plugin introduces its own
   //  terrain palette, but ESMReader does not pass a reference to the correct plugin
@@ -244,7 +259,24 @@ public:
   template <typename X>
   void getT(X &x) { getExact(&x, sizeof(X)); }
 
-  void getExact(void*x, int size);
+  void getExact(void*x, int size)
+  {
+      if (mMapped)
+      {
+          if (static_cast<size_t>(size) > mMappedSize - mMappedPos)
+              fail("Read error");
+          memcpy(x, mMapped + mMappedPos, size);
+          mMappedPos += size;
+      }
+      else
+          getExactFromStream(x, size);
+  }
+
+  /// Read the next 'size' bytes without copying them, if possible. In memory mapped mode the
+  /// returned pointer points into the mapping and stays valid as long as the file is open;
+  /// otherwise the data is read into an internal buffer that is overwritten by the next call.
+  const char *getSpan(int size);
+
   void getName(NAME &name) { getT(name); }
   void getUint(uint32_t &u) { getT(u); }
 
@@ -252,8 +284,8 @@ public:
   // them from native encoding to UTF8 in the process.
   std::string getString(int size);
 
-  void skip(int bytes) { mEsm->seek(mEsm->tell()+bytes); }
-  uint64_t getOffset() { return mEsm->tell(); }
+  void skip(int bytes) { seek(tell()+bytes); }
+  uint64_t getOffset() { return tell(); }
 
   /// Used for error handling
   void fail(const std::string &msg);
@@ -265,8 +297,21 @@ public:
   unsigned int getRecordFlags() { return mRecordFlags; }
 
 private:
+  void getExactFromStream(void*x, int size);
+
+  size_t tell() const { return mMapped ? mMappedPos : mEsm->tell(); }
+  void seek(size_t pos);
+
   Ogre::DataStreamPtr mEsm;
 
+  // Memory mapped mode. mMapped is NULL when reading through mEsm.
+  MemoryMappedFilePtr mMappedFile;
+  const char *mMapped;
+  size_t mMappedSize;
+  size_t mMappedPos;
+
+  static bool sUseMemoryMapping;
+
   ESM_Context mCtx;
 
   unsigned int mRecordFlags;
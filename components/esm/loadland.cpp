@@ -138,6 +138,11 @@ void Land::save(ESMWriter &esm) const
 }
 
 void Land::loadData(int flags)
+{
+    loadData(flags, *mEsm);
+}
+
+void Land::loadData(int flags, ESMReader& esm)
 {
     // Try to load only available data
     flags = flags & mDataTypes;
@@ -150,15 +155,15 @@ void Land::loadData(int flags)
         mLandData = new LandData;
         mLandData->mDataTypes = mDataTypes;
     }
-    mEsm->restoreContext(mContext);
+    esm.restoreContext(mContext);
 
-    if (mEsm->isNextSub("VNML")) {
-        condLoad(flags, DATA_VNML, mLandData->mNormals, sizeof(mLandData->mNormals));
+    if (esm.isNextSub("VNML")) {
+        condLoad(esm, flags, DATA_VNML, mLandData->mNormals, sizeof(mLandData->mNormals));
     }
 
-    if (mEsm->isNextSub("VHGT")) {
-        static VHGT vhgt;
-        if (condLoad(flags, DATA_VHGT, &vhgt, sizeof(vhgt))) {
+    if (esm.isNextSub("VHGT")) {
+        VHGT vhgt;
+        if (condLoad(esm, flags, DATA_VHGT, &vhgt, sizeof(vhgt))) {
             float rowOffset = vhgt.mHeightOffset;
             for (int y = 0; y < LAND_SIZE; y++) {
                 rowOffset += vhgt.mHeightData[y * LAND_SIZE];
@@ -176,14 +181,14 @@ void Land::loadData(int flags)
         }
     }
 
-    if (mEsm->isNextSub("WNAM")) {
-        condLoad(flags, DATA_WNAM, mLandData->mWnam, 81);
+    if (esm.isNextSub("WNAM")) {
+        condLoad(esm, flags, DATA_WNAM, mLandData->mWnam, 81);
     }
-    if (mEsm->isNextSub("VCLR"))
-        condLoad(flags, DATA_VCLR, mLandData->mColours, 3 * LAND_NUM_VERTS);
-    if (mEsm->isNextSub("VTEX")) {
-        static uint16_t vtex[LAND_NUM_TEXTURES];
-        if (condLoad(flags, DATA_VTEX, vtex, sizeof(vtex))) {
+    if (esm.isNextSub("VCLR"))
+        condLoad(esm, flags, DATA_VCLR, mLandData->mColours, 3 * LAND_NUM_VERTS);
+    if (esm.isNextSub("VTEX")) {
+        uint16_t vtex[LAND_NUM_TEXTURES];
+        if (condLoad(esm, flags, DATA_VTEX, vtex, sizeof(vtex))) {
             LandData::transposeTextureData(vtex, mLandData->mTextures);
         }
     }
@@ -199,14 +204,14 @@ void Land::unloadData()
     }
 }
 
-bool Land::condLoad(int flags, int dataFlag, void *ptr, unsigned int size)
+bool Land::condLoad(ESMReader& esm, int flags, int dataFlag, void *ptr, unsigned int size)
 {
     if ((mDataLoaded & dataFlag) == 0 && (flags & dataFlag) != 0) {
-        mEsm->getHExact(ptr, size);
+        esm.getHExact(ptr, size);
         mDataLoaded |= dataFlag;
         return true;
     }
-    mEsm->skipHSubSize(size);
+    esm.skipHSubSize(size);
     return false;
 }
 
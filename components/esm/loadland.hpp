@@ -105,6 +105,12 @@ struct Land
      */
     void loadData(int flags);
 
+    /**
+     * Loads data with \a esm instead of the reader the record was read with, e.g. on another
+     * thread. \a esm is repositioned to this record.
+     */
+    void loadData(int flags, ESMReader& esm);
+
     /**
      * Frees memory allocated for land data
      */
@@ -121,7 +127,7 @@ struct Land
         /// Loads data and marks it as loaded
         /// \return true if data is actually loaded from file, false otherwise
         /// including the case when data is already loaded
-        bool condLoad(int flags, int dataFlag, void *ptr, unsigned int size);
+        bool condLoad(ESMReader& esm, int flags, int dataFlag, void *ptr, unsigned int size);
 };
 
 }
@@ -1,21 +1,98 @@
 #include "storage.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
 #include <OgreVector2.h>
 #include <OgreTextureManager.h>
 #include <OgreStringConverter.h>
-#include <OgreRenderSystem.h>
+#include <OgreHardwareVertexBuffer.h>
 #include <OgreResourceGroupManager.h>
 #include <OgreResourceBackgroundQueue.h>
-#include <OgreRoot.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 
 #include <components/terrain/quadtreenode.hpp>
 #include <components/misc/resourcehelpers.hpp>
+#include <components/esm/cachefile.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/esm/defs.hpp>
+
+namespace
+{
+    /// Increase when the layout of the cache files or the way blendmaps are created changes
+    const int sCacheFormat = 1;
+
+    const uint32_t sBlendmapsRecord = ESM::FourCC<'B','L','N','D'>::value;
+    const uint32_t sCompositeMapRecord = ESM::FourCC<'C','M','A','P'>::value;
+
+    boost::filesystem::path getCompositeMapFile (const boost::filesystem::path& dir, Ogre::uint64 hash)
+    {
+        std::ostringstream name;
+        name << "composite_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".cache";
+        return dir / name.str();
+    }
+}
 
 namespace ESMTerrain
 {
 
+    Storage::Storage()
+        : mDecodedCellVertices(0)
+        , mCacheKey(0)
+        , mBlendmapCacheRead(false)
+        , mBlendmapCacheChanged(false)
+    {
+        const Ogre::VertexElementType colourType = Ogre::VertexElement::getBestColourVertexElementType();
+
+        for (int i=0; i<256; ++i)
+        {
+            // same as the record's colours, which are signed
+            float value = static_cast<char>(i) / 255.f;
+            mRedChannel[i] = Ogre::VertexElement::convertColourValue(Ogre::ColourValue(value, 0, 0, 0), colourType);
+            mGreenChannel[i] = Ogre::VertexElement::convertColourValue(Ogre::ColourValue(0, value, 0, 0), colourType);
+            mBlueChannel[i] = Ogre::VertexElement::convertColourValue(Ogre::ColourValue(0, 0, value, 0), colourType);
+        }
+
+        mAlphaChannel = Ogre::VertexElement::convertColourValue(Ogre::ColourValue(0, 0, 0, 1), colourType);
+        mWhite = Ogre::VertexElement::convertColourValue(Ogre::ColourValue::White, colourType);
+    }
+
+    Storage::~Storage()
+    {
+        boost::mutex::scoped_lock lock(mBlendmapCacheMutex);
+
+        if (mBlendmapCacheChanged)
+            writeBlendmapCache();
+    }
+
+    void Storage::setCache(const boost::filesystem::path& dir, uint64_t key, uint64_t maxCompositeMapSize)
+    {
+        boost::mutex::scoped_lock lock(mBlendmapCacheMutex);
+
+        mCacheDir = dir;
+        mCacheKey = key;
+        mCachedBlendmaps.clear();
+        mBlendmapCacheRead = false;
+        mBlendmapCacheChanged = false;
+
+        // Every change of the land or its textures leaves new composite maps behind
+        try
+        {
+            ESM::pruneCacheFiles(mCacheDir, "composite_", maxCompositeMapSize);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to prune terrain composite map cache " << mCacheDir.string() << ": " << e.what() << std::endl;
+        }
+    }
+
     bool Storage::getMinMaxHeights(float size, const Ogre::Vector2 &center, float &min, float &max)
     {
         assert (size <= 1 && "Storage::getMinMaxHeights, chunk size should be <= 1 cell");
@@ -50,29 +127,32 @@ namespace ESMTerrain
         return true;
     }
 
-    void Storage::fixNormal (Ogre::Vector3& normal, int cellX, int cellY, int col, int row)
+    void Storage::fixNormal (Ogre::Vector3& normal, const Neighbours& lands, int col, int row)
     {
+        int x = 1;
+        int y = 1;
         while (col >= ESM::Land::LAND_SIZE-1)
         {
-            ++cellY;
+            ++y;
             col -= ESM::Land::LAND_SIZE-1;
         }
         while (row >= ESM::Land::LAND_SIZE-1)
         {
-            ++cellX;
+            ++x;
             row -= ESM::Land::LAND_SIZE-1;
         }
         while (col < 0)
         {
-            --cellY;
+            --y;
             col += ESM::Land::LAND_SIZE-1;
         }
         while (row < 0)
         {
-            --cellX;
+            --x;
             row += ESM::Land::LAND_SIZE-1;
         }
-        ESM::Land* land = getLand(cellX, cellY);
+        assert(x >= 0 && x <= 2 && y >= 0 && y <= 2);
+        const ESM::Land* land = lands[x][y];
         if (land && land->mDataTypes&ESM::Land::DATA_VNML)
         {
             normal.x = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3];
@@ -84,43 +164,206 @@ namespace ESMTerrain
             normal = Ogre::Vector3(0,0,1);
     }
 
-    void Storage::averageNormal(Ogre::Vector3 &normal, int cellX, int cellY, int col, int row)
+    void Storage::averageNormal(Ogre::Vector3 &normal, const Neighbours& lands, int col, int row)
     {
         Ogre::Vector3 n1,n2,n3,n4;
-        fixNormal(n1, cellX, cellY, col+1, row);
-        fixNormal(n2, cellX, cellY, col-1, row);
-        fixNormal(n3, cellX, cellY, col, row+1);
-        fixNormal(n4, cellX, cellY, col, row-1);
+        fixNormal(n1, lands, col+1, row);
+        fixNormal(n2, lands, col-1, row);
+        fixNormal(n3, lands, col, row+1);
+        fixNormal(n4, lands, col, row-1);
         normal = (n1+n2+n3+n4);
         normal.normalise();
     }
 
-    void Storage::fixColour (Ogre::ColourValue& color, int cellX, int cellY, int col, int row)
+    void Storage::fixColour (Ogre::uint32& colour, const Neighbours& lands, int col, int row)
     {
+        int x = 1;
+        int y = 1;
         if (col == ESM::Land::LAND_SIZE-1)
         {
-            ++cellY;
+            ++y;
             col = 0;
         }
         if (row == ESM::Land::LAND_SIZE-1)
         {
-            ++cellX;
+            ++x;
             row = 0;
         }
-        ESM::Land* land = getLand(cellX, cellY);
+        const ESM::Land* land = lands[x][y];
         if (land && land->mDataTypes&ESM::Land::DATA_VCLR)
+            colour = convertColour(*land->mLandData, col*ESM::Land::LAND_SIZE+row);
+        else
+            colour = mWhite;
+    }
+
+    Storage::DecodedCellPtr Storage::getDecodedCell (int cellX, int cellY, int lodLevel)
+    {
+        DecodedCellKey key (std::make_pair(cellX, cellY), lodLevel);
+
+        {
+            boost::mutex::scoped_lock lock (mDecodedCellMutex);
+
+            std::map<DecodedCellKey, DecodedCells::iterator>::iterator iter = mDecodedCellIndex.find (key);
+            if (iter != mDecodedCellIndex.end())
+            {
+                mDecodedCells.splice (mDecodedCells.begin(), mDecodedCells, iter->second);
+                return iter->second->second;
+            }
+        }
+
+        // Decode without holding the lock, so that other threads can use the cache meanwhile.
+        boost::shared_ptr<DecodedCell> cell (new DecodedCell);
+        decodeCell (cellX, cellY, lodLevel, *cell);
+
+        boost::mutex::scoped_lock lock (mDecodedCellMutex);
+
+        if (mDecodedCellIndex.find (key) != mDecodedCellIndex.end())
+            return cell; // decoded by another thread meanwhile
+
+        mDecodedCells.push_front (std::make_pair (key, DecodedCellPtr (cell)));
+        mDecodedCellIndex[key] = mDecodedCells.begin();
+        mDecodedCellVertices += cell->mSize * cell->mSize;
+
+        while (mDecodedCellVertices > sDecodedCellCacheSize && mDecodedCells.size() > 1)
         {
-            color.r = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3] / 255.f;
-            color.g = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+1] / 255.f;
-            color.b = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+2] / 255.f;
+            mDecodedCellVertices -= mDecodedCells.back().second->mSize * mDecodedCells.back().second->mSize;
+            mDecodedCellIndex.erase (mDecodedCells.back().first);
+            mDecodedCells.pop_back();
+        }
+
+        return cell;
+    }
+
+    void Storage::decodeCell (int cellX, int cellY, int lodLevel, DecodedCell& cell)
+    {
+        // LOD level n means every 2^n-th vertex is kept
+        const int increment = 1 << lodLevel;
+        const int last = ESM::Land::LAND_SIZE - 1;
+        assert(increment <= last);
+
+        const int size = last / increment + 1;
+        const int numVerts = size*size;
+
+        cell.mSize = size;
+        // not initialised, all of it is written below
+        cell.mHeights.reset(new float[numVerts]);
+        cell.mNormals.reset(new float[numVerts*3]);
+        cell.mColours.reset(new Ogre::uint32[numVerts]);
+
+        // The fixes at the borders need the neighbouring cells
+        Neighbours lands;
+        for (int x=0; x<3; ++x)
+            for (int y=0; y<3; ++y)
+                lands[x][y] = getLand(cellX + x - 1, cellY + y - 1);
+
+        const ESM::Land* land = lands[1][1];
+        if (land && !(land->mDataTypes&ESM::Land::DATA_VHGT))
+            land = NULL;
+
+        float* heights = cell.mHeights.get();
+        float* normals = cell.mNormals.get();
+        Ogre::uint32* colours = cell.mColours.get();
+
+        // The whole cell, as stored in the record, in flat loops without branches.
+        // Source index is col*LAND_SIZE + row, destination index is row*size + col.
+        if (land)
+        {
+            for (int i=0; i<size; ++i)
+                for (int j=0; j<size; ++j)
+                    heights[i*size + j] = land->mLandData->mHeights[(j*ESM::Land::LAND_SIZE + i)*increment];
         }
         else
+            std::fill(heights, heights + numVerts, -2048.f);
+
+        if (land && land->mDataTypes&ESM::Land::DATA_VNML)
+        {
+            const ESM::Land::VNML* source = land->mLandData->mNormals;
+
+            for (int i=0; i<size; ++i)
+                for (int j=0; j<size; ++j)
+                    for (int k=0; k<3; ++k)
+                        normals[(i*size + j)*3 + k] = source[(j*ESM::Land::LAND_SIZE + i)*increment*3 + k];
+
+            // Same as Ogre::Vector3::normalise
+            for (int i=0; i<numVerts; ++i)
+            {
+                float length = std::sqrt(normals[i*3]*normals[i*3] + normals[i*3+1]*normals[i*3+1]
+                    + normals[i*3+2]*normals[i*3+2]);
+                float invLength = length > 0 ? 1.0f / length : 1.0f;
+                normals[i*3] *= invLength;
+                normals[i*3+1] *= invLength;
+                normals[i*3+2] *= invLength;
+            }
+        }
+        else
+        {
+            for (int i=0; i<numVerts; ++i)
+            {
+                normals[i*3] = 0;
+                normals[i*3+1] = 0;
+                normals[i*3+2] = 1;
+            }
+        }
+
+        if (land && land->mDataTypes&ESM::Land::DATA_VCLR)
         {
-            color.r = 1;
-            color.g = 1;
-            color.b = 1;
+            for (int i=0; i<size; ++i)
+                for (int j=0; j<size; ++j)
+                    colours[i*size + j] = convertColour(*land->mLandData, (j*ESM::Land::LAND_SIZE + i)*increment);
         }
+        else
+            std::fill(colours, colours + numVerts, mWhite);
 
+        // Fix-ups on the last row and column, which need the neighbouring cells
+        for (int i=0; i<size; ++i)
+        {
+            for (int border=0; border<2; ++border)
+            {
+                int row = border ? last : i*increment;
+                int col = border ? i*increment : last;
+                int dst = (row/increment)*size + col/increment;
+
+                // Normals apparently don't connect seamlessly between cells
+                Ogre::Vector3 normal;
+                fixNormal(normal, lands, col, row);
+
+                normals[dst*3] = normal.x;
+                normals[dst*3+1] = normal.y;
+                normals[dst*3+2] = normal.z;
+
+                // Unlike normals, colors mostly connect seamlessly between cells, but not always...
+                fixColour(colours[dst], lands, col, row);
+            }
+        }
+
+        // some corner normals appear to be complete garbage (z < 0)
+        for (int row=0; row<=last; row += last)
+        {
+            for (int col=0; col<=last; col += last)
+            {
+                int dst = (row/increment)*size + col/increment;
+
+                Ogre::Vector3 normal;
+                averageNormal(normal, lands, col, row);
+
+                normals[dst*3] = normal.x;
+                normals[dst*3+1] = normal.y;
+                normals[dst*3+2] = normal.z;
+            }
+        }
+
+#ifndef NDEBUG
+        for (int i=0; i<numVerts; ++i)
+            assert(normals[i*3+2] > 0);
+#endif
+    }
+
+    void Storage::clearCache()
+    {
+        boost::mutex::scoped_lock lock (mDecodedCellMutex);
+        mDecodedCells.clear();
+        mDecodedCellIndex.clear();
+        mDecodedCellVertices = 0;
     }
 
     void Storage::fillVertexBuffers (int lodLevel, float size, const Ogre::Vector2& center, Terrain::Alignment align,
@@ -144,97 +387,56 @@ namespace ESMTerrain
         positions.resize(numVerts*numVerts*3);
         normals.resize(numVerts*numVerts*3);
 
-        Ogre::Vector3 normal;
-        Ogre::ColourValue color;
+        // vertices on one side of a cell
+        size_t cellSize = (ESM::Land::LAND_SIZE - 1) / increment + 1;
 
-        float vertY = 0;
-        float vertX = 0;
+        // x and y of the vertices in local space, the same on both axes
+        std::vector<float> coordinates(numVerts);
+        for (size_t i=0; i<numVerts; ++i)
+            coordinates[i] = (static_cast<float>(i) / float(numVerts - 1) - 0.5f) * size * 8192;
 
-        float vertY_ = 0; // of current cell corner
+        size_t vertY_ = 0; // of current cell corner
         for (int cellY = startY; cellY < startY + std::ceil(size); ++cellY)
         {
-            float vertX_ = 0; // of current cell corner
+            // Skip the first row / column unless we're at a chunk edge,
+            // since this row / column is already contained in a previous cell
+            size_t colStart = vertY_ != 0 ? 1 : 0;
+            size_t numCols = cellSize - colStart;
+
+            size_t vertX_ = 0; // of current cell corner
             for (int cellX = startX; cellX < startX + std::ceil(size); ++cellX)
             {
-                ESM::Land* land = getLand(cellX, cellY);
-                if (land && !(land->mDataTypes&ESM::Land::DATA_VHGT))
-                    land = NULL;
-
-                int rowStart = 0;
-                int colStart = 0;
-                // Skip the first row / column unless we're at a chunk edge,
-                // since this row / column is already contained in a previous cell
-                if (colStart == 0 && vertY_ != 0)
-                    colStart += increment;
-                if (rowStart == 0 && vertX_ != 0)
-                    rowStart += increment;
-
-                vertY = vertY_;
-                for (int col=colStart; col<ESM::Land::LAND_SIZE; col += increment)
+                DecodedCellPtr cell = getDecodedCell(cellX, cellY, lodLevel);
+                assert(static_cast<size_t>(cell->mSize) == cellSize);
+
+                size_t rowStart = vertX_ != 0 ? 1 : 0;
+
+                for (size_t row=rowStart; row<cellSize; ++row)
                 {
-                    vertX = vertX_;
-                    for (int row=rowStart; row<ESM::Land::LAND_SIZE; row += increment)
+                    size_t vertX = vertX_ + row - rowStart;
+                    size_t src = row*cellSize + colStart;
+                    size_t dst = vertX*numVerts + vertY_;
+
+                    const float x = coordinates[vertX];
+                    const float* y = &coordinates[vertY_];
+                    const float* heights = &cell->mHeights[src];
+                    float* outPositions = &positions[dst*3];
+
+                    // Consecutive vertices of the buffers, no branches
+                    for (size_t j=0; j<numCols; ++j)
                     {
-                        positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3)] = ((vertX / float(numVerts - 1) - 0.5f) * size * 8192);
-                        positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 1)] = ((vertY / float(numVerts - 1) - 0.5f) * size * 8192);
-                        if (land)
-                            positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = land->mLandData->mHeights[col*ESM::Land::LAND_SIZE + row];
-                        else
-                            positions[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = -2048;
-
-                        if (land && land->mDataTypes&ESM::Land::DATA_VNML)
-                        {
-                            normal.x = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3];
-                            normal.y = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+1];
-                            normal.z = land->mLandData->mNormals[col*ESM::Land::LAND_SIZE*3+row*3+2];
-                            normal.normalise();
-                        }
-                        else
-                            normal = Ogre::Vector3(0,0,1);
-
-                        // Normals apparently don't connect seamlessly between cells
-                        if (col == ESM::Land::LAND_SIZE-1 || row == ESM::Land::LAND_SIZE-1)
-                            fixNormal(normal, cellX, cellY, col, row);
-
-                        // some corner normals appear to be complete garbage (z < 0)
-                        if ((row == 0 || row == ESM::Land::LAND_SIZE-1) && (col == 0 || col == ESM::Land::LAND_SIZE-1))
-                            averageNormal(normal, cellX, cellY, col, row);
-
-                        assert(normal.z > 0);
-
-                        normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3)] = normal.x;
-                        normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 1)] = normal.y;
-                        normals[static_cast<unsigned int>(vertX*numVerts * 3 + vertY * 3 + 2)] = normal.z;
-
-                        if (land && land->mDataTypes&ESM::Land::DATA_VCLR)
-                        {
-                            color.r = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3] / 255.f;
-                            color.g = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+1] / 255.f;
-                            color.b = land->mLandData->mColours[col*ESM::Land::LAND_SIZE*3+row*3+2] / 255.f;
-                        }
-                        else
-                        {
-                            color.r = 1;
-                            color.g = 1;
-                            color.b = 1;
-                        }
-
-                        // Unlike normals, colors mostly connect seamlessly between cells, but not always...
-                        if (col == ESM::Land::LAND_SIZE-1 || row == ESM::Land::LAND_SIZE-1)
-                            fixColour(color, cellX, cellY, col, row);
-
-                        color.a = 1;
-                        Ogre::uint32 rsColor;
-                        Ogre::Root::getSingleton().getRenderSystem()->convertColourValue(color, &rsColor);
-                        memcpy(&colours[static_cast<unsigned int>(vertX*numVerts * 4 + vertY * 4)], &rsColor, sizeof(Ogre::uint32));
-
-                        ++vertX;
+                        outPositions[j*3] = x;
+                        outPositions[j*3+1] = y[j];
+                        outPositions[j*3+2] = heights[j];
                     }
-                    ++vertY;
+
+                    memcpy(&normals[dst*3], &cell->mNormals[src*3], numCols*3*sizeof(float));
+                    memcpy(&colours[dst*4], &cell->mColours[src], numCols*sizeof(Ogre::uint32));
                 }
-                vertX_ = vertX;
+
+                vertX_ += cellSize - rowStart;
             }
-            vertY_ = vertY;
+            vertY_ += numCols;
 
             assert(vertX_ == numVerts); // Ensure we covered whole area
         }
@@ -295,6 +497,12 @@ namespace ESMTerrain
             out.back().mTarget = *it;
             getBlendmapsImpl(static_cast<float>((*it)->getSize()), (*it)->getCenter(), pack, out.back().mBlendmaps, out.back().mLayers);
         }
+
+        // All blendmaps of the world are requested at once, so this is the time to save them
+        boost::mutex::scoped_lock lock(mBlendmapCacheMutex);
+
+        if (mBlendmapCacheChanged)
+            writeBlendmapCache();
     }
 
     void Storage::getBlendmaps(float chunkSize, const Ogre::Vector2 &chunkCenter,
@@ -314,6 +522,9 @@ namespace ESMTerrain
         int cellX = static_cast<int>(origin.x);
         int cellY = static_cast<int>(origin.y);
 
+        if (getCachedBlendmaps(cellX, cellY, pack, blendmaps, layerList))
+            return;
+
         // Save the used texture indices so we know the total number of textures
         // and number of required blend maps
         std::set<UniqueTextureId> textureIndices;
@@ -334,11 +545,13 @@ namespace ESMTerrain
         // retrieved as sorted. This is important to keep the splatting order
         // consistent across cells.
         std::map<UniqueTextureId, int> textureIndicesMap;
+        std::vector<std::string> textures;
         for (std::set<UniqueTextureId>::iterator it = textureIndices.begin(); it != textureIndices.end(); ++it)
         {
             int size = textureIndicesMap.size();
             textureIndicesMap[*it] = size;
-            layerList.push_back(getLayerInfo(getTextureName(*it)));
+            textures.push_back(getTextureName(*it));
+            layerList.push_back(getLayerInfo(textures.back()));
         }
 
         int numTextures = textureIndices.size();
@@ -375,6 +588,242 @@ namespace ESMTerrain
             }
             blendmaps.push_back(Ogre::PixelBox(blendmapSize, blendmapSize, 1, format, pData));
         }
+
+        addCachedBlendmaps(cellX, cellY, pack, textures,
+            std::vector<Ogre::PixelBox>(blendmaps.end()-numBlendmaps, blendmaps.end()));
+    }
+
+    bool Storage::getCachedBlendmaps(int cellX, int cellY, bool pack,
+        std::vector<Ogre::PixelBox>& blendmaps, std::vector<Terrain::LayerInfo>& layerList)
+    {
+        boost::mutex::scoped_lock lock(mBlendmapCacheMutex);
+
+        if (mCacheDir.empty())
+            return false;
+
+        if (!mBlendmapCacheRead)
+            readBlendmapCache();
+
+        std::map<CachedBlendmapsKey, CachedBlendmaps>::const_iterator found =
+            mCachedBlendmaps.find(std::make_pair(std::make_pair(cellX, cellY), pack));
+
+        if (found == mCachedBlendmaps.end())
+            return false;
+
+        // Looked up again, since which normal and specular maps exist is not part of the cache
+        for (std::vector<std::string>::const_iterator it = found->second.mTextures.begin();
+            it != found->second.mTextures.end(); ++it)
+            layerList.push_back(getLayerInfo(*it));
+
+        const int blendmapSize = ESM::Land::LAND_TEXTURE_SIZE+1;
+        Ogre::PixelFormat format = pack ? Ogre::PF_A8B8G8R8 : Ogre::PF_A8;
+
+        for (std::vector<std::vector<Ogre::uint8> >::const_iterator it = found->second.mBlendmaps.begin();
+            it != found->second.mBlendmaps.end(); ++it)
+        {
+            Ogre::uchar* pData = OGRE_ALLOC_T(Ogre::uchar, it->size(), Ogre::MEMCATEGORY_GENERAL);
+            memcpy(pData, &(*it)[0], it->size());
+            blendmaps.push_back(Ogre::PixelBox(blendmapSize, blendmapSize, 1, format, pData));
+        }
+
+        return true;
+    }
+
+    void Storage::addCachedBlendmaps(int cellX, int cellY, bool pack, const std::vector<std::string>& textures,
+        const std::vector<Ogre::PixelBox>& blendmaps)
+    {
+        boost::mutex::scoped_lock lock(mBlendmapCacheMutex);
+
+        if (mCacheDir.empty())
+            return;
+
+        CachedBlendmaps& cached = mCachedBlendmaps[std::make_pair(std::make_pair(cellX, cellY), pack)];
+        cached.mTextures = textures;
+        cached.mBlendmaps.clear();
+
+        for (std::vector<Ogre::PixelBox>::const_iterator it = blendmaps.begin(); it != blendmaps.end(); ++it)
+        {
+            const Ogre::uint8* data = static_cast<const Ogre::uint8*>(it->data);
+            cached.mBlendmaps.push_back(std::vector<Ogre::uint8>(data,
+                data + it->getWidth()*it->getHeight()*Ogre::PixelUtil::getNumElemBytes(it->format)));
+        }
+
+        mBlendmapCacheChanged = true;
+    }
+
+    void Storage::readBlendmapCache()
+    {
+        mBlendmapCacheRead = true;
+
+        boost::filesystem::path file = mCacheDir / "blendmaps.cache";
+
+        std::map<CachedBlendmapsKey, CachedBlendmaps> cachedBlendmaps;
+
+        try
+        {
+            ESM::ESMReader reader;
+
+            if (!ESM::openCacheFile(reader, file, sCacheFormat, mCacheKey))
+                return;
+
+            const size_t blendmapSize = ESM::Land::LAND_TEXTURE_SIZE+1;
+
+            while (reader.hasMoreRecs())
+            {
+                if (reader.getRecName().val!=sBlendmapsRecord)
+                    throw std::runtime_error("unknown record");
+
+                reader.getRecHeader();
+
+                int cellX = 0;
+                int cellY = 0;
+                char pack = 0;
+                reader.getHNT(cellX, "XPOS");
+                reader.getHNT(cellY, "YPOS");
+                reader.getHNT(pack, "PACK");
+
+                CachedBlendmaps& cached = cachedBlendmaps[std::make_pair(std::make_pair(cellX, cellY), pack!=0)];
+
+                while (reader.isNextSub("TEXN"))
+                    cached.mTextures.push_back(reader.getHString());
+
+                const size_t size = blendmapSize*blendmapSize*(pack ? 4 : 1);
+
+                while (reader.isNextSub("DATA"))
+                {
+                    reader.getSubHeader();
+
+                    if (reader.getSubSize()!=size)
+                        throw std::runtime_error("blendmap size mismatch");
+
+                    cached.mBlendmaps.push_back(std::vector<Ogre::uint8>(size));
+                    reader.getExact(&cached.mBlendmaps.back()[0], static_cast<int>(size));
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Ignoring terrain blendmap cache " << file.string() << ": " << e.what() << std::endl;
+            return;
+        }
+
+        mCachedBlendmaps.swap(cachedBlendmaps);
+    }
+
+    void Storage::writeBlendmapCache()
+    {
+        boost::filesystem::path file = mCacheDir / "blendmaps.cache";
+
+        try
+        {
+            // ESMWriter seeks back for every record size, which is a lot faster in memory
+            std::stringstream buffer;
+
+            ESM::ESMWriter writer;
+            ESM::startCacheFile(writer, buffer, sCacheFormat, mCacheKey);
+
+            for (std::map<CachedBlendmapsKey, CachedBlendmaps>::const_iterator it = mCachedBlendmaps.begin();
+                it != mCachedBlendmaps.end(); ++it)
+            {
+                writer.startRecord(sBlendmapsRecord);
+                writer.writeHNT("XPOS", it->first.first.first);
+                writer.writeHNT("YPOS", it->first.first.second);
+                writer.writeHNT("PACK", static_cast<char>(it->first.second));
+
+                for (std::vector<std::string>::const_iterator texture = it->second.mTextures.begin();
+                    texture != it->second.mTextures.end(); ++texture)
+                    writer.writeHNString("TEXN", *texture);
+
+                for (std::vector<std::vector<Ogre::uint8> >::const_iterator blendmap = it->second.mBlendmaps.begin();
+                    blendmap != it->second.mBlendmaps.end(); ++blendmap)
+                {
+                    writer.startSubRecord("DATA");
+                    writer.write(reinterpret_cast<const char *>(&(*blendmap)[0]), blendmap->size());
+                    writer.endRecord("DATA");
+                }
+
+                writer.endRecord(sBlendmapsRecord);
+            }
+
+            writer.close();
+
+            ESM::saveCacheFile(file, buffer.str());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write terrain blendmap cache " << file.string() << ": " << e.what() << std::endl;
+        }
+
+        // Don't retry a failed write for every chunk of blendmaps
+        mBlendmapCacheChanged = false;
+    }
+
+    bool Storage::readCompositeMap(Ogre::uint64 hash, std::vector<Ogre::uint8>& data)
+    {
+        if (mCacheDir.empty())
+            return false;
+
+        boost::filesystem::path file = getCompositeMapFile(mCacheDir, hash);
+
+        try
+        {
+            ESM::ESMReader reader;
+
+            if (!ESM::openCacheFile(reader, file, sCacheFormat, hash))
+                return false;
+
+            if (!reader.hasMoreRecs() || reader.getRecName().val!=sCompositeMapRecord)
+                throw std::runtime_error("missing composite map");
+
+            reader.getRecHeader();
+            reader.getSubNameIs("DATA");
+            reader.getSubHeader();
+
+            data.resize(reader.getSubSize());
+
+            if (!data.empty())
+                reader.getExact(&data[0], static_cast<int>(data.size()));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Ignoring terrain composite map cache " << file.string() << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        // for pruning in setCache
+        ESM::touchCacheFile(file);
+
+        return true;
+    }
+
+    void Storage::writeCompositeMap(Ogre::uint64 hash, const std::vector<Ogre::uint8>& data)
+    {
+        if (mCacheDir.empty() || data.empty())
+            return;
+
+        boost::filesystem::path file = getCompositeMapFile(mCacheDir, hash);
+
+        try
+        {
+            std::stringstream buffer;
+
+            ESM::ESMWriter writer;
+            ESM::startCacheFile(writer, buffer, sCacheFormat, hash);
+
+            writer.startRecord(sCompositeMapRecord);
+            writer.startSubRecord("DATA");
+            writer.write(reinterpret_cast<const char *>(&data[0]), data.size());
+            writer.endRecord("DATA");
+            writer.endRecord(sCompositeMapRecord);
+
+            writer.close();
+
+            ESM::saveCacheFile(file, buffer.str());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write terrain composite map cache " << file.string() << ": " << e.what() << std::endl;
+        }
     }
 
     float Storage::getHeightAt(const Ogre::Vector3 &worldPos)
@@ -1,6 +1,16 @@
 #ifndef COMPONENTS_ESM_TERRAIN_STORAGE_H
 #define COMPONENTS_ESM_TERRAIN_STORAGE_H
 
+#include <list>
+#include <map>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <components/terrain/storage.hpp>
 
 #include <components/esm/loadland.hpp>
@@ -21,6 +31,21 @@ namespace ESMTerrain
 
     public:
 
+        Storage();
+
+        virtual ~Storage();
+
+        /// Drop the vertex data decoded for fillVertexBuffers. Must be called when land records change.
+        void clearCache();
+
+        /// Keep blendmaps and composite maps in files in \a dir, so that they don't have to be
+        /// created again in the next session.
+        /// @param key identifies the land and land texture records the blendmaps are created from.
+        ///        Blendmaps cached with a different key are discarded.
+        /// @param maxCompositeMapSize The least recently used composite maps are removed, until they
+        ///        take up no more than this many bytes.
+        void setCache (const boost::filesystem::path& dir, uint64_t key, uint64_t maxCompositeMapSize);
+
         // Not implemented in this class, because we need different Store implementations for game and editor
         /// Get bounds of the whole terrain in cell units
         virtual void getBounds(float& minX, float& maxX, float& minY, float& maxY) = 0;
@@ -82,6 +107,10 @@ namespace ESMTerrain
 
         virtual Terrain::LayerInfo getDefaultLayer();
 
+        virtual bool readCompositeMap (Ogre::uint64 hash, std::vector<Ogre::uint8>& data);
+
+        virtual void writeCompositeMap (Ogre::uint64 hash, const std::vector<Ogre::uint8>& data);
+
         /// Get the transformation factor for mapping cell units to world units.
         virtual float getCellWorldSize();
 
@@ -89,9 +118,59 @@ namespace ESMTerrain
         virtual int getCellVertices();
 
     private:
-        void fixNormal (Ogre::Vector3& normal, int cellX, int cellY, int col, int row);
-        void fixColour (Ogre::ColourValue& colour, int cellX, int cellY, int col, int row);
-        void averageNormal (Ogre::Vector3& normal, int cellX, int cellY, int col, int row);
+        /// Vertex data of one cell at one level of detail, decoded from its ESM::Land, with the fixes
+        /// at the cell borders applied. Transposed into the order of the vertex buffers (row-major,
+        /// a row is parallel to the y-axis), so that fillVertexBuffers copies runs of consecutive vertices.
+        struct DecodedCell
+        {
+            int mSize; // vertices on one side
+            boost::scoped_array<float> mHeights;
+            boost::scoped_array<float> mNormals;
+            boost::scoped_array<Ogre::uint32> mColours; // render-system specific format
+        };
+
+        typedef boost::shared_ptr<const DecodedCell> DecodedCellPtr;
+
+        // cell x, cell y, LOD level
+        typedef std::pair<std::pair<int, int>, int> DecodedCellKey;
+
+        // Cells decoded last, most recently used first
+        typedef std::list<std::pair<DecodedCellKey, DecodedCellPtr> > DecodedCells;
+
+        // in vertices, about 20 bytes each
+        static const size_t sDecodedCellCacheSize = 1024*1024;
+
+        // Vertex colour channels converted to the render-system specific format. The channels are
+        // converted independently of each other, so they can be looked up instead of converted.
+        Ogre::uint32 mRedChannel[256];
+        Ogre::uint32 mGreenChannel[256];
+        Ogre::uint32 mBlueChannel[256];
+        Ogre::uint32 mAlphaChannel;
+        Ogre::uint32 mWhite;
+
+        DecodedCells mDecodedCells;
+        std::map<DecodedCellKey, DecodedCells::iterator> mDecodedCellIndex;
+        size_t mDecodedCellVertices;
+        boost::mutex mDecodedCellMutex;
+
+        /// @note Thread-safe, if getLand is.
+        DecodedCellPtr getDecodedCell (int cellX, int cellY, int lodLevel);
+
+        void decodeCell (int cellX, int cellY, int lodLevel, DecodedCell& cell);
+
+        /// @param index index of the vertex in ESM::Land::LandData::mColours
+        Ogre::uint32 convertColour (const ESM::Land::LandData& data, int index) const
+        {
+            const unsigned char* colour = reinterpret_cast<const unsigned char*>(&data.mColours[index*3]);
+            return mRedChannel[colour[0]] | mGreenChannel[colour[1]] | mBlueChannel[colour[2]] | mAlphaChannel;
+        }
+
+        // A cell and its neighbours, indexed by [x+1][y+1] relative to the cell
+        typedef ESM::Land* Neighbours[3][3];
+
+        static void fixNormal (Ogre::Vector3& normal, const Neighbours& lands, int col, int row);
+        void fixColour (Ogre::uint32& colour, const Neighbours& lands, int col, int row);
+        static void averageNormal (Ogre::Vector3& normal, const Neighbours& lands, int col, int row);
 
         float getVertexHeight (const ESM::Land* land, int x, int y);
 
@@ -108,6 +187,37 @@ namespace ESMTerrain
 
         Terrain::LayerInfo getLayerInfo(const std::string& texture);
 
+        /// Blendmaps of one cell, as stored in the cache
+        struct CachedBlendmaps
+        {
+            std::vector<std::string> mTextures; // one per layer, before getLayerInfo
+            std::vector<std::vector<Ogre::uint8> > mBlendmaps;
+        };
+
+        // cell x, cell y, packed
+        typedef std::pair<std::pair<int, int>, bool> CachedBlendmapsKey;
+
+        boost::filesystem::path mCacheDir;
+        uint64_t mCacheKey;
+        std::map<CachedBlendmapsKey, CachedBlendmaps> mCachedBlendmaps;
+        bool mBlendmapCacheRead;
+        bool mBlendmapCacheChanged;
+        boost::mutex mBlendmapCacheMutex;
+
+        /// @note Call with mBlendmapCacheMutex locked
+        void readBlendmapCache();
+
+        /// @note Call with mBlendmapCacheMutex locked
+        void writeBlendmapCache();
+
+        /// @return Have the blendmaps of this cell been found in the cache?
+        bool getCachedBlendmaps (int cellX, int cellY, bool pack,
+                           std::vector<Ogre::PixelBox>& blendmaps,
+                           std::vector<Terrain::LayerInfo>& layerList);
+
+        void addCachedBlendmaps (int cellX, int cellY, bool pack, const std::vector<std::string>& textures,
+                           const std::vector<Ogre::PixelBox>& blendmaps);
+
         // Non-virtual
         void getBlendmapsImpl (float chunkSize, const Ogre::Vector2& chunkCenter, bool pack,
                            std::vector<Ogre::PixelBox>& blendmaps,
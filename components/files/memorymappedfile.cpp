@@ -0,0 +1,207 @@
+#include "memorymappedfile.hpp"
+
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+
+#if FILE_API == FILE_API_POSIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#elif FILE_API == FILE_API_WIN32
+#include <boost/locale.hpp>
+#endif
+
+namespace
+{
+    void throwOpenError (char const * filename, char const * reason)
+    {
+        std::ostringstream os;
+        os << "Failed to map '" << filename << "' into memory: " << reason;
+        throw std::runtime_error (os.str ());
+    }
+}
+
+#if FILE_API == FILE_API_STDIO
+/*
+ *
+ *  No memory mapping support for plain stdio
+ *
+ */
+
+MemoryMappedFile::MemoryMappedFile ()
+    : mData (NULL), mSize (0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile ()
+{
+}
+
+void MemoryMappedFile::open (char const * filename)
+{
+    throwOpenError (filename, "not supported on this platform");
+}
+
+void MemoryMappedFile::close ()
+{
+}
+
+#elif FILE_API == FILE_API_POSIX
+/*
+ *
+ *  Implementation of MemoryMappedFile methods using mmap
+ *
+ */
+
+MemoryMappedFile::MemoryMappedFile ()
+    : mData (NULL), mSize (0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile ()
+{
+    if (mData != NULL)
+        close ();
+}
+
+void MemoryMappedFile::open (char const * filename)
+{
+    assert (mData == NULL);
+
+#ifdef O_BINARY
+    static const int openFlags = O_RDONLY | O_BINARY;
+#else
+    static const int openFlags = O_RDONLY;
+#endif
+
+    int handle = ::open (filename, openFlags, 0);
+
+    if (handle == -1)
+        throwOpenError (filename, "can not open file");
+
+    struct stat info;
+
+    if (::fstat (handle, &info) == -1)
+    {
+        ::close (handle);
+        throwOpenError (filename, "can not query file size");
+    }
+
+    // mmap refuses zero-length mappings
+    if (info.st_size == 0)
+    {
+        ::close (handle);
+        throwOpenError (filename, "file is empty");
+    }
+
+    void * data = ::mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close (handle);
+
+    if (data == MAP_FAILED)
+        throwOpenError (filename, "mmap failed");
+
+#ifdef MADV_SEQUENTIAL
+    // Content files are mostly read front to back
+    ::madvise (data, info.st_size, MADV_SEQUENTIAL);
+#endif
+
+    mData = static_cast<const char *> (data);
+    mSize = info.st_size;
+}
+
+void MemoryMappedFile::close ()
+{
+    assert (mData != NULL);
+
+    ::munmap (const_cast<char *> (mData), mSize);
+
+    mData = NULL;
+    mSize = 0;
+}
+
+#elif FILE_API == FILE_API_WIN32
+/*
+ *
+ *  Implementation of MemoryMappedFile methods using Win32 file mappings
+ *
+ */
+
+MemoryMappedFile::MemoryMappedFile ()
+    : mData (NULL), mSize (0), mHandle (INVALID_HANDLE_VALUE), mMapping (NULL)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile ()
+{
+    if (mData != NULL)
+        close ();
+}
+
+void MemoryMappedFile::open (char const * filename)
+{
+    assert (mData == NULL);
+
+    std::wstring wname = boost::locale::conv::utf_to_utf<wchar_t>(filename);
+    HANDLE handle = CreateFileW (wname.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    if (handle == INVALID_HANDLE_VALUE)
+        throwOpenError (filename, "can not open file");
+
+    BY_HANDLE_FILE_INFORMATION info;
+
+    if (!GetFileInformationByHandle (handle, &info) || info.nFileSizeHigh != 0 || info.nFileSizeLow == 0)
+    {
+        CloseHandle (handle);
+        throwOpenError (filename, "unsupported file size");
+    }
+
+    HANDLE mapping = CreateFileMappingW (handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mapping == NULL)
+    {
+        CloseHandle (handle);
+        throwOpenError (filename, "CreateFileMapping failed");
+    }
+
+    const void * data = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (data == NULL)
+    {
+        CloseHandle (mapping);
+        CloseHandle (handle);
+        throwOpenError (filename, "MapViewOfFile failed");
+    }
+
+    mHandle = handle;
+    mMapping = mapping;
+    mData = static_cast<const char *> (data);
+    mSize = info.nFileSizeLow;
+}
+
+void MemoryMappedFile::close ()
+{
+    assert (mData != NULL);
+
+    UnmapViewOfFile (mData);
+    CloseHandle (mMapping);
+    CloseHandle (mHandle);
+
+    mData = NULL;
+    mSize = 0;
+    mMapping = NULL;
+    mHandle = INVALID_HANDLE_VALUE;
+}
+
+#endif
+
+MemoryMappedFilePtr openMemoryMappedFile (char const * filename)
+{
+    MemoryMappedFilePtr file (new MemoryMappedFile);
+    file->open (filename);
+    return file;
+}
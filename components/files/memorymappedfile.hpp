@@ -0,0 +1,47 @@
+#ifndef COMPONENTS_FILES_MEMORYMAPPEDFILE_HPP
+#define COMPONENTS_FILES_MEMORYMAPPEDFILE_HPP
+
+#include "lowlevelfile.hpp"
+
+#include <boost/shared_ptr.hpp>
+
+/// \brief Read-only mapping of a whole file into memory
+///
+/// open() throws a std::runtime_error if the file can not be opened or mapped, or if the
+/// platform does not support memory mapping. Callers are expected to fall back to
+/// stream-based IO in that case.
+class MemoryMappedFile
+{
+public:
+
+    MemoryMappedFile ();
+    ~MemoryMappedFile ();
+
+    void open (char const * filename);
+    void close ();
+
+    bool isOpen () const { return mData != NULL; }
+
+    const char * data () const { return mData; }
+    size_t size () const { return mSize; }
+
+private:
+
+    MemoryMappedFile (const MemoryMappedFile&);
+    MemoryMappedFile& operator= (const MemoryMappedFile&);
+
+    const char * mData;
+    size_t mSize;
+
+#if FILE_API == FILE_API_WIN32
+    HANDLE mHandle;
+    HANDLE mMapping;
+#endif
+};
+
+typedef boost::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+
+/// Map \a filename into memory, throws on failure.
+MemoryMappedFilePtr openMemoryMappedFile (char const * filename);
+
+#endif
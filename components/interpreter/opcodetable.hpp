@@ -0,0 +1,75 @@
+#ifndef INTERPRETER_OPCODETABLE_H_INCLUDED
+#define INTERPRETER_OPCODETABLE_H_INCLUDED
+
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+
+namespace Interpreter
+{
+    /// \brief Dispatch table for the opcodes of one segment
+    ///
+    /// The lower half of a segment holds the interpreter's own opcodes, the upper half those of
+    /// the compiler extensions, each allocated from 0 upwards. Each half is a dense array up to its
+    /// highest installed opcode, so looking up an opcode is one array access.
+    template<typename T>
+    class OpcodeTable
+    {
+            /// Limit for the size of each half, so that a stray opcode can't blow up the table
+            static const unsigned int sMaxIndex = 0xffff;
+
+            int mSegment;
+            unsigned int mHalfBits;
+            std::vector<T *> mOpcodes[2];
+
+            // not implemented
+            OpcodeTable (const OpcodeTable&);
+            OpcodeTable& operator= (const OpcodeTable&);
+
+        public:
+
+            /// \param bits Width of the opcode field of the segment
+            OpcodeTable (int segment, unsigned int bits) : mSegment (segment), mHalfBits (bits-1) {}
+
+            ~OpcodeTable()
+            {
+                for (int i=0; i<2; ++i)
+                    for (typename std::vector<T *>::iterator iter (mOpcodes[i].begin());
+                        iter!=mOpcodes[i].end(); ++iter)
+                        delete *iter;
+            }
+
+            void install (unsigned int code, T *opcode)
+            ///< ownership of \a opcode is transferred to *this.
+            {
+                std::vector<T *>& table = mOpcodes[(code>>mHalfBits) & 1];
+                unsigned int index = code & ((1u<<mHalfBits)-1);
+
+                if ((code>>mHalfBits)>1 || index>sMaxIndex || (index<table.size() && table[index]))
+                {
+                    delete opcode;
+
+                    std::ostringstream error;
+                    error << "can't install opcode " << code << " in segment " << mSegment << ": "
+                        << ((code>>mHalfBits)>1 || index>sMaxIndex ? "out of range" : "already installed");
+
+                    throw std::logic_error (error.str());
+                }
+
+                if (index>=table.size())
+                    table.resize (index+1, 0);
+
+                table[index] = opcode;
+            }
+
+            T *get (unsigned int code) const
+            ///< \return 0, if there is no opcode \a code (code must be within the segment).
+            {
+                const std::vector<T *>& table = mOpcodes[code>>mHalfBits];
+                unsigned int index = code & ((1u<<mHalfBits)-1);
+                return index<table.size() ? table[index] : 0;
+            }
+    };
+}
+
+#endif
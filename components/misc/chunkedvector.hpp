@@ -0,0 +1,150 @@
+#ifndef MISC_CHUNKEDVECTOR_H
+#define MISC_CHUNKEDVECTOR_H
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <cstddef>
+
+namespace Misc
+{
+    /// \brief Sequence that stores its elements contiguously in fixed size chunks
+    ///
+    /// Elements can only be appended. They never move, so pointers and references to them stay
+    /// valid until the container is destroyed or assigned to. Iterators refer to an element by its
+    /// index, so they stay valid as well, with the exception of end(), which refers to the next
+    /// element that is appended.
+    template<typename T, std::size_t ChunkSize = 64>
+    class ChunkedVector
+    {
+            std::vector<T *> mChunks;
+            std::size_t mSize;
+
+            template<typename Container, typename Value>
+            class Iterator : public std::iterator<std::bidirectional_iterator_tag, Value>
+            {
+                    Container *mContainer;
+                    std::size_t mIndex;
+
+                public:
+
+                    Iterator() : mContainer (0), mIndex (0) {}
+
+                    Iterator (Container *container, std::size_t index)
+                    : mContainer (container), mIndex (index) {}
+
+                    /// Conversion from iterator to const_iterator
+                    template<typename Container2, typename Value2>
+                    Iterator (const Iterator<Container2, Value2>& iter)
+                    : mContainer (iter.getContainer()), mIndex (iter.getIndex()) {}
+
+                    Container *getContainer() const { return mContainer; }
+
+                    std::size_t getIndex() const { return mIndex; }
+
+                    Value& operator*() const { return (*mContainer)[mIndex]; }
+
+                    Value *operator->() const { return &(*mContainer)[mIndex]; }
+
+                    Iterator& operator++() { ++mIndex; return *this; }
+
+                    Iterator operator++ (int) { Iterator iter (*this); ++mIndex; return iter; }
+
+                    Iterator& operator--() { --mIndex; return *this; }
+
+                    Iterator operator-- (int) { Iterator iter (*this); --mIndex; return iter; }
+
+                    bool operator== (const Iterator& iter) const
+                    {
+                        return mIndex==iter.mIndex && mContainer==iter.mContainer;
+                    }
+
+                    bool operator!= (const Iterator& iter) const { return !(*this==iter); }
+            };
+
+        public:
+
+            typedef T value_type;
+            typedef T& reference;
+            typedef const T& const_reference;
+            typedef std::size_t size_type;
+            typedef Iterator<ChunkedVector, T> iterator;
+            typedef Iterator<const ChunkedVector, const T> const_iterator;
+
+            ChunkedVector() : mSize (0) {}
+
+            ChunkedVector (const ChunkedVector& vector) : mSize (0)
+            {
+                for (std::size_t i=0; i<vector.size(); ++i)
+                    push_back (vector[i]);
+            }
+
+            ChunkedVector& operator= (const ChunkedVector& vector)
+            {
+                if (&vector!=this)
+                {
+                    clear();
+
+                    for (std::size_t i=0; i<vector.size(); ++i)
+                        push_back (vector[i]);
+                }
+
+                return *this;
+            }
+
+            ~ChunkedVector()
+            {
+                clear();
+            }
+
+            void push_back (const T& value)
+            {
+                if (mSize==mChunks.size()*ChunkSize)
+                    mChunks.push_back (std::allocator<T>().allocate (ChunkSize));
+
+                new (mChunks.back() + mSize % ChunkSize) T (value);
+                ++mSize;
+            }
+
+            void clear()
+            {
+                for (std::size_t i=0; i<mSize; ++i)
+                    (*this)[i].~T();
+
+                for (typename std::vector<T *>::iterator iter (mChunks.begin()); iter!=mChunks.end(); ++iter)
+                    std::allocator<T>().deallocate (*iter, ChunkSize);
+
+                mChunks.clear();
+                mSize = 0;
+            }
+
+            T& operator[] (std::size_t index) { return mChunks[index / ChunkSize][index % ChunkSize]; }
+
+            const T& operator[] (std::size_t index) const
+            {
+                return mChunks[index / ChunkSize][index % ChunkSize];
+            }
+
+            std::size_t size() const { return mSize; }
+
+            bool empty() const { return mSize==0; }
+
+            T& front() { return (*this)[0]; }
+
+            const T& front() const { return (*this)[0]; }
+
+            T& back() { return (*this)[mSize-1]; }
+
+            const T& back() const { return (*this)[mSize-1]; }
+
+            iterator begin() { return iterator (this, 0); }
+
+            iterator end() { return iterator (this, mSize); }
+
+            const_iterator begin() const { return const_iterator (this, 0); }
+
+            const_iterator end() const { return const_iterator (this, mSize); }
+    };
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MISC_HASH_H
+#define MISC_HASH_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+namespace Misc
+{
+    /// \brief FNV-1a, for the keys of cache files and hashes of content
+    ///
+    /// Values are hashed by their bytes, so only use it with types without padding or pointers.
+
+    const uint64_t sHashSeed = 14695981039346656037ull;
+
+    inline void addHash (uint64_t& hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *> (data);
+        for (size_t i=0; i<size; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    template<typename T>
+    inline void addHash (uint64_t& hash, const T& value)
+    {
+        addHash (hash, &value, sizeof (T));
+    }
+
+    /// The size goes first, so that the boundaries between strings are part of the hash.
+    inline void addHash (uint64_t& hash, const std::string& value)
+    {
+        addHash (hash, static_cast<uint32_t> (value.size()));
+        addHash (hash, value.data(), value.size());
+    }
+
+    inline uint64_t getHash (const void *data, size_t size)
+    {
+        uint64_t hash = sHashSeed;
+        addHash (hash, data, size);
+        return hash;
+    }
+}
+
+#endif
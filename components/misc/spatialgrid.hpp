@@ -0,0 +1,292 @@
+#ifndef MISC_SPATIALGRID_H
+#define MISC_SPATIALGRID_H
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include <boost/unordered_map.hpp>
+
+namespace Misc
+{
+    /// \brief Index of points in 3D space, for radius and nearest neighbour queries
+    ///
+    /// The points are sorted into the cells of a uniform grid in the XY plane. Moving a point
+    /// only touches the grid when it crosses into another cell. Queries look only at the cells
+    /// that overlap the query, or at the occupied cells, whichever are fewer.
+    template<typename Key, typename Compare = std::less<Key> >
+    class SpatialGrid
+    {
+            typedef std::pair<int, int> CellIndex;
+
+            struct Entry
+            {
+                CellIndex mCell;
+                std::size_t mIndex; // in the cell
+            };
+
+            typedef std::map<Key, Entry, Compare> Entries;
+
+            // Positions are kept in the cells, so that queries read them in sequence. Entries don't
+            // move in the map, so the cells can refer to them directly.
+            struct CellEntry
+            {
+                float mPosition[3];
+                typename Entries::iterator mEntry;
+            };
+
+            typedef std::vector<CellEntry> CellEntries;
+            typedef boost::unordered_map<CellIndex, CellEntries> Cells;
+
+            float mCellSize;
+            Entries mEntries;
+            Cells mCells;
+
+            /// Cell indices are clamped, so that converting them from float never overflows and
+            /// looping over a range of them never wraps around. NaN ends up in the lowest cell.
+            static const int sMaxCell = 1 << 30;
+
+            static int getCellIndex (float value)
+            {
+                double cell = std::floor (static_cast<double> (value));
+
+                if (!(cell>-sMaxCell))
+                    return -sMaxCell;
+
+                if (cell>sMaxCell)
+                    return sMaxCell;
+
+                return static_cast<int> (cell);
+            }
+
+            CellIndex getCell (float x, float y) const
+            {
+                return CellIndex (getCellIndex (x / mCellSize), getCellIndex (y / mCellSize));
+            }
+
+            /// Smallest radius around (x, y) whose square covers every occupied cell. NaN, if
+            /// (x, y) is.
+            float getCoveringRadius (float x, float y) const
+            {
+                float radius = 0;
+
+                for (typename Cells::const_iterator iter (mCells.begin()); iter!=mCells.end(); ++iter)
+                {
+                    float left = iter->first.first * mCellSize;
+                    float bottom = iter->first.second * mCellSize;
+
+                    radius = std::max (radius, std::max (std::abs (x-left), std::abs (x-left-mCellSize)));
+                    radius = std::max (radius, std::max (std::abs (y-bottom), std::abs (y-bottom-mCellSize)));
+                }
+
+                return radius;
+            }
+
+            void addToCell (typename Entries::iterator entry, const CellIndex& index)
+            {
+                CellEntries& cell = mCells[index];
+
+                CellEntry cellEntry;
+                cellEntry.mEntry = entry;
+                cell.push_back (cellEntry);
+
+                entry->second.mCell = index;
+                entry->second.mIndex = cell.size()-1;
+            }
+
+            void removeFromCell (typename Entries::iterator entry)
+            {
+                typename Cells::iterator cell = mCells.find (entry->second.mCell);
+
+                CellEntries& entries = cell->second;
+
+                entries[entry->second.mIndex] = entries.back();
+                entries[entry->second.mIndex].mEntry->second.mIndex = entry->second.mIndex;
+                entries.pop_back();
+
+                if (entries.empty())
+                    mCells.erase (cell);
+            }
+
+            template<typename Output>
+            static void collect (const CellEntries& entries, float x, float y, float z, float radius,
+                Output& out)
+            {
+                for (typename CellEntries::const_iterator iter (entries.begin()); iter!=entries.end(); ++iter)
+                {
+                    float dx = iter->mPosition[0] - x;
+                    float dy = iter->mPosition[1] - y;
+                    float dz = iter->mPosition[2] - z;
+                    float distance = dx*dx + dy*dy + dz*dz;
+
+                    if (distance<=radius*radius)
+                        out.add (distance, iter->mEntry->first);
+                }
+            }
+
+            template<typename Output>
+            void query (float x, float y, float z, float radius, Output& out) const
+            {
+                CellIndex min = getCell (x-radius, y-radius);
+                CellIndex max = getCell (x+radius, y+radius);
+
+                double overlapping = (static_cast<double> (max.first) - min.first + 1) *
+                    (static_cast<double> (max.second) - min.second + 1);
+
+                if (overlapping>mCells.size())
+                {
+                    for (typename Cells::const_iterator iter (mCells.begin()); iter!=mCells.end(); ++iter)
+                        if (iter->first.first>=min.first && iter->first.first<=max.first &&
+                            iter->first.second>=min.second && iter->first.second<=max.second)
+                            collect (iter->second, x, y, z, radius, out);
+                }
+                else
+                {
+                    for (int cellX=min.first; cellX<=max.first; ++cellX)
+                        for (int cellY=min.second; cellY<=max.second; ++cellY)
+                        {
+                            typename Cells::const_iterator iter = mCells.find (CellIndex (cellX, cellY));
+
+                            if (iter!=mCells.end())
+                                collect (iter->second, x, y, z, radius, out);
+                        }
+                }
+            }
+
+            struct KeyOutput
+            {
+                std::vector<Key>& mKeys;
+
+                KeyOutput (std::vector<Key>& keys) : mKeys (keys) {}
+
+                void add (float, const Key& key) { mKeys.push_back (key); }
+            };
+
+            struct DistanceOutput
+            {
+                std::vector<std::pair<float, Key> > mFound;
+
+                void add (float distance, const Key& key) { mFound.push_back (std::make_pair (distance, key)); }
+            };
+
+            struct CompareDistance
+            {
+                bool operator() (const std::pair<float, Key>& left, const std::pair<float, Key>& right) const
+                {
+                    if (left.first!=right.first)
+                        return left.first<right.first;
+
+                    return Compare() (left.second, right.second);
+                }
+            };
+
+        public:
+
+            /// \param cellSize Edge length of a grid cell. Should be about the diameter of typical
+            /// queries.
+            explicit SpatialGrid (float cellSize) : mCellSize (cellSize) {}
+
+            /// Insert \a key or move it to a new position.
+            void update (const Key& key, float x, float y, float z)
+            {
+                CellIndex index = getCell (x, y);
+
+                typename Entries::iterator iter = mEntries.find (key);
+
+                if (iter==mEntries.end())
+                {
+                    iter = mEntries.insert (std::make_pair (key, Entry())).first;
+                    addToCell (iter, index);
+                }
+                else if (iter->second.mCell!=index)
+                {
+                    removeFromCell (iter);
+                    addToCell (iter, index);
+                }
+
+                float *position = mCells[index][iter->second.mIndex].mPosition;
+                position[0] = x;
+                position[1] = y;
+                position[2] = z;
+            }
+
+            /// \note Ignored, if \a key is not in the grid.
+            void remove (const Key& key)
+            {
+                typename Entries::iterator iter = mEntries.find (key);
+
+                if (iter!=mEntries.end())
+                {
+                    removeFromCell (iter);
+                    mEntries.erase (iter);
+                }
+            }
+
+            void clear()
+            {
+                mEntries.clear();
+                mCells.clear();
+            }
+
+            std::size_t size() const { return mEntries.size(); }
+
+            /// Append all keys within \a radius of (x, y, z) to \a out, in no particular order.
+            void query (float x, float y, float z, float radius, std::vector<Key>& out) const
+            {
+                KeyOutput output (out);
+                query (x, y, z, radius, output);
+            }
+
+            /// Append the \a count keys closest to (x, y, z) to \a out, closest first. Ties are
+            /// ordered by key.
+            void queryNearest (float x, float y, float z, std::size_t count, std::vector<Key>& out) const
+            {
+                count = std::min (count, mEntries.size());
+
+                if (count==0)
+                    return;
+
+                // Grow the radius until it contains enough keys. A query finds all keys within the
+                // radius, so they include the closest ones. Keys far away along z can take a radius
+                // that covers the whole grid, and from there on every key is taken.
+                float coveringRadius = std::numeric_limits<float>::infinity();
+
+                DistanceOutput output;
+                for (float radius = mCellSize; ; radius *= 2)
+                {
+                    output.mFound.clear();
+
+                    // Also stops at an infinite radius or a NaN position
+                    if (!(radius<coveringRadius))
+                    {
+                        for (typename Cells::const_iterator iter (mCells.begin()); iter!=mCells.end(); ++iter)
+                            collect (iter->second, x, y, z, std::numeric_limits<float>::infinity(), output);
+                        break;
+                    }
+
+                    query (x, y, z, radius, output);
+
+                    if (output.mFound.size()>=count)
+                        break;
+
+                    if (radius==mCellSize)
+                        coveringRadius = getCoveringRadius (x, y);
+                }
+
+                // Keys with a NaN distance are never found
+                count = std::min (count, output.mFound.size());
+
+                std::partial_sort (output.mFound.begin(), output.mFound.begin()+count, output.mFound.end(),
+                    CompareDistance());
+
+                for (std::size_t i=0; i<count; ++i)
+                    out.push_back (output.mFound[i].second);
+            }
+    };
+}
+
+#endif
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <locale>
 
+#include "hash.hpp"
+
 namespace Misc
 {
 class StringUtils
@@ -71,6 +73,41 @@ public:
         std::string out = in;
         return toLower(out);
     }
+
+    /// Same as std::tolower with mLocale, which is the classic locale, without the overhead of
+    /// the locale lookup
+    static char toLowerAscii(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+
+    /// Case insensitive hash function for hashed containers, consistent with CiEqual
+    struct CiHash
+    {
+        size_t operator()(const std::string &str) const
+        {
+            uint64_t hash = sHashSeed;
+            for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+            {
+                char lower = toLowerAscii(*it);
+                addHash(hash, &lower, 1);
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct CiEqual
+    {
+        bool operator()(const std::string &x, const std::string &y) const
+        {
+            if (x.size() != y.size())
+                return false;
+            for (std::string::size_type i = 0; i < x.size(); ++i)
+                if (toLowerAscii(x[i]) != toLowerAscii(y[i]))
+                    return false;
+            return true;
+        }
+    };
 };
 
 }
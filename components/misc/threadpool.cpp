@@ -0,0 +1,114 @@
+#include "threadpool.hpp"
+
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+namespace Misc
+{
+    ThreadPool::ThreadPool (unsigned int threads)
+    : mThreadCount (threads ? threads : getHardwareThreadCount()), mPending (0), mStopping (false)
+    {
+        for (unsigned int i=0; i<mThreadCount; ++i)
+            mThreads.create_thread (boost::bind (&ThreadPool::run, this));
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            boost::mutex::scoped_lock lock (mMutex);
+            mStopping = true;
+        }
+        mJobAvailable.notify_all();
+        mThreads.join_all();
+    }
+
+    void ThreadPool::push (const Job& job)
+    {
+        {
+            boost::mutex::scoped_lock lock (mMutex);
+            mQueue.push_back (job);
+            ++mPending;
+        }
+        mJobAvailable.notify_one();
+    }
+
+    void ThreadPool::wait()
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+
+        while (mPending>0)
+            mJobsDone.wait (lock);
+
+        if (!mError.empty())
+        {
+            std::string error = mError;
+            mError.clear();
+            throw std::runtime_error (error);
+        }
+    }
+
+    unsigned int ThreadPool::getThreadCount() const
+    {
+        return mThreadCount;
+    }
+
+    size_t ThreadPool::getPendingCount() const
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        return mPending;
+    }
+
+    unsigned int ThreadPool::getHardwareThreadCount()
+    {
+        unsigned int count = boost::thread::hardware_concurrency();
+        return count ? count : 1;
+    }
+
+    void ThreadPool::run()
+    {
+        while (true)
+        {
+            Job job;
+
+            {
+                boost::mutex::scoped_lock lock (mMutex);
+
+                // Keep working through the queue when stopping, so no job gets lost
+                while (mQueue.empty() && !mStopping)
+                    mJobAvailable.wait (lock);
+
+                if (mQueue.empty())
+                    return;
+
+                job = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            std::string error;
+
+            try
+            {
+                job();
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+            }
+            catch (...)
+            {
+                error = "unknown exception in worker thread";
+            }
+
+            {
+                boost::mutex::scoped_lock lock (mMutex);
+
+                if (!error.empty() && mError.empty())
+                    mError = error;
+
+                if (--mPending==0)
+                    mJobsDone.notify_all();
+            }
+        }
+    }
+}
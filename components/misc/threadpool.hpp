@@ -0,0 +1,64 @@
+#ifndef MISC_THREADPOOL_H
+#define MISC_THREADPOOL_H
+
+#include <deque>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Misc
+{
+    /// \brief Fixed-size pool of worker threads processing a FIFO job queue
+    ///
+    /// Jobs must not touch state that is used by other jobs or by the owning thread without
+    /// their own synchronisation. An exception escaping from a job is caught by the worker and
+    /// rethrown as std::runtime_error from the next call to wait().
+    class ThreadPool
+    {
+        public:
+            typedef boost::function<void ()> Job;
+
+            /// \param threads Number of worker threads, 0 for one per hardware thread.
+            explicit ThreadPool (unsigned int threads = 0);
+
+            /// Finishes all queued jobs, then stops the workers.
+            ~ThreadPool();
+
+            void push (const Job& job);
+
+            /// Block until all jobs pushed so far have finished.
+            void wait();
+
+            unsigned int getThreadCount() const;
+
+            /// Number of jobs that are queued or currently running.
+            size_t getPendingCount() const;
+
+            /// Number of hardware threads, at least 1.
+            static unsigned int getHardwareThreadCount();
+
+        private:
+
+            ThreadPool (const ThreadPool&);
+            ThreadPool& operator= (const ThreadPool&);
+
+            void run();
+
+            boost::thread_group mThreads;
+            unsigned int mThreadCount;
+
+            mutable boost::mutex mMutex;
+            boost::condition_variable mJobAvailable;
+            boost::condition_variable mJobsDone;
+
+            std::deque<Job> mQueue;
+            size_t mPending;
+            bool mStopping;
+            std::string mError;
+    };
+}
+
+#endif
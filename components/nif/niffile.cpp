@@ -12,8 +12,17 @@ namespace Nif
 NIFFile::NIFFile(const std::string &name)
     : ver(0)
     , filename(name)
+    , fileSize(0)
 {
-    parse();
+    parse(Ogre::ResourceGroupManager::getSingleton().openResource(filename));
+}
+
+NIFFile::NIFFile(const std::string &name, Ogre::DataStreamPtr stream)
+    : ver(0)
+    , filename(name)
+    , fileSize(0)
+{
+    parse(stream);
 }
 
 NIFFile::~NIFFile()
@@ -127,9 +136,10 @@ std::string NIFFile::printVersion(unsigned int version)
     +"." + Ogre::StringConverter::toString(version_out.quad[0]);
 }
 
-void NIFFile::parse()
+void NIFFile::parse(Ogre::DataStreamPtr stream)
 {
-    NIFStream nif (this, Ogre::ResourceGroupManager::getSingleton().openResource(filename));
+    fileSize = stream->size();
+    NIFStream nif (this, stream);
 
   // Check the header string
   std::string head = nif.getVersionString();
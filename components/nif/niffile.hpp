@@ -7,6 +7,8 @@
 #include <vector>
 #include <iostream>
 
+#include <OgreDataStream.h>
+
 #include "record.hpp"
 
 namespace Nif
@@ -24,6 +26,9 @@ class NIFFile
     /// File name, used for error messages and opening the file
     std::string filename;
 
+    /// Size of the file in bytes
+    size_t fileSize;
+
     /// Record list
     std::vector<Record*> records;
 
@@ -31,7 +36,7 @@ class NIFFile
     std::vector<Record*> roots;
 
     /// Parse the file
-    void parse();
+    void parse(Ogre::DataStreamPtr stream);
 
     /// Get the file's version in a human readable form
     ///\returns A string containing a human readable NIF version number
@@ -59,6 +64,9 @@ public:
 
     /// Open a NIF stream. The name is used for error messages and opening the file.
     NIFFile(const std::string &name);
+    /// Parse a NIF file from an already opened stream. Does not use the Ogre resource system, so
+    /// this can be called from a worker thread.
+    NIFFile(const std::string &name, Ogre::DataStreamPtr stream);
     ~NIFFile();
 
     /// Get a given record
@@ -81,6 +89,9 @@ public:
 
     /// Get the name of the file
     std::string getFilename(){ return filename; }
+
+    /// Size of the file in bytes, an estimate of the memory used by the parsed file
+    size_t getFileSize() const { return fileSize; }
 };
 
 
@@ -2,6 +2,28 @@
 //For error reporting
 #include "niffile.hpp"
 
+#include <algorithm>
+#include <cstring>
+
+#include <boost/static_assert.hpp>
+
+#include <OgrePlatform.h>
+
+namespace
+{
+    /// Convert an array of little endian values to native byte order in place. This is a no-op on
+    /// little endian hosts; otherwise a plain loop over fixed size elements, which the compiler
+    /// can vectorize.
+    template<size_t Size>
+    void convertLittleEndian(char *data, size_t count)
+    {
+#if OGRE_ENDIAN == OGRE_ENDIAN_BIG
+        for (size_t i = 0; i < count; ++i, data += Size)
+            std::reverse(data, data + Size);
+#endif
+    }
+}
+
 namespace Nif
 {
 
@@ -106,41 +128,68 @@ std::string NIFStream::getVersionString()
     return inp->getLine();
 }
 
+template<typename T>
+void NIFStream::readLittleEndianBuffer(T *dest, size_t count)
+{
+    BOOST_STATIC_ASSERT(sizeof(T) == 2 || sizeof(T) == 4);
+
+    char *data = reinterpret_cast<char *>(dest);
+    size_t size = count * sizeof(T);
+    size_t read = inp->read(data, size);
+
+    // Same as the single value reads, which return 0 past the end of the stream
+    if(read != size)
+        std::memset(data + read, 0, size - read);
+
+    convertLittleEndian<sizeof(T)>(data, count);
+}
+
+template<typename T, size_t Components>
+void NIFStream::readFloatArray(std::vector<T> &vec, size_t size)
+{
+    BOOST_STATIC_ASSERT(sizeof(T) == Components * sizeof(Ogre::Real));
+
+    vec.resize(size);
+    if(size == 0)
+        return;
+
+#if OGRE_DOUBLE_PRECISION == 1
+    std::vector<float> buffer(size * Components);
+    readLittleEndianBuffer(&buffer[0], buffer.size());
+    std::copy(buffer.begin(), buffer.end(), reinterpret_cast<Ogre::Real *>(&vec[0]));
+#else
+    readLittleEndianBuffer(reinterpret_cast<float *>(&vec[0]), size * Components);
+#endif
+}
+
 void NIFStream::getShorts(std::vector<short> &vec, size_t size)
 {
     vec.resize(size);
-    for(size_t i = 0;i < vec.size();i++)
-        vec[i] = getShort();
+    if(size != 0)
+        readLittleEndianBuffer(&vec[0], size);
 }
 void NIFStream::getFloats(std::vector<float> &vec, size_t size)
 {
     vec.resize(size);
-    for(size_t i = 0;i < vec.size();i++)
-        vec[i] = getFloat();
+    if(size != 0)
+        readLittleEndianBuffer(&vec[0], size);
 }
 void NIFStream::getVector2s(std::vector<Ogre::Vector2> &vec, size_t size)
 {
-    vec.resize(size);
-    for(size_t i = 0;i < vec.size();i++)
-        vec[i] = getVector2();
+    readFloatArray<Ogre::Vector2, 2>(vec, size);
 }
 void NIFStream::getVector3s(std::vector<Ogre::Vector3> &vec, size_t size)
 {
-    vec.resize(size);
-    for(size_t i = 0;i < vec.size();i++)
-        vec[i] = getVector3();
+    readFloatArray<Ogre::Vector3, 3>(vec, size);
 }
 void NIFStream::getVector4s(std::vector<Ogre::Vector4> &vec, size_t size)
 {
-    vec.resize(size);
-    for(size_t i = 0;i < vec.size();i++)
-        vec[i] = getVector4();
+    readFloatArray<Ogre::Vector4, 4>(vec, size);
 }
 void NIFStream::getQuaternions(std::vector<Ogre::Quaternion> &quat, size_t size)
 {
-    quat.resize(size);
-    for(size_t i = 0;i < quat.size();i++)
-        quat[i] = getQuaternion();
+    // Ogre::Quaternion is stored as w, x, y, z, the same order as in the file
+    readFloatArray<Ogre::Quaternion, 4>(quat, size);
 }
 
 }
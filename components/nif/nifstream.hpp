@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stdexcept>
+#include <vector>
 
 #include <OgreDataStream.h>
 #include <OgreVector2.h>
@@ -31,6 +32,15 @@ class NIFStream {
     uint32_t read_le32();
     float read_le32f();
 
+    /// Read \a count little endian values of type \a T (2 or 4 bytes) into \a dest with a single
+    /// read from the stream
+    template<typename T>
+    void readLittleEndianBuffer(T *dest, size_t count);
+
+    /// Read \a size elements made of \a Components floats each
+    template<typename T, size_t Components>
+    void readFloatArray(std::vector<T> &vec, size_t size);
+
 public:
 
     NIFFile * const file;
@@ -1,5 +1,25 @@
 #include "nifcache.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+#include <OgreResourceGroupManager.h>
+
+#include <components/nif/niftypes.hpp>
+#include <components/misc/stringops.hpp>
+#include <components/misc/threadpool.hpp>
+
+namespace
+{
+    char normalizeSlash (char ch)
+    {
+        return ch == '\\' ? '/' : ch;
+    }
+}
+
 namespace Nif
 {
 
@@ -17,23 +37,277 @@ Cache* Cache::getInstancePtr()
 }
 
 Cache::Cache()
+: mMemoryBudget (0), mPrefetchedMemory (0), mStopping (false)
 {
     assert (!sThis);
     sThis = this;
+
+    Stats stats = { 0, 0, 0, 0, 0, 0, 0 };
+    mStats = stats;
+
+    // Initialise function local statics used by the parser before there are any workers
+    Transformation::getIdentity();
+}
+
+Cache::~Cache()
+{
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        mStopping = true;
+    }
+
+    // Queued jobs return immediately once we are stopping
+    mWorkers.reset();
+
+    sThis = 0;
+}
+
+void Cache::setThreads (unsigned int threads)
+{
+    mWorkers.reset();
+
+    if (threads>0)
+        mWorkers.reset (new Misc::ThreadPool (threads));
+}
+
+void Cache::setMemoryBudget (size_t bytes)
+{
+    boost::mutex::scoped_lock lock (mMutex);
+    mMemoryBudget = bytes;
+    evict();
+}
+
+std::string Cache::normalize (const std::string& filename)
+{
+    std::string key = Misc::StringUtils::lowerCase (filename);
+    std::transform (key.begin(), key.end(), key.begin(), normalizeSlash);
+    return key;
+}
+
+void Cache::loadInBackground (const std::string& filename)
+{
+    if (!mWorkers.get())
+        return;
+
+    std::string key = normalize (filename);
+
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        if (mLoadedMap.find (key)!=mLoadedMap.end())
+            return;
+    }
+
+    // The Ogre resource system is not thread-safe, so the file is opened here and only parsed
+    // by the worker
+    Ogre::DataStreamPtr stream;
+
+    try
+    {
+        stream = Ogre::ResourceGroupManager::getSingleton().openResource (filename);
+    }
+    catch (const std::exception&)
+    {
+        // Leave reporting the error to load()
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+
+        Entry& entry = mLoadedMap[key];
+        entry.mLoading = true;
+
+        // Hand over the only reference, so that the stream is never shared between threads
+        entry.mStream = stream;
+        stream.setNull();
+
+        ++mStats.mInFlight;
+    }
+
+    mWorkers->push (boost::bind (&Cache::loadJob, this, key, filename));
+}
+
+void Cache::loadJob (const std::string& key, const std::string& filename)
+{
+    Ogre::DataStreamPtr stream;
+
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+
+        LoadedMap::iterator iter = mLoadedMap.find (key);
+        assert (iter!=mLoadedMap.end() && iter->second.mLoading);
+
+        stream = iter->second.mStream;
+        iter->second.mStream.setNull();
+
+        if (mStopping)
+        {
+            mLoadedMap.erase (iter);
+            --mStats.mInFlight;
+            return;
+        }
+    }
+
+    NIFFilePtr file;
+    std::string error;
+
+    try
+    {
+        file.reset (new NIFFile (filename, stream));
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+
+    stream.setNull();
+
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+
+        LoadedMap::iterator iter = mLoadedMap.find (key);
+        iter->second.mLoading = false;
+        --mStats.mInFlight;
+
+        if (file)
+        {
+            // Keep it until load() picks it up, see evict()
+            iter->second.mPrefetched = true;
+            mPrefetchedMemory += file->getFileSize();
+            insert (iter, file);
+        }
+        else
+            iter->second.mError = error;
+    }
+
+    mLoaded.notify_all();
 }
 
 NIFFilePtr Cache::load(const std::string &filename)
 {
-    // TODO: normalize file path to make sure we're not loading the same file twice
+    std::string key = normalize (filename);
 
-    LoadedMap::iterator it = mLoadedMap.find(filename);
-    if (it != mLoadedMap.end())
-        return it->second;
-    else
     {
-        NIFFilePtr file(new Nif::NIFFile(filename));
-        mLoadedMap[filename] = file;
-        return file;
+        boost::mutex::scoped_lock lock (mMutex);
+
+        LoadedMap::iterator it = mLoadedMap.find(key);
+        if (it != mLoadedMap.end() && it->second.mLoading)
+        {
+            ++mStats.mWaits;
+            ++it->second.mWaiters;
+
+            // Other threads change the map while we wait, so look the file up again each time
+            do
+            {
+                mLoaded.wait (lock);
+                it = mLoadedMap.find (key);
+            }
+            while (it != mLoadedMap.end() && it->second.mLoading);
+
+            if (it != mLoadedMap.end())
+                --it->second.mWaiters;
+        }
+
+        if (it != mLoadedMap.end())
+        {
+            if (!it->second.mError.empty())
+            {
+                // Don't keep failures around, so that the next load() tries again. The last of
+                // the threads that waited for the file removes it.
+                std::string error = it->second.mError;
+                if (it->second.mWaiters==0)
+                    mLoadedMap.erase (it);
+                ++mStats.mMisses;
+                throw std::runtime_error (error);
+            }
+
+            if (it->second.mPrefetched)
+            {
+                it->second.mPrefetched = false;
+                mPrefetchedMemory -= it->second.mFile->getFileSize();
+            }
+
+            ++mStats.mHits;
+            touch (it);
+            return it->second.mFile;
+        }
+
+        ++mStats.mMisses;
+    }
+
+    NIFFilePtr file(new Nif::NIFFile(filename));
+
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+
+        // Only this thread inserts files that are not loading in the background
+        LoadedMap::iterator it = mLoadedMap.insert (std::make_pair (key, Entry())).first;
+        insert (it, file);
+    }
+
+    return file;
+}
+
+bool Cache::isLoading (const std::string& filename) const
+{
+    boost::mutex::scoped_lock lock (mMutex);
+
+    LoadedMap::const_iterator iter = mLoadedMap.find (normalize (filename));
+    return iter!=mLoadedMap.end() && iter->second.mLoading;
+}
+
+Cache::Stats Cache::getStats() const
+{
+    boost::mutex::scoped_lock lock (mMutex);
+    return mStats;
+}
+
+void Cache::touch (LoadedMap::iterator iter)
+{
+    mUsed.splice (mUsed.begin(), mUsed, iter->second.mUsed);
+}
+
+void Cache::insert (LoadedMap::iterator iter, NIFFilePtr file)
+{
+    iter->second.mFile = file;
+    iter->second.mUsed = mUsed.insert (mUsed.begin(), iter->first);
+
+    mStats.mMemoryUsage += file->getFileSize();
+    ++mStats.mFiles;
+
+    evict();
+}
+
+void Cache::evict()
+{
+    if (mMemoryBudget==0)
+        return;
+
+    std::list<std::string>::iterator iter = mUsed.end();
+
+    while (mStats.mMemoryUsage>mMemoryBudget && iter!=mUsed.begin())
+    {
+        --iter;
+
+        LoadedMap::iterator entry = mLoadedMap.find (*iter);
+
+        // Only the cache can hand out new references, so a file that is unique here stays unused
+        if (!entry->second.mFile.unique() || entry->second.mWaiters>0)
+            continue;
+
+        // Files loaded in the background are about to be used, unless there are too many of them
+        if (entry->second.mPrefetched && mPrefetchedMemory<=mMemoryBudget)
+            continue;
+
+        if (entry->second.mPrefetched)
+            mPrefetchedMemory -= entry->second.mFile->getFileSize();
+
+        mStats.mMemoryUsage -= entry->second.mFile->getFileSize();
+        --mStats.mFiles;
+        ++mStats.mEvictions;
+
+        mLoadedMap.erase (entry);
+        iter = mUsed.erase (iter);
     }
 }
 
@@ -4,8 +4,17 @@
 #include <components/nif/niffile.hpp>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include <map>
+#include <list>
+#include <memory>
+
+namespace Misc
+{
+    class ThreadPool;
+}
 
 namespace Nif
 {
@@ -16,12 +25,37 @@ namespace Nif
     class Cache
     {
     public:
+        struct Stats
+        {
+            size_t mHits; ///< load() calls served from the cache, including files loaded in the background
+            size_t mMisses; ///< load() calls that had to parse the file themselves
+            size_t mWaits; ///< load() calls that had to wait for a file still being loaded in the background
+            size_t mInFlight; ///< files currently queued or being loaded in the background
+            size_t mEvictions; ///< files unloaded to stay within the memory budget
+            size_t mFiles; ///< files currently in the cache
+            size_t mMemoryUsage; ///< estimated memory used by the files in the cache, in bytes
+        };
+
         Cache();
 
+        /// Waits for the worker threads to finish the file they are currently loading.
+        ~Cache();
+
+        /// Start \a threads worker threads for background loading. 0 disables background loading.
+        /// @note Must not be called while files are loading in the background.
+        void setThreads (unsigned int threads);
+
+        /// Files that are not referenced outside of the cache are unloaded, least recently used
+        /// first, while the cache uses more than \a bytes. 0 disables unloading.
+        /// @note Files loaded in the background are kept until load() picks them up, unless those
+        ///       files alone take up more than the budget.
+        void setMemoryBudget (size_t bytes);
+
         /// Queue this file for background loading. A worker thread will start loading the file.
         /// To get the loaded NIFFilePtr, use the load method, which will wait until the worker thread is finished
         /// and then return the loaded file.
-        //void loadInBackground (const std::string& file);
+        /// @note Does nothing if the file is already loaded or there are no worker threads.
+        void loadInBackground (const std::string& file);
 
         /// Read and parse the given file. May retrieve from cache if this file has been used previously.
         /// @note If the file is currently loading in the background, this function will block until
@@ -30,6 +64,11 @@ namespace Nif
         ///       When all external SharedPtrs to a file are released, the cache may decide to unload the file.
         NIFFilePtr load (const std::string& filename);
 
+        /// Is this file queued or being loaded in the background, so that load() would block?
+        bool isLoading (const std::string& filename) const;
+
+        Stats getStats() const;
+
         /// Return instance of this class.
         static Cache& getInstance();
         static Cache* getInstancePtr();
@@ -40,9 +79,55 @@ namespace Nif
         Cache(const Cache&);
         Cache& operator =(const Cache&);
 
-        typedef std::map<std::string, NIFFilePtr> LoadedMap;
+        struct Entry
+        {
+            NIFFilePtr mFile;
+            /// Stream to load the file from in the background, opened by the main thread
+            Ogre::DataStreamPtr mStream;
+            bool mLoading;
+            /// Loaded in the background and not returned by load() yet
+            bool mPrefetched;
+            /// Threads waiting in load() for the file, which must not be unloaded meanwhile
+            int mWaiters;
+            /// Error message, if loading in the background failed
+            std::string mError;
+            std::list<std::string>::iterator mUsed;
+
+            Entry() : mLoading (false), mPrefetched (false), mWaiters (0) {}
+        };
+
+        typedef std::map<std::string, Entry> LoadedMap;
+
+        /// Lower case with forward slashes, so that all spellings of a file share an entry
+        static std::string normalize (const std::string& filename);
+
+        /// Called by the worker threads.
+        void loadJob (const std::string& key, const std::string& filename);
+
+        /// Mark a loaded file as most recently used.
+        void touch (LoadedMap::iterator iter);
+
+        /// Add a loaded file to the memory usage and unload unused files if over budget.
+        /// @note Must be called with mMutex locked.
+        void insert (LoadedMap::iterator iter, NIFFilePtr file);
+
+        void evict();
 
         LoadedMap mLoadedMap;
+
+        /// Keys of all loaded files, most recently used first
+        std::list<std::string> mUsed;
+
+        size_t mMemoryBudget;
+        /// Memory used by files with Entry::mPrefetched
+        size_t mPrefetchedMemory;
+        bool mStopping;
+        Stats mStats;
+
+        mutable boost::mutex mMutex;
+        boost::condition_variable mLoaded;
+
+        std::auto_ptr<Misc::ThreadPool> mWorkers;
     };
 
 }
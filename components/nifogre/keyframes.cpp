@@ -0,0 +1,272 @@
+#include "keyframes.hpp"
+
+#include <map>
+#include <algorithm>
+#include <cassert>
+
+#include <boost/weak_ptr.hpp>
+
+namespace NifOgre
+{
+
+KeyframeTrack::KeyframeTrack()
+  : mComponents(0)
+{ }
+
+void KeyframeTrack::compile(const Nif::FloatKeyMap::MapType &keys)
+{
+    mComponents = 1;
+    mTimes.reserve(keys.size());
+    mValues[0].reserve(keys.size());
+
+    for(Nif::FloatKeyMap::MapType::const_iterator it = keys.begin();it != keys.end();++it)
+    {
+        mTimes.push_back(it->first);
+        mValues[0].push_back(it->second.mValue);
+    }
+}
+
+void KeyframeTrack::compile(const Nif::Vector3KeyMap::MapType &keys)
+{
+    mComponents = 3;
+    mTimes.reserve(keys.size());
+    for(size_t i = 0;i < mComponents;i++)
+        mValues[i].reserve(keys.size());
+
+    for(Nif::Vector3KeyMap::MapType::const_iterator it = keys.begin();it != keys.end();++it)
+    {
+        mTimes.push_back(it->first);
+        for(size_t i = 0;i < mComponents;i++)
+            mValues[i].push_back(it->second.mValue[i]);
+    }
+}
+
+void KeyframeTrack::compile(const Nif::QuaternionKeyMap::MapType &keys)
+{
+    mComponents = 4;
+    mTimes.reserve(keys.size());
+    for(size_t i = 0;i < mComponents;i++)
+        mValues[i].reserve(keys.size());
+
+    for(Nif::QuaternionKeyMap::MapType::const_iterator it = keys.begin();it != keys.end();++it)
+    {
+        mTimes.push_back(it->first);
+        for(size_t i = 0;i < mComponents;i++)
+            mValues[i].push_back(it->second.mValue[i]);
+    }
+}
+
+size_t KeyframeTrack::findKey(float time, size_t cursor) const
+{
+    const size_t count = mTimes.size();
+
+    // Try the key of the last sample and the few after it, then give up and search
+    if(cursor > 0 && cursor < count && mTimes[cursor-1] < time)
+    {
+        size_t end = std::min(count, cursor+4);
+        for(;cursor < end;cursor++)
+        {
+            if(time <= mTimes[cursor])
+                return cursor;
+        }
+    }
+
+    return std::lower_bound(mTimes.begin()+1, mTimes.end(), time) - mTimes.begin();
+}
+
+void KeyframeTrack::sample(float time, size_t &cursor, float *values) const
+{
+    assert(!mTimes.empty());
+
+    const size_t last = mTimes.size()-1;
+
+    if(time <= mTimes[0])
+    {
+        for(size_t i = 0;i < mComponents;i++)
+            values[i] = mValues[i][0];
+        return;
+    }
+    if(time > mTimes[last])
+    {
+        for(size_t i = 0;i < mComponents;i++)
+            values[i] = mValues[i][last];
+        return;
+    }
+
+    size_t key = cursor = findKey(time, cursor);
+
+    float a = (time - mTimes[key-1]) / (mTimes[key] - mTimes[key-1]);
+    for(size_t i = 0;i < mComponents;i++)
+        values[i] = mValues[i][key-1] + ((mValues[i][key] - mValues[i][key-1]) * a);
+}
+
+
+KeyframeTracks::Cursor::Cursor()
+{
+    std::fill(mKeys, mKeys+Track_Count, 0);
+}
+
+KeyframeTracksPtr KeyframeTracks::get(const Nif::NIFFilePtr &nif, const Nif::NiKeyframeData *data)
+{
+    typedef std::map<const Nif::NiKeyframeData*, boost::weak_ptr<const KeyframeTracks> > Cache;
+    static Cache sCache;
+
+    Cache::iterator iter = sCache.find(data);
+    if(iter != sCache.end())
+    {
+        KeyframeTracksPtr tracks = iter->second.lock();
+        if(tracks)
+            return tracks;
+    }
+
+    // The data of expired entries may have been unloaded, and its address reused
+    for(Cache::iterator it = sCache.begin();it != sCache.end();)
+    {
+        if(it->second.expired())
+            sCache.erase(it++);
+        else
+            ++it;
+    }
+
+    KeyframeTracksPtr tracks(new KeyframeTracks(nif, data));
+    sCache[data] = tracks;
+    return tracks;
+}
+
+KeyframeTracks::KeyframeTracks(const Nif::NIFFilePtr &nif, const Nif::NiKeyframeData *data)
+  : mNif(nif)
+{
+    mTracks[Track_Rotation].compile(data->mRotations.mKeys);
+    mTracks[Track_XRotation].compile(data->mXRotations.mKeys);
+    mTracks[Track_YRotation].compile(data->mYRotations.mKeys);
+    mTracks[Track_ZRotation].compile(data->mZRotations.mKeys);
+    mTracks[Track_Translation].compile(data->mTranslations.mKeys);
+    mTracks[Track_Scale].compile(data->mScales.mKeys);
+
+    mXYZRotation = !mTracks[Track_XRotation].empty() || !mTracks[Track_YRotation].empty() ||
+                   !mTracks[Track_ZRotation].empty();
+}
+
+Ogre::Quaternion KeyframeTracks::getRotation(float time, Cursor &cursor) const
+{
+    if(!mTracks[Track_Rotation].empty())
+    {
+        // Same as Ogre::Quaternion::nlerp
+        Ogre::Quaternion rot;
+        mTracks[Track_Rotation].sample(time, cursor.mKeys[Track_Rotation], rot.ptr());
+        rot.normalise();
+        return rot;
+    }
+
+    float xyz[3] = { 0.0f, 0.0f, 0.0f };
+    for(int i = 0;i < 3;i++)
+    {
+        const KeyframeTrack &track = mTracks[Track_XRotation+i];
+        if(!track.empty())
+            track.sample(time, cursor.mKeys[Track_XRotation+i], &xyz[i]);
+    }
+    Ogre::Quaternion xr(Ogre::Radian(xyz[0]), Ogre::Vector3::UNIT_X);
+    Ogre::Quaternion yr(Ogre::Radian(xyz[1]), Ogre::Vector3::UNIT_Y);
+    Ogre::Quaternion zr(Ogre::Radian(xyz[2]), Ogre::Vector3::UNIT_Z);
+    return (zr*yr*xr);
+}
+
+Ogre::Vector3 KeyframeTracks::getTranslation(float time, Cursor &cursor) const
+{
+    Ogre::Vector3 pos;
+    mTracks[Track_Translation].sample(time, cursor.mKeys[Track_Translation], pos.ptr());
+    return pos;
+}
+
+Ogre::Real KeyframeTracks::getScale(float time, Cursor &cursor) const
+{
+    Ogre::Real scale;
+    mTracks[Track_Scale].sample(time, cursor.mKeys[Track_Scale], &scale);
+    return scale;
+}
+
+
+KeyframeValue::KeyframeValue(Ogre::Node *target, const Nif::NIFFilePtr& nif, const Nif::NiKeyframeData *data)
+  : NodeTargetValue<Ogre::Real>(target)
+  , mTracks(KeyframeTracks::get(nif, data))
+{ }
+
+Ogre::Quaternion KeyframeValue::getRotation(float time) const
+{
+    if(mTracks->hasRotation())
+        return mTracks->getRotation(time, mCursor);
+    return mNode->getOrientation();
+}
+
+Ogre::Vector3 KeyframeValue::getTranslation(float time) const
+{
+    if(mTracks->hasTranslation())
+        return mTracks->getTranslation(time, mCursor);
+    return mNode->getPosition();
+}
+
+Ogre::Vector3 KeyframeValue::getScale(float time) const
+{
+    if(mTracks->hasScale())
+        return Ogre::Vector3(mTracks->getScale(time, mCursor));
+    return mNode->getScale();
+}
+
+void KeyframeValue::setValue(Ogre::Real time)
+{
+    if(mTracks->hasRotation())
+        mNode->setOrientation(mTracks->getRotation(time, mCursor));
+    if(mTracks->hasTranslation())
+        mNode->setPosition(mTracks->getTranslation(time, mCursor));
+    if(mTracks->hasScale())
+        mNode->setScale(Ogre::Vector3(mTracks->getScale(time, mCursor)));
+}
+
+
+void KeyframePose::add(const Ogre::Controller<Ogre::Real> &ctrl)
+{
+    // Loader::createKfControllers only creates KeyframeValues
+    const KeyframeValue *value = static_cast<const KeyframeValue*>(ctrl.getDestination().getPointer());
+
+    mNodes.push_back(value->getNode());
+    mTracks.push_back(value->getTracks());
+    mFunctions.push_back(ctrl.getFunction());
+    mCursors.push_back(KeyframeTracks::Cursor());
+
+    mRotations.resize(mNodes.size());
+    mTranslations.resize(mNodes.size());
+    mScales.resize(mNodes.size());
+}
+
+void KeyframePose::update(Ogre::Real time)
+{
+    const size_t count = mNodes.size();
+
+    for(size_t i = 0;i < count;i++)
+    {
+        const KeyframeTracks &tracks = *mTracks[i];
+        Ogre::Real t = mFunctions[i].isNull() ? time : mFunctions[i]->calculate(time);
+
+        if(tracks.hasRotation())
+            mRotations[i] = tracks.getRotation(t, mCursors[i]);
+        if(tracks.hasTranslation())
+            mTranslations[i] = tracks.getTranslation(t, mCursors[i]);
+        if(tracks.hasScale())
+            mScales[i] = tracks.getScale(t, mCursors[i]);
+    }
+
+    for(size_t i = 0;i < count;i++)
+    {
+        const KeyframeTracks &tracks = *mTracks[i];
+        Ogre::Node *node = mNodes[i];
+
+        if(tracks.hasRotation())
+            node->setOrientation(mRotations[i]);
+        if(tracks.hasTranslation())
+            node->setPosition(mTranslations[i]);
+        if(tracks.hasScale())
+            node->setScale(Ogre::Vector3(mScales[i]));
+    }
+}
+
+}
@@ -0,0 +1,158 @@
+#ifndef COMPONENTS_NIFOGRE_KEYFRAMES_H
+#define COMPONENTS_NIFOGRE_KEYFRAMES_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <OgreController.h>
+#include <OgreQuaternion.h>
+#include <OgreVector3.h>
+
+#include <components/nif/data.hpp>
+#include <components/nifcache/nifcache.hpp>
+
+#include "ogrenifloader.hpp"
+
+namespace NifOgre
+{
+
+/// A key track, with the key times and each component of the key values in arrays of their own.
+///
+/// Sampling keeps a cursor on the last key it used. Animations mostly play forward, so the next
+/// sample finds its keys at the cursor or right after it instead of searching the whole track.
+class KeyframeTrack
+{
+public:
+    KeyframeTrack();
+
+    void compile(const Nif::FloatKeyMap::MapType &keys);
+    void compile(const Nif::Vector3KeyMap::MapType &keys);
+    /// Components are stored in w, x, y, z order.
+    void compile(const Nif::QuaternionKeyMap::MapType &keys);
+
+    bool empty() const
+    { return mTimes.empty(); }
+
+    /// Interpolate the key values linearly at \a time, like ValueInterpolator::interpKey.
+    /// @param cursor Key found by the previous sample of the same user (0 to start)
+    /// @param values Receives one float per component
+    void sample(float time, size_t &cursor, float *values) const;
+
+private:
+    std::vector<float> mTimes;
+    std::vector<float> mValues[4];
+    size_t mComponents;
+
+    /// Find the key i with mTimes[i-1] < time <= mTimes[i], starting at \a cursor.
+    size_t findKey(float time, size_t cursor) const;
+};
+
+/// The key tracks of a NiKeyframeData, compiled once and shared by all skeletons using them.
+class KeyframeTracks
+{
+public:
+    enum Track
+    {
+        Track_Rotation,
+        Track_XRotation,
+        Track_YRotation,
+        Track_ZRotation,
+        Track_Translation,
+        Track_Scale,
+        Track_Count
+    };
+
+    /// Keys last used by one user of the tracks
+    struct Cursor
+    {
+        size_t mKeys[Track_Count];
+
+        Cursor();
+    };
+
+    /// Get the compiled tracks of \a data, which belongs to \a nif. The tracks are shared for as
+    /// long as anything is using them.
+    /// @note Not thread-safe, like the rest of the loader.
+    static boost::shared_ptr<const KeyframeTracks> get(const Nif::NIFFilePtr &nif,
+                                                       const Nif::NiKeyframeData *data);
+
+    KeyframeTracks(const Nif::NIFFilePtr &nif, const Nif::NiKeyframeData *data);
+
+    bool hasRotation() const
+    { return !mTracks[Track_Rotation].empty() || mXYZRotation; }
+    bool hasTranslation() const
+    { return !mTracks[Track_Translation].empty(); }
+    bool hasScale() const
+    { return !mTracks[Track_Scale].empty(); }
+
+    /// @note Only valid if there is a rotation, and so on.
+    Ogre::Quaternion getRotation(float time, Cursor &cursor) const;
+    Ogre::Vector3 getTranslation(float time, Cursor &cursor) const;
+    Ogre::Real getScale(float time, Cursor &cursor) const;
+
+private:
+    KeyframeTrack mTracks[Track_Count];
+    bool mXYZRotation;
+    Nif::NIFFilePtr mNif; // Hold a SharedPtr to make sure the data stays in the cache
+};
+
+typedef boost::shared_ptr<const KeyframeTracks> KeyframeTracksPtr;
+
+/// Controller value for the bone animated by a NiKeyframeController
+class KeyframeValue : public NodeTargetValue<Ogre::Real>
+{
+    KeyframeTracksPtr mTracks;
+    mutable KeyframeTracks::Cursor mCursor;
+
+public:
+    /// @note The NiKeyFrameData must belong to \a nif.
+    KeyframeValue(Ogre::Node *target, const Nif::NIFFilePtr& nif, const Nif::NiKeyframeData *data);
+
+    const KeyframeTracksPtr &getTracks() const
+    { return mTracks; }
+
+    virtual Ogre::Quaternion getRotation(float time) const;
+    virtual Ogre::Vector3 getTranslation(float time) const;
+    virtual Ogre::Vector3 getScale(float time) const;
+
+    virtual Ogre::Real getValue() const
+    {
+        // Should not be called
+        return 0.0f;
+    }
+
+    virtual void setValue(Ogre::Real time);
+};
+
+/// Evaluates the keyframe controllers of a skeleton that share an animation time in one pass.
+///
+/// All tracks are sampled first, into an array per transformation, then all bones are updated
+/// from those arrays, instead of alternating between key data and bones for each controller.
+class KeyframePose
+{
+public:
+    /// Add a controller created by Loader::createKfControllers. The pose keeps its function,
+    /// the source is passed to update.
+    void add(const Ogre::Controller<Ogre::Real> &ctrl);
+
+    bool empty() const
+    { return mNodes.empty(); }
+
+    /// Same as updating each of the controllers from a source with the value \a time.
+    void update(Ogre::Real time);
+
+private:
+    std::vector<Ogre::Node*> mNodes;
+    std::vector<KeyframeTracksPtr> mTracks;
+    std::vector<Ogre::ControllerFunctionRealPtr> mFunctions;
+    std::vector<KeyframeTracks::Cursor> mCursors;
+
+    std::vector<Ogre::Quaternion> mRotations;
+    std::vector<Ogre::Vector3> mTranslations;
+    std::vector<Ogre::Real> mScales;
+};
+
+}
+
+#endif
@@ -53,6 +53,7 @@
 #include "material.hpp"
 #include "mesh.hpp"
 #include "controller.hpp"
+#include "keyframes.hpp"
 #include "particles.hpp"
 
 namespace
@@ -438,109 +439,7 @@ public:
 class KeyframeController
 {
 public:
-    class Value : public NodeTargetValue<Ogre::Real>, public ValueInterpolator
-    {
-    private:
-        const Nif::QuaternionKeyMap* mRotations;
-        const Nif::FloatKeyMap* mXRotations;
-        const Nif::FloatKeyMap* mYRotations;
-        const Nif::FloatKeyMap* mZRotations;
-        const Nif::Vector3KeyMap* mTranslations;
-        const Nif::FloatKeyMap* mScales;
-        Nif::NIFFilePtr mNif; // Hold a SharedPtr to make sure key lists stay valid
-
-        using ValueInterpolator::interpKey;
-
-        static Ogre::Quaternion interpKey(const Nif::QuaternionKeyMap::MapType &keys, float time)
-        {
-            if(time <= keys.begin()->first)
-                return keys.begin()->second.mValue;
-
-            Nif::QuaternionKeyMap::MapType::const_iterator it = keys.lower_bound(time);
-            if (it != keys.end())
-            {
-                float aTime = it->first;
-                const Nif::QuaternionKey* aKey = &it->second;
-
-                assert (it != keys.begin()); // Shouldn't happen, was checked at beginning of this function
-
-                Nif::QuaternionKeyMap::MapType::const_iterator last = --it;
-                float aLastTime = last->first;
-                const Nif::QuaternionKey* aLastKey = &last->second;
-
-                float a = (time - aLastTime) / (aTime - aLastTime);
-                return Ogre::Quaternion::nlerp(a, aLastKey->mValue, aKey->mValue);
-            }
-            else
-                return keys.rbegin()->second.mValue;
-        }
-
-        Ogre::Quaternion getXYZRotation(float time) const
-        {
-            float xrot = interpKey(mXRotations->mKeys, time);
-            float yrot = interpKey(mYRotations->mKeys, time);
-            float zrot = interpKey(mZRotations->mKeys, time);
-            Ogre::Quaternion xr(Ogre::Radian(xrot), Ogre::Vector3::UNIT_X);
-            Ogre::Quaternion yr(Ogre::Radian(yrot), Ogre::Vector3::UNIT_Y);
-            Ogre::Quaternion zr(Ogre::Radian(zrot), Ogre::Vector3::UNIT_Z);
-            return (zr*yr*xr);
-        }
-
-    public:
-        /// @note The NiKeyFrameData must be valid as long as this KeyframeController exists.
-        Value(Ogre::Node *target, const Nif::NIFFilePtr& nif, const Nif::NiKeyframeData *data)
-          : NodeTargetValue<Ogre::Real>(target)
-          , mRotations(&data->mRotations)
-          , mXRotations(&data->mXRotations)
-          , mYRotations(&data->mYRotations)
-          , mZRotations(&data->mZRotations)
-          , mTranslations(&data->mTranslations)
-          , mScales(&data->mScales)
-          , mNif(nif)
-        { }
-
-        virtual Ogre::Quaternion getRotation(float time) const
-        {
-            if(mRotations->mKeys.size() > 0)
-                return interpKey(mRotations->mKeys, time);
-            else if (!mXRotations->mKeys.empty() || !mYRotations->mKeys.empty() || !mZRotations->mKeys.empty())
-                return getXYZRotation(time);
-            return mNode->getOrientation();
-        }
-
-        virtual Ogre::Vector3 getTranslation(float time) const
-        {
-            if(mTranslations->mKeys.size() > 0)
-                return interpKey(mTranslations->mKeys, time);
-            return mNode->getPosition();
-        }
-
-        virtual Ogre::Vector3 getScale(float time) const
-        {
-            if(mScales->mKeys.size() > 0)
-                return Ogre::Vector3(interpKey(mScales->mKeys, time));
-            return mNode->getScale();
-        }
-
-        virtual Ogre::Real getValue() const
-        {
-            // Should not be called
-            return 0.0f;
-        }
-
-        virtual void setValue(Ogre::Real time)
-        {
-            if(mRotations->mKeys.size() > 0)
-                mNode->setOrientation(interpKey(mRotations->mKeys, time));
-            else if (!mXRotations->mKeys.empty() || !mYRotations->mKeys.empty() || !mZRotations->mKeys.empty())
-                mNode->setOrientation(getXYZRotation(time));
-            if(mTranslations->mKeys.size() > 0)
-                mNode->setPosition(interpKey(mTranslations->mKeys, time));
-            if(mScales->mKeys.size() > 0)
-                mNode->setScale(Ogre::Vector3(interpKey(mScales->mKeys, time)));
-        }
-    };
-
+    typedef KeyframeValue Value;
     typedef DefaultFunction Function;
 };
 
@@ -228,6 +228,13 @@ namespace Terrain
         target->getBuffer()->blit(mCompositeMapRenderTexture->getBuffer());
     }
 
+    void DefaultWorld::readCompositeMap(std::vector<Ogre::uint8>& data)
+    {
+        Ogre::HardwarePixelBufferSharedPtr buffer = mCompositeMapRenderTexture->getBuffer();
+        data.resize(buffer->getWidth()*buffer->getHeight()*Ogre::PixelUtil::getNumElemBytes(Ogre::PF_A8B8G8R8));
+        buffer->blitToMemory(Ogre::PixelBox(buffer->getWidth(), buffer->getHeight(), 1, Ogre::PF_A8B8G8R8, &data[0]));
+    }
+
     void DefaultWorld::clearCompositeMapSceneManager()
     {
         mCompositeMapSceneMgr->destroyAllManualObjects();
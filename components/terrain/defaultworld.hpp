@@ -128,6 +128,8 @@ namespace Terrain
         // Delete all quads
         void clearCompositeMapSceneManager();
         void renderCompositeMap (Ogre::TexturePtr target);
+        // Copy the texels of the last rendered composite map into \a data (PF_A8B8G8R8)
+        void readCompositeMap (std::vector<Ogre::uint8>& data);
 
         // Adds a WorkQueue request to load a chunk for this node in the background.
         void queueLoad (QuadTreeNode* node);
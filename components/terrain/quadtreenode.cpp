@@ -26,6 +26,9 @@
 #include <OgreSceneNode.h>
 #include <OgreMaterialManager.h>
 #include <OgreTextureManager.h>
+#include <OgreHardwarePixelBuffer.h>
+
+#include <components/misc/hash.hpp>
 
 #include "defaultworld.hpp"
 #include "chunk.hpp"
@@ -37,6 +40,16 @@ using namespace Terrain;
 
 namespace
 {
+    using Misc::addHash;
+
+    void addHash (uint64_t& hash, const LayerInfo& layer)
+    {
+        addHash (hash, layer.mDiffuseMap);
+        addHash (hash, layer.mNormalMap);
+        addHash (hash, layer.mParallax);
+        addHash (hash, layer.mSpecular);
+    }
+
     int Log2( int n )
     {
         assert(n > 0);
@@ -145,6 +158,7 @@ QuadTreeNode::QuadTreeNode(DefaultWorld* terrain, ChildDirection dir, float size
     , mParent(parent)
     , mChunk(NULL)
     , mTerrain(terrain)
+    , mLayerHash(Misc::sHashSeed)
 {
     mBounds.setNull();
     for (int i=0; i<4; ++i)
@@ -486,9 +500,17 @@ void QuadTreeNode::loadLayers(const LayerCollection& collection)
 {
     assert (!mMaterialGenerator->hasLayers());
 
+    for (std::vector<LayerInfo>::const_iterator it = collection.mLayers.begin(); it != collection.mLayers.end(); ++it)
+        addHash(mLayerHash, *it);
+
     std::vector<Ogre::TexturePtr> blendTextures;
     for (std::vector<Ogre::PixelBox>::const_iterator it = collection.mBlendmaps.begin(); it != collection.mBlendmaps.end(); ++it)
     {
+        addHash(mLayerHash, it->getWidth());
+        addHash(mLayerHash, it->getHeight());
+        addHash(mLayerHash, it->format);
+        addHash(mLayerHash, it->data, it->getWidth()*it->getHeight()*Ogre::PixelUtil::getNumElemBytes(it->format));
+
         // TODO: clean up blend textures on destruction
         static int count=0;
         Ogre::TexturePtr map = Ogre::TextureManager::getSingleton().createManual("terrain/blend/"
@@ -585,6 +607,21 @@ void QuadTreeNode::ensureCompositeMap()
                 name.str(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
         Ogre::TEX_TYPE_2D, size, size, Ogre::MIP_DEFAULT, Ogre::PF_A8B8G8R8);
 
+    // The composite map only depends on the layers of the cells it covers, so a map rendered in
+    // an earlier session can be reused as long as none of them changed.
+    Storage* storage = mTerrain->getStorage();
+    uint64_t hash = getCompositeMapHash();
+    addHash(hash, mTerrain->getShadersEnabled());
+    addHash(hash, size);
+    std::vector<Ogre::uint8> data;
+
+    if (storage->readCompositeMap(hash, data)
+        && data.size() == size*size*Ogre::PixelUtil::getNumElemBytes(Ogre::PF_A8B8G8R8))
+    {
+        mCompositeMap->getBuffer()->blitFromMemory(Ogre::PixelBox(size, size, 1, Ogre::PF_A8B8G8R8, &data[0]));
+        return;
+    }
+
     // Create quads for each cell
     prepareForCompositeMap(Ogre::TRect<float>(0,0,1,1));
 
@@ -592,6 +629,29 @@ void QuadTreeNode::ensureCompositeMap()
 
     mTerrain->clearCompositeMapSceneManager();
 
+    mTerrain->readCompositeMap(data);
+    storage->writeCompositeMap(hash, data);
+}
+
+uint64_t QuadTreeNode::getCompositeMapHash()
+{
+    uint64_t hash = Misc::sHashSeed;
+
+    if (mIsDummy)
+    {
+        addHash(hash, mTerrain->getStorage()->getDefaultLayer());
+    }
+    else if (mSize > 1)
+    {
+        assert(hasChildren());
+
+        for (int i=0; i<4; ++i)
+            addHash(hash, mChildren[i]->getCompositeMapHash());
+    }
+    else
+        hash = mLayerHash;
+
+    return hash;
 }
 
 void QuadTreeNode::applyMaterials()
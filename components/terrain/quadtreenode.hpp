@@ -22,6 +22,8 @@
 #ifndef COMPONENTS_TERRAIN_QUADTREENODE_H
 #define COMPONENTS_TERRAIN_QUADTREENODE_H
 
+#include <stdint.h>
+
 #include <OgreAxisAlignedBox.h>
 #include <OgreVector2.h>
 #include <OgreTexture.h>
@@ -181,7 +183,13 @@ namespace Terrain
 
         Ogre::TexturePtr mCompositeMap;
 
+        // Hash of the layers and blendmaps passed to loadLayers
+        uint64_t mLayerHash;
+
         void ensureCompositeMap();
+
+        /// Get a hash of everything the composite map of this node is rendered from.
+        uint64_t getCompositeMapHash();
     };
 
 }
@@ -95,6 +95,18 @@ namespace Terrain
 
         virtual LayerInfo getDefaultLayer() = 0;
 
+        /// Retrieve a composite map kept by writeCompositeMap.
+        /// @note The default implementation doesn't keep any composite maps.
+        /// @param hash identifies the layers and blendmaps the composite map was rendered from
+        /// @param data texel data, will be resized to the size of the composite map
+        /// @return Was a composite map found?
+        virtual bool readCompositeMap (Ogre::uint64 hash, std::vector<Ogre::uint8>& data) { return false; }
+
+        /// Keep a rendered composite map, so that it doesn't have to be rendered again.
+        /// @param hash identifies the layers and blendmaps the composite map was rendered from
+        /// @param data texel data
+        virtual void writeCompositeMap (Ogre::uint64 hash, const std::vector<Ogre::uint8>& data) {}
+
         /// Get the transformation factor for mapping cell units to world units.
         virtual float getCellWorldSize() = 0;
 
@@ -4,13 +4,17 @@
 #include <btBulletCollisionCommon.h>
 #include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
 
+#include <algorithm>
+
 #include <boost/lexical_cast.hpp>
 #include <boost/format.hpp>
+#include <boost/bind.hpp>
 
 #include <OgreSceneManager.h>
 
 #include <components/nifbullet/bulletnifloader.hpp>
 #include <components/misc/stringops.hpp>
+#include <components/misc/threadpool.hpp>
 
 #include "BtOgrePG.h"
 #include "BtOgreGP.h"
@@ -67,6 +71,12 @@ void deleteShape(btCollisionShape* shape)
     }
 }
 
+// Name of the collision shape of a mesh at a scale. The shape loader takes the scale off the end again.
+std::string getShapeName(const std::string &mesh, float scale)
+{
+    return mesh + (boost::format("%07.3f") % scale).str();
+}
+
 }
 
 namespace OEngine {
@@ -220,6 +230,7 @@ namespace Physic
     RigidBody::RigidBody(btRigidBody::btRigidBodyConstructionInfo& CI,std::string name)
         : btRigidBody(CI)
         , mName(name)
+        , mObjectId(0)
         , mPlaceable(false)
     {
     }
@@ -440,8 +451,7 @@ namespace Physic
     void PhysicEngine::boxAdjustExternal(const std::string &mesh, RigidBody* body,
         float scale, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
+        std::string outputstring = getShapeName(mesh, scale);
 
         //get the shape from the .nif
         mShapeLoader->load(outputstring,"General");
@@ -451,12 +461,19 @@ namespace Physic
         adjustRigidBody(body, position, rotation, shape->mBoxTranslation * scale, shape->mBoxRotation);
     }
 
+    void PhysicEngine::preloadShape(const std::string &mesh, float scale)
+    {
+        std::string outputstring = getShapeName(mesh, scale);
+
+        mShapeLoader->load(outputstring,"General");
+        BulletShapeManager::getSingletonPtr()->load(outputstring,"General");
+    }
+
     RigidBody* PhysicEngine::createAndAdjustRigidBody(const std::string &mesh, const std::string &name,
         float scale, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation,
         Ogre::Vector3* scaledBoxTranslation, Ogre::Quaternion* boxRotation, bool raycasting, bool placeable)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
+        std::string outputstring = getShapeName(mesh, scale);
 
         //get the shape from the .nif
         mShapeLoader->load(outputstring,"General");
@@ -603,7 +620,7 @@ namespace Physic
     class ContactTestResultCallback : public btCollisionWorld::ContactResultCallback
     {
     public:
-        std::vector<std::string> mResult;
+        std::vector<const RigidBody*> mResult;
 
         // added in bullet 2.81
         // this is just a quick hack, as there does not seem to be a BULLET_VERSION macro?
@@ -615,7 +632,7 @@ namespace Physic
             const RigidBody* body = dynamic_cast<const RigidBody*>(colObj0Wrap->m_collisionObject);
             if (body && !(colObj0Wrap->m_collisionObject->getBroadphaseHandle()->m_collisionFilterGroup
                           & CollisionType_Raycasting))
-                mResult.push_back(body->mName);
+                mResult.push_back(body);
 
             return 0.f;
         }
@@ -626,7 +643,7 @@ namespace Physic
             const RigidBody* body = dynamic_cast<const RigidBody*>(col0);
             if (body && !(col0->getBroadphaseHandle()->m_collisionFilterGroup
                           & CollisionType_Raycasting))
-                mResult.push_back(body->mName);
+                mResult.push_back(body);
 
             return 0.f;
         }
@@ -635,7 +652,7 @@ namespace Physic
 
     class DeepestNotMeContactTestResultCallback : public btCollisionWorld::ContactResultCallback
     {
-        const std::string &mFilter;
+        const btCollisionObject *mFilter;
         // Store the real origin, since the shape's origin is its center
         btVector3 mOrigin;
 
@@ -644,7 +661,7 @@ namespace Physic
         btVector3 mContactPoint;
         btScalar mLeastDistSqr;
 
-        DeepestNotMeContactTestResultCallback(const std::string &filter, const btVector3 &origin)
+        DeepestNotMeContactTestResultCallback(const btCollisionObject *filter, const btVector3 &origin)
           : mFilter(filter), mOrigin(origin), mObject(0), mContactPoint(0,0,0),
             mLeastDistSqr(std::numeric_limits<float>::max())
         { }
@@ -655,7 +672,7 @@ namespace Physic
                                          const btCollisionObjectWrapper* col1Wrap,int partId1,int index1)
         {
             const RigidBody* body = dynamic_cast<const RigidBody*>(col1Wrap->m_collisionObject);
-            if(body && body->mName != mFilter)
+            if(body && body != mFilter)
             {
                 btScalar distsqr = mOrigin.distance2(cp.getPositionWorldOnA());
                 if(!mObject || distsqr < mLeastDistSqr)
@@ -674,7 +691,7 @@ namespace Physic
                                          const btCollisionObject* col1, int partId1, int index1)
         {
             const RigidBody* body = dynamic_cast<const RigidBody*>(col1);
-            if(body && body->mName != mFilter)
+            if(body && body != mFilter)
             {
                 btScalar distsqr = mOrigin.distance2(cp.getPositionWorldOnA());
                 if(!mObject || distsqr < mLeastDistSqr)
@@ -691,7 +708,7 @@ namespace Physic
     };
 
 
-    std::vector<std::string> PhysicEngine::getCollisions(const std::string& name, int collisionGroup, int collisionMask)
+    std::vector<const RigidBody*> PhysicEngine::getCollisions(const std::string& name, int collisionGroup, int collisionMask)
     {
         RigidBody* body = getRigidBody(name);
         if (!body) // fall back to raycasting body if there is no collision body
@@ -704,7 +721,7 @@ namespace Physic
     }
 
 
-    std::pair<const RigidBody*,btVector3> PhysicEngine::getFilteredContact(const std::string &filter,
+    std::pair<const RigidBody*,btVector3> PhysicEngine::getFilteredContact(const btCollisionObject *filter,
                                                                            const btVector3 &origin,
                                                                            btCollisionObject *object)
     {
@@ -765,9 +782,9 @@ namespace Physic
         }
     }
 
-    std::pair<std::string,float> PhysicEngine::rayTest(const btVector3 &from, const btVector3 &to, bool raycastingObjectOnly, bool ignoreHeightMap, Ogre::Vector3* normal)
+    std::pair<const RigidBody*,float> PhysicEngine::rayTest(const btVector3 &from, const btVector3 &to, bool raycastingObjectOnly, bool ignoreHeightMap, Ogre::Vector3* normal)
     {
-        std::string name = "";
+        const RigidBody* body = NULL;
         float d = -1;
 
         btCollisionWorld::ClosestRayResultCallback resultCallback1(from, to);
@@ -779,10 +796,10 @@ namespace Physic
 
         if(!ignoreHeightMap)
             resultCallback1.m_collisionFilterMask = resultCallback1.m_collisionFilterMask | CollisionType_HeightMap;
-        mDynamicsWorld->rayTest(from, to, resultCallback1);
+        rayTest(from, to, resultCallback1);
         if (resultCallback1.hasHit())
         {
-            name = static_cast<const RigidBody&>(*resultCallback1.m_collisionObject).mName;
+            body = static_cast<const RigidBody*>(resultCallback1.m_collisionObject);
             d = resultCallback1.m_closestHitFraction;
             if (normal)
                 *normal = Ogre::Vector3(resultCallback1.m_hitNormalWorld.x(),
@@ -790,7 +807,7 @@ namespace Physic
                                         resultCallback1.m_hitNormalWorld.z());
         }
 
-        return std::pair<std::string,float>(name,d);
+        return std::pair<const RigidBody*,float>(body,d);
     }
 
     // callback that ignores player in results
@@ -809,6 +826,154 @@ namespace Physic
         }
     };
 
+    namespace
+    {
+        class SweepAabbCallback : public btBroadphaseAabbCallback
+        {
+            const btConvexShape* mShape;
+            const btTransform& mFrom;
+            const btTransform& mTo;
+            btCollisionWorld::ConvexResultCallback& mResult;
+            btScalar mAllowedPenetration;
+
+        public:
+            SweepAabbCallback(const btConvexShape* shape, const btTransform& from, const btTransform& to,
+                              btCollisionWorld::ConvexResultCallback& result, btScalar allowedPenetration)
+                : mShape(shape), mFrom(from), mTo(to), mResult(result), mAllowedPenetration(allowedPenetration)
+            {}
+
+            virtual bool process(const btBroadphaseProxy* proxy)
+            {
+                // Nothing can be closer than a hit at the start
+                if (mResult.m_closestHitFraction == btScalar(0))
+                    return false;
+
+                btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+
+                if (mResult.needsCollision(object->getBroadphaseHandle()))
+                    btCollisionWorld::objectQuerySingle(mShape, mFrom, mTo, object, object->getCollisionShape(),
+                                                        object->getWorldTransform(), mResult, mAllowedPenetration);
+                return true;
+            }
+        };
+
+        class RayDbvtCallback : public btDbvt::ICollide
+        {
+            btTransform mFrom;
+            btTransform mTo;
+            btCollisionWorld::RayResultCallback& mResult;
+
+        public:
+            RayDbvtCallback(const btVector3& from, const btVector3& to, btCollisionWorld::RayResultCallback& result)
+                : mFrom(btMatrix3x3::getIdentity(), from), mTo(btMatrix3x3::getIdentity(), to), mResult(result)
+            {}
+
+            virtual void Process(const btDbvtNode* leaf)
+            {
+                if (mResult.m_closestHitFraction == btScalar(0))
+                    return;
+
+                btBroadphaseProxy* proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+                btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+
+                if (mResult.needsCollision(proxy))
+                    btCollisionWorld::rayTestSingle(mFrom, mTo, object, object->getCollisionShape(),
+                                                    object->getWorldTransform(), mResult);
+            }
+        };
+    }
+
+    void PhysicEngine::convexSweepTest (const btConvexShape* shape, const btTransform& from, const btTransform& to,
+                                        btCollisionWorld::ConvexResultCallback& callback) const
+    {
+        btVector3 fromMin, fromMax, toMin, toMax;
+        shape->getAabb(from, fromMin, fromMax);
+        shape->getAabb(to, toMin, toMax);
+        fromMin.setMin(toMin);
+        fromMax.setMax(toMax);
+
+        // Same as btCollisionWorld::convexSweepTest
+        SweepAabbCallback aabbCallback(shape, from, to, callback,
+                                       mDynamicsWorld->getDispatchInfo().m_allowedCcdPenetration);
+        broadphase->aabbTest(fromMin, fromMax, aabbCallback);
+    }
+
+    void PhysicEngine::rayTest (const btVector3& from, const btVector3& to, btCollisionWorld::RayResultCallback& callback) const
+    {
+        // btDbvt::rayTest keeps its traversal stack on the stack, unlike btDbvtBroadphase::rayTest
+        const btDbvtBroadphase* dbvt = static_cast<const btDbvtBroadphase*>(broadphase);
+
+        RayDbvtCallback dbvtCallback(from, to, callback);
+        btDbvt::rayTest(dbvt->m_sets[0].m_root, from, to, dbvtCallback);
+        btDbvt::rayTest(dbvt->m_sets[1].m_root, from, to, dbvtCallback);
+    }
+
+    void PhysicEngine::queryBatch (const std::vector<RayQuery>& queries, std::vector<RayQueryResult>& results,
+                                   Misc::ThreadPool *workers) const
+    {
+        results.clear();
+        results.resize(queries.size());
+
+        // Not worth handing out less than a few queries to a thread
+        const size_t minQueries = 8;
+
+        size_t ranges = workers ? std::min((queries.size() + minQueries - 1) / minQueries,
+                                           static_cast<size_t>(workers->getThreadCount() * 4)) : 1;
+
+        if (ranges > 1)
+        {
+            for (size_t i = 0; i < ranges; ++i)
+                workers->push(boost::bind(&PhysicEngine::runQueries, this, &queries, &results,
+                                          queries.size() * i / ranges, queries.size() * (i+1) / ranges));
+            workers->wait();
+        }
+        else
+            runQueries(&queries, &results, 0, queries.size());
+    }
+
+    void PhysicEngine::runQueries (const std::vector<RayQuery> *queries, std::vector<RayQueryResult> *results,
+                                   size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const RayQuery& query = (*queries)[i];
+            RayQueryResult& result = (*results)[i];
+
+            if (query.mRadius > 0)
+            {
+                btCollisionWorld::ClosestConvexResultCallback callback(query.mFrom, query.mTo);
+                callback.m_collisionFilterGroup = query.mGroup;
+                callback.m_collisionFilterMask = query.mMask;
+
+                btSphereShape shape(query.mRadius);
+                convexSweepTest(&shape, btTransform(btMatrix3x3::getIdentity(), query.mFrom),
+                                btTransform(btMatrix3x3::getIdentity(), query.mTo), callback);
+
+                if (callback.hasHit())
+                {
+                    result.mObject = static_cast<const RigidBody*>(callback.m_hitCollisionObject);
+                    result.mFraction = callback.m_closestHitFraction;
+                    result.mNormal = callback.m_hitNormalWorld;
+                }
+            }
+            else
+            {
+                btCollisionWorld::ClosestRayResultCallback callback(query.mFrom, query.mTo);
+                callback.m_collisionFilterGroup = query.mGroup;
+                callback.m_collisionFilterMask = query.mMask;
+
+                rayTest(query.mFrom, query.mTo, callback);
+
+                if (callback.hasHit())
+                {
+                    result.mObject = static_cast<const RigidBody*>(callback.m_collisionObject);
+                    result.mFraction = callback.m_closestHitFraction;
+                    result.mNormal = callback.m_hitNormalWorld;
+                }
+            }
+        }
+    }
+
     std::pair<bool, float> PhysicEngine::sphereCast (float radius, btVector3& from, btVector3& to)
     {
         OurClosestConvexResultCallback callback(from, to);
@@ -821,7 +986,7 @@ namespace Physic
         btTransform from_ (btrot, from);
         btTransform to_ (btrot, to);
 
-        mDynamicsWorld->convexSweepTest(&shape, from_, to_, callback);
+        convexSweepTest(&shape, from_, to_, callback);
 
         if (callback.hasHit())
             return std::make_pair(true, callback.m_closestHitFraction);
@@ -829,20 +994,21 @@ namespace Physic
             return std::make_pair(false, 1.0f);
     }
 
-    std::vector< std::pair<float, std::string> > PhysicEngine::rayTest2(const btVector3& from, const btVector3& to, int filterGroup)
+    std::vector< std::pair<float, const RigidBody*> > PhysicEngine::rayTest2(const btVector3& from, const btVector3& to, int filterGroup)
     {
         MyRayResultCallback resultCallback1;
         resultCallback1.m_collisionFilterGroup = filterGroup;
         resultCallback1.m_collisionFilterMask = CollisionType_Raycasting|CollisionType_Actor|CollisionType_HeightMap;
-        mDynamicsWorld->rayTest(from, to, resultCallback1);
+        rayTest(from, to, resultCallback1);
         std::vector< std::pair<float, const btCollisionObject*> > results = resultCallback1.results;
 
-        std::vector< std::pair<float, std::string> > results2;
+        std::vector< std::pair<float, const RigidBody*> > results2;
+        results2.reserve(results.size());
 
         for (std::vector< std::pair<float, const btCollisionObject*> >::iterator it=results.begin();
             it != results.end(); ++it)
         {
-            results2.push_back( std::make_pair( (*it).first, static_cast<const RigidBody&>(*(*it).second).mName ) );
+            results2.push_back( std::make_pair( (*it).first, static_cast<const RigidBody*>((*it).second) ) );
         }
 
         std::sort(results2.begin(), results2.end(), MyRayResultCallback::cmp);
@@ -852,8 +1018,7 @@ namespace Physic
 
     void PhysicEngine::getObjectAABB(const std::string &mesh, float scale, btVector3 &min, btVector3 &max)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
+        std::string outputstring = getShapeName(mesh, scale);
 
         mShapeLoader->load(outputstring, "General");
         BulletShapeManager::getSingletonPtr()->load(outputstring, "General");
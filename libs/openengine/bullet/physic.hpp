@@ -6,6 +6,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include "BulletShapeLoader.h"
 #include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
 #include <boost/shared_ptr.hpp>
@@ -33,6 +34,11 @@ namespace MWWorld
     class World;
 }
 
+namespace Misc
+{
+    class ThreadPool;
+}
+
 
 namespace OEngine {
 namespace Physic
@@ -63,6 +69,10 @@ namespace Physic
         virtual ~RigidBody();
         std::string mName;
 
+        /// ID of the game object this body belongs to, 0 if none. Not interpreted by the engine;
+        /// query results carry it, so that they can be resolved without going through mName.
+        int mObjectId;
+
         // Hack: placeable objects (that can be picked up by the player) have different collision behaviour.
         // This variable needs to be passed to BulletNifLoader.
         bool mPlaceable;
@@ -132,6 +142,17 @@ namespace Physic
             return mBody;
         }
 
+        /// \see RigidBody::mObjectId
+        void setObjectId(int id)
+        {
+            mBody->mObjectId = id;
+        }
+
+        int getObjectId() const
+        {
+            return mBody->mObjectId;
+        }
+
 
         /// Sets whether this actor should be able to collide with the water surface
         void setCanWaterWalk(bool waterWalk);
@@ -172,6 +193,29 @@ namespace Physic
     };
 
 
+    /// A ray or sphere sweep, see PhysicEngine::queryBatch
+    struct RayQuery
+    {
+        btVector3 mFrom;
+        btVector3 mTo;
+        float mRadius; ///< 0: ray, otherwise the radius of the sphere to sweep
+        int mGroup;
+        int mMask;
+
+        RayQuery (const btVector3& from, const btVector3& to, int mask, float radius = 0, int group = 0xff)
+        : mFrom (from), mTo (to), mRadius (radius), mGroup (group), mMask (mask) {}
+    };
+
+    /// Closest hit of a RayQuery
+    struct RayQueryResult
+    {
+        const RigidBody* mObject; ///< NULL, if nothing was hit
+        float mFraction; ///< 1, if nothing was hit
+        btVector3 mNormal;
+
+        RayQueryResult() : mObject (NULL), mFraction (1), mNormal (0, 0, 0) {}
+    };
+
     struct HeightField
     {
         btHeightfieldTerrainShape* mShape;
@@ -224,6 +268,12 @@ namespace Physic
          Mainly used to (but not limited to) adjust rigid bodies based on box shapes to the right position and rotation.
          */
         void boxAdjustExternal(const std::string &mesh, RigidBody* body, float scale, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation);
+
+        /**
+         * Build the collision shape of a mesh at this scale, so that creating rigid bodies
+         * for it later finds the shape ready
+         */
+        void preloadShape(const std::string &mesh, float scale);
         /**
          * Add a HeightField to the simulation
          */
@@ -291,25 +341,43 @@ namespace Physic
         void setSceneManager(Ogre::SceneManager* sceneMgr);
 
         /**
-         * Return the closest object hit by a ray. If there are no objects, it will return ("",-1).
+         * Return the closest object hit by a ray. If there are no objects, it will return (NULL,-1).
          * If \a normal is non-NULL, the hit normal will be written there (if there is a hit)
          */
-        std::pair<std::string,float> rayTest(const btVector3& from,const btVector3& to,bool raycastingObjectOnly = true,
+        std::pair<const RigidBody*,float> rayTest(const btVector3& from,const btVector3& to,bool raycastingObjectOnly = true,
                                              bool ignoreHeightMap = false, Ogre::Vector3* normal = NULL);
 
         /**
          * Return all objects hit by a ray.
          */
-        std::vector< std::pair<float, std::string> > rayTest2(const btVector3 &from, const btVector3 &to, int filterGroup=0xff);
+        std::vector< std::pair<float, const RigidBody*> > rayTest2(const btVector3 &from, const btVector3 &to, int filterGroup=0xff);
 
         std::pair<bool, float> sphereCast (float radius, btVector3& from, btVector3& to);
         ///< @return (hit, relative distance)
 
-        std::vector<std::string> getCollisions(const std::string& name, int collisionGroup, int collisionMask);
-
-        // Get the nearest object that's inside the given object, filtering out objects of the
-        // provided name
-        std::pair<const RigidBody*,btVector3> getFilteredContact(const std::string &filter,
+        /// Same as btCollisionWorld::convexSweepTest, except that the start and end transforms
+        /// must have the same rotation. Only reads the collision world, so it can be called from
+        /// several threads at once, as long as no objects are added, removed or moved meanwhile.
+        /// (The broadphase ray test used by btCollisionWorld keeps its traversal stack in the
+        /// broadphase.)
+        void convexSweepTest (const btConvexShape* shape, const btTransform& from, const btTransform& to,
+                              btCollisionWorld::ConvexResultCallback& callback) const;
+
+        /// Same as btCollisionWorld::rayTest, and thread-safe under the same conditions as
+        /// convexSweepTest.
+        void rayTest (const btVector3& from, const btVector3& to, btCollisionWorld::RayResultCallback& callback) const;
+
+        /// Run a batch of independent queries and write the closest hit of each to the same
+        /// index of \a results. If \a workers is not NULL, the queries are split among its
+        /// threads; the results don't depend on it.
+        void queryBatch (const std::vector<RayQuery>& queries, std::vector<RayQueryResult>& results,
+                         Misc::ThreadPool *workers = NULL) const;
+
+        std::vector<const RigidBody*> getCollisions(const std::string& name, int collisionGroup, int collisionMask);
+
+        // Get the nearest object that's inside the given object, filtering out the provided
+        // collision object
+        std::pair<const RigidBody*,btVector3> getFilteredContact(const btCollisionObject *filter,
                                                                  const btVector3 &origin,
                                                                  btCollisionObject *object);
 
@@ -357,6 +425,9 @@ namespace Physic
         void removeDebugDraw(Ogre::SceneManager *sceneMgr);
 
     private:
+        void runQueries (const std::vector<RayQuery> *queries, std::vector<RayQueryResult> *results,
+                         size_t begin, size_t end) const;
+
         PhysicEngine(const PhysicEngine&);
         PhysicEngine& operator=(const PhysicEngine&);
     };
@@ -370,11 +441,15 @@ namespace Physic
             return rayResult.m_hitFraction;
         }
 
-        static bool cmp( const std::pair<float, std::string>& i, const std::pair<float, std::string>& j )
+        /// Order by hit fraction. Hits at the same fraction are ordered by object ID, then by name for
+        /// bodies without an ID like height fields, so that the order does not depend on addresses.
+        static bool cmp( const std::pair<float, const RigidBody*>& i, const std::pair<float, const RigidBody*>& j )
         {
             if( i.first > j.first ) return false;
             if( j.first > i.first ) return true;
-            return false;
+            if( i.second->mObjectId != j.second->mObjectId )
+                return i.second->mObjectId < j.second->mObjectId;
+            return i.second->mName < j.second->mName;
         }
 
         std::vector < std::pair<float, const btCollisionObject*> > results;
@@ -71,8 +71,7 @@ void ActorTracer::doTrace(btCollisionObject *actor, const Ogre::Vector3 &start,
 
     btCollisionShape *shape = actor->getCollisionShape();
     assert(shape->isConvex());
-    enginePass->mDynamicsWorld->convexSweepTest(static_cast<btConvexShape*>(shape),
-                                               from, to, newTraceCallback);
+    enginePass->convexSweepTest(static_cast<btConvexShape*>(shape), from, to, newTraceCallback);
 
     // Copy the hit data over to our trace results struct:
     if(newTraceCallback.hasHit())
@@ -112,7 +111,7 @@ void ActorTracer::findGround(const OEngine::Physic::PhysicActor* actor, const Og
     halfExtents[2] = 1.0f;
     btCylinderShapeZ base(halfExtents);
 
-    enginePass->mDynamicsWorld->convexSweepTest(&base, from, to, newTraceCallback);
+    enginePass->convexSweepTest(&base, from, to, newTraceCallback);
     if(newTraceCallback.hasHit())
     {
         const btVector3& tracehitnormal = newTraceCallback.m_hitNormalWorld;